@@ -0,0 +1,733 @@
+#include "util/tc_option.h"
+#include "tc_redis_bulkloader.h"
+#include "tc_redis_mockserver.h"
+#include <cmath>
+#include <random>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace tars;
+
+enum OpType
+{
+    OP_GET = 0,
+    OP_SET,
+    OP_MGET,
+    OP_HGET,
+    OP_HSET,
+    OP_INCR,
+    OP_MAX,
+};
+
+static const char *g_sOpName[OP_MAX] = { "get", "set", "mget", "hget", "hset", "incr" };
+
+struct BenchConf
+{
+    TC_RDConf   rdConf;
+
+    /**
+    * proxy: RedisProxy, 连接数即串行连接数(tars_set_protocol); conn: RedisConnection, 支持流水线
+    */
+    string      sMode;
+
+    int         iThreads;
+
+    size_t      iConns;
+
+    size_t      iPipeline;
+
+    /**
+    * 各命令的权重
+    */
+    size_t      vWeight[OP_MAX];
+
+    size_t      iTotalWeight;
+
+    size_t      iMgetKeys;
+
+    uint64_t    iKeys;
+
+    bool        bZipf;
+
+    double      dTheta;
+
+    size_t      iValueSize;
+
+    int         iDuration;
+
+    int         iTimeout;
+
+    string      sPrefix;
+};
+
+/**
+* @brief zipf分布的key序号(YCSB的生成算法), 序号0最热. zeta只在构造时计算一次
+*/
+class ZipfGenerator
+{
+public:
+    ZipfGenerator(uint64_t iItems, double dTheta)
+        : _iItems(iItems)
+        , _dTheta(dTheta)
+    {
+        _dZetan = zeta(iItems, dTheta);
+        _dAlpha = 1.0 / (1.0 - dTheta);
+        _dEta   = (1 - pow(2.0 / iItems, 1 - dTheta)) / (1 - zeta(2, dTheta) / _dZetan);
+    }
+
+    template<typename RNG>
+    uint64_t next(RNG &rng) const
+    {
+        double u  = std::uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * _dZetan;
+
+        if (uz < 1.0)
+        {
+            return 0;
+        }
+
+        if (uz < 1.0 + pow(0.5, _dTheta))
+        {
+            return 1;
+        }
+
+        uint64_t i = (uint64_t)(_iItems * pow(_dEta * u - _dEta + 1, _dAlpha));
+
+        return i < _iItems ? i : _iItems - 1;
+    }
+
+protected:
+    static double zeta(uint64_t n, double dTheta)
+    {
+        double dSum = 0;
+
+        for (uint64_t i = 1; i <= n; i++)
+        {
+            dSum += 1.0 / pow((double)i, dTheta);
+        }
+
+        return dSum;
+    }
+
+protected:
+    uint64_t    _iItems;
+
+    double      _dTheta;
+
+    double      _dZetan;
+
+    double      _dAlpha;
+
+    double      _dEta;
+};
+
+/**
+* @brief 压测线程: 按权重选命令, 按分布选key, 每个命令的延时记录到本线程的直方图
+*/
+class BenchWorker
+{
+public:
+    BenchWorker(const BenchConf &conf, const ZipfGenerator &zipf, int iIndex)
+        : iErr(0)
+        , iMiss(0)
+        , _conf(conf)
+        , _zipf(zipf)
+        , _rng(iIndex * 7919 + 1)
+        , _sValue(conf.iValueSize, 'x')
+    {
+        for (size_t i = 0; i < OP_MAX; i++)
+        {
+            vHist.push_back(std::make_shared<RedisHistogram>());
+        }
+    }
+
+    /**
+    * @brief 通过RedisProxy同步调用, 一次一个命令
+    */
+    void runProxy(RedisPrx prx, int64_t iEnd)
+    {
+        string sValue;
+        vector<string> vKey;
+        vector<pair<int, string> > vValue;
+        int64_t iResult;
+
+        while (TC_Common::now2ms() < iEnd)
+        {
+            OpType op = nextOp();
+            int iRet  = -1;
+
+            int64_t iBegin = TC_Common::now2us();
+
+            try
+            {
+                switch (op)
+                {
+                case OP_GET:  iRet = prx->get(key(nextKey()), sValue); break;
+                case OP_SET:  iRet = prx->set(key(nextKey()), _sValue); break;
+                case OP_HGET: iRet = prx->hget(hashKey(nextKey()), "f", sValue); break;
+                case OP_HSET: iRet = prx->hset(hashKey(nextKey()), "f", _sValue); break;
+                case OP_INCR: iRet = prx->incr(key(nextKey()), iResult); break;
+                case OP_MGET:
+                    vKey.clear();
+                    for (size_t i = 0; i < _conf.iMgetKeys; i++)
+                    {
+                        vKey.push_back(key(nextKey()));
+                    }
+                    iRet = prx->get(vKey, vValue);
+                    break;
+                default: break;
+                }
+            }
+            catch (exception &ex)
+            {
+                iRet = -1;
+            }
+
+            record(op, TC_Common::now2us() - iBegin);
+
+            if (iRet < 0)
+            {
+                ++iErr;
+            }
+            else if (iRet == 1)
+            {
+                ++iMiss;
+            }
+        }
+    }
+
+    /**
+    * @brief 在独占的RedisConnection上流水线: 每轮先在所有连接上各发送iPipeline个命令, 再依次收取应答.
+    *        命令的延时从所在批次发送前算到其应答解析完
+    */
+    void runConn(vector<RedisConnectionPtr> &vConn, int64_t iEnd)
+    {
+        vector<vector<OpType> > vOp(vConn.size());
+        vector<int64_t> vSend(vConn.size());
+        string sBuffer;
+        RedisReply reply;
+
+        while (TC_Common::now2ms() < iEnd)
+        {
+            for (size_t c = 0; c < vConn.size(); c++)
+            {
+                vOp[c].clear();
+
+                if (!vConn[c]->isConnected() && vConn[c]->connect() != 0)
+                {
+                    ++iErr;
+                    continue;
+                }
+
+                sBuffer.clear();
+
+                for (size_t i = 0; i < _conf.iPipeline; i++)
+                {
+                    vOp[c].push_back(nextOp());
+                    encode(vOp[c].back(), sBuffer);
+                }
+
+                vSend[c] = TC_Common::now2us();
+
+                if (vConn[c]->send(sBuffer.data(), sBuffer.size(), vOp[c].size()) != 0)
+                {
+                    iErr += vOp[c].size();
+                    vOp[c].clear();
+                }
+            }
+
+            for (size_t c = 0; c < vConn.size(); c++)
+            {
+                for (size_t i = 0; i < vOp[c].size(); i++)
+                {
+                    if (vConn[c]->readReply(reply) != 0)
+                    {
+                        //连接已关闭, 下一轮重连
+                        iErr += vOp[c].size() - i;
+                        break;
+                    }
+
+                    record(vOp[c][i], TC_Common::now2us() - vSend[c]);
+
+                    if (reply.isError())
+                    {
+                        ++iErr;
+                    }
+                    else if (reply.isNil())
+                    {
+                        ++iMiss;
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    vector<RedisHistogramPtr>   vHist;
+
+    uint64_t                    iErr;
+
+    uint64_t                    iMiss;
+
+protected:
+    OpType nextOp()
+    {
+        size_t iPick = std::uniform_int_distribution<size_t>(0, _conf.iTotalWeight - 1)(_rng);
+
+        for (size_t i = 0; i < OP_MAX; i++)
+        {
+            if (iPick < _conf.vWeight[i])
+            {
+                return (OpType)i;
+            }
+
+            iPick -= _conf.vWeight[i];
+        }
+
+        return OP_GET;
+    }
+
+    uint64_t nextKey()
+    {
+        if (_conf.bZipf)
+        {
+            return _zipf.next(_rng);
+        }
+
+        return std::uniform_int_distribution<uint64_t>(0, _conf.iKeys - 1)(_rng);
+    }
+
+    string key(uint64_t iKey) const
+    {
+        return _conf.sPrefix + TC_Common::tostr(iKey);
+    }
+
+    string hashKey(uint64_t iKey) const
+    {
+        return _conf.sPrefix + "h:" + TC_Common::tostr(iKey);
+    }
+
+    void encode(OpType op, string &sBuffer)
+    {
+        switch (op)
+        {
+        case OP_GET:
+            RedisProxy::appendCommandHeader(sBuffer, 2);
+            RedisProxy::appendCommandArg(sBuffer, "GET", 3);
+            RedisProxy::appendCommandArg(sBuffer, key(nextKey()));
+            break;
+        case OP_SET:
+            RedisProxy::appendCommandHeader(sBuffer, 3);
+            RedisProxy::appendCommandArg(sBuffer, "SET", 3);
+            RedisProxy::appendCommandArg(sBuffer, key(nextKey()));
+            RedisProxy::appendCommandArg(sBuffer, _sValue);
+            break;
+        case OP_MGET:
+            RedisProxy::appendCommandHeader(sBuffer, 1 + _conf.iMgetKeys);
+            RedisProxy::appendCommandArg(sBuffer, "MGET", 4);
+            for (size_t i = 0; i < _conf.iMgetKeys; i++)
+            {
+                RedisProxy::appendCommandArg(sBuffer, key(nextKey()));
+            }
+            break;
+        case OP_HGET:
+            RedisProxy::appendCommandHeader(sBuffer, 3);
+            RedisProxy::appendCommandArg(sBuffer, "HGET", 4);
+            RedisProxy::appendCommandArg(sBuffer, hashKey(nextKey()));
+            RedisProxy::appendCommandArg(sBuffer, "f", 1);
+            break;
+        case OP_HSET:
+            RedisProxy::appendCommandHeader(sBuffer, 4);
+            RedisProxy::appendCommandArg(sBuffer, "HSET", 4);
+            RedisProxy::appendCommandArg(sBuffer, hashKey(nextKey()));
+            RedisProxy::appendCommandArg(sBuffer, "f", 1);
+            RedisProxy::appendCommandArg(sBuffer, _sValue);
+            break;
+        case OP_INCR:
+            RedisProxy::appendCommandHeader(sBuffer, 2);
+            RedisProxy::appendCommandArg(sBuffer, "INCR", 4);
+            RedisProxy::appendCommandArg(sBuffer, key(nextKey()) + ":n");
+            break;
+        default:
+            break;
+        }
+    }
+
+    void record(OpType op, int64_t iCost)
+    {
+        vHist[op]->record(iCost > 0 ? iCost : 0);
+    }
+
+protected:
+    const BenchConf     &_conf;
+
+    const ZipfGenerator &_zipf;
+
+    std::mt19937_64     _rng;
+
+    string              _sValue;
+};
+
+/**
+* @brief 合并后的一项统计
+*/
+struct BenchStat
+{
+    string   sName;
+
+    uint64_t iCount;
+
+    double   dQps;
+
+    uint64_t iAvg;
+
+    uint64_t iP50;
+
+    uint64_t iP99;
+
+    uint64_t iP999;
+
+    uint64_t iMax;
+};
+
+BenchStat toStat(const string &sName, const vector<uint64_t> &vBucket, uint64_t iCount, uint64_t iSum, uint64_t iMax, double dSecond)
+{
+    BenchStat stat;
+
+    stat.sName  = sName;
+    stat.iCount = iCount;
+    stat.dQps   = iCount / dSecond;
+    stat.iAvg   = iCount > 0 ? iSum / iCount : 0;
+    stat.iP50   = RedisHistogram::percentile(vBucket, iCount, 0.5);
+    stat.iP99   = RedisHistogram::percentile(vBucket, iCount, 0.99);
+    stat.iP999  = RedisHistogram::percentile(vBucket, iCount, 0.999);
+    stat.iMax   = iMax;
+
+    return stat;
+}
+
+/**
+* @brief 按配置预先写入全部key, 避免读命令全部未命中
+*/
+int populate(const BenchConf &conf)
+{
+    RedisBulkLoader loader;
+    loader.init(conf.rdConf, 1000, 64 * 1024, conf.iTimeout);
+
+    string sValue(conf.iValueSize, 'x');
+    uint64_t iIndex = 0;
+
+    int iRet = loader.loadCommand([&](vector<string> &vPart) -> bool
+    {
+        if (iIndex >= conf.iKeys * 2)
+        {
+            return false;
+        }
+
+        uint64_t iKey = iIndex / 2;
+
+        if (iIndex++ % 2 == 0)
+        {
+            vPart.push_back("SET");
+            vPart.push_back(conf.sPrefix + TC_Common::tostr(iKey));
+            vPart.push_back(sValue);
+        }
+        else
+        {
+            vPart.push_back("HSET");
+            vPart.push_back(conf.sPrefix + "h:" + TC_Common::tostr(iKey));
+            vPart.push_back("f");
+            vPart.push_back(sValue);
+        }
+
+        return true;
+    });
+
+    cerr << "populate ret:" << iRet << " sent:" << loader.getSent() << " cost:" << loader.getCost() << "ms" << endl;
+
+    return iRet;
+}
+
+/**
+* @brief 解析 get:80,set:20
+*/
+int parseOps(const string &sOps, BenchConf &conf)
+{
+    conf.iTotalWeight = 0;
+
+    for (size_t i = 0; i < OP_MAX; i++)
+    {
+        conf.vWeight[i] = 0;
+    }
+
+    vector<string> vOps = TC_Common::sepstr<string>(sOps, ",");
+
+    for (size_t i = 0; i < vOps.size(); i++)
+    {
+        vector<string> vPair = TC_Common::sepstr<string>(vOps[i], ":");
+        size_t iOp = 0;
+
+        while (iOp < OP_MAX && TC_Common::lower(TC_Common::trim(vPair[0])) != g_sOpName[iOp])
+        {
+            ++iOp;
+        }
+
+        if (iOp == OP_MAX)
+        {
+            cerr << "unknown op:" << vPair[0] << endl;
+            return -1;
+        }
+
+        conf.vWeight[iOp]  = vPair.size() > 1 ? TC_Common::strto<size_t>(vPair[1]) : 1;
+        conf.iTotalWeight += conf.vWeight[iOp];
+    }
+
+    return conf.iTotalWeight > 0 ? 0 : -1;
+}
+
+void printText(const BenchConf &conf, const vector<BenchStat> &vStat, uint64_t iErr, uint64_t iMiss)
+{
+    cout << "mode:" << conf.sMode << " threads:" << conf.iThreads << " conns:" << conf.iConns
+         << " pipeline:" << conf.iPipeline << " keys:" << conf.iKeys
+         << " dist:" << (conf.bZipf ? "zipf(" + TC_Common::tostr(conf.dTheta) + ")" : string("uniform"))
+         << " value-size:" << conf.iValueSize << " duration:" << conf.iDuration << "s" << endl;
+
+    cout << "op\tcount\tqps\tavg(us)\tp50\tp99\tp999\tmax" << endl;
+
+    for (size_t i = 0; i < vStat.size(); i++)
+    {
+        const BenchStat &s = vStat[i];
+
+        cout << s.sName << "\t" << s.iCount << "\t" << (uint64_t)s.dQps << "\t" << s.iAvg << "\t" << s.iP50
+             << "\t" << s.iP99 << "\t" << s.iP999 << "\t" << s.iMax << endl;
+    }
+
+    cout << "errors:" << iErr << " misses:" << iMiss << endl;
+}
+
+void printJson(const BenchConf &conf, const vector<BenchStat> &vStat, uint64_t iErr, uint64_t iMiss)
+{
+    cout << "{\"conf\":{\"mode\":\"" << conf.sMode << "\",\"threads\":" << conf.iThreads << ",\"conns\":" << conf.iConns
+         << ",\"pipeline\":" << conf.iPipeline << ",\"keys\":" << conf.iKeys
+         << ",\"dist\":\"" << (conf.bZipf ? "zipf" : "uniform") << "\",\"theta\":" << conf.dTheta
+         << ",\"value_size\":" << conf.iValueSize << ",\"duration\":" << conf.iDuration << "}"
+         << ",\"errors\":" << iErr << ",\"misses\":" << iMiss << ",\"ops\":{";
+
+    for (size_t i = 0; i < vStat.size(); i++)
+    {
+        const BenchStat &s = vStat[i];
+
+        cout << (i > 0 ? "," : "") << "\"" << s.sName << "\":{\"count\":" << s.iCount << ",\"qps\":" << (uint64_t)s.dQps
+             << ",\"avg\":" << s.iAvg << ",\"p50\":" << s.iP50 << ",\"p99\":" << s.iP99
+             << ",\"p999\":" << s.iP999 << ",\"max\":" << s.iMax << "}";
+    }
+
+    cout << "}}" << endl;
+}
+
+void usage(char *argv)
+{
+    cout << "Usage:" << argv << " --host=127.0.0.1 --port=6379 [--pass=] [--index=0]" << endl;
+    cout << "    [--mode=proxy|conn]                 proxy: RedisProxy, conn: RedisConnection with pipeline" << endl;
+    cout << "    [--threads=4] [--conns=4]           conns is the serial connection count in proxy mode" << endl;
+    cout << "    [--pipeline=1]                      commands in flight per connection (conn mode)" << endl;
+    cout << "    [--ops=get:80,set:20]               weights of get,set,mget,hget,hset,incr" << endl;
+    cout << "    [--mget-keys=10] [--keys=100000] [--dist=uniform|zipf] [--theta=0.99]" << endl;
+    cout << "    [--value-size=100] [--duration=10] [--timeout=3000] [--prefix=bench:]" << endl;
+    cout << "    [--populate]                        write all keys before the run" << endl;
+    cout << "    [--json]                            print result as json" << endl;
+    cout << "    [--mock] [--mock-latency=0] [--mock-fragment=0]   run against an in-process mock server on host:port" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        TC_Option option;
+        option.decode(argc, argv);
+
+        if (option.hasParam("help") || (option.getValue("host").empty() && !option.hasParam("mock")))
+        {
+            usage(argv[0]);
+            return 0;
+        }
+
+        map<string, string> mpParam;
+        mpParam["host"]  = option.getValue("host").empty() ? "127.0.0.1" : option.getValue("host");
+        mpParam["port"]  = option.getValue("port");
+        mpParam["pass"]  = option.getValue("pass");
+        mpParam["index"] = option.getValue("index");
+
+        BenchConf conf;
+        conf.rdConf.loadFromMap(mpParam);
+
+        conf.sMode      = option.hasParam("mode") ? option.getValue("mode") : "proxy";
+        conf.iThreads   = option.hasParam("threads") ? TC_Common::strto<int>(option.getValue("threads")) : 4;
+        conf.iConns     = option.hasParam("conns") ? TC_Common::strto<size_t>(option.getValue("conns")) : 4;
+        conf.iPipeline  = option.hasParam("pipeline") ? TC_Common::strto<size_t>(option.getValue("pipeline")) : 1;
+        conf.iMgetKeys  = option.hasParam("mget-keys") ? TC_Common::strto<size_t>(option.getValue("mget-keys")) : 10;
+        conf.iKeys      = option.hasParam("keys") ? TC_Common::strto<uint64_t>(option.getValue("keys")) : 100000;
+        conf.bZipf      = option.getValue("dist") == "zipf";
+        conf.dTheta     = option.hasParam("theta") ? TC_Common::strto<double>(option.getValue("theta")) : 0.99;
+        conf.iValueSize = option.hasParam("value-size") ? TC_Common::strto<size_t>(option.getValue("value-size")) : 100;
+        conf.iDuration  = option.hasParam("duration") ? TC_Common::strto<int>(option.getValue("duration")) : 10;
+        conf.iTimeout   = option.hasParam("timeout") ? TC_Common::strto<int>(option.getValue("timeout")) : 3000;
+        conf.sPrefix    = option.hasParam("prefix") ? option.getValue("prefix") : "bench:";
+
+        if (parseOps(option.hasParam("ops") ? option.getValue("ops") : "get:80,set:20", conf) != 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+
+        conf.iThreads  = std::max(conf.iThreads, 1);
+        conf.iPipeline = std::max<size_t>(conf.iPipeline, 1);
+        conf.iMgetKeys = std::max<size_t>(conf.iMgetKeys, 1);
+        conf.iKeys     = std::max<uint64_t>(conf.iKeys, 2);
+
+        //每个线程至少一条连接
+        if (conf.sMode == "conn")
+        {
+            conf.iConns = std::max<size_t>(conf.iConns, conf.iThreads);
+        }
+
+        if (conf.bZipf && (conf.dTheta <= 0 || conf.dTheta >= 1))
+        {
+            cerr << "theta must be in (0, 1)" << endl;
+            return 1;
+        }
+
+        //进程内的模拟服务端, 只测量客户端自身的开销
+        RedisMockServer mock;
+
+        if (option.hasParam("mock"))
+        {
+            if (mock.start(conf.rdConf._host, conf.rdConf._port) != 0)
+            {
+                return 1;
+            }
+
+            mock.setLatency(TC_Common::strto<int64_t>(option.getValue("mock-latency")));
+            mock.setFragment(TC_Common::strto<size_t>(option.getValue("mock-fragment")));
+        }
+
+        if (option.hasParam("populate") && populate(conf) != 0)
+        {
+            return 1;
+        }
+
+        ZipfGenerator zipf(conf.bZipf ? conf.iKeys : 2, conf.dTheta);
+
+        Communicator comm;
+        RedisPrx prx;
+
+        if (conf.sMode == "proxy")
+        {
+            ProxyProtocol prot;
+            prot.requestFunc  = RedisProxy::redisRequest;
+            prot.responseFunc = RedisProxy::redisResponse;
+
+            prx = comm.stringToProxy<RedisPrx>(RedisProxy::genRedisObj(conf.rdConf));
+            prx->tars_set_protocol(prot, conf.iConns);
+            prx->tars_timeout(conf.iTimeout);
+        }
+
+        vector<shared_ptr<BenchWorker> > vWorker;
+        vector<vector<RedisConnectionPtr> > vConn(conf.iThreads);
+
+        for (int i = 0; i < conf.iThreads; i++)
+        {
+            vWorker.push_back(std::make_shared<BenchWorker>(conf, zipf, i));
+        }
+
+        if (conf.sMode == "conn")
+        {
+            for (size_t i = 0; i < conf.iConns; i++)
+            {
+                RedisConnectionPtr conn = std::make_shared<RedisConnection>();
+                conn->init(conf.rdConf, conf.iTimeout);
+
+                if (conn->connect() != 0)
+                {
+                    cerr << "connect error:" << conf.rdConf._host << ":" << conf.rdConf._port << endl;
+                    return 1;
+                }
+
+                vConn[i % conf.iThreads].push_back(conn);
+            }
+        }
+
+        int64_t iBegin = TC_Common::now2ms();
+        int64_t iEnd   = iBegin + conf.iDuration * 1000LL;
+
+        vector<std::thread> vThread;
+
+        for (int i = 0; i < conf.iThreads; i++)
+        {
+            if (conf.sMode == "conn")
+            {
+                vThread.push_back(std::thread(&BenchWorker::runConn, vWorker[i].get(), std::ref(vConn[i]), iEnd));
+            }
+            else
+            {
+                vThread.push_back(std::thread(&BenchWorker::runProxy, vWorker[i].get(), prx, iEnd));
+            }
+        }
+
+        for (size_t i = 0; i < vThread.size(); i++)
+        {
+            vThread[i].join();
+        }
+
+        double dSecond = std::max<int64_t>(TC_Common::now2ms() - iBegin, 1) / 1000.0;
+
+        vector<BenchStat> vStat;
+        vector<uint64_t> vTotal;
+        uint64_t iTotalCount = 0, iTotalSum = 0, iTotalMax = 0, iErr = 0, iMiss = 0;
+
+        for (size_t op = 0; op < OP_MAX; op++)
+        {
+            if (conf.vWeight[op] == 0)
+            {
+                continue;
+            }
+
+            vector<uint64_t> vBucket;
+            uint64_t iCount = 0, iSum = 0, iMax = 0;
+
+            for (size_t i = 0; i < vWorker.size(); i++)
+            {
+                vWorker[i]->vHist[op]->mergeTo(vBucket, iCount, iSum, iMax);
+                vWorker[i]->vHist[op]->mergeTo(vTotal, iTotalCount, iTotalSum, iTotalMax);
+            }
+
+            vStat.push_back(toStat(g_sOpName[op], vBucket, iCount, iSum, iMax, dSecond));
+        }
+
+        vStat.push_back(toStat("all", vTotal, iTotalCount, iTotalSum, iTotalMax, dSecond));
+
+        for (size_t i = 0; i < vWorker.size(); i++)
+        {
+            iErr  += vWorker[i]->iErr;
+            iMiss += vWorker[i]->iMiss;
+        }
+
+        if (option.hasParam("json"))
+        {
+            printJson(conf, vStat, iErr, iMiss);
+        }
+        else
+        {
+            printText(conf, vStat, iErr, iMiss);
+        }
+
+        return 0;
+    }
+    catch (exception &ex)
+    {
+        cerr << "exception:" << ex.what() << endl;
+    }
+
+    return 1;
+}
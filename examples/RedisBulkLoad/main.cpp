@@ -0,0 +1,105 @@
+#include "util/tc_option.h"
+#include "tc_redis_bulkloader.h"
+#include <iostream>
+
+using namespace std;
+using namespace tars;
+
+void usage(char *argv)
+{
+    cout << "Usage:" << argv << " --host=127.0.0.1 --port=6379 [--pass=] [--index=0]" << endl;
+    cout << "    [--file=data.txt] [--sep=tab]       import key<sep>value lines from file" << endl;
+    cout << "    [--gen=100000] [--value-size=100] [--prefix=key:]   import generated data" << endl;
+    cout << "    [--window=1000] [--batch=65536] [--expire=0] [--timeout=3000]" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        TC_Option option;
+        option.decode(argc, argv);
+
+        if (option.hasParam("help") || option.getValue("host").empty())
+        {
+            usage(argv[0]);
+            return 0;
+        }
+
+        map<string, string> mpParam;
+        mpParam["host"]  = option.getValue("host");
+        mpParam["port"]  = option.getValue("port");
+        mpParam["pass"]  = option.getValue("pass");
+        mpParam["index"] = option.getValue("index");
+
+        TC_RDConf tcRDConf;
+        tcRDConf.loadFromMap(mpParam);
+
+        size_t iWindow = option.hasParam("window") ? TC_Common::strto<size_t>(option.getValue("window")) : 1000;
+        size_t iBatch  = option.hasParam("batch") ? TC_Common::strto<size_t>(option.getValue("batch")) : 64 * 1024;
+        int iTimeout   = option.hasParam("timeout") ? TC_Common::strto<int>(option.getValue("timeout")) : 3000;
+
+        RedisBulkLoader loader;
+        loader.init(tcRDConf, iWindow, iBatch, iTimeout);
+        loader.setExpire(TC_Common::strto<unsigned int>(option.getValue("expire")));
+
+        size_t iReport = 0;
+
+        loader.setErrorCallback([&](const string &sKey, const string &sError)
+        {
+            //只打印前100个错误
+            if (iReport++ < 100)
+            {
+                cerr << "key:" << sKey << " error:" << sError << endl;
+            }
+        });
+
+        int iRet = -1;
+
+        if (option.hasParam("file"))
+        {
+            string sSep = option.getValue("sep");
+            char cSep   = (sSep.empty() || sSep == "tab") ? '\t' : sSep[0];
+
+            iRet = loader.loadFile(option.getValue("file"), cSep);
+        }
+        else
+        {
+            size_t iTotal     = option.hasParam("gen") ? TC_Common::strto<size_t>(option.getValue("gen")) : 100000;
+            size_t iValueSize = option.hasParam("value-size") ? TC_Common::strto<size_t>(option.getValue("value-size")) : 100;
+            string sPrefix    = option.hasParam("prefix") ? option.getValue("prefix") : "key:";
+            size_t iIndex     = 0;
+
+            iRet = loader.load([&](string &sKey, string &sValue) -> bool
+            {
+                if (iIndex >= iTotal)
+                {
+                    return false;
+                }
+
+                sKey = sPrefix + TC_Common::tostr(iIndex++);
+                sValue.assign(iValueSize, 'x');
+
+                return true;
+            });
+        }
+
+        int64_t iCost = loader.getCost() > 0 ? loader.getCost() : 1;
+
+        cout << "ret:" << iRet
+             << " sent:" << loader.getSent()
+             << " succ:" << loader.getSucc()
+             << " failed:" << loader.getFailed()
+             << " cost:" << iCost << "ms"
+             << " qps:" << loader.getSent() * 1000 / iCost
+             << endl;
+
+        return iRet == 0 ? 0 : 1;
+    }
+    catch (exception &ex)
+    {
+        cerr << "exception:" << ex.what() << endl;
+    }
+
+    return 1;
+}
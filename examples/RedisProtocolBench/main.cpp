@@ -0,0 +1,671 @@
+#include "util/tc_option.h"
+#include "util/tc_file.h"
+#include "tc_redis.h"
+#include "tc_redis_mockserver.h"
+#include <functional>
+#include <iostream>
+
+using namespace std;
+using namespace tars;
+
+/**
+* @brief 协议层的微基准测试(编码, 分帧, 解码), 风格类似google benchmark:
+*        每个用例自动增加迭代次数直到运行时间足够, 输出 ns/op 及 MB/s
+*/
+
+/**
+* @brief 阻止编译器把被测结果优化掉
+*/
+template<typename T>
+inline void escape(T &t)
+{
+    asm volatile("" : : "g"(&t) : "memory");
+}
+
+struct BenchState
+{
+    /**
+    * 本轮需要执行的次数
+    */
+    uint64_t iIterations;
+
+    /**
+    * 本轮处理的字节数, 由用例设置
+    */
+    uint64_t iBytes;
+};
+
+typedef std::function<void(BenchState &)> BenchFunc;
+
+struct BenchCase
+{
+    string      sName;
+
+    BenchFunc   func;
+};
+
+struct BenchResult
+{
+    string      sName;
+
+    uint64_t    iIterations;
+
+    double      dNsPerOp;
+
+    double      dMBPerSec;
+};
+
+class BenchRunner
+{
+public:
+    BenchRunner(double dMinTime, const string &sFilter)
+        : _dMinTime(dMinTime)
+        , _sFilter(sFilter)
+        , _bJson(false)
+    {
+    }
+
+    void add(const string &sName, const BenchFunc &func)
+    {
+        if (_sFilter.empty() || sName.find(_sFilter) != string::npos)
+        {
+            BenchCase c;
+            c.sName = sName;
+            c.func  = func;
+
+            _vCase.push_back(c);
+        }
+    }
+
+    /**
+    * @brief 迭代次数从1开始倍增, 超过10ms后按耗时估算出满足最短运行时间的次数再跑一轮
+    */
+    vector<BenchResult> run()
+    {
+        vector<BenchResult> vResult;
+
+        for (size_t i = 0; i < _vCase.size(); i++)
+        {
+            BenchState state;
+            state.iIterations = 1;
+
+            int64_t iCost = 0;
+
+            while (true)
+            {
+                state.iBytes = 0;
+
+                int64_t iBegin = TC_Common::now2us();
+                _vCase[i].func(state);
+                iCost = std::max<int64_t>(TC_Common::now2us() - iBegin, 1);
+
+                if (iCost >= _dMinTime * 1e6)
+                {
+                    break;
+                }
+
+                uint64_t iNext = iCost < 10000 ? state.iIterations * 2 : (uint64_t)(state.iIterations * _dMinTime * 1e6 * 1.2 / iCost);
+
+                state.iIterations = std::max(iNext, state.iIterations + 1);
+            }
+
+            BenchResult result;
+            result.sName       = _vCase[i].sName;
+            result.iIterations = state.iIterations;
+            result.dNsPerOp    = iCost * 1000.0 / state.iIterations;
+            result.dMBPerSec   = state.iBytes / (iCost / 1e6) / (1024 * 1024);
+
+            vResult.push_back(result);
+
+            if (!_bJson)
+            {
+                print(result);
+            }
+        }
+
+        return vResult;
+    }
+
+    void setJson(bool bJson) { _bJson = bJson; }
+
+    static void print(const BenchResult &r)
+    {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%-56s %12llu %14.1f ns/op %12.1f MB/s", r.sName.c_str(), (unsigned long long)r.iIterations, r.dNsPerOp, r.dMBPerSec);
+
+        cout << buf << endl;
+    }
+
+    static void printJson(const vector<BenchResult> &vResult)
+    {
+        cout << "{\"benchmarks\":[";
+
+        for (size_t i = 0; i < vResult.size(); i++)
+        {
+            const BenchResult &r = vResult[i];
+
+            cout << (i > 0 ? "," : "") << "{\"name\":\"" << r.sName << "\",\"iterations\":" << r.iIterations
+                 << ",\"ns_per_op\":" << r.dNsPerOp << ",\"mb_per_sec\":" << r.dMBPerSec << "}";
+        }
+
+        cout << "]}" << endl;
+    }
+
+protected:
+    double              _dMinTime;
+
+    string              _sFilter;
+
+    bool                _bJson;
+
+    vector<BenchCase>   _vCase;
+};
+
+/**
+* @brief 应答语料
+*/
+struct Corpus
+{
+    string sName;
+
+    string sReply;
+};
+
+string bulk(const string &s)
+{
+    return "$" + TC_Common::tostr(s.size()) + "\r\n" + s + "\r\n";
+}
+
+/**
+* @brief 生成的语料: 小GET, 1MB bulk, 10万元素数组, 嵌套数组等
+*/
+vector<Corpus> genCorpus()
+{
+    vector<Corpus> vCorpus;
+    Corpus c;
+
+    c.sName  = "status";
+    c.sReply = "+OK\r\n";
+    vCorpus.push_back(c);
+
+    c.sName  = "get_16B";
+    c.sReply = bulk(string(16, 'v'));
+    vCorpus.push_back(c);
+
+    c.sName  = "get_nil";
+    c.sReply = "$-1\r\n";
+    vCorpus.push_back(c);
+
+    c.sName  = "get_1MB";
+    c.sReply = bulk(string(1024 * 1024, 'v'));
+    vCorpus.push_back(c);
+
+    c.sName  = "mget_10";
+    c.sReply = "*10\r\n";
+    for (int i = 0; i < 10; i++)
+    {
+        c.sReply += i % 5 == 4 ? string("$-1\r\n") : bulk("value:" + TC_Common::tostr(i));
+    }
+    vCorpus.push_back(c);
+
+    c.sName  = "array_100k";
+    c.sReply = "*100000\r\n";
+    for (int i = 0; i < 100000; i++)
+    {
+        c.sReply += bulk("member:" + TC_Common::tostr(i));
+    }
+    vCorpus.push_back(c);
+
+    //类似XRANGE: [id, [field, value, field, value]]
+    c.sName  = "nested_stream_1k";
+    c.sReply = "*1000\r\n";
+    for (int i = 0; i < 1000; i++)
+    {
+        c.sReply += "*2\r\n" + bulk("1700000000000-" + TC_Common::tostr(i)) + "*4\r\n" + bulk("f1") + bulk("v" + TC_Common::tostr(i)) + bulk("f2") + ":" + TC_Common::tostr(i) + "\r\n";
+    }
+    vCorpus.push_back(c);
+
+    c.sName  = "nested_depth_32";
+    c.sReply.clear();
+    for (int i = 0; i < 32; i++)
+    {
+        c.sReply += "*2\r\n:" + TC_Common::tostr(i) + "\r\n";
+    }
+    c.sReply += bulk("leaf");
+    vCorpus.push_back(c);
+
+    return vCorpus;
+}
+
+/**
+* @brief 格式错误的应答, 分帧时必须识别为协议错误(连接随之关闭), 而不是一直等待数据
+*/
+vector<Corpus> genMalformed()
+{
+    vector<Corpus> vCorpus;
+    Corpus c;
+
+    c.sName  = "bulk_over_limit";
+    c.sReply = "$999999999999\r\n";
+    vCorpus.push_back(c);
+
+    c.sName  = "array_negative";
+    c.sReply = "*-5\r\n";
+    vCorpus.push_back(c);
+
+    c.sName  = "bulk_non_digit";
+    c.sReply = "$12a\r\nvalue\r\n";
+    vCorpus.push_back(c);
+
+    c.sName  = "integer_overflow";
+    c.sReply = ":99999999999999999999\r\n";
+    vCorpus.push_back(c);
+
+    c.sName  = "nested_over_limit";
+    c.sReply = "*2\r\n$3\r\nabc\r\n$99999999999999999999\r\n";
+    vCorpus.push_back(c);
+
+    return vCorpus;
+}
+
+/**
+* @brief 检查格式错误的应答被识别为协议错误
+*
+* @return 是否正确识别
+*/
+bool checkError(const string &sReply)
+{
+    RedisRsp rsp;
+    TC_NetWorkBuffer::Buffer buff;
+
+    buff.addBuffer(sReply.data(), sReply.size());
+
+    return !rsp.decode(buff) && rsp.isError();
+}
+
+/**
+* @brief 检查在每个字节处拆成两段时都能正确分帧
+*
+* @return 出错的拆分位置, -1 全部正确
+*/
+int64_t checkSplit(const string &sReply)
+{
+    RedisRsp rsp;
+    TC_NetWorkBuffer::Buffer buff;
+
+    for (size_t k = 1; k < sReply.size(); k++)
+    {
+        rsp.reset();
+
+        buff.addBuffer(sReply.data(), k);
+
+        if (rsp.decode(buff))
+        {
+            return k;
+        }
+
+        buff.addBuffer(sReply.data() + k, sReply.size() - k);
+
+        if (!rsp.decode(buff) || rsp.getBuffer() != sReply)
+        {
+            return k;
+        }
+    }
+
+    return -1;
+}
+
+void addEncode(BenchRunner &runner)
+{
+    struct Cmd
+    {
+        string          sName;
+
+        vector<string>  vPart;
+    };
+
+    vector<Cmd> vCmd(4);
+
+    vCmd[0].sName = "get";
+    vCmd[0].vPart = { "GET", "user:12345:profile" };
+
+    vCmd[1].sName = "set_100B";
+    vCmd[1].vPart = { "SET", "user:12345:profile", string(100, 'v') };
+
+    vCmd[2].sName = "set_1MB";
+    vCmd[2].vPart = { "SET", "user:12345:profile", string(1024 * 1024, 'v') };
+
+    vCmd[3].sName = "mset_100";
+    vCmd[3].vPart.push_back("MSET");
+    for (int i = 0; i < 100; i++)
+    {
+        vCmd[3].vPart.push_back("key:" + TC_Common::tostr(i));
+        vCmd[3].vPart.push_back(string(32, 'v'));
+    }
+
+    for (size_t c = 0; c < vCmd.size(); c++)
+    {
+        vector<string> vPart = vCmd[c].vPart;
+
+        runner.add("encode/buildCommand/" + vCmd[c].sName, [vPart](BenchState &state)
+        {
+            string sCommand;
+
+            for (uint64_t i = 0; i < state.iIterations; i++)
+            {
+                RedisProxy::buildCommand(vPart, sCommand);
+                escape(sCommand);
+                state.iBytes += sCommand.size();
+            }
+        });
+
+        runner.add("encode/appendCommandArg/" + vCmd[c].sName, [vPart](BenchState &state)
+        {
+            string sCommand;
+
+            for (uint64_t i = 0; i < state.iIterations; i++)
+            {
+                sCommand.clear();
+
+                RedisProxy::appendCommandHeader(sCommand, vPart.size());
+
+                for (size_t j = 0; j < vPart.size(); j++)
+                {
+                    RedisProxy::appendCommandArg(sCommand, vPart[j]);
+                }
+
+                escape(sCommand);
+                state.iBytes += sCommand.size();
+            }
+        });
+    }
+}
+
+void addDecode(BenchRunner &runner, const vector<Corpus> &vCorpus)
+{
+    for (size_t c = 0; c < vCorpus.size(); c++)
+    {
+        const string &sReply = vCorpus[c].sReply;
+
+        //网络线程上的分帧: 整包到达
+        runner.add("frame/RedisRsp::decode/" + vCorpus[c].sName, [&sReply](BenchState &state)
+        {
+            RedisRsp rsp;
+            TC_NetWorkBuffer::Buffer buff;
+
+            for (uint64_t i = 0; i < state.iIterations; i++)
+            {
+                rsp.reset();
+                buff.addBuffer(sReply.data(), sReply.size());
+
+                bool bFull = rsp.decode(buff);
+                escape(bFull);
+
+                state.iBytes += sReply.size();
+            }
+        });
+
+        //按MSS大小分段到达
+        if (sReply.size() > 1460)
+        {
+            runner.add("frame/RedisRsp::decode_1460B_segments/" + vCorpus[c].sName, [&sReply](BenchState &state)
+            {
+                RedisRsp rsp;
+                TC_NetWorkBuffer::Buffer buff;
+
+                for (uint64_t i = 0; i < state.iIterations; i++)
+                {
+                    rsp.reset();
+
+                    for (size_t iPos = 0; iPos < sReply.size(); iPos += 1460)
+                    {
+                        buff.addBuffer(sReply.data() + iPos, std::min<size_t>(1460, sReply.size() - iPos));
+
+                        bool bFull = rsp.decode(buff);
+                        escape(bFull);
+                    }
+
+                    state.iBytes += sReply.size();
+                }
+            });
+        }
+        else
+        {
+            //依次在每个字节处拆成两段
+            runner.add("frame/RedisRsp::decode_every_split/" + vCorpus[c].sName, [&sReply](BenchState &state)
+            {
+                RedisRsp rsp;
+                TC_NetWorkBuffer::Buffer buff;
+
+                for (uint64_t i = 0; i < state.iIterations; i++)
+                {
+                    size_t k = 1 + i % (sReply.size() - 1);
+
+                    rsp.reset();
+
+                    buff.addBuffer(sReply.data(), k);
+                    bool bFull = rsp.decode(buff);
+                    escape(bFull);
+
+                    buff.addBuffer(sReply.data() + k, sReply.size() - k);
+                    bFull = rsp.decode(buff);
+                    escape(bFull);
+
+                    state.iBytes += sReply.size();
+                }
+            });
+        }
+
+        runner.add("decode/RedisReplyParser::decode/" + vCorpus[c].sName, [&sReply](BenchState &state)
+        {
+            for (uint64_t i = 0; i < state.iIterations; i++)
+            {
+                RedisReply reply;
+                size_t iPos = 0;
+
+                RedisReplyParser::decode(sReply.data(), sReply.size(), iPos, reply);
+                escape(reply);
+
+                state.iBytes += sReply.size();
+            }
+        });
+
+        runner.add("decode/RedisLazyReply/" + vCorpus[c].sName, [&sReply](BenchState &state)
+        {
+            RedisLazyReply reply;
+
+            for (uint64_t i = 0; i < state.iIterations; i++)
+            {
+                reply.assign(sReply.data(), sReply.size());
+                escape(reply);
+
+                state.iBytes += sReply.size();
+            }
+        });
+
+        //decodeBulks(RedisProxy内部的doMultiReplay)只支持bulk及元素为bulk/整数的数组
+        if (sReply[0] == '$' || vCorpus[c].sName.compare(0, 6, "nested") != 0)
+        {
+            runner.add("decode/decodeBulks/" + vCorpus[c].sName, [&sReply](BenchState &state)
+            {
+                vector<pair<int, string> > vBuffer;
+
+                for (uint64_t i = 0; i < state.iIterations; i++)
+                {
+                    vBuffer.clear();
+
+                    RedisReplyParser::decodeBulks(sReply.data(), sReply.size(), vBuffer);
+                    escape(vBuffer);
+
+                    state.iBytes += sReply.size();
+                }
+            });
+        }
+    }
+}
+
+/**
+* @brief 通过RedisProxy对进程内模拟服务端的完整调用(编码, 网络线程分帧, doCommand解码)
+*/
+void addProxy(BenchRunner &runner, RedisPrx prx)
+{
+    prx->set("bench:small", string(16, 'v'));
+    prx->set("bench:large", string(1024 * 1024, 'v'));
+
+    vector<string> vKey;
+
+    for (int i = 0; i < 100; i++)
+    {
+        vKey.push_back("bench:mget:" + TC_Common::tostr(i));
+        prx->set(vKey.back(), string(32, 'v'));
+    }
+
+    runner.add("proxy/get_16B", [prx](BenchState &state)
+    {
+        string sValue;
+
+        for (uint64_t i = 0; i < state.iIterations; i++)
+        {
+            prx->get("bench:small", sValue);
+            state.iBytes += sValue.size();
+        }
+    });
+
+    runner.add("proxy/get_1MB", [prx](BenchState &state)
+    {
+        string sValue;
+
+        for (uint64_t i = 0; i < state.iIterations; i++)
+        {
+            prx->get("bench:large", sValue);
+            state.iBytes += sValue.size();
+        }
+    });
+
+    runner.add("proxy/mget_100", [prx, vKey](BenchState &state)
+    {
+        vector<pair<int, string> > vValue;
+
+        for (uint64_t i = 0; i < state.iIterations; i++)
+        {
+            vValue.clear();
+            prx->get(vKey, vValue);
+            state.iBytes += vValue.size() * 32;
+        }
+    });
+}
+
+void usage(char *argv)
+{
+    cout << "Usage:" << argv << " [--filter=substring] [--min-time=0.5] [--json]" << endl;
+    cout << "    [--corpus=file1,file2]              recorded replies, one raw RESP reply per file" << endl;
+    cout << "    [--mock-port=26379]                 also run RedisProxy calls against an in-process mock server" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        TC_Option option;
+        option.decode(argc, argv);
+
+        if (option.hasParam("help"))
+        {
+            usage(argv[0]);
+            return 0;
+        }
+
+        double dMinTime = option.hasParam("min-time") ? TC_Common::strto<double>(option.getValue("min-time")) : 0.5;
+
+        BenchRunner runner(dMinTime, option.getValue("filter"));
+        runner.setJson(option.hasParam("json"));
+
+        vector<Corpus> vCorpus = genCorpus();
+
+        if (option.hasParam("corpus"))
+        {
+            vector<string> vFile = TC_Common::sepstr<string>(option.getValue("corpus"), ",");
+
+            for (size_t i = 0; i < vFile.size(); i++)
+            {
+                Corpus c;
+                c.sName  = TC_File::extractFileName(vFile[i]);
+                c.sReply = TC_File::load2str(vFile[i]);
+
+                if (c.sReply.size() < 3)
+                {
+                    cerr << "invalid corpus:" << vFile[i] << endl;
+                    return 1;
+                }
+
+                vCorpus.push_back(c);
+            }
+        }
+
+        //基准之前先校验分帧在任意拆分下都正确, 大语料只校验生成的小语料
+        for (size_t i = 0; i < vCorpus.size(); i++)
+        {
+            if (vCorpus[i].sReply.size() > 64 * 1024)
+            {
+                continue;
+            }
+
+            int64_t iSplit = checkSplit(vCorpus[i].sReply);
+
+            if (iSplit >= 0)
+            {
+                cerr << "frame error, corpus:" << vCorpus[i].sName << " split at:" << iSplit << endl;
+                return 1;
+            }
+        }
+
+        vector<Corpus> vMalformed = genMalformed();
+
+        for (size_t i = 0; i < vMalformed.size(); i++)
+        {
+            if (!checkError(vMalformed[i].sReply))
+            {
+                cerr << "protocol error not detected, corpus:" << vMalformed[i].sName << endl;
+                return 1;
+            }
+        }
+
+        addEncode(runner);
+        addDecode(runner, vCorpus);
+
+        RedisMockServer mock;
+        Communicator comm;
+
+        if (option.hasParam("mock-port"))
+        {
+            if (mock.start("127.0.0.1", TC_Common::strto<int>(option.getValue("mock-port"))) != 0)
+            {
+                return 1;
+            }
+
+            ProxyProtocol prot;
+            prot.requestFunc  = RedisProxy::redisRequest;
+            prot.responseFunc = RedisProxy::redisResponse;
+
+            RedisPrx prx = comm.stringToProxy<RedisPrx>(RedisProxy::genRedisObj(mock.getConf()));
+            prx->tars_set_protocol(prot, 1);
+
+            addProxy(runner, prx);
+        }
+
+        vector<BenchResult> vResult = runner.run();
+
+        if (option.hasParam("json"))
+        {
+            BenchRunner::printJson(vResult);
+        }
+
+        return 0;
+    }
+    catch (exception &ex)
+    {
+        cerr << "exception:" << ex.what() << endl;
+    }
+
+    return 1;
+}
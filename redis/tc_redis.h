@@ -2,18 +2,40 @@
 #define tc_redis_h__
 #include "util/tc_ex.h"
 #include "tup/TarsType.h"
+#include "tup/Tars.h"
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string.h>
 #include <stdlib.h>
 #include <iostream>
 #include <cfloat>
+#include <cmath>
+#include <poll.h>
+#include <errno.h>
+#include <climits>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+//C++17起结果容器可以使用std::pmr的memory resource
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define TARS_REDIS_PMR 1
+#endif
+#endif
 #include "util/tc_epoller.h"
 #include "util/tc_socket.h"
 #include "util/tc_clientsocket.h"
 #include "servant/ServantProxy.h"
 #include "util/tc_custom_protocol.h"
 #include "util/tc_thread_rwlock.h"
+#include "tc_redis_codec.h"
+#include "tc_redis_stat.h"
 
 using namespace std;
 
@@ -99,1769 +121,7714 @@ struct TC_RDConf
     }
 };
 
-class RedisReq: public TC_CustomProtoReq
+/**
+* @brief 解码后的redis应答, 支持RESP2/RESP3及嵌套结构
+*/
+struct RedisReply
 {
+    enum REPLY_TYPE
+    {
+        REPLY_NONE      = 0,
+        REPLY_STATUS    = '+',
+        REPLY_ERROR     = '-',
+        REPLY_INTEGER   = ':',
+        REPLY_STRING    = '$',
+        REPLY_ARRAY     = '*',
+        REPLY_NIL       = '_',
+        REPLY_DOUBLE    = ',',
+        REPLY_BOOL      = '#',
+        REPLY_BIGNUM    = '(',
+        REPLY_BLOBERROR = '!',
+        REPLY_VERBATIM  = '=',
+        REPLY_MAP       = '%',
+        REPLY_SET       = '~',
+        REPLY_PUSH      = '>',
+    };
+
+    /**
+    * 应答类型, REPLY_TYPE
+    */
+    int type;
+
+    /**
+    * 字符串类应答的内容(status/error/string/double/bignum)
+    */
+    string str;
+
+    /**
+    * 整数/布尔应答的值
+    */
+    int64_t integer;
+
+    /**
+    * 聚合类应答的元素, map按 k1,v1,k2,v2... 展开
+    */
+    vector<RedisReply> element;
+
+    RedisReply() : type(REPLY_NONE), integer(0)
+    {
+    }
+
+    bool isNil() const { return type == REPLY_NIL; }
+
+    bool isError() const { return type == REPLY_ERROR || type == REPLY_BLOBERROR; }
+
+    bool isAggregate() const { return type == REPLY_ARRAY || type == REPLY_MAP || type == REPLY_SET || type == REPLY_PUSH; }
 };
 
-class RedisRsp: public TC_CustomProtoRsp
+/**
+* @brief RESP2/RESP3增量解析器
+*
+* scan() 只负责分帧, 记录已扫描到的位置和未完成的聚合层级, 数据分多次到达时已扫描的部分不会重复扫描;
+* decode() 把一个完整的应答解码为RedisReply.
+*/
+class RedisReplyParser
 {
 public:
-    bool parseType(const string& buffer, size_t& iStartPos)
+    RedisReplyParser()
     {
-        bool bRet = false;
+        reset();
+    }
 
-        string sSep = "\r\n";
-        char f = buffer[iStartPos];
-        size_t iPos = _buffer.find(sSep, iStartPos);
+    /**
+    * @brief 开始扫描下一个应答
+    */
+    void reset()
+    {
+        _iPos  = 0;
+        _iNeed = 0;
+        _vStack.clear();
+    }
 
-        switch (f)
+    /**
+    * @brief 上次scan数据不完整时, 至少需要的数据长度(正在等待已知长度的bulk内容时有效, 否则为0).
+    *        数据达到该长度前再次scan不会有进展
+    */
+    size_t getNeed() const { return _iNeed; }
+
+    /**
+    * @brief 检查data开头是否已有一个完整的应答.
+    *        两次reset()之间, data必须是同一段数据(只能在尾部追加)
+    *
+    * @param data
+    * @param len
+    * @return >0 完整应答的长度 0 数据不完整 -1 协议错误
+    */
+    int64_t scan(const char *data, size_t len)
+    {
+        const char *end = data + len;
+
+        _iNeed = 0;
+
+        while (_iPos < len)
         {
-        case '+':
-        case '-':
-        case ':':
-            if (iPos + sSep.size() <= _buffer.size())
+            const char *p    = data + _iPos;
+            const char *crlf = findLine(p + 1, end);
+
+            if (crlf == NULL)
             {
-                bRet = true;
-                iStartPos = iPos + sSep.size();
+                return 0;
             }
-            break;
-        case '$':
-            if (iPos != string::npos)
+
+            size_t iNext  = crlf + 2 - data;
+            int64_t iNum  = 0;
+            bool bElement = true;
+
+            switch (*p)
             {
-                int iLen = TC_Common::strto<size_t>(_buffer.substr(1+iStartPos, iPos));
+            case '+':
+            case '-':
+            case ',':
+            case '#':
+            case '(':
+            case '_':
+                break;
+            case ':':
+                //整数在分帧时即校验, 溢出等格式错误作为协议错误
+                if (!parseInteger(p + 1, crlf, iNum))
+                {
+                    return -1;
+                }
+                break;
+            case '$':
+            case '!':
+            case '=':
+                if (!parseLength(p + 1, crlf, iNum))
+                {
+                    return -1;
+                }
+
+                if (iNum >= 0)
+                {
+                    iNext += iNum + 2;
+
+                    if (iNext > len)
+                    {
+                        _iNeed = iNext;
+                        return 0;
+                    }
+                }
+                break;
+            case '*':
+            case '~':
+            case '>':
+            case '%':
+            case '|':
+                if (!parseLength(p + 1, crlf, iNum))
+                {
+                    return -1;
+                }
+
+                if (*p == '%' || *p == '|')
+                {
+                    iNum *= 2;
+                }
 
-                if (iLen >= 0 && (iLen + iPos + sSep.size()*2 <= _buffer.size()))
+                if (iNum > 0)
                 {
-                    bRet = true;
-                    iStartPos = iLen + iPos + sSep.size()*2;
+                    _vStack.push_back(make_pair(iNum, *p == '|'));
+                    bElement = false;
                 }
-                else if(iLen == -1 && (iPos + sSep.size()) <= _buffer.size())
+                else if (*p == '|')
                 {
-                    bRet = true;
-                    iStartPos = iPos + sSep.size();
+                    //空属性不算作元素
+                    bElement = false;
                 }
+                break;
+            default:
+                return -1;
+            }
+
+            _iPos = iNext;
+
+            if (bElement && completeElement())
+            {
+                return _iPos;
             }
-            break;
-        default:
-            bRet = false;
-            break;
         }
-		return bRet;
+
+        return 0;
     }
 
-	virtual bool decode(TC_NetWorkBuffer::Buffer &data)
-	{
-        bool bRet = true;
+    /**
+    * @brief 解码data中从iPos开始的一个完整应答, 成功后iPos指向应答之后
+    *
+    * @return 0 成功 -1 失败
+    */
+    static int decode(const char *data, size_t len, size_t &iPos, RedisReply &reply)
+    {
+        if (iPos >= len)
+        {
+            return -1;
+        }
 
-        _buffer.append(data.buffer(), data.length());
+        const char *p    = data + iPos;
+        const char *crlf = findLine(p + 1, data + len);
 
-        string sSep = "\r\n";
-        string sData;
-        size_t iPos;
-        
-        if (_buffer.empty())
+        if (crlf == NULL)
         {
-            return false;
+            return -1;
         }
 
-        char f = _buffer[0];
-        iPos = _buffer.find(sSep);
+        size_t iNext = crlf + 2 - data;
+        int64_t iNum = 0;
 
-        switch (f)
+        reply.type = *p;
+
+        switch (*p)
         {
-        case '*':
-            if (iPos != string::npos)
+        case '+':
+        case '-':
+        case ',':
+        case '(':
+            reply.str.assign(p + 1, crlf);
+            break;
+        case ':':
+            if (!parseInteger(p + 1, crlf, reply.integer))
             {
-                size_t iSize = TC_Common::strto<size_t>(_buffer.substr(1, iPos));
-                size_t iStartPos = iPos + sSep.size();
-
-                for (size_t i = 0; i < iSize; i++)
-                {
-                    if (!parseType(_buffer, iStartPos))
-                    {
-                        bRet = false;
-                        break;
-                    }
-                }
+                return -1;
             }
             break;
-        default:
-            size_t iStartPos = 0;
-            bRet = parseType(_buffer, iStartPos);
+        case '#':
+            reply.integer = (p[1] == 't') ? 1 : 0;
             break;
-        }
+        case '_':
+            break;
+        case '$':
+        case '!':
+        case '=':
+            if (!parseLength(p + 1, crlf, iNum))
+            {
+                return -1;
+            }
 
-		data.clear();
-		return bRet;
-	}
-};
+            if (iNum < 0)
+            {
+                reply.type = RedisReply::REPLY_NIL;
+                break;
+            }
 
+            if (iNext + iNum + 2 > len)
+            {
+                return -1;
+            }
 
-class TC_Redis_Config_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_Config_Holder>
-{
-public:
-	/**
-    * @brief 构造函数
-    */
-	TC_Redis_Config_Holder(){}
+            //verbatim string带"txt:"之类的前缀
+            if (*p == '=' && iNum >= 4)
+            {
+                reply.str.assign(data + iNext + 4, iNum - 4);
+            }
+            else
+            {
+                reply.str.assign(data + iNext, iNum);
+            }
 
-	/**
-    * @brief 析构函数.
-    */
-	~TC_Redis_Config_Holder(){}
+            iNext += iNum + 2;
+            break;
+        case '*':
+        case '~':
+        case '>':
+        case '%':
+            if (!parseLength(p + 1, crlf, iNum))
+            {
+                return -1;
+            }
 
-    void set_password(const string& sObj, const string& sPasswd)
-    {
-        TC_ThreadWLock w(_rwl);
-        _mObjPasswd[sObj] = sPasswd;
-    }
+            if (iNum < 0)
+            {
+                reply.type = RedisReply::REPLY_NIL;
+                break;
+            }
 
-    int get_password(const string& sObj, string& sPasswd)
-    {
-        TC_ThreadRLock w(_rwl);
+            if (*p == '%')
+            {
+                iNum *= 2;
+            }
 
-        map<string, string>::iterator it = _mObjPasswd.find(sObj);
-        
-        if (it != _mObjPasswd.end())
-        {
-            sPasswd = it->second;
+            //每个元素至少3个字节, 防止异常长度导致的超大分配
+            if (iNum > (int64_t)(len - iNext))
+            {
+                return -1;
+            }
 
-            return 0;
-        }
+            reply.element.resize(iNum);
 
-        return -1;
-    }
+            iPos = iNext;
 
-protected:
-	/**
-    * @brief copy contructor，只申明,不定义,保证不被使用
-    */
-	TC_Redis_Config_Holder(const TC_Redis_Config_Holder &);
+            for (int64_t i = 0; i < iNum; i++)
+            {
+                if (decode(data, len, iPos, reply.element[i]) != 0)
+                {
+                    return -1;
+                }
+            }
 
-	/**
-    * @brief 只申明,不定义,保证不被使用
-    */
-	TC_Redis_Config_Holder &operator=(const TC_Redis_Config_Holder &);
+            return 0;
+        case '|':
+            if (!parseLength(p + 1, crlf, iNum) || iNum < 0)
+            {
+                return -1;
+            }
 
-private:
-	TC_ThreadRWLocker _rwl;
-    map<string, string> _mObjPasswd;
-};
+            //属性直接跳过, 解码其后的真正应答
+            iPos = iNext;
 
-class RedisProxy: public ServantProxy
-{
-public:
-    static string genRedisObj(const string& sHost, const string& sPasswd, const int& port)
-    {
-        string sObj = "TARS.RedisServer.RedisObj." + sHost + "." + TC_Common::tostr(port);
-        TC_Redis_Config_Holder::getInstance()->set_password(sObj, sPasswd);
+            for (int64_t i = 0; i < iNum * 2; i++)
+            {
+                RedisReply attr;
 
-        sObj += "@tcp -h " + sHost + " -p " + TC_Common::tostr(port);
-        if (!sPasswd.empty())
-        {
-            sObj += " -e 1";
+                if (decode(data, len, iPos, attr) != 0)
+                {
+                    return -1;
+                }
+            }
+
+            return decode(data, len, iPos, reply);
+        default:
+            return -1;
         }
 
-        return sObj;
+        iPos = iNext;
+
+        return 0;
     }
 
-    static string genRedisObj(const TC_RDConf& tcRDConf)
+    /**
+    * @brief 解析单个bulk或元素都为bulk/整数的数组应答, nil的长度为-1
+    *
+    * @return 0 成功 -1 失败
+    */
+    static int decodeBulks(const char *data, size_t len, vector<pair<int, string> >& vBuffer)
     {
-        string sObj = "TARS.RedisServer.RedisObj." + tcRDConf._host + "." + TC_Common::tostr(tcRDConf._port);
-        sObj += "@tcp -h " + tcRDConf._host + " -p " + TC_Common::tostr(tcRDConf._port);
+        size_t iPos   = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
 
-        if (!tcRDConf._password.empty())
-        {
-            sObj += " -e 1";
-            TC_Redis_Config_Holder::getInstance()->set_password(sObj, tcRDConf._password);
-        }
+        char f = readElement(data, len, iPos, p, iLen);
 
-        return sObj;
-    }
-    
-    static shared_ptr<TC_NetWorkBuffer::Buffer> redisRequest(tars::RequestPacket& request, TC_Transceiver *trans)
-    {
-        shared_ptr<TC_NetWorkBuffer::Buffer> buff = std::make_shared<TC_NetWorkBuffer::Buffer>();
+        int64_t iSize = 1;
 
-        if (TC_Port::strncasecmp(request.sFuncName.c_str(), "InnerAuthServer", request.sFuncName.size()) == 0)
+        if (f == '*')
         {
-            string sPasswd;
-            TC_Redis_Config_Holder::getInstance()->get_password(request.sServantName, sPasswd);
-            if (!sPasswd.empty())
+            if (iLen <= 0)
             {
-                buff->addBuffer("Auth " + sPasswd + "\r\n");
+                return 0;
             }
+
+            iSize = iLen;
+            f     = readElement(data, len, iPos, p, iLen);
         }
-        else
+
+        vBuffer.reserve(vBuffer.size() + iSize);
+
+        for (int64_t i = 0; i < iSize; i++)
         {
-            shared_ptr<RedisReq> &data = *(shared_ptr<RedisReq>*)request.sBuffer.data();
-            data->encode(buff);
-            data.reset();
+            if (i > 0)
+            {
+                f = readElement(data, len, iPos, p, iLen);
+            }
+
+            if (f != '$' && f != ':' && f != '+')
+            {
+                vBuffer.clear();
+                return -1;
+            }
+
+            if (iLen < 0)
+            {
+                vBuffer.push_back(make_pair(-1, string()));
+            }
+            else
+            {
+                vBuffer.push_back(make_pair((int)iLen, string(p, iLen)));
+            }
         }
 
-        return buff;
+        return 0;
     }
 
-    static TC_NetWorkBuffer::PACKET_TYPE redisResponse(TC_NetWorkBuffer &in, ResponsePacket& rsp)
+    /**
+    * @brief 读取iPos处的一个元素头, 不做拷贝, 成功后iPos指向下一个元素.
+    *        聚合类型只读取头部, 返回元素个数, 其元素需接着逐个读取
+    *
+    * @param p       返回内容的起始位置(指向应答缓冲, 内容后紧跟"\r\n")
+    * @param iLen    返回内容的长度, 聚合类型为元素个数, nil为-1
+    * @return 元素类型, 0 数据不完整或格式错误
+    */
+    static char readElement(const char *data, size_t len, size_t &iPos, const char *&p, int64_t &iLen)
     {
-        shared_ptr<RedisRsp> *context = (shared_ptr<RedisRsp>*)(in.getContextData());
+        if (iPos >= len)
+        {
+            return 0;
+        }
 
-        const int kAuthType = 0x40;
+        const char *h    = data + iPos;
+        const char *crlf = findLine(h + 1, data + len);
 
-        if(!context)
+        if (crlf == NULL)
         {
-            context = new shared_ptr<RedisRsp>();
-            *context = std::make_shared<RedisRsp>();
-            in.setContextData(context, [](TC_NetWorkBuffer*nb){ shared_ptr<RedisRsp> *p = (shared_ptr<RedisRsp>*)(nb->getContextData()); if(p) { nb->setContextData(NULL); delete p; }});
+            return 0;
         }
 
-        if((*context)->incrementDecode(in))
-        {	
-            auto sBuf = in.getBuffer();
-            string buffer;
-            buffer.assign((*sBuf.get()).buffer(), (*sBuf.get()).length());
+        size_t iNext = crlf + 2 - data;
 
-            (*sBuf.get()).clear();
+        p    = h + 1;
+        iLen = crlf - p;
 
-            rsp.sBuffer.resize(sizeof(shared_ptr<RedisRsp>));
+        switch (*h)
+        {
+        case '$':
+        case '!':
+        case '=':
+        case '*':
+        case '~':
+        case '>':
+        case '%':
+            if (!parseLength(h + 1, crlf, iLen))
+            {
+                return 0;
+            }
 
-            shared_ptr<RedisRsp> &data = *(shared_ptr<RedisRsp>*)rsp.sBuffer.data();
-            data = *context;
+            p = data + iNext;
 
-            auto ret = TC_NetWorkBuffer::PACKET_FULL;
+            if (iLen >= 0 && *h != '*' && *h != '~' && *h != '>' && *h != '%')
+            {
+                if (iNext + iLen + 2 > len)
+                {
+                    return 0;
+                }
 
-            (*context) = NULL;
-            delete context;
-            in.setContextData(NULL);
-            
-            if (rsp.iMessageType == kAuthType)
+                iNext += iLen + 2;
+            }
+            break;
+        case '_':
+            iLen = -1;
+            break;
+        default:
+            break;
+        }
+
+        iPos = iNext;
+
+        return *h;
+    }
+
+    /**
+    * @brief 在[p, end)中查找"\r\n"
+    *
+    * @return 指向'\r'的位置, 没找到返回NULL
+    */
+    static const char *findLine(const char *p, const char *end)
+    {
+        while (p < end)
+        {
+            const char *r = (const char *)memchr(p, '\r', end - p);
+
+            if (r == NULL || r + 1 >= end)
             {
-                string sRet = "AUTH_SUCC";
-                rsp.sBuffer.assign(sRet.begin(), sRet.end());
+                return NULL;
             }
 
-            return ret;
+            if (r[1] == '\n')
+            {
+                return r;
+            }
+
+            p = r + 1;
         }
 
-        return TC_NetWorkBuffer::PACKET_LESS;
+        return NULL;
     }
-    
+
     /**
-    * @brief 初始化. 
-    *  
-    * @param sHost        主机IP
-    * @param sPasswd      密码
-    * @param port         端口
-    * @return 无
+    * @brief 解析[p, end)中的十进制整数, 不产生临时对象
     */
-    void init(const string& sHost, const string& sPasswd = "", int port = 0)
+    static bool parseInteger(const char *p, const char *end, int64_t &iValue)
     {
-        _rdConf._host     = sHost;
-        _rdConf._password = sPasswd;
-        _rdConf._port     = port;
+        bool bNeg = false;
+
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            bNeg = (*p == '-');
+            ++p;
+        }
+
+        if (p >= end)
+        {
+            return false;
+        }
+
+        int64_t v = 0;
+
+        for (; p < end; ++p)
+        {
+            if (*p < '0' || *p > '9')
+            {
+                return false;
+            }
+
+            //溢出视为格式错误
+            if (v > (INT64_MAX - (*p - '0')) / 10)
+            {
+                return false;
+            }
+
+            v = v * 10 + (*p - '0');
+        }
+
+        iValue = bNeg ? -v : v;
+
+        return true;
     }
 
     /**
-    * @brief 初始化. 
-    *  
-    * @param tcDBConf 数据库配置
+    * @brief 解析bulk长度或聚合元素个数: 只允许-1(nil)或不超过上限的非负数
     */
-    void init(const TC_RDConf& tcRDConf)
+    static bool parseLength(const char *p, const char *end, int64_t &iValue)
     {
-        _rdConf = tcRDConf;
+        return parseInteger(p, end, iValue) && iValue >= -1 && iValue <= maxLength().load(std::memory_order_relaxed);
     }
-    
+
     /**
-    * @brief get数据 
-    *  
-    * @param sKey        
-    * @param sValue      
-    * @return 0 成功 1 没有数据 -1 失败
+    * @brief 设置bulk长度及聚合元素个数的上限, 超过视为协议错误, 避免异常长度在网络线程上导致超大分配.
+    *        进程内所有连接共用, 默认512M(同redis的proto-max-bulk-len)
     */
-    int get(const string& sKey, string& sValue)
+    static void setMaxLength(int64_t iMax)
     {
-        int iRet = -1;
-
-        string sCommand;
-        vector<string> vPart;
-
-        vPart.push_back("GET");
-        vPart.push_back(sKey);
+        maxLength().store(iMax > 0 ? iMax : 0, std::memory_order_relaxed);
+    }
 
-        buildCommand(vPart, sCommand);
-        
-        vector<pair<int, string> > vBuffer;
+    static std::atomic<int64_t> &maxLength()
+    {
+        static std::atomic<int64_t> iMax(512 * 1024 * 1024LL);
 
-        iRet = doCommand(sCommand, vBuffer);
+        return iMax;
+    }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+protected:
+    /**
+    * @brief 完成了一个元素, 逐层向上归并
+    *
+    * @return true 整个应答已完整
+    */
+    bool completeElement()
+    {
+        while (!_vStack.empty())
         {
-            if (vBuffer[0].first == -1)
+            if (--_vStack.back().first > 0)
             {
-                iRet = 1;
+                return false;
             }
-            else
+
+            bool bAttr = _vStack.back().second;
+
+            _vStack.pop_back();
+
+            //属性不计入上层元素个数
+            if (bAttr)
             {
-                sValue = vBuffer[0].second;
-                iRet = 0;
+                return false;
             }
         }
-        
-        return iRet;
+
+        return true;
     }
 
+protected:
     /**
-    * @brief get数据 
-    *  
-    * @param sKey        
-    * @param vValue      
-    * @return 0 成功 1 没有数据 -1 失败
+    * 已扫描到的位置(总在元素边界上)
     */
-    int get(const string& sKey, vector<char>& vValue)
+    size_t _iPos;
+
+    /**
+    * 等待bulk内容时需要的数据长度
+    */
+    size_t _iNeed;
+
+    /**
+    * 未完成的聚合层级: 剩余元素个数, 是否为属性
+    */
+    vector<pair<int64_t, bool> > _vStack;
+};
+
+
+/**
+* @brief 单调递增(bump)分配器.
+*
+* 从大块内存中顺序切分, 不单独释放, 析构或reset时一次性归还.
+* 定义了TARS_REDIS_PMR时同时是std::pmr::memory_resource, 可直接作为pmr容器的分配器.
+* 非线程安全.
+*/
+class RedisArena
+#ifdef TARS_REDIS_PMR
+    : public std::pmr::memory_resource
+#endif
+{
+public:
+    /**
+    * @param iBlockSize 空间不足时新申请的块的最小字节数
+    */
+    explicit RedisArena(size_t iBlockSize = 4096)
+        : _pBlock(NULL)
+        , _pCur(NULL)
+        , _pEnd(NULL)
+        , _iBlockSize(iBlockSize)
+        , _iAllocated(0)
     {
-        string sValue;
-        int iRet = get(sKey, sValue);
-        vValue.assign(sValue.begin(), sValue.end());
+    }
 
-        return iRet;
+    ~RedisArena()
+    {
+        release();
     }
 
     /**
-    * @brief set
-    *  
-    * @param sKey        
-    * @param sValue      
-    * @param expir 数据的过期时间   
-    * @return 0 成功 -1 失败
+    * @brief 分配iSize字节, 按iAlign对齐
     */
-    int set(const string& sKey, const string& sValue, unsigned int expir = 0)
+    void *alloc(size_t iSize, size_t iAlign = alignof(std::max_align_t))
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
+        char *p = align(_pCur, iAlign);
 
-        if(expir == 0)
-        {
-            vPart.push_back("SET");
-            vPart.push_back(sKey);
-            vPart.push_back(sValue);
-        }
-        else
+        if (_pCur == NULL || p + iSize > _pEnd)
         {
-            vPart.push_back("SETEX");
-            vPart.push_back(sKey);
-            vPart.push_back(TC_Common::tostr(expir));
-            vPart.push_back(sValue);
+            newBlock(iSize + iAlign);
+
+            p = align(_pCur, iAlign);
         }
 
-        buildCommand(vPart, sCommand);
+        _pCur = p + iSize;
 
-        vector<pair<int, string> > vBuffer;
+        _iAllocated += iSize;
 
-        iRet = doCommand(sCommand, vBuffer);
+        return p;
+    }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+    /**
+    * @brief 保证接下来连续分配iSize字节(含对齐)不需要再申请内存, 用于按应答长度一次申请
+    */
+    void reserve(size_t iSize)
+    {
+        if (_pCur == NULL || (size_t)(_pEnd - _pCur) < iSize)
         {
-            iRet = 0;
+            newBlock(iSize);
         }
-        else
+    }
+
+    /**
+    * @brief 释放所有内存
+    */
+    void release()
+    {
+        while (_pBlock != NULL)
         {
-            iRet = -1;
+            Block *pNext = _pBlock->pNext;
+
+            free(_pBlock);
+
+            _pBlock = pNext;
         }
 
-        return iRet;
+        _pCur       = NULL;
+        _pEnd       = NULL;
+        _iAllocated = 0;
     }
 
     /**
-    * @brief mset
-    *  
-    * @param vKeyValue        
-    * @return 0 成功 -1 失败
+    * @brief 已分配的字节数
     */
-    int mset(const vector<pair<string, string> >& vKeyValue)
+    size_t getAllocated() const { return _iAllocated; }
+
+protected:
+#ifdef TARS_REDIS_PMR
+    virtual void *do_allocate(size_t iSize, size_t iAlign)
     {
-        int iRet = -1;
+        return alloc(iSize, iAlign);
+    }
 
-        string sCommand;
+    virtual void do_deallocate(void *, size_t, size_t)
+    {
+    }
 
-        vector<string> vPart;
+    virtual bool do_is_equal(const std::pmr::memory_resource &other) const noexcept
+    {
+        return this == &other;
+    }
+#endif
 
-        vPart.push_back("MSET");
+    struct Block
+    {
+        Block *pNext;
+    };
 
-        for (size_t i = 0; i < vKeyValue.size(); i++)
+    static char *align(char *p, size_t iAlign)
+    {
+        return (char *)(((uintptr_t)p + iAlign - 1) & ~(uintptr_t)(iAlign - 1));
+    }
+
+    void newBlock(size_t iSize)
+    {
+        size_t iBlock = std::max(iSize, _iBlockSize) + sizeof(Block);
+
+        Block *b = (Block *)malloc(iBlock);
+
+        if (b == NULL)
         {
-            vPart.push_back(vKeyValue[i].first);
-            vPart.push_back(vKeyValue[i].second);
+            throw std::bad_alloc();
         }
-        
-        buildCommand(vPart, sCommand);
 
-        vector<pair<int, string> > vBuffer;
+        b->pNext = _pBlock;
+        _pBlock  = b;
 
-        iRet = doCommand(sCommand, vBuffer);
+        _pCur = (char *)(b + 1);
+        _pEnd = (char *)b + iBlock;
+    }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+private:
+    RedisArena(const RedisArena &);
+    RedisArena &operator=(const RedisArena &);
+
+protected:
+    Block  *_pBlock;
+
+    char   *_pCur;
+
+    char   *_pEnd;
+
+    size_t  _iBlockSize;
+
+    size_t  _iAllocated;
+};
+
+/**
+* @brief 一个数组应答(smembers/hgetall/keys...)的所有元素, 存储在同一个RedisArena中.
+*
+* 元素数组及每个元素的内容都从arena分配, arena按应答长度一次申请, 对象析构或重新赋值时一次性释放;
+* 元素内容以'\0'结尾.
+*/
+class RedisArenaReply
+{
+public:
+    struct Element
+    {
+        /**
+        * 内容, nil时为NULL
+        */
+        const char *data;
+
+        /**
+        * 长度, nil时为-1
+        */
+        int64_t     size;
+
+        bool isNil() const { return size < 0; }
+
+        string str() const { return size > 0 ? string(data, size) : string(); }
+    };
+
+    RedisArenaReply()
+        : _pElement(NULL)
+        , _iCount(0)
+    {
+    }
+
+    /**
+    * @brief 从完整的应答解析, 原有的内容释放
+    *
+    * @return 0 成功 -1 不是数组或包含嵌套元素, 错误应答的内容保存在getError()
+    */
+    int assign(const char *data, size_t len)
+    {
+        clear();
+
+        size_t iPos = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        char c = RedisReplyParser::readElement(data, len, iPos, p, iLen);
+
+        if (c == '-' || c == '!')
         {
-            iRet = 0;
+            _sError.assign(p, iLen);
+            return -1;
         }
-        else
+
+        if (c != '*' && c != '~' && c != '%' && c != '>')
         {
-            iRet = -1;
+            return -1;
         }
 
-        return iRet;
+        if (iLen <= 0)
+        {
+            return 0;
+        }
+
+        size_t iCount = c == '%' ? iLen * 2 : iLen;
+
+        //每个元素在应答中至少占4字节, 内容加'\0'不会超过应答长度
+        _arena.reserve(len + iCount * sizeof(Element) + alignof(Element));
+
+        _pElement = (Element *)_arena.alloc(iCount * sizeof(Element), alignof(Element));
+
+        for (size_t i = 0; i < iCount; i++)
+        {
+            c = RedisReplyParser::readElement(data, len, iPos, p, iLen);
+
+            Element &e = _pElement[i];
+
+            if (c == 0 || c == '*' || c == '~' || c == '%' || c == '>')
+            {
+                clear();
+                return -1;
+            }
+
+            if (c == '_' || iLen < 0)
+            {
+                e.data = NULL;
+                e.size = -1;
+            }
+            else
+            {
+                char *buf = (char *)_arena.alloc(iLen + 1, 1);
+
+                memcpy(buf, p, iLen);
+                buf[iLen] = '\0';
+
+                e.data = buf;
+                e.size = iLen;
+            }
+
+            ++_iCount;
+        }
+
+        return 0;
+    }
+
+    void clear()
+    {
+        _arena.release();
+
+        _pElement = NULL;
+        _iCount   = 0;
+
+        _sError.clear();
+    }
+
+    size_t size() const { return _iCount; }
+
+    bool empty() const { return _iCount == 0; }
+
+    const Element &operator[](size_t i) const { return _pElement[i]; }
+
+    const Element *begin() const { return _pElement; }
+
+    const Element *end() const { return _pElement + _iCount; }
+
+    const string &getError() const { return _sError; }
+
+    /**
+    * @brief 占用的arena字节数
+    */
+    size_t getAllocated() const { return _arena.getAllocated(); }
+
+protected:
+    RedisArena  _arena;
+
+    Element    *_pElement;
+
+    size_t      _iCount;
+
+    string      _sError;
+};
+
+/**
+* @brief 延迟解码的应答.
+*
+* assign时只扫描一遍, 记录各顶层元素在应答缓冲中的位置, 不拷贝任何内容;
+* 访问某个元素时才把它转换为字符串, 整数或浮点数. 支持随机访问, 取元素个数及长度不解码内容.
+* 非聚合的应答视为只有一个元素.
+*/
+class RedisLazyReply
+{
+public:
+    RedisLazyReply()
+        : _data(NULL)
+        , _len(0)
+        , _type(0)
+    {
+    }
+
+    /**
+    * @brief 从proxy的应答解析, 持有应答直到下次assign或析构
+    *
+    * @return 0 成功 -1 格式错误或错误应答(内容见getError)
+    */
+    int assign(const shared_ptr<TC_CustomProtoRsp> &rsp)
+    {
+        _rsp = rsp;
+
+        return assign(rsp->getBuffer().data(), rsp->getBuffer().size());
+    }
+
+    /**
+    * @brief 从[data, data + len)解析, 调用方保证使用期间内存有效
+    */
+    int assign(const char *data, size_t len)
+    {
+        _data = data;
+        _len  = len;
+        _type = 0;
+
+        _vPos.clear();
+        _sError.clear();
+
+        size_t iPos   = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        char c = RedisReplyParser::readElement(data, len, iPos, p, iLen);
+
+        if (c == 0)
+        {
+            return -1;
+        }
+
+        _type = c;
+
+        if (c == '-' || c == '!')
+        {
+            _sError.assign(p, iLen);
+            return -1;
+        }
+
+        if (!isAggregate(c))
+        {
+            _vPos.push_back(0);
+            return 0;
+        }
+
+        size_t iCount = iLen <= 0 ? 0 : (c == '%' ? iLen * 2 : iLen);
+
+        _vPos.reserve(iCount);
+
+        for (size_t i = 0; i < iCount; i++)
+        {
+            _vPos.push_back(iPos);
+
+            if (!skip(data, len, iPos))
+            {
+                _vPos.clear();
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+    * @brief 应答的类型(RedisReply::REPLY_TYPE)
+    */
+    char type() const { return _type; }
+
+    /**
+    * @brief 元素个数
+    */
+    size_t size() const { return _vPos.size(); }
+
+    bool empty() const { return _vPos.empty(); }
+
+    const string &getError() const { return _sError; }
+
+    /**
+    * @brief 第i个元素的类型
+    */
+    char type(size_t i) const
+    {
+        return i < _vPos.size() ? _data[_vPos[i]] : 0;
+    }
+
+    /**
+    * @brief 第i个元素是否为nil
+    */
+    bool isNil(size_t i) const
+    {
+        const char *p;
+        int64_t iLen;
+
+        char c = read(i, p, iLen);
+
+        return c == 0 || c == '_' || iLen < 0;
+    }
+
+    /**
+    * @brief 第i个元素的长度(聚合类型为其元素个数), nil为-1, 不解码内容
+    */
+    int64_t length(size_t i) const
+    {
+        const char *p;
+        int64_t iLen = -1;
+
+        read(i, p, iLen);
+
+        return iLen;
+    }
+
+    /**
+    * @brief 第i个元素的内容, 指向应答缓冲, 不做拷贝
+    *
+    * @return false 不存在, nil或聚合类型
+    */
+    bool getView(size_t i, const char *&p, size_t &iLen) const
+    {
+        int64_t n;
+
+        char c = read(i, p, n);
+
+        if (c == 0 || c == '_' || n < 0 || isAggregate(c))
+        {
+            return false;
+        }
+
+        iLen = n;
+
+        return true;
+    }
+
+    /**
+    * @brief 第i个元素转换为字符串, 复用sValue的内存
+    */
+    bool getString(size_t i, string &sValue) const
+    {
+        const char *p;
+        size_t iLen;
+
+        if (!getView(i, p, iLen))
+        {
+            return false;
+        }
+
+        sValue.assign(p, iLen);
+
+        return true;
+    }
+
+    string getString(size_t i) const
+    {
+        string sValue;
+
+        getString(i, sValue);
+
+        return sValue;
+    }
+
+    /**
+    * @brief 第i个元素转换为整数(整数或内容为数字的字符串)
+    */
+    bool getInteger(size_t i, int64_t &iValue) const
+    {
+        const char *p;
+        size_t iLen;
+
+        if (!getView(i, p, iLen) || iLen == 0)
+        {
+            return false;
+        }
+
+        //内容后紧跟"\r\n", 转换在此停止
+        char *end = NULL;
+        iValue = strtoll(p, &end, 10);
+
+        return end == p + iLen;
+    }
+
+    /**
+    * @brief 第i个元素转换为浮点数(double或内容为数字的字符串, 如zset的score)
+    */
+    bool getDouble(size_t i, double &dValue) const
+    {
+        const char *p;
+        size_t iLen;
+
+        if (!getView(i, p, iLen) || iLen == 0)
+        {
+            return false;
+        }
+
+        char *end = NULL;
+        dValue = strtod(p, &end);
+
+        return end == p + iLen;
+    }
+
+    /**
+    * @brief 第i个元素完整解码(用于嵌套的聚合元素)
+    */
+    bool getReply(size_t i, RedisReply &reply) const
+    {
+        if (i >= _vPos.size())
+        {
+            return false;
+        }
+
+        size_t iPos = _vPos[i];
+
+        return RedisReplyParser::decode(_data, _len, iPos, reply) == 0;
+    }
+
+protected:
+    static bool isAggregate(char c)
+    {
+        return c == '*' || c == '~' || c == '%' || c == '>';
+    }
+
+    /**
+    * @brief 读取第i个元素的头
+    */
+    char read(size_t i, const char *&p, int64_t &iLen) const
+    {
+        if (i >= _vPos.size())
+        {
+            return 0;
+        }
+
+        size_t iPos = _vPos[i];
+
+        return RedisReplyParser::readElement(_data, _len, iPos, p, iLen);
+    }
+
+    /**
+    * @brief 跳过iPos处的一个元素(含嵌套)
+    */
+    static bool skip(const char *data, size_t len, size_t &iPos)
+    {
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        char c = RedisReplyParser::readElement(data, len, iPos, p, iLen);
+
+        if (c == 0)
+        {
+            return false;
+        }
+
+        if (isAggregate(c) && iLen > 0)
+        {
+            int64_t iCount = c == '%' ? iLen * 2 : iLen;
+
+            for (int64_t i = 0; i < iCount; i++)
+            {
+                if (!skip(data, len, iPos))
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+protected:
+    shared_ptr<TC_CustomProtoRsp>   _rsp;
+
+    const char                     *_data;
+
+    size_t                          _len;
+
+    char                            _type;
+
+    vector<size_t>                  _vPos;
+
+    string                          _sError;
+};
+
+/**
+* @brief stream中的一条消息
+*/
+struct RedisStreamEntry
+{
+    /**
+    * 消息id, 如 1526569495631-0
+    */
+    string sId;
+
+    /**
+    * 消息内容, 已被删除的消息(XAUTOCLAIM/XREADGROUP读pending时可能出现)为空
+    */
+    vector<pair<string, string> > vField;
+
+    /**
+    * @brief 从 [id, [k1, v1, k2, v2...]] 解析一批消息, 字符串从reply中移走, 不做拷贝
+    */
+    static void parse(RedisReply &reply, vector<RedisStreamEntry> &vEntry)
+    {
+        vEntry.reserve(vEntry.size() + reply.element.size());
+
+        for (size_t i = 0; i < reply.element.size(); i++)
+        {
+            RedisReply &item = reply.element[i];
+
+            if (item.element.size() != 2)
+            {
+                continue;
+            }
+
+            vEntry.push_back(RedisStreamEntry());
+
+            RedisStreamEntry &entry = vEntry.back();
+            entry.sId.swap(item.element[0].str);
+
+            vector<RedisReply> &vKv = item.element[1].element;
+
+            entry.vField.reserve(vKv.size() / 2);
+
+            for (size_t j = 0; j + 1 < vKv.size(); j += 2)
+            {
+                entry.vField.push_back(pair<string, string>());
+                entry.vField.back().first.swap(vKv[j].str);
+                entry.vField.back().second.swap(vKv[j + 1].str);
+            }
+        }
+    }
+};
+
+class RedisReq: public TC_CustomProtoReq
+{
+public:
+    /**
+    * 对象池复用时保留的最大缓冲, 超过则释放
+    */
+    enum { kMaxKeepBytes = 1024 * 1024 };
+
+    RedisReq()
+        : _iEncodeBegin(0)
+        , _iEncodeEnd(0)
+        , _iDeadline(0)
+        , _bCancelled(false)
+    {
+    }
+
+    /**
+    * @brief 对象池复用前清空, 保留缓冲的内存
+    */
+    void reset()
+    {
+        if (_buffer.capacity() > kMaxKeepBytes)
+        {
+            string().swap(_buffer);
+        }
+
+        _buffer.clear();
+
+        _iEncodeBegin = 0;
+        _iEncodeEnd   = 0;
+        _iDeadline    = 0;
+        _bCancelled   = false;
+    }
+
+    /**
+    * @brief 把命令交换进请求, 避免sendBuffer的拷贝, 调用后sBuffer为空
+    */
+    void swapBuffer(string &sBuffer)
+    {
+        _buffer.clear();
+        _buffer.swap(sBuffer);
+    }
+
+    /**
+    * @brief 编码后的命令
+    */
+    const string &getBuffer() const { return _buffer; }
+
+    /**
+    * @brief 追踪开启时, 网络线程写入发送缓冲的开始/结束时间(微秒).
+    *        调用超时后调用方线程可能与网络线程并发读写, 先写结束时间, 读到开始时间后结束时间一定可见
+    */
+    void setEncodeTime(int64_t iBegin, int64_t iEnd)
+    {
+        _iEncodeEnd.store(iEnd, std::memory_order_relaxed);
+        _iEncodeBegin.store(iBegin, std::memory_order_release);
+    }
+
+    int64_t getEncodeBegin() const { return _iEncodeBegin.load(std::memory_order_acquire); }
+
+    int64_t getEncodeEnd() const { return _iEncodeEnd.load(std::memory_order_relaxed); }
+
+    /**
+    * @brief 截止时间(微秒), 0 没有
+    */
+    void setDeadline(int64_t iDeadline) { _iDeadline = iDeadline; }
+
+    int64_t getDeadline() const { return _iDeadline; }
+
+    /**
+    * @brief 网络线程发送时已过截止时间, 实际发送的是PING
+    */
+    void setCancelled() { _bCancelled = true; }
+
+    bool isCancelled() const { return _bCancelled; }
+
+protected:
+    std::atomic<int64_t> _iEncodeBegin;
+
+    std::atomic<int64_t> _iEncodeEnd;
+
+    int64_t _iDeadline;
+
+    std::atomic<bool> _bCancelled;
+};
+
+class RedisRsp: public TC_CustomProtoRsp
+{
+public:
+    RedisRsp()
+        : _iFirst(0)
+        , _iFrame(0)
+        , _iDecode(0)
+        , _bError(false)
+    {
+    }
+
+    /**
+    * @brief 对象池复用前清空, 保留缓冲的内存
+    */
+    void reset()
+    {
+        if (_buffer.capacity() > RedisReq::kMaxKeepBytes)
+        {
+            string().swap(_buffer);
+        }
+
+        _buffer.clear();
+
+        _parser.reset();
+
+        _iFirst  = 0;
+        _iFrame  = 0;
+        _iDecode = 0;
+        _bError  = false;
+    }
+
+    /**
+    * @brief 追踪开启时, 收到第一段数据, 分帧完成的时间及分帧的累计耗时(微秒)
+    */
+    int64_t getFirstTime() const { return _iFirst; }
+
+    int64_t getFrameTime() const { return _iFrame; }
+
+    int64_t getDecodeCost() const { return _iDecode; }
+
+    /**
+    * @brief 分帧时遇到协议错误(格式错误或长度超过上限), 连接需要关闭
+    */
+    bool isError() const { return _bError; }
+
+    virtual bool decode(TC_NetWorkBuffer::Buffer &data)
+    {
+        if (!TC_Redis_Trace_Holder::getInstance()->isEnable())
+        {
+            return frame(data);
+        }
+
+        int64_t iBegin = TC_Common::now2us();
+
+        if (_iFirst == 0)
+        {
+            _iFirst = iBegin;
+        }
+
+        bool bFull = frame(data);
+
+        int64_t iEnd = TC_Common::now2us();
+
+        _iDecode += iEnd - iBegin;
+
+        if (bFull)
+        {
+            _iFrame = iEnd;
+        }
+
+        return bFull;
+    }
+
+protected:
+    bool frame(TC_NetWorkBuffer::Buffer &data)
+    {
+        _buffer.append(data.buffer(), data.length());
+
+        data.clear();
+
+        //网络线程上只分帧, 解码在调用方线程进行.
+        //等待已知长度的bulk内容时, 收齐之前不再扫描
+        if (_buffer.size() < _parser.getNeed())
+        {
+            return false;
+        }
+
+        //增量分帧, 已扫描过的数据不会重复扫描, 支持嵌套应答
+        int64_t iRet = _parser.scan(_buffer.data(), _buffer.size());
+
+        if (iRet > 0)
+        {
+            return true;
+        }
+
+        if (iRet < 0)
+        {
+            _bError = true;
+            return false;
+        }
+
+        //大的bulk按其长度一次预留, 避免后续追加时反复扩容拷贝. 长度已由解析器限制在上限内
+        if (_parser.getNeed() > _buffer.capacity())
+        {
+            _buffer.reserve(_parser.getNeed());
+        }
+
+        return false;
+    }
+
+protected:
+    RedisReplyParser _parser;
+
+    int64_t          _iFirst;
+
+    int64_t          _iFrame;
+
+    int64_t          _iDecode;
+
+    bool             _bError;
+};
+
+
+/**
+* @brief 对象池的命中统计
+*/
+struct RedisPoolStat
+{
+    string   sName;
+
+    /**
+    * 取对象次数
+    */
+    uint64_t iGet;
+
+    /**
+    * 复用池中对象的次数
+    */
+    uint64_t iHit;
+};
+
+/**
+* @brief 对象池中各类型的清空方式及名字
+*/
+template<typename T>
+struct RedisPoolTraits
+{
+    /**
+    * @brief 复用前清空, 返回false表示不再复用(如占用内存过大)
+    */
+    static bool reset(T &t)
+    {
+        t.reset();
+
+        return true;
+    }
+
+    static const char *name();
+};
+
+template<> inline const char *RedisPoolTraits<RedisReq>::name() { return "RedisReq"; }
+
+template<> inline const char *RedisPoolTraits<RedisRsp>::name() { return "RedisRsp"; }
+
+template<>
+struct RedisPoolTraits<TC_NetWorkBuffer::Buffer>
+{
+    static bool reset(TC_NetWorkBuffer::Buffer &t)
+    {
+        if (t.capacity() > RedisReq::kMaxKeepBytes)
+        {
+            return false;
+        }
+
+        t.clear();
+
+        return true;
+    }
+
+    static const char *name() { return "Buffer"; }
+};
+
+/**
+* @brief 线程私有的对象池.
+*
+* 池中保存对象的shared_ptr, 取用时返回其拷贝; 使用方(包括网络线程等其他线程)都释放后引用计数回到1,
+* 对象即可在本线程再次取出复用. 对象不需要归还, 线程退出时池中的引用随之释放,
+* 仍被其他地方持有的对象不受影响.
+*/
+template<typename T>
+class RedisObjectPool
+{
+public:
+    enum
+    {
+        /**
+        * 每个线程池中最多的对象数
+        */
+        kPoolSize = 64,
+
+        /**
+        * 每次取用最多检查的对象数
+        */
+        kScan     = 8,
+    };
+
+    static shared_ptr<T> get()
+    {
+        Pool &pool = local();
+
+        add(pool.iGet);
+
+        for (size_t n = 0; n < kScan && n < pool.vObject.size(); n++)
+        {
+            shared_ptr<T> &t = pool.vObject[pool.iCur];
+
+            pool.iCur = (pool.iCur + 1) % pool.vObject.size();
+
+            if (t.use_count() == 1)
+            {
+                //其他线程最后对对象的修改在释放引用之前, 复用前同步
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (!RedisPoolTraits<T>::reset(*t))
+                {
+                    t = std::make_shared<T>();
+                    return t;
+                }
+
+                add(pool.iHit);
+
+                return t;
+            }
+        }
+
+        shared_ptr<T> t = std::make_shared<T>();
+
+        if (pool.vObject.size() < kPoolSize)
+        {
+            pool.vObject.push_back(t);
+        }
+
+        return t;
+    }
+
+    static RedisPoolStat getStat()
+    {
+        RedisPoolStat stat;
+
+        Registry &registry = getRegistry();
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        stat.sName = RedisPoolTraits<T>::name();
+        stat.iGet  = registry.iGet;
+        stat.iHit  = registry.iHit;
+
+        for (size_t i = 0; i < registry.vPool.size(); i++)
+        {
+            stat.iGet += registry.vPool[i]->iGet.load(std::memory_order_relaxed);
+            stat.iHit += registry.vPool[i]->iHit.load(std::memory_order_relaxed);
+        }
+
+        return stat;
+    }
+
+protected:
+    struct Pool;
+
+    /**
+    * @brief 登记各线程的池以汇总计数, 线程退出时其计数累加到这里
+    */
+    struct Registry
+    {
+        Registry() : iGet(0), iHit(0) {}
+
+        std::mutex      mutex;
+
+        vector<Pool*>   vPool;
+
+        uint64_t        iGet;
+
+        uint64_t        iHit;
+    };
+
+    struct Pool
+    {
+        Pool() : iCur(0), iGet(0), iHit(0)
+        {
+            Registry &registry = getRegistry();
+
+            std::lock_guard<std::mutex> lock(registry.mutex);
+
+            registry.vPool.push_back(this);
+        }
+
+        ~Pool()
+        {
+            Registry &registry = getRegistry();
+
+            std::lock_guard<std::mutex> lock(registry.mutex);
+
+            registry.iGet += iGet.load(std::memory_order_relaxed);
+            registry.iHit += iHit.load(std::memory_order_relaxed);
+
+            registry.vPool.erase(std::remove(registry.vPool.begin(), registry.vPool.end(), this), registry.vPool.end());
+        }
+
+        vector<shared_ptr<T> >  vObject;
+
+        size_t                  iCur;
+
+        /**
+        * 取用次数及命中次数, 只由所属线程写入
+        */
+        std::atomic<uint64_t>   iGet;
+
+        std::atomic<uint64_t>   iHit;
+    };
+
+    static Pool &local()
+    {
+        static thread_local Pool pool;
+
+        return pool;
+    }
+
+    static Registry &getRegistry()
+    {
+        static Registry registry;
+
+        return registry;
+    }
+
+    /**
+    * @brief 只有所属线程写入, 不需要原子的读改写
+    */
+    static void add(std::atomic<uint64_t> &counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+/**
+* @brief redis独占连接.
+*
+* 不经过ServantProxy的请求/应答模型, 用于订阅, 阻塞命令等需要长期占用一条连接的场景.
+* socket为非阻塞, 收发都用poll控制超时; 同一个对象不能多线程同时使用.
+*/
+class RedisConnection
+{
+public:
+    /**
+    * 每次recv至少预留的空间
+    */
+    enum { kRecvChunk = 64 * 1024 };
+
+    RedisConnection()
+        : _iTimeout(3000)
+        , _bConnected(false)
+        , _iReadPos(0)
+        , _iWritePos(0)
+    {
+    }
+
+    ~RedisConnection()
+    {
+        close();
+
+        if (_counter)
+        {
+            TC_Redis_Conn_Holder::getInstance()->remove(_counter);
+        }
+    }
+
+    /**
+    * @brief 初始化
+    *
+    * @param tcRDConf    redis配置
+    * @param iTimeout    连接/发送/等待应答的超时(毫秒)
+    */
+    void init(const TC_RDConf& tcRDConf, int iTimeout = 3000)
+    {
+        _rdConf   = tcRDConf;
+        _iTimeout = iTimeout;
+
+        if (_counter)
+        {
+            TC_Redis_Conn_Holder::getInstance()->remove(_counter);
+            _counter.reset();
+        }
+
+        if (TC_Redis_Conn_Holder::getInstance()->isEnable())
+        {
+            //与RedisProxy::genRedisObj的obj名一致, 便于和proxy的统计一起汇总
+            string sObj = "TARS.RedisServer.RedisObj." + _rdConf._host + "." + TC_Common::tostr(_rdConf._port);
+
+            _counter = TC_Redis_Conn_Holder::getInstance()->create(sObj, "conn");
+        }
+    }
+
+    const TC_RDConf& getConf() const { return _rdConf; }
+
+    int getTimeout() const { return _iTimeout; }
+
+    bool isConnected() const { return _bConnected; }
+
+    /**
+    * @brief 建立连接, 有密码时AUTH, 非0号库时SELECT
+    *
+    * @return 0 成功 -1 失败
+    */
+    int connect();
+
+    /**
+    * @brief 关闭连接, 丢弃未处理的数据
+    */
+    void close()
+    {
+        if (_socket.isValid())
+        {
+            _socket.close();
+        }
+
+        _bConnected = false;
+        _iReadPos   = 0;
+        _iWritePos  = 0;
+        _parser.reset();
+    }
+
+    /**
+    * @brief 发送全部数据
+    *
+    * @param iCommands  数据中包含的命令数, 用于统计在途命令
+    * @return 0 成功 -1 失败(连接已关闭)
+    */
+    int send(const char *pData, size_t iLen, size_t iCommands = 1)
+    {
+        if (!_bConnected)
+        {
+            return -1;
+        }
+
+        size_t iSent = 0;
+
+        while (iSent < iLen)
+        {
+            int iRet = _socket.send(pData + iSent, iLen - iSent);
+
+            if (iRet > 0)
+            {
+                iSent += iRet;
+            }
+            else if (iRet < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (iRet < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                if (wait(POLLOUT, _iTimeout) <= 0)
+                {
+                    if (_counter)
+                    {
+                        _counter->onTimeout();
+                    }
+
+                    close();
+                    return -1;
+                }
+            }
+            else
+            {
+                close();
+                return -1;
+            }
+        }
+
+        if (_counter)
+        {
+            _counter->onSend(iLen, iCommands);
+        }
+
+        return 0;
+    }
+
+    int send(const string& sCommand)
+    {
+        return send(sCommand.c_str(), sCommand.size());
+    }
+
+    /**
+    * @brief 等待并读取一次数据到接收缓冲
+    *
+    * @param iTimeout 等待时间(毫秒)
+    * @return >0 读到的字节数 0 超时 -1 连接关闭或出错
+    */
+    int recv(int iTimeout)
+    {
+        if (!_bConnected)
+        {
+            return -1;
+        }
+
+        int iRet = wait(POLLIN, iTimeout);
+
+        if (iRet <= 0)
+        {
+            return iRet;
+        }
+
+        reserve(kRecvChunk);
+
+        iRet = _socket.recv(&_vBuffer[_iWritePos], _vBuffer.size() - _iWritePos);
+
+        if (iRet > 0)
+        {
+            _iWritePos += iRet;
+
+            if (_counter)
+            {
+                _counter->onRecv(iRet, length());
+            }
+
+            return iRet;
+        }
+
+        if (iRet < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            return 0;
+        }
+
+        close();
+        return -1;
+    }
+
+    /**
+    * @brief 从接收缓冲中取出一个完整应答, 不做网络读取
+    *
+    * @return 1 取到 0 数据不完整 -1 协议错误(连接会被关闭)
+    */
+    int nextReply(RedisReply &reply)
+    {
+        int64_t iFrame = _parser.scan(data(), length());
+
+        if (iFrame == 0)
+        {
+            return 0;
+        }
+
+        size_t iPos = 0;
+
+        if (iFrame < 0 || RedisReplyParser::decode(data(), iFrame, iPos, reply) != 0)
+        {
+            LOG_CONSOLE_DEBUG << "protocol error from " << _rdConf._host << ":" << _rdConf._port << endl;
+            close();
+            return -1;
+        }
+
+        consume(iFrame);
+
+        if (_counter)
+        {
+            _counter->onReply();
+        }
+
+        return 1;
+    }
+
+    /**
+    * @brief 读取一个完整应答. 超时后连接上的应答已无法对齐, 连接会被关闭
+    *
+    * @param iTimeout 超时(毫秒), <0 使用初始化时的超时
+    * @return 0 成功 -1 失败
+    */
+    int readReply(RedisReply &reply, int iTimeout = -1)
+    {
+        int64_t iEnd = TC_Common::now2ms() + (iTimeout < 0 ? _iTimeout : iTimeout);
+
+        while (true)
+        {
+            int iRet = nextReply(reply);
+
+            if (iRet != 0)
+            {
+                return iRet > 0 ? 0 : -1;
+            }
+
+            int64_t iLeft = iEnd - TC_Common::now2ms();
+
+            if (iLeft <= 0 && _counter)
+            {
+                _counter->onTimeout();
+            }
+
+            if (iLeft <= 0 || recv(iLeft) < 0)
+            {
+                close();
+                return -1;
+            }
+        }
+    }
+
+    /**
+    * @brief 发送命令并等待应答
+    *
+    * @return 0 成功 -1 失败
+    */
+    int call(const string &sCommand, RedisReply &reply, int iTimeout = -1)
+    {
+        if (send(sCommand) != 0)
+        {
+            return -1;
+        }
+
+        return readReply(reply, iTimeout);
+    }
+
+    /**
+    * @brief 接收缓冲中未处理的数据
+    */
+    const char *data() const { return _vBuffer.empty() ? NULL : &_vBuffer[_iReadPos]; }
+
+    size_t length() const { return _iWritePos - _iReadPos; }
+
+    /**
+    * @brief 丢弃接收缓冲头部已处理的数据, 并开始扫描下一个应答
+    */
+    void consume(size_t iLen)
+    {
+        _iReadPos += iLen;
+
+        if (_iReadPos == _iWritePos)
+        {
+            _iReadPos  = 0;
+            _iWritePos = 0;
+        }
+
+        _parser.reset();
+    }
+
+protected:
+    /**
+    * @brief 等待socket事件
+    *
+    * @return 1 就绪 0 超时 -1 出错
+    */
+    int wait(short iEvent, int iTimeout)
+    {
+        struct pollfd pfd;
+        pfd.fd      = _socket.getfd();
+        pfd.events  = iEvent;
+        pfd.revents = 0;
+
+        int iRet;
+
+        do
+        {
+            iRet = poll(&pfd, 1, iTimeout);
+        }
+        while (iRet < 0 && errno == EINTR);
+
+        if (iRet > 0 && (pfd.revents & (POLLERR | POLLNVAL)) && !(pfd.revents & iEvent))
+        {
+            return -1;
+        }
+
+        return iRet < 0 ? -1 : iRet;
+    }
+
+    /**
+    * @brief 保证写位置后至少有iLen字节空间, 优先把未处理数据挪到头部
+    */
+    void reserve(size_t iLen)
+    {
+        if (_iWritePos + iLen <= _vBuffer.size())
+        {
+            return;
+        }
+
+        if (_iReadPos > 0)
+        {
+            memmove(&_vBuffer[0], &_vBuffer[_iReadPos], _iWritePos - _iReadPos);
+            _iWritePos -= _iReadPos;
+            _iReadPos   = 0;
+        }
+
+        if (_iWritePos + iLen > _vBuffer.size())
+        {
+            _vBuffer.resize(_iWritePos + iLen);
+        }
+    }
+
+protected:
+    TC_RDConf        _rdConf;
+
+    int              _iTimeout;
+
+    bool             _bConnected;
+
+    TC_Socket        _socket;
+
+    /**
+    * 接收缓冲, [_iReadPos, _iWritePos)为未处理的数据
+    */
+    vector<char>     _vBuffer;
+    size_t           _iReadPos;
+    size_t           _iWritePos;
+
+    RedisReplyParser _parser;
+
+    /**
+    * 连接统计, 关闭统计时为空
+    */
+    RedisConnCounterPtr _counter;
+};
+
+typedef shared_ptr<RedisConnection> RedisConnectionPtr;
+
+/**
+* @brief RedisConnection连接池, 连接数有上限, 连接用完时调用方等待
+*/
+class RedisConnectionPool
+{
+public:
+    RedisConnectionPool()
+        : _iMaxConn(8)
+        , _iWait(1000)
+        , _iTimeout(3000)
+        , _iCreated(0)
+    {
+    }
+
+    /**
+    * @brief 初始化
+    *
+    * @param tcRDConf    redis配置
+    * @param iMaxConn    最多连接数
+    * @param iWait       没有空闲连接时最多等待的毫秒数
+    * @param iTimeout    连接建立及收发的超时(毫秒)
+    */
+    void init(const TC_RDConf &tcRDConf, size_t iMaxConn, int iWait, int iTimeout = 3000)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _rdConf   = tcRDConf;
+        _iMaxConn = iMaxConn > 0 ? iMaxConn : 1;
+        _iWait    = iWait;
+        _iTimeout = iTimeout;
+    }
+
+    int getTimeout() const { return _iTimeout; }
+
+    /**
+    * @brief 取一个已建立的连接, 用完后必须put回来
+    *
+    * @return 等待超时或连接失败返回NULL
+    */
+    RedisConnectionPtr get()
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            std::chrono::steady_clock::time_point tEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(_iWait);
+
+            while (_idle.empty() && _iCreated >= _iMaxConn)
+            {
+                if (_cond.wait_until(lock, tEnd) == std::cv_status::timeout && _idle.empty() && _iCreated >= _iMaxConn)
+                {
+                    return RedisConnectionPtr();
+                }
+            }
+
+            if (!_idle.empty())
+            {
+                RedisConnectionPtr conn = _idle.back();
+                _idle.pop_back();
+                return conn;
+            }
+
+            ++_iCreated;
+        }
+
+        RedisConnectionPtr conn = std::make_shared<RedisConnection>();
+        conn->init(_rdConf, _iTimeout);
+
+        if (conn->connect() != 0)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            --_iCreated;
+            _cond.notify_one();
+
+            return RedisConnectionPtr();
+        }
+
+        return conn;
+    }
+
+    /**
+    * @brief 归还连接, 已断开的连接直接丢弃
+    */
+    void put(const RedisConnectionPtr &conn)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (conn->isConnected() && conn->length() == 0)
+        {
+            _idle.push_back(conn);
+        }
+        else
+        {
+            --_iCreated;
+        }
+
+        _cond.notify_one();
+    }
+
+    /**
+    * @brief 当前已建立的连接数(含使用中的)
+    */
+    size_t getCreated()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _iCreated;
+    }
+
+protected:
+    TC_RDConf                   _rdConf;
+
+    size_t                      _iMaxConn;
+
+    int                         _iWait;
+
+    int                         _iTimeout;
+
+    std::mutex                  _mutex;
+
+    std::condition_variable     _cond;
+
+    vector<RedisConnectionPtr>  _idle;
+
+    size_t                      _iCreated;
+};
+
+class TC_Redis_Config_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_Config_Holder>
+{
+public:
+	/**
+    * @brief 构造函数
+    */
+	TC_Redis_Config_Holder(){}
+
+	/**
+    * @brief 析构函数.
+    */
+	~TC_Redis_Config_Holder(){}
+
+    void set_password(const string& sObj, const string& sPasswd)
+    {
+        TC_ThreadWLock w(_rwl);
+        _mObjPasswd[sObj] = sPasswd;
+    }
+
+    int get_password(const string& sObj, string& sPasswd)
+    {
+        TC_ThreadRLock w(_rwl);
+
+        map<string, string>::iterator it = _mObjPasswd.find(sObj);
+        
+        if (it != _mObjPasswd.end())
+        {
+            sPasswd = it->second;
+
+            return 0;
+        }
+
+        return -1;
+    }
+
+protected:
+	/**
+    * @brief copy contructor，只申明,不定义,保证不被使用
+    */
+	TC_Redis_Config_Holder(const TC_Redis_Config_Holder &);
+
+	/**
+    * @brief 只申明,不定义,保证不被使用
+    */
+	TC_Redis_Config_Holder &operator=(const TC_Redis_Config_Holder &);
+
+private:
+	TC_ThreadRWLocker _rwl;
+    map<string, string> _mObjPasswd;
+};
+
+/**
+* @brief value压缩配置
+*/
+struct RedisCompressConf
+{
+    RedisCompressConf()
+        : iThreshold(0)
+        , bDecompress(false)
+    {
+    }
+
+    /**
+    * 写入时使用的codec, 为空不压缩
+    */
+    RedisCodecPtr codec;
+
+    /**
+    * 不小于该字节数的value才压缩
+    */
+    size_t iThreshold;
+
+    /**
+    * 读取时是否识别并解压
+    */
+    bool bDecompress;
+};
+
+/**
+* @brief 热点key的本地缓存.
+*        只缓存GET的结果, 条目iTtl毫秒后过期; 经本proxy的其他命令会使其所有参数对应的key失效
+*        (多key命令及RENAME/COPY等的目标key同样失效, FLUSHDB/FLUSHALL/SWAPDB清空缓存),
+*        其他客户端的写入最长iTtl毫秒后可见
+*/
+class RedisHotCache
+{
+public:
+    RedisHotCache(int iTtl, size_t iMaxKeys)
+        : _iTtl(iTtl)
+        , _iMaxKeys(iMaxKeys > 0 ? iMaxKeys : 1)
+        , _iVersion(0)
+    {
+    }
+
+    /**
+    * @brief 当前的失效序号, GET发送前取得, 缓存结果时传给set
+    */
+    uint64_t version()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return _iVersion;
+    }
+
+    /**
+    * @brief 取未过期的value
+    *
+    * @param iNow 当前时间(毫秒)
+    */
+    bool get(const string &sKey, string &sValue, int64_t iNow)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        unordered_map<string, pair<int64_t, string> >::iterator it = _mValue.find(sKey);
+
+        if (it == _mValue.end())
+        {
+            return false;
+        }
+
+        if (it->second.first <= iNow)
+        {
+            _mValue.erase(it);
+            return false;
+        }
+
+        sValue.assign(it->second.second);
+
+        return true;
+    }
+
+    /**
+    * @brief 缓存value, 已满时先清除过期的条目, 仍然满则不缓存.
+    *        GET发送后有过失效(iVersion已变化)时不缓存: 读到的可能是写入之前的值, 而写入的失效已经执行过了
+    *
+    * @param iVersion  GET发送前取得的version()
+    */
+    void set(const string &sKey, const string &sValue, int64_t iNow, uint64_t iVersion)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (iVersion != _iVersion)
+        {
+            return;
+        }
+
+        if (_mValue.size() >= _iMaxKeys && _mValue.find(sKey) == _mValue.end())
+        {
+            for (unordered_map<string, pair<int64_t, string> >::iterator it = _mValue.begin(); it != _mValue.end(); )
+            {
+                if (it->second.first <= iNow)
+                {
+                    it = _mValue.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            if (_mValue.size() >= _iMaxKeys)
+            {
+                return;
+            }
+        }
+
+        pair<int64_t, string> &value = _mValue[sKey];
+
+        value.first = iNow + _iTtl;
+        value.second.assign(sValue);
+    }
+
+    /**
+    * @brief 使编码后的命令涉及的key失效.
+    *        不区分key与value, 所有参数都当作key处理, 多清除的条目只是少一次命中
+    */
+    void invalidate(const string &sCommand)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        //缓存为空时同样递增, 使正在进行的GET不再缓存其结果
+        ++_iVersion;
+
+        if (_mValue.empty())
+        {
+            return;
+        }
+
+        const char *p = NULL;
+        int64_t iLen  = 0;
+        size_t iPos   = 0;
+
+        if (RedisReplyParser::readElement(sCommand.data(), sCommand.size(), iPos, p, iLen) != '*'
+            || RedisReplyParser::readElement(sCommand.data(), sCommand.size(), iPos, p, iLen) != '$')
+        {
+            return;
+        }
+
+        if ((iLen == 7 && TC_Port::strncasecmp(p, "FLUSHDB", 7) == 0)
+            || (iLen == 8 && TC_Port::strncasecmp(p, "FLUSHALL", 8) == 0)
+            || (iLen == 6 && TC_Port::strncasecmp(p, "SWAPDB", 6) == 0))
+        {
+            _mValue.clear();
+            return;
+        }
+
+        string sKey;
+
+        while (!_mValue.empty() && RedisReplyParser::readElement(sCommand.data(), sCommand.size(), iPos, p, iLen) == '$')
+        {
+            sKey.assign(p, iLen);
+            _mValue.erase(sKey);
+        }
+    }
+
+protected:
+    std::mutex                                      _mutex;
+
+    int                                             _iTtl;
+
+    size_t                                          _iMaxKeys;
+
+    /**
+    * 失效序号, 每次invalidate递增
+    */
+    uint64_t                                        _iVersion;
+
+    /**
+    * key -> (过期时间, value)
+    */
+    unordered_map<string, pair<int64_t, string> >   _mValue;
+};
+
+typedef shared_ptr<RedisHotCache> RedisHotCachePtr;
+
+/**
+* @brief 并发限制及熔断的配置
+*/
+struct RedisLimiterConf
+{
+    RedisLimiterConf()
+        : bLimit(true)
+        , iInitLimit(32)
+        , iMinLimit(4)
+        , iMaxLimit(512)
+        , dTolerance(2.0)
+        , dSmoothing(0.2)
+        , bBreaker(true)
+        , iWindow(10000)
+        , iMinRequests(20)
+        , iFailRatio(50)
+        , iConsecutive(10)
+        , iOpenTime(5000)
+        , iMaxOpenTime(60000)
+        , iProbes(1)
+        , iProbeSuccess(3)
+    {
+    }
+
+    /**
+    * 开启自适应并发限制
+    */
+    bool   bLimit;
+
+    /**
+    * 并发上限的初始值及范围
+    */
+    size_t iInitLimit;
+
+    size_t iMinLimit;
+
+    size_t iMaxLimit;
+
+    /**
+    * 延时超过长期平均延时的倍数后开始下调上限
+    */
+    double dTolerance;
+
+    /**
+    * 上限调整的平滑系数(0~1), 越大调整越快
+    */
+    double dSmoothing;
+
+    /**
+    * 开启熔断
+    */
+    bool   bBreaker;
+
+    /**
+    * 统计失败比例的周期(毫秒), 周期内请求数不少于iMinRequests且失败比例(百分比)不小于iFailRatio时熔断
+    */
+    int    iWindow;
+
+    size_t iMinRequests;
+
+    size_t iFailRatio;
+
+    /**
+    * 连续失败次数不小于该值时熔断
+    */
+    size_t iConsecutive;
+
+    /**
+    * 熔断后直接失败的时间(毫秒), 探测失败后加倍, 最长iMaxOpenTime
+    */
+    int    iOpenTime;
+
+    int    iMaxOpenTime;
+
+    /**
+    * 半开时同时放行的探测请求数, 及关闭熔断需要的连续探测成功次数
+    */
+    size_t iProbes;
+
+    size_t iProbeSuccess;
+};
+
+/**
+* @brief 并发限制及熔断的状态
+*/
+struct RedisLimiterStat
+{
+    /**
+    * 当前并发上限及在途请求数
+    */
+    size_t   iLimit;
+
+    size_t   iInFlight;
+
+    /**
+    * 熔断状态: 0 关闭 1 打开 2 半开
+    */
+    int      iState;
+
+    /**
+    * 长期平均延时(微秒)
+    */
+    uint64_t iLongRtt;
+
+    /**
+    * 超过并发上限/熔断而直接失败的请求数
+    */
+    uint64_t iRejectLimit;
+
+    uint64_t iRejectOpen;
+
+    /**
+    * 熔断打开的次数
+    */
+    uint64_t iTrips;
+};
+
+/**
+* @brief 一个endpoint的自适应并发限制及熔断.
+*
+* 并发上限按观测到的延时调整(gradient): 梯度 = dTolerance * 长期平均延时 / 本次延时, 限制在0.5~1之间,
+* 新上限 = 上限 * 梯度 + sqrt(上限), 再按dSmoothing平滑; 在途请求不到上限一半时不调整, 避免空闲时上限无限增长.
+* 熔断: 周期内失败比例或连续失败次数超过阈值时打开, 打开期间直接失败; 打开时间过后进入半开,
+* 只放行少量探测请求, 连续成功若干次后关闭, 探测失败则重新打开且打开时间加倍.
+* 失败指调用异常(超时, 连接断开等), redis返回的错误应答不算.
+* 熔断关闭时请求只有原子操作, 上限的调整在锁被占用时跳过该次样本.
+*/
+class RedisLimiter
+{
+public:
+    enum STATE
+    {
+        STATE_CLOSED    = 0,
+        STATE_OPEN      = 1,
+        STATE_HALF_OPEN = 2,
+    };
+
+    enum
+    {
+        ACQUIRE_OK    = 0,
+        ACQUIRE_LIMIT = 1,
+        ACQUIRE_OPEN  = 2,
+    };
+
+    RedisLimiter(const RedisLimiterConf &conf)
+        : _conf(conf)
+        , _iState(STATE_CLOSED)
+        , _iInFlight(0)
+        , _dLimit((double)conf.iInitLimit)
+        , _iLimit(conf.iInitLimit)
+        , _dLongRtt(0)
+        , _iSamples(0)
+        , _iWindowBegin(TC_Common::now2ms())
+        , _iTotal(0)
+        , _iFailed(0)
+        , _iConsecutive(0)
+        , _iOpenTime(conf.iOpenTime)
+        , _iOpenUntil(0)
+        , _iProbing(0)
+        , _iProbeSuccess(0)
+        , _iRejectLimit(0)
+        , _iRejectOpen(0)
+        , _iTrips(0)
+    {
+        _conf.iMinLimit = std::max<size_t>(_conf.iMinLimit, 1);
+        _conf.iMaxLimit = std::max(_conf.iMaxLimit, _conf.iMinLimit);
+        _conf.iProbes   = std::max<size_t>(_conf.iProbes, 1);
+
+        _dLimit = std::min(std::max(_dLimit, (double)_conf.iMinLimit), (double)_conf.iMaxLimit);
+        _iLimit = (size_t)_dLimit;
+    }
+
+    /**
+    * @brief 有proxy开启了并发限制或熔断, 都未开启时请求不必查询
+    */
+    static std::atomic<bool> &used()
+    {
+        static std::atomic<bool> bUsed(false);
+
+        return bUsed;
+    }
+
+    /**
+    * @brief 请求发送前调用, 返回ACQUIRE_OK时请求结束后必须调用release
+    *
+    * @param bProbe  返回是否为半开时的探测请求
+    * @return ACQUIRE_OK 放行 ACQUIRE_LIMIT 超过并发上限 ACQUIRE_OPEN 熔断中
+    */
+    int acquire(bool &bProbe)
+    {
+        bProbe = false;
+
+        if (_conf.bBreaker && _iState.load(std::memory_order_acquire) != STATE_CLOSED)
+        {
+            int64_t iNow = TC_Common::now2ms();
+
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_iState == STATE_OPEN)
+            {
+                if (iNow < _iOpenUntil)
+                {
+                    _iRejectOpen.fetch_add(1, std::memory_order_relaxed);
+                    return ACQUIRE_OPEN;
+                }
+
+                _iState        = STATE_HALF_OPEN;
+                _iProbing      = 0;
+                _iProbeSuccess = 0;
+            }
+
+            if (_iState == STATE_HALF_OPEN)
+            {
+                if (_iProbing >= _conf.iProbes)
+                {
+                    _iRejectOpen.fetch_add(1, std::memory_order_relaxed);
+                    return ACQUIRE_OPEN;
+                }
+
+                ++_iProbing;
+                _iInFlight.fetch_add(1, std::memory_order_relaxed);
+
+                bProbe = true;
+                return ACQUIRE_OK;
+            }
+        }
+
+        size_t iInFlight = _iInFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        if (_conf.bLimit && iInFlight > _iLimit.load(std::memory_order_relaxed))
+        {
+            _iInFlight.fetch_sub(1, std::memory_order_relaxed);
+            _iRejectLimit.fetch_add(1, std::memory_order_relaxed);
+            return ACQUIRE_LIMIT;
+        }
+
+        return ACQUIRE_OK;
+    }
+
+    /**
+    * @brief 请求结束
+    *
+    * @param iCost     耗时(微秒)
+    * @param bSuccess  是否成功(没有调用异常)
+    * @param bProbe    acquire返回的是否为探测请求
+    * @param bCount    是否计入熔断及延时样本, 调用方自己的截止时间导致的超时不反映服务端状态, 不计
+    */
+    void release(int64_t iCost, bool bSuccess, bool bProbe, bool bCount = true)
+    {
+        size_t iInFlight = _iInFlight.fetch_sub(1, std::memory_order_relaxed);
+
+        if (bProbe)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            --_iProbing;
+
+            if (_iState != STATE_HALF_OPEN || !bCount)
+            {
+                return;
+            }
+
+            if (!bSuccess)
+            {
+                open(TC_Common::now2ms(), true);
+            }
+            else if (++_iProbeSuccess >= _conf.iProbeSuccess)
+            {
+                close();
+            }
+
+            return;
+        }
+
+        if (!bCount)
+        {
+            return;
+        }
+
+        if (_conf.bBreaker)
+        {
+            onResult(bSuccess);
+        }
+
+        if (_conf.bLimit)
+        {
+            std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+
+            if (lock.owns_lock())
+            {
+                update(iCost > 0 ? iCost : 1, iInFlight);
+            }
+        }
+    }
+
+    void getStat(RedisLimiterStat &stat)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        stat.iLimit       = _conf.bLimit ? _iLimit.load(std::memory_order_relaxed) : 0;
+        stat.iInFlight    = _iInFlight.load(std::memory_order_relaxed);
+        stat.iState       = _iState.load(std::memory_order_relaxed);
+        stat.iLongRtt     = (uint64_t)_dLongRtt;
+        stat.iRejectLimit = _iRejectLimit.load(std::memory_order_relaxed);
+        stat.iRejectOpen  = _iRejectOpen.load(std::memory_order_relaxed);
+        stat.iTrips       = _iTrips;
+    }
+
+protected:
+    /**
+    * @brief 熔断关闭时的成功/失败计数
+    */
+    void onResult(bool bSuccess)
+    {
+        int64_t iNow = TC_Common::now2ms();
+
+        _iTotal.fetch_add(1, std::memory_order_relaxed);
+
+        if (bSuccess)
+        {
+            if (_iConsecutive.load(std::memory_order_relaxed) != 0)
+            {
+                _iConsecutive.store(0, std::memory_order_relaxed);
+            }
+
+            if (iNow - _iWindowBegin.load(std::memory_order_relaxed) < _conf.iWindow)
+            {
+                return;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+
+        //成功时只需要换周期, 锁被占用就留给下一个请求
+        if (!bSuccess)
+        {
+            lock.lock();
+        }
+        else if (!lock.try_lock())
+        {
+            return;
+        }
+
+        if (iNow - _iWindowBegin.load(std::memory_order_relaxed) >= _conf.iWindow)
+        {
+            _iWindowBegin.store(iNow, std::memory_order_relaxed);
+            _iTotal.store(bSuccess ? 0 : 1, std::memory_order_relaxed);
+            _iFailed = 0;
+        }
+
+        if (bSuccess || _iState != STATE_CLOSED)
+        {
+            return;
+        }
+
+        ++_iFailed;
+
+        size_t iConsecutive = _iConsecutive.fetch_add(1, std::memory_order_relaxed) + 1;
+        uint64_t iTotal     = _iTotal.load(std::memory_order_relaxed);
+
+        if (iConsecutive >= _conf.iConsecutive || (iTotal >= _conf.iMinRequests && _iFailed * 100 >= iTotal * _conf.iFailRatio))
+        {
+            open(iNow, false);
+        }
+    }
+
+    /**
+    * @brief 打开熔断, 调用方持有_mutex
+    *
+    * @param bBackoff 探测失败, 打开时间加倍
+    */
+    void open(int64_t iNow, bool bBackoff)
+    {
+        _iOpenTime  = bBackoff ? std::min(_iOpenTime * 2, _conf.iMaxOpenTime) : _conf.iOpenTime;
+        _iOpenUntil = iNow + _iOpenTime;
+
+        _iState.store(STATE_OPEN, std::memory_order_release);
+
+        ++_iTrips;
+
+        LOG_CONSOLE_DEBUG << "redis circuit breaker open " << _iOpenTime << "ms, failed:" << _iFailed
+                          << "/" << _iTotal.load(std::memory_order_relaxed) << ", consecutive:" << _iConsecutive.load(std::memory_order_relaxed) << endl;
+    }
+
+    /**
+    * @brief 探测成功, 关闭熔断, 调用方持有_mutex
+    */
+    void close()
+    {
+        _iOpenTime = _conf.iOpenTime;
+        _iFailed   = 0;
+
+        _iTotal.store(0, std::memory_order_relaxed);
+        _iConsecutive.store(0, std::memory_order_relaxed);
+        _iWindowBegin.store(TC_Common::now2ms(), std::memory_order_relaxed);
+
+        _iState.store(STATE_CLOSED, std::memory_order_release);
+
+        LOG_CONSOLE_DEBUG << "redis circuit breaker closed" << endl;
+    }
+
+    /**
+    * @brief 按本次延时调整并发上限, 调用方持有_mutex
+    *
+    * @param iInFlight 本请求结束前的在途请求数
+    */
+    void update(int64_t iCost, size_t iInFlight)
+    {
+        double dRtt = (double)iCost;
+
+        //前600个样本取算术平均, 之后为指数平均
+        ++_iSamples;
+        _dLongRtt += (dRtt - _dLongRtt) / std::min<uint64_t>(_iSamples, 600);
+
+        //延时远低于长期平均, 说明已从拥塞中恢复, 让长期平均更快回落
+        if (_dLongRtt > dRtt * 2)
+        {
+            _dLongRtt *= 0.95;
+        }
+
+        if (iInFlight < _dLimit / 2)
+        {
+            return;
+        }
+
+        double dGradient = std::max(0.5, std::min(1.0, _conf.dTolerance * _dLongRtt / dRtt));
+        double dNewLimit = _dLimit * dGradient + std::sqrt(_dLimit);
+
+        dNewLimit = _dLimit * (1 - _conf.dSmoothing) + dNewLimit * _conf.dSmoothing;
+        dNewLimit = std::min(std::max(dNewLimit, (double)_conf.iMinLimit), (double)_conf.iMaxLimit);
+
+        _dLimit = dNewLimit;
+        _iLimit.store((size_t)dNewLimit, std::memory_order_relaxed);
+    }
+
+protected:
+    RedisLimiterConf        _conf;
+
+    std::mutex              _mutex;
+
+    std::atomic<int>        _iState;
+
+    std::atomic<size_t>     _iInFlight;
+
+    /**
+    * 并发上限, _dLimit由_mutex保护, _iLimit为其整数部分供acquire读取
+    */
+    double                  _dLimit;
+
+    std::atomic<size_t>     _iLimit;
+
+    double                  _dLongRtt;
+
+    uint64_t                _iSamples;
+
+    /**
+    * 失败比例的统计周期
+    */
+    std::atomic<int64_t>    _iWindowBegin;
+
+    std::atomic<uint64_t>   _iTotal;
+
+    uint64_t                _iFailed;
+
+    std::atomic<size_t>     _iConsecutive;
+
+    int                     _iOpenTime;
+
+    int64_t                 _iOpenUntil;
+
+    size_t                  _iProbing;
+
+    size_t                  _iProbeSuccess;
+
+    std::atomic<uint64_t>   _iRejectLimit;
+
+    std::atomic<uint64_t>   _iRejectOpen;
+
+    uint64_t                _iTrips;
+};
+
+typedef shared_ptr<RedisLimiter> RedisLimiterPtr;
+
+/**
+* @brief 请求结束时释放RedisLimiter, 没有标记成功(调用异常)时按失败计
+*/
+class RedisLimiterGuard
+{
+public:
+    RedisLimiterGuard(RedisLimiter *limiter, bool bProbe, int64_t iBegin)
+        : _limiter(limiter)
+        , _bProbe(bProbe)
+        , _iBegin(iBegin)
+        , _bSuccess(false)
+        , _bCount(true)
+    {
+    }
+
+    ~RedisLimiterGuard()
+    {
+        if (_limiter != NULL)
+        {
+            _limiter->release(TC_Common::now2us() - _iBegin, _bSuccess, _bProbe, _bCount);
+        }
+    }
+
+    void setSuccess() { _bSuccess = true; }
+
+    /**
+    * @brief 本次结果不计入熔断及延时样本
+    */
+    void setIgnore() { _bCount = false; }
+
+protected:
+    RedisLimiter   *_limiter;
+
+    bool            _bProbe;
+
+    int64_t         _iBegin;
+
+    bool            _bSuccess;
+
+    bool            _bCount;
+};
+
+/**
+* @brief 调用的截止时间.
+*
+* 当前线程的截止时间由RedisDeadlineScope设置, 与proxy上按命令配置的超时(RedisProxy::setCommandTimeout)
+* 及proxy的超时取最早的一个. 调用前已超过截止时间的请求不发送, 直接失败;
+* 在ServantProxy的队列中等到截止时间之后才轮到发送的请求, 网络线程改为发送PING(保持应答顺序), 不再占用redis的处理能力
+*/
+class RedisDeadline
+{
+public:
+    /**
+    * @brief 当前线程的截止时间(1970年以来的微秒), 0 没有
+    */
+    static int64_t &current()
+    {
+        static thread_local int64_t iDeadline = 0;
+
+        return iDeadline;
+    }
+
+    /**
+    * @brief 有proxy按命令配置了超时, 都未配置时请求不必查询
+    */
+    static std::atomic<bool> &used()
+    {
+        static std::atomic<bool> bUsed(false);
+
+        return bUsed;
+    }
+
+    /**
+    * @brief 发送前已超时而直接失败的请求数
+    */
+    static std::atomic<uint64_t> &expired()
+    {
+        static std::atomic<uint64_t> iExpired(0);
+
+        return iExpired;
+    }
+
+    /**
+    * @brief 轮到发送时已超时而改为PING的请求数
+    */
+    static std::atomic<uint64_t> &cancelled()
+    {
+        static std::atomic<uint64_t> iCancelled(0);
+
+        return iCancelled;
+    }
+};
+
+/**
+* @brief 在作用域内为当前线程的redis调用设置截止时间, 嵌套时取更早的一个, 析构时恢复.
+*
+* 在tars服务中可从收到的请求推导剩余时间, 如:
+*   RedisDeadlineScope scope(current->getRecvTime(), current->getTimeout());
+*/
+class RedisDeadlineScope
+{
+public:
+    /**
+    * @param iTimeout 从现在开始的超时(毫秒)
+    */
+    explicit RedisDeadlineScope(int iTimeout)
+        : _iPrevious(RedisDeadline::current())
+    {
+        set(TC_Common::now2us() + iTimeout * 1000LL);
+    }
+
+    /**
+    * @param iBegin    请求开始的时间(毫秒), 如收到tars请求的时间
+    * @param iTimeout  请求的总超时(毫秒)
+    */
+    RedisDeadlineScope(int64_t iBegin, int iTimeout)
+        : _iPrevious(RedisDeadline::current())
+    {
+        set((iBegin + iTimeout) * 1000LL);
+    }
+
+    ~RedisDeadlineScope()
+    {
+        RedisDeadline::current() = _iPrevious;
+    }
+
+protected:
+    void set(int64_t iDeadline)
+    {
+        int64_t &iCurrent = RedisDeadline::current();
+
+        if (iCurrent == 0 || iDeadline < iCurrent)
+        {
+            iCurrent = iDeadline;
+        }
+    }
+
+    RedisDeadlineScope(const RedisDeadlineScope &);
+    RedisDeadlineScope &operator=(const RedisDeadlineScope &);
+
+protected:
+    int64_t _iPrevious;
+};
+
+/**
+* @brief 每个redis obj的运行时状态.
+*
+* RedisProxy由ServantProxyFactory按ServantProxy创建后强转而来, 自身不能有成员,
+* 因此和密码一样, 按obj名保存在TC_Redis_Context_Holder中.
+*/
+struct RedisProxyContext
+{
+    RedisProxyContext()
+        : iBlockingConn(8)
+        , iBlockingWait(1000)
+    {
+    }
+
+    /**
+    * 保护以下成员的延迟创建
+    */
+    std::mutex mutex;
+
+    /**
+    * 阻塞命令独占连接的上限
+    */
+    size_t iBlockingConn;
+
+    /**
+    * 阻塞命令等待空闲连接的毫秒数
+    */
+    int iBlockingWait;
+
+    /**
+    * 阻塞命令(BLPOP/BRPOP/BLMOVE/XREAD BLOCK...)使用的连接池
+    */
+    shared_ptr<RedisConnectionPool> blockingPool;
+
+    /**
+    * value压缩配置
+    */
+    RedisCompressConf compress;
+
+    /**
+    * 热点key的本地缓存, 未开启时为空
+    */
+    RedisHotCachePtr hotCache;
+
+    /**
+    * 并发限制及熔断, 未开启时为空
+    */
+    RedisLimiterPtr limiter;
+
+    /**
+    * 按命令名(大写)配置的超时(毫秒)
+    */
+    map<string, int> mCommandTimeout;
+};
+
+typedef shared_ptr<RedisProxyContext> RedisProxyContextPtr;
+
+class TC_Redis_Context_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_Context_Holder>
+{
+public:
+    /**
+    * @brief 取obj对应的状态, 不存在则创建
+    */
+    RedisProxyContextPtr get(const string& sObj)
+    {
+        {
+            TC_ThreadRLock r(_rwl);
+
+            map<string, RedisProxyContextPtr>::iterator it = _mContext.find(sObj);
+
+            if (it != _mContext.end())
+            {
+                return it->second;
+            }
+        }
+
+        TC_ThreadWLock w(_rwl);
+
+        RedisProxyContextPtr &context = _mContext[sObj];
+
+        if (!context)
+        {
+            context = std::make_shared<RedisProxyContext>();
+        }
+
+        return context;
+    }
+
+private:
+	TC_ThreadRWLocker _rwl;
+    map<string, RedisProxyContextPtr> _mContext;
+};
+
+class RedisProxy: public ServantProxy
+{
+public:
+    static string genRedisObj(const string& sHost, const string& sPasswd, const int& port)
+    {
+        string sObj = "TARS.RedisServer.RedisObj." + sHost + "." + TC_Common::tostr(port);
+        TC_Redis_Config_Holder::getInstance()->set_password(sObj, sPasswd);
+
+        sObj += "@tcp -h " + sHost + " -p " + TC_Common::tostr(port);
+        if (!sPasswd.empty())
+        {
+            sObj += " -e 1";
+        }
+
+        return sObj;
+    }
+
+    static string genRedisObj(const TC_RDConf& tcRDConf)
+    {
+        string sObj = "TARS.RedisServer.RedisObj." + tcRDConf._host + "." + TC_Common::tostr(tcRDConf._port);
+        sObj += "@tcp -h " + tcRDConf._host + " -p " + TC_Common::tostr(tcRDConf._port);
+
+        if (!tcRDConf._password.empty())
+        {
+            sObj += " -e 1";
+            TC_Redis_Config_Holder::getInstance()->set_password(sObj, tcRDConf._password);
+        }
+
+        return sObj;
+    }
+    
+    static shared_ptr<TC_NetWorkBuffer::Buffer> redisRequest(tars::RequestPacket& request, TC_Transceiver *trans)
+    {
+        shared_ptr<TC_NetWorkBuffer::Buffer> buff = RedisObjectPool<TC_NetWorkBuffer::Buffer>::get();
+
+        bool bAuth = TC_Port::strncasecmp(request.sFuncName.c_str(), "InnerAuthServer", request.sFuncName.size()) == 0;
+
+        if (bAuth)
+        {
+            string sPasswd;
+            TC_Redis_Config_Holder::getInstance()->get_password(request.sServantName, sPasswd);
+            if (!sPasswd.empty())
+            {
+                //按RESP编码, 密码中可以有空格等字符, 也不依赖服务端支持inline命令
+                string sCommand;
+
+                appendCommandHeader(sCommand, 2);
+                appendCommandArg(sCommand, "AUTH", 4);
+                appendCommandArg(sCommand, sPasswd);
+
+                buff->addBuffer(sCommand);
+            }
+        }
+        else
+        {
+            shared_ptr<RedisReq> &data = *(shared_ptr<RedisReq>*)request.sBuffer.data();
+
+            if (data->getDeadline() != 0 && TC_Common::now2us() >= data->getDeadline())
+            {
+                //调用方已超时, 只发PING占住应答的位置
+                buff->addBuffer("*1\r\n$4\r\nPING\r\n");
+                data->setCancelled();
+
+                RedisDeadline::cancelled().fetch_add(1, std::memory_order_relaxed);
+            }
+            else if (TC_Redis_Trace_Holder::getInstance()->isEnable())
+            {
+                int64_t iBegin = TC_Common::now2us();
+
+                data->encode(buff);
+                data->setEncodeTime(iBegin, TC_Common::now2us());
+            }
+            else
+            {
+                data->encode(buff);
+            }
+
+            data.reset();
+        }
+
+        if (TC_Redis_Conn_Holder::getInstance()->isEnable() && !buff->empty())
+        {
+            bool bNew = false;
+
+            RedisConnCounter *counter = TC_Redis_Conn_Holder::getInstance()->getProxyCounter(trans, request.sServantName, &bNew);
+
+            //AUTH是连接建立后的第一个请求, 之后再出现即为重连; 无密码时只能记录第一次连接
+            if (bNew || bAuth)
+            {
+                counter->onConnect();
+            }
+
+            counter->onSend(buff->length(), 1);
+        }
+
+        return buff;
+    }
+
+    static TC_NetWorkBuffer::PACKET_TYPE redisResponse(TC_NetWorkBuffer &in, ResponsePacket& rsp)
+    {
+        shared_ptr<RedisRsp> *context = (shared_ptr<RedisRsp>*)(in.getContextData());
+
+        const int kAuthType = 0x40;
+
+        if(!context)
+        {
+            context = new shared_ptr<RedisRsp>();
+            *context = RedisObjectPool<RedisRsp>::get();
+            in.setContextData(context, [](TC_NetWorkBuffer*nb){ shared_ptr<RedisRsp> *p = (shared_ptr<RedisRsp>*)(nb->getContextData()); if(p) { nb->setContextData(NULL); delete p; }});
+        }
+
+        RedisConnCounter *counter = NULL;
+
+        if (TC_Redis_Conn_Holder::getInstance()->isEnable())
+        {
+            counter = TC_Redis_Conn_Holder::getInstance()->findProxyCounter(in.getConnection());
+
+            if (counter)
+            {
+                counter->onRecv(in.getBufferLength(), in.getBufferLength() + (*context)->getBuffer().size());
+            }
+        }
+
+        if((*context)->incrementDecode(in))
+        {	
+            in.getBuffer()->clear();
+
+            if (counter)
+            {
+                counter->onReply();
+
+                if (rsp.iMessageType == kAuthType && (*context)->getBuffer().compare(0, 1, "-") == 0)
+                {
+                    counter->onAuthFailed();
+                }
+            }
+
+            rsp.sBuffer.resize(sizeof(shared_ptr<RedisRsp>));
+
+            shared_ptr<RedisRsp> &data = *(shared_ptr<RedisRsp>*)rsp.sBuffer.data();
+            data = *context;
+
+            auto ret = TC_NetWorkBuffer::PACKET_FULL;
+
+            (*context) = NULL;
+            delete context;
+            in.setContextData(NULL);
+            
+            if (rsp.iMessageType == kAuthType)
+            {
+                string sRet = "AUTH_SUCC";
+                rsp.sBuffer.assign(sRet.begin(), sRet.end());
+            }
+
+            return ret;
+        }
+
+        if ((*context)->isError())
+        {
+            return TC_NetWorkBuffer::PACKET_ERR;
+        }
+
+        return TC_NetWorkBuffer::PACKET_LESS;
+    }
+    
+    /**
+    * @brief 初始化. 
+    *  
+    * @param sHost        主机IP
+    * @param sPasswd      密码
+    * @param port         端口
+    * @return 无
+    */
+    void init(const string& sHost, const string& sPasswd = "", int port = 0)
+    {
+        _rdConf._host     = sHost;
+        _rdConf._password = sPasswd;
+        _rdConf._port     = port;
+    }
+
+    /**
+    * @brief 初始化. 
+    *  
+    * @param tcDBConf 数据库配置
+    */
+    void init(const TC_RDConf& tcRDConf)
+    {
+        _rdConf = tcRDConf;
+    }
+    
+    /**
+    * @brief get数据 
+    *  
+    * @param sKey        
+    * @param sValue      直接从应答缓冲写入, 复用sValue已有的内存
+    * @return 0 成功 1 没有数据 -1 失败
+    */
+    int get(const string& sKey, string& sValue)
+    {
+        RedisHotCachePtr cache = getHotCache();
+        int64_t iNow      = 0;
+        uint64_t iVersion = 0;
+
+        if (cache)
+        {
+            iNow = TC_Common::now2us();
+
+            if (cache->get(sKey, sValue, iNow / 1000))
+            {
+                TC_Redis_HotKey_Holder::getInstance()->record([this]{ return tars_name(); }, sKey.data(), sKey.size(), iNow);
+                return 0;
+            }
+
+            iVersion = cache->version();
+        }
+
+        shared_ptr<TC_CustomProtoRsp> rsp;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        int iRet = doKeyBulkCommand("GET", sKey, rsp, p, iLen);
+
+        if (iRet == 0)
+        {
+            //压缩的value直接解压到sValue
+            iRet = unpackValue(getCompressConf(), p, iLen, sValue);
+
+            if (iRet == 0 && p != sValue.data())
+            {
+                //assign复用sValue已有的内存
+                sValue.assign(p, iLen);
+            }
+        }
+
+        if (cache && iRet == 0 && TC_Redis_HotKey_Holder::getInstance()->isHot(sKey))
+        {
+            cache->set(sKey, sValue, iNow / 1000, iVersion);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief get数据 
+    *  
+    * @param sKey        
+    * @param vValue      直接从应答缓冲写入, 复用vValue已有的内存
+    * @return 0 成功 1 没有数据 -1 失败
+    */
+    int get(const string& sKey, vector<char>& vValue)
+    {
+        shared_ptr<TC_CustomProtoRsp> rsp;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        int iRet = doKeyBulkCommand("GET", sKey, rsp, p, iLen);
+
+        if (iRet == 0)
+        {
+            iRet = unpackValue(getCompressConf(), p, iLen, getUnpackBuffer());
+        }
+
+        if (iRet == 0)
+        {
+            vValue.assign(p, p + iLen);
+        }
+        else
+        {
+            vValue.clear();
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief get数据到调用方提供的定长缓冲
+    *  
+    * @param sKey        
+    * @param pBuffer     缓冲
+    * @param iSize       缓冲大小
+    * @param iLen        返回数据的实际长度(可能大于iSize)
+    * @param bTruncated  返回数据是否被截断(实际长度大于iSize时只写入前iSize字节)
+    * @return 0 成功 1 没有数据 -1 失败
+    */
+    int get(const string& sKey, char* pBuffer, size_t iSize, size_t& iLen, bool& bTruncated)
+    {
+        shared_ptr<TC_CustomProtoRsp> rsp;
+        const char *p  = NULL;
+        int64_t iValue = 0;
+
+        iLen       = 0;
+        bTruncated = false;
+
+        int iRet = doKeyBulkCommand("GET", sKey, rsp, p, iValue);
+
+        if (iRet == 0)
+        {
+            iRet = unpackValue(getCompressConf(), p, iValue, getUnpackBuffer());
+        }
+
+        if (iRet == 0)
+        {
+            iLen       = iValue;
+            bTruncated = iLen > iSize;
+
+            memcpy(pBuffer, p, bTruncated ? iSize : iLen);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief get数据, 追加到TC_NetWorkBuffer
+    *  
+    * @param sKey        
+    * @param buff        
+    * @return 0 成功 1 没有数据 -1 失败
+    */
+    int get(const string& sKey, TC_NetWorkBuffer& buff)
+    {
+        shared_ptr<TC_CustomProtoRsp> rsp;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        int iRet = doKeyBulkCommand("GET", sKey, rsp, p, iLen);
+
+        if (iRet == 0)
+        {
+            iRet = unpackValue(getCompressConf(), p, iLen, getUnpackBuffer());
+        }
+
+        if (iRet == 0 && iLen > 0)
+        {
+            buff.addBuffer(p, iLen);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief set
+    *  
+    * @param sKey        
+    * @param sValue      
+    * @param expir 数据的过期时间   
+    * @return 0 成功 -1 失败
+    */
+    int set(const string& sKey, const string& sValue, unsigned int expir = 0)
+    {
+        return setData(sKey, sValue.data(), sValue.size(), expir);
+    }
+
+    /**
+    * @brief set, value为调用方的一段内存, 直接编码进命令
+    *        (不与set重载, 避免set(key, "literal", expir)被解析为长度)
+    *
+    * @param sKey
+    * @param pValue
+    * @param iLen
+    * @param expir 数据的过期时间
+    * @return 0 成功 -1 失败
+    */
+    int setData(const string& sKey, const char* pValue, size_t iLen, unsigned int expir = 0)
+    {
+        string sCommand;
+        sCommand.reserve(64 + sKey.size() + iLen);
+
+        if (expir == 0)
+        {
+            appendCommandHeader(sCommand, 3);
+            appendCommandArg(sCommand, "SET", 3);
+            appendCommandArg(sCommand, sKey);
+        }
+        else
+        {
+            char buf[16];
+
+            appendCommandHeader(sCommand, 4);
+            appendCommandArg(sCommand, "SETEX", 5);
+            appendCommandArg(sCommand, sKey);
+            appendCommandArg(sCommand, buf, snprintf(buf, sizeof(buf), "%u", expir));
+        }
+
+        string sPacked;
+        appendValue(getCompressConf(), sCommand, pValue, iLen, sPacked);
+
+        return doStatusCommand(sCommand);
+    }
+
+    /**
+    * @brief mset
+    *  
+    * @param vKeyValue        
+    * @return 0 成功 -1 失败
+    */
+    int mset(const vector<pair<string, string> >& vKeyValue)
+    {
+        return mset(vKeyValue.begin(), vKeyValue.end());
+    }
+
+    /**
+    * @brief mset, 元素的first为key, second为value(string, vector<char>或const char*),
+    *        直接从区间编码进命令, 不产生中间拷贝
+    *
+    * @param begin, end  前向迭代器区间
+    * @return 0 成功 -1 失败
+    */
+    template<typename Iterator>
+    int mset(Iterator begin, Iterator end)
+    {
+        string sCommand;
+
+        appendCommandHeader(sCommand, 1 + std::distance(begin, end) * 2);
+        appendCommandArg(sCommand, "MSET", 4);
+
+        RedisCompressConf conf = getCompressConf();
+        string sPacked;
+
+        for (; begin != end; ++begin)
+        {
+            appendCommandArg(sCommand, argData(begin->first), argSize(begin->first));
+            appendValue(conf, sCommand, argData(begin->second), argSize(begin->second), sPacked);
+        }
+
+        return doStatusCommand(sCommand);
+    }
+
+    /**
+    * @brief del
+    *  
+    * @param sKey        
+    * @return 0 成功 -1 失败
+    */
+    int del( const string& sKey )
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("DEL");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief exists
+    *  
+    * @param sKey        
+    * @return 0-不存在；1-存在
+    */
+    int exists(const string& sKey)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("EXISTS");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief del
+    *  
+    * @param vKey        
+    * @return 
+    */
+    int del(const vector<string>& vKey)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("DEL");
+
+        for (size_t i = 0; i < vKey.size(); i++)
+        {
+            vPart.push_back(vKey[i]);
+        }
+        
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    *@brief 批量获取数据
+    *@param vKey
+    *@param mpValues:返回key value对集合
+    *@param vNoKey: 不存在的key集合
+    * @return 0 成功 -1 失败
+    */   
+    int get(const vector<string>& vKey, map<string,string>& mValues, vector<string>& vNoKey)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+        vPart.push_back("MGET");
+
+        for (size_t i=0; i < vKey.size(); i++)
+        {        
+            vPart.push_back(vKey[i]);
+        }
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (vKey.size() != vBuffer.size())
+        {
+            iRet = -1;
+
+            return iRet;
+        }
+        
+        RedisCompressConf conf = getCompressConf();
+
+        for (size_t i = 0; i < vKey.size(); i++)
+        {
+            if (vBuffer[i].first < 0)
+            {
+                vNoKey.push_back(vKey[i]);
+            }
+            else
+            {
+                string &sValue = mValues[vKey[i]];
+                sValue.swap(vBuffer[i].second);
+
+                if (unpackValue(conf, sValue) != 0)
+                {
+                    iRet = -1;
+                }
+            }
+        }
+        
+        return iRet;
+    }
+
+    /**
+    * @brief 批量获取数据, 结果与vKey按位置一一对应, 没有逐个key的map插入
+    *
+    * @param vKey
+    * @param vValue  返回与vKey等长的结果: first为value长度, 不存在时为-1; 复用vValue中已有string的内存
+    * @return 0 成功 -1 失败
+    */
+    int get(const vector<string>& vKey, vector<pair<int, string> >& vValue)
+    {
+        RedisCompressConf conf = getCompressConf();
+        int iRet = 0;
+
+        int iCount = doArrayCommand(buildMget(vKey), [&](size_t i, const char *p, int64_t iLen)
+        {
+            if (i == 0)
+            {
+                vValue.resize(iLen);
+                return;
+            }
+
+            pair<int, string> &value = vValue[i - 1];
+
+            if (iLen < 0)
+            {
+                value.first = -1;
+                value.second.clear();
+            }
+            else if (unpackValue(conf, p, iLen, value.second) == 0)
+            {
+                if (p != value.second.data())
+                {
+                    value.second.assign(p, iLen);
+                }
+
+                value.first = value.second.size();
+            }
+            else
+            {
+                iRet = -1;
+            }
+        });
+
+        return iCount == (int)vKey.size() ? iRet : -1;
+    }
+
+    /**
+    * @brief 批量获取数据到hash表, 不存在的key不出现在结果中
+    *
+    * @param vKey
+    * @param mValue
+    * @return 0 成功 -1 失败
+    */
+    int get(const vector<string>& vKey, unordered_map<string, string>& mValue)
+    {
+        RedisCompressConf conf = getCompressConf();
+        int iRet = 0;
+
+        mValue.reserve(mValue.size() + vKey.size());
+
+        int iCount = doArrayCommand(buildMget(vKey), [&](size_t i, const char *p, int64_t iLen)
+        {
+            if (i == 0 || iLen < 0 || i > vKey.size())
+            {
+                return;
+            }
+
+            string &sValue = mValue[vKey[i - 1]];
+
+            if (unpackValue(conf, p, iLen, sValue) == 0)
+            {
+                if (p != sValue.data())
+                {
+                    sValue.assign(p, iLen);
+                }
+            }
+            else
+            {
+                iRet = -1;
+            }
+        });
+
+        return iCount == (int)vKey.size() ? iRet : -1;
+    }
+
+    /**
+    * @brief 批量获取数据, 结果与vKey按位置一一对应, 存放在同一个arena中(不存在的为nil); 返回存储的原始内容, 不做解压
+    *
+    * @param vKey
+    * @param reply
+    * @return 0 成功 -1 失败
+    */
+    int get(const vector<string>& vKey, RedisArenaReply& reply)
+    {
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(buildMget(vKey));
+
+        const string &sBuffer = rsp->getBuffer();
+
+        if (reply.assign(sBuffer.data(), sBuffer.size()) != 0 || reply.size() != vKey.size())
+        {
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << reply.getError() << endl;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    /**
+    * @brief 写入tars结构体.
+    *        结构体直接序列化到线程私有的缓冲(复用内存), 只拷贝一次到命令中, 命令交换进请求不再拷贝.
+    *        与set一样按配置压缩
+    *
+    * @param sKey
+    * @param t           tars结构体
+    * @param expir       数据的过期时间
+    * @return 0 成功 -1 失败
+    */
+    template<typename T>
+    int setStruct(const string& sKey, const T& t, unsigned int expir = 0)
+    {
+        TarsOutputStream<BufferWriterString> &os = getStructWriter();
+        t.writeTo(os);
+
+        string sCommand;
+        sCommand.reserve(64 + sKey.size() + os.getLength());
+
+        if (expir == 0)
+        {
+            appendCommandHeader(sCommand, 3);
+            appendCommandArg(sCommand, "SET", 3);
+            appendCommandArg(sCommand, sKey);
+        }
+        else
+        {
+            char buf[16];
+
+            appendCommandHeader(sCommand, 4);
+            appendCommandArg(sCommand, "SETEX", 5);
+            appendCommandArg(sCommand, sKey);
+            appendCommandArg(sCommand, buf, snprintf(buf, sizeof(buf), "%u", expir));
+        }
+
+        string sPacked;
+        appendValue(getCompressConf(), sCommand, os.getBuffer(), os.getLength(), sPacked);
+
+        return doSwapCommand(sCommand)->getBuffer().compare(0, 3, "+OK") == 0 ? 0 : -1;
+    }
+
+    /**
+    * @brief 读取tars结构体, 直接从应答缓冲反序列化, 不做拷贝(压缩的value先解压)
+    *
+    * @param sKey
+    * @param t           tars结构体
+    * @return 0 成功 1 没有数据 -1 失败(包括反序列化失败)
+    */
+    template<typename T>
+    int getStruct(const string& sKey, T& t)
+    {
+        shared_ptr<TC_CustomProtoRsp> rsp;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        int iRet = doKeyBulkCommand("GET", sKey, rsp, p, iLen);
+
+        if (iRet == 0)
+        {
+            iRet = unpackValue(getCompressConf(), p, iLen, getUnpackBuffer());
+        }
+
+        if (iRet == 0 && !readStruct(p, iLen, t))
+        {
+            LOG_CONSOLE_DEBUG << "decode struct error, key:" << sKey << endl;
+            iRet = -1;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief 批量写入tars结构体(MSET)
+    *
+    * @param vKeyValue
+    * @return 0 成功 -1 失败
+    */
+    template<typename T>
+    int msetStruct(const vector<pair<string, T> >& vKeyValue)
+    {
+        TarsOutputStream<BufferWriterString> &os = getStructWriter();
+
+        string sCommand;
+        sCommand.reserve(32 + vKeyValue.size() * 64);
+
+        appendCommandHeader(sCommand, 1 + vKeyValue.size() * 2);
+        appendCommandArg(sCommand, "MSET", 4);
+
+        RedisCompressConf conf = getCompressConf();
+        string sPacked;
+
+        for (size_t i = 0; i < vKeyValue.size(); i++)
+        {
+            os.reset();
+            vKeyValue[i].second.writeTo(os);
+
+            appendCommandArg(sCommand, vKeyValue[i].first);
+            appendValue(conf, sCommand, os.getBuffer(), os.getLength(), sPacked);
+        }
+
+        return doSwapCommand(sCommand)->getBuffer().compare(0, 3, "+OK") == 0 ? 0 : -1;
+    }
+
+    /**
+    * @brief 批量读取tars结构体(MGET), 每个值直接从应答缓冲反序列化
+    *
+    * @param vKey
+    * @param mValues     返回key及结构体
+    * @param vNoKey      不存在的key集合
+    * @return 0 成功 -1 失败(包括反序列化失败)
+    */
+    template<typename T>
+    int mgetStruct(const vector<string>& vKey, map<string, T>& mValues, vector<string>& vNoKey)
+    {
+        string sCommand = buildMget(vKey);
+
+        shared_ptr<TC_CustomProtoRsp> rsp = doSwapCommand(sCommand);
+
+        const string &sBuffer = rsp->getBuffer();
+        size_t iPos = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        if (RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen) != '*' || iLen != (int64_t)vKey.size())
+        {
+            return -1;
+        }
+
+        RedisCompressConf conf = getCompressConf();
+
+        for (size_t i = 0; i < vKey.size(); i++)
+        {
+            char f = RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen);
+
+            if (f == 0)
+            {
+                return -1;
+            }
+
+            if (f != '$' || iLen < 0)
+            {
+                vNoKey.push_back(vKey[i]);
+            }
+            else if (unpackValue(conf, p, iLen, getUnpackBuffer()) != 0 || !readStruct(p, iLen, mValues[vKey[i]]))
+            {
+                LOG_CONSOLE_DEBUG << "decode struct error, key:" << vKey[i] << endl;
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+    * @brief incr
+    *  
+    * @param sKey        
+    * @param iResult        
+    * @return 0 成功 -1 失败
+    */
+    int incr(const string& sKey, int64_t& iResult)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("INCR");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iResult = TC_Common::strto<int64_t>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief incrby
+    *  
+    * @param sKey        
+    * @param iInrement        
+    * @param iResult        
+    * @return 0 成功 -1 失败
+    */
+    int incrby(const string& sKey, int iInrement, int64_t& iResult)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("INCRBY");
+        vPart.push_back(sKey);
+        vPart.push_back(TC_Common::tostr(iInrement));
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iResult = TC_Common::strto<int64_t>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief decr
+    *  
+    * @param sKey        
+    * @param iResult        
+    * @return 0 成功 -1 失败
+    */
+    int decr(const string& sKey, int64_t& iResult)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("DECR");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iResult = TC_Common::strto<int64_t>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    
+    /**
+    * @brief zAdd
+    *  
+    * @param sKey        
+    * @param sMember        
+    * @param dValue      score
+    * @return 0 成功 -1 失败
+    */
+    int zAdd(const string& sKey, const string& sMember, double dValue)
+    {
+        int iRet = -1;
+
+        string sCommand;
+        sCommand.reserve(64 + sKey.size() + sMember.size());
+
+        appendCommandHeader(sCommand, 4);
+        appendCommandArg(sCommand, "ZADD", 4);
+        appendCommandArg(sCommand, sKey);
+        appendScore(sCommand, dValue);
+        appendCommandArg(sCommand, sMember);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            int iSize = TC_Common::strto<int>(vBuffer[0].second);
+
+            if (iSize == 0 || iSize == 1)
+            {
+                iRet = 0;
+            }
+            else
+            {
+                iRet = -1;
+            }
+        }
+
+        return iRet;
+    }
+
+    /**
+    * zAdd的选项, 可组合
+    */
+    enum ZADD_FLAG
+    {
+        ZADD_NX = 0x01,     //只添加新成员, 不更新已存在的
+        ZADD_XX = 0x02,     //只更新已存在的成员, 不添加
+        ZADD_GT = 0x04,     //新score大于当前值时才更新
+        ZADD_LT = 0x08,     //新score小于当前值时才更新
+        ZADD_CH = 0x10,     //返回值为变化(新增+更新)的成员数
+    };
+
+    /**
+    * @brief 批量zAdd, 一条命令写入全部成员, score直接格式化到命令缓冲中
+    *
+    * @param sKey
+    * @param vMemberScore   成员及score
+    * @param iFlag          ZADD_FLAG的组合
+    * @return 新增的成员数(带ZADD_CH时为变化的成员数) -1 失败
+    */
+    int zAdd(const string& sKey, const vector<pair<string, double> >& vMemberScore, int iFlag = 0)
+    {
+        if (vMemberScore.empty())
+        {
+            return 0;
+        }
+
+        static const char *aFlag[] = { "NX", "XX", "GT", "LT", "CH" };
+
+        size_t iArgc = 2 + vMemberScore.size() * 2;
+        size_t iSize = 64 + sKey.size();
+
+        for (size_t i = 0; i < sizeof(aFlag) / sizeof(aFlag[0]); i++)
+        {
+            if (iFlag & (1 << i))
+            {
+                ++iArgc;
+            }
+        }
+
+        for (size_t i = 0; i < vMemberScore.size(); i++)
+        {
+            iSize += vMemberScore[i].first.size() + 48;
+        }
+
+        string sCommand;
+        sCommand.reserve(iSize);
+
+        appendCommandHeader(sCommand, iArgc);
+        appendCommandArg(sCommand, "ZADD", 4);
+        appendCommandArg(sCommand, sKey);
+
+        for (size_t i = 0; i < sizeof(aFlag) / sizeof(aFlag[0]); i++)
+        {
+            if (iFlag & (1 << i))
+            {
+                appendCommandArg(sCommand, aFlag[i], 2);
+            }
+        }
+
+        for (size_t i = 0; i < vMemberScore.size(); i++)
+        {
+            appendScore(sCommand, vMemberScore[i].second);
+            appendCommandArg(sCommand, vMemberScore[i].first);
+        }
+
+        RedisReply reply;
+
+        int iRet = doCommand(sCommand, reply);
+
+        if (iRet == 0)
+        {
+            iRet = (int)reply.integer;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief zRem
+    *  
+    * @param sKey        
+    * @param sMember        
+    * @return 0 成功 -1 失败
+    */
+    int zRem(const string& sKey, const string& sMember)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("ZREM");
+        vPart.push_back(sKey);
+        vPart.push_back(sMember);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief zRem
+    *  
+    * @param sKey        
+    * @param vMember        
+    * @return 0 成功 -1 失败
+    */
+    int zRem(const string& sKey, const vector<string>& vMember)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("ZREM");
+        vPart.push_back(sKey);
+
+        for (size_t i = 0; i < vMember.size(); i++)
+        {
+            vPart.push_back(vMember[i]);
+        }
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+    
+    /**
+    * @brief zRangeByScore
+    *  
+    * @param sKey        
+    * @param vKeyList        
+    * @param fStart        
+    * @param fEnd        
+    * @return 0 成功 -1 失败
+    * @deprecated score为float, 超过2^24会丢失精度, 使用double版本
+    */
+    int zRangeByScore(const string& sKey, vector<pair<string, float> >& vKeyList, float fStart = FLT_MIN, float fEnd = FLT_MAX)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("ZRANGEBYSCORE");
+        vPart.push_back(sKey);
+        vPart.push_back(TC_Common::tostr(fStart));
+        vPart.push_back(TC_Common::tostr(fEnd));
+        vPart.push_back("WITHSCORES");
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (vBuffer.size() % 2 != 0)
+        {
+            return iRet;
+        }
+        
+        for (size_t i = 0; i < vBuffer.size(); i += 2) 
+        {
+            vKeyList.push_back(make_pair(vBuffer[i].second, TC_Common::strto<float>(vBuffer[i+1].second)));
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief zRangeByScore, double精度, 支持LIMIT分页
+    *
+    * @param sKey
+    * @param vValue      返回成员及score. 内容被覆盖, 复用其中已有字符串的内存, 调用方可反复使用同一个vector
+    * @param dMin        最小score(含)
+    * @param dMax        最大score(含)
+    * @param iOffset     LIMIT offset
+    * @param iCount      LIMIT count, 0 表示不分页
+    * @return 0 成功 -1 失败
+    */
+    int zRangeByScore(const string& sKey, vector<pair<string, double> >& vValue, double dMin = -HUGE_VAL, double dMax = HUGE_VAL,
+                      size_t iOffset = 0, size_t iCount = 0)
+    {
+        return zRangeByScore("ZRANGEBYSCORE", sKey, dMin, dMax, iOffset, iCount, vValue);
+    }
+
+    /**
+    * @brief zRevRangeByScore, 按score从大到小, 支持LIMIT分页
+    *
+    * @param sKey
+    * @param vValue      返回成员及score. 内容被覆盖, 复用其中已有字符串的内存
+    * @param dMax        最大score(含)
+    * @param dMin        最小score(含)
+    * @param iOffset     LIMIT offset
+    * @param iCount      LIMIT count, 0 表示不分页
+    * @return 0 成功 -1 失败
+    */
+    int zRevRangeByScore(const string& sKey, vector<pair<string, double> >& vValue, double dMax = HUGE_VAL, double dMin = -HUGE_VAL,
+                         size_t iOffset = 0, size_t iCount = 0)
+    {
+        return zRangeByScore("ZREVRANGEBYSCORE", sKey, dMax, dMin, iOffset, iCount, vValue);
+    }
+
+    /**
+    * @brief setNx
+    *  
+    * @param sKey        
+    * @param sValue        
+    * @return 0 成功 -1 失败
+    */
+    int setNx(const string& sKey, const string& sValue)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        string sPacked;
+
+        vPart.push_back("SETNX");
+        vPart.push_back(sKey);
+        vPart.push_back(packValue(getCompressConf(), sValue, sPacked));
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief setExpire
+    *  
+    * @param sKey        
+    * @param expir        
+    * @return 0 成功 -1 失败
+    */
+    int setExpire(const string& sKey, unsigned int expir = 0)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("EXPIRE");
+        vPart.push_back(sKey);
+        vPart.push_back(TC_Common::tostr(expir));
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief getset
+    *  
+    * @param sKey        
+    * @param sSetValue        
+    * @param sReturnValue        
+    * @return 0 成功 -1 失败
+    */
+    int getset(const string& sKey, const string& sSetValue, string& sReturnValue)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        RedisCompressConf conf = getCompressConf();
+        string sPacked;
+
+        vPart.push_back("GETSET");
+        vPart.push_back(sKey);
+        vPart.push_back(packValue(conf, sSetValue, sPacked));
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = 0;
+
+            if (vBuffer[0].first == -1)
+            {
+                iRet = 1;
+            }
+            else
+            {
+                sReturnValue.swap(vBuffer[0].second);
+                iRet = unpackValue(conf, sReturnValue);
+            }
+        }
+        else
+        {
+            iRet = -1;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief list
+    *  
+    * @param sKey        
+    * @param vValue        
+    * @return 0 成功 -1 失败
+    *  查找所有符合给定模式 pattern 的 key 
+        KEYS * 匹配数据库中所有 key
+        KEYS h?llo 匹配 hello ， hallo 和 hxllo 等
+        KEYS h*llo 匹配 hllo 和 heeeeello 等。
+        KEYS h[ae]llo 匹配 hello 和 hallo ，但不匹配 hillo 
+    */
+    int list(const string& sKey, vector<string>& vValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("KEYS");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0)
+        {
+            if (vBuffer.empty())
+            {
+                iRet = 1;
+            }
+            else
+            {
+                for (size_t i = 0; i < vBuffer.size(); ++i)
+                {
+                    if (vBuffer[i].first > 0)
+                    {
+                        vValue.push_back(vBuffer[i].second);
+                    }
+                }
+
+                iRet = 0;
+            }
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief 查找所有符合给定模式的key, 所有key存放在同一个arena中
+    *
+    * @return 返回key的个数, -1 失败
+    */
+    int list(const string& sKey, RedisArenaReply& reply)
+    {
+        return doArenaCommand("KEYS", sKey, reply);
+    }
+
+    /**
+    * @brief 查找所有符合给定模式的key, 延迟解码
+    *
+    * @return 返回key的个数, -1 失败
+    */
+    int list(const string& sKey, RedisLazyReply& reply)
+    {
+        vector<string> vPart;
+
+        vPart.push_back("KEYS");
+        vPart.push_back(sKey);
+
+        return command(vPart, reply) == 0 ? (int)reply.size() : -1;
+    }
+
+    /**
+    * @brief hgetall
+    *  
+    * @param sKey        
+    * @param mValue        
+    * @return 0 成功 -1 失败
+    * 返回哈希表 key中，所有的域和值。在返回值里，紧跟每个域名(field name)之后是域的值(value)，所以返回值的长度是哈希表大小的两倍。
+    */
+    int hgetall(const string& sKey, map<string, string>& mValue)
+    {
+        int iRet = -1;
+
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("HGETALL");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0)
+        {
+            if (vBuffer.empty())
+            {
+                iRet = 1;
+            }
+            else
+            {
+                iRet = 0;
+
+                RedisCompressConf conf = getCompressConf();
+
+                for (size_t i = 0; i < vBuffer.size(); i += 2)
+                {
+                    if (i + 1 < vBuffer.size())
+                    {
+                        string &sValue = mValue[vBuffer[i].second];
+                        sValue.swap(vBuffer[i+1].second);
+
+                        if (unpackValue(conf, sValue) != 0)
+                        {
+                            iRet = -1;
+                        }
+                    }
+                }
+            }
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief hgetall, 所有域和值存放在同一个arena中, 依次为field, value, field, value...
+    *        返回存储的原始内容, 不做解压
+    *
+    * @param sKey
+    * @param reply
+    * @return 0 成功 1 不存在 -1 失败
+    */
+    int hgetall(const string& sKey, RedisArenaReply& reply)
+    {
+        int iRet = doArenaCommand("HGETALL", sKey, reply);
+
+        return iRet < 0 ? -1 : (iRet == 0 ? 1 : 0);
+    }
+
+#ifdef TARS_REDIS_PMR
+    /**
+    * @brief hgetall, 域和值从mValue的memory resource分配
+    *
+    * @return 0 成功 1 不存在 -1 失败
+    */
+    int hgetall(const string& sKey, std::pmr::map<std::pmr::string, std::pmr::string>& mValue)
+    {
+        string sCommand;
+
+        appendCommandHeader(sCommand, 2);
+        appendCommandArg(sCommand, "HGETALL", 7);
+        appendCommandArg(sCommand, sKey);
+
+        RedisCompressConf conf = getCompressConf();
+        const char *pField = NULL;
+        int64_t iField     = 0;
+        int iRet           = 0;
+
+        int iCount = doArrayCommand(sCommand, [&](size_t i, const char *p, int64_t iLen)
+        {
+            if (i == 0 || iLen < 0)
+            {
+                return;
+            }
+
+            if (i % 2 == 1)
+            {
+                pField = p;
+                iField = iLen;
+            }
+            else if (unpackValue(conf, p, iLen, getUnpackBuffer()) == 0)
+            {
+                mValue[std::pmr::string(pField, iField, mValue.get_allocator())].assign(p, iLen);
+            }
+            else
+            {
+                iRet = -1;
+            }
+        });
+
+        return iCount < 0 ? -1 : (iCount == 0 ? 1 : iRet);
+    }
+#endif
+
+    /**
+    * @brief hget
+    *  
+    * @param sKey        
+    * @param mValue        
+    * @return 0 成功 1-不存在 -1 失败
+    */
+    int hget(const string& sKey, const string& sField, string& sValue)
+    {
+        string sCommand;
+        sCommand.reserve(32 + sKey.size() + sField.size());
+
+        appendCommandHeader(sCommand, 3);
+        appendCommandArg(sCommand, "HGET", 4);
+        appendCommandArg(sCommand, sKey);
+        appendCommandArg(sCommand, sField);
+
+        shared_ptr<TC_CustomProtoRsp> rsp;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        int iRet = doBulkCommand(sCommand, rsp, p, iLen);
+
+        if (iRet == 0)
+        {
+            iRet = unpackValue(getCompressConf(), p, iLen, sValue);
+
+            if (iRet == 0 && p != sValue.data())
+            {
+                sValue.assign(p, iLen);
+            }
+        }
+        else
+        {
+            iRet = 1;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief hdel
+    *  
+    * @param sKey        
+    * @param sField        
+    * @return 0 成功 -1 失败
+    */
+    int hdel(const string& sKey, const string& sField)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("HDEL");
+        vPart.push_back(sKey);
+        vPart.push_back(sField);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    // 0-不存在 1-存在
+    int hexists(const string& sKey, const string& sField)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("HEXISTS");
+        vPart.push_back(sKey);
+        vPart.push_back(sField);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief hmset
+    *  
+    * @param sKey        
+    * @param mValue        
+    * @return 0 成功 -1 失败
+    * 同时将多个field-value(域-值)对设置到哈希表 key中。此命令会覆盖哈希表中已存在的域。如果 key不存在，一个空哈希表被创建并执行 HMSET操作。
+    */
+    int hmset(const string& sKey, const map<string, string>& mValue)
+    {
+        return hmset(sKey, mValue.begin(), mValue.end());
+    }
+
+    /**
+    * @brief hmset, 元素的first为field, second为value(string, vector<char>或const char*),
+    *        直接从区间编码进命令, 不产生中间拷贝
+    *
+    * @param sKey
+    * @param begin, end  前向迭代器区间
+    * @return 0 成功 -1 失败
+    */
+    template<typename Iterator>
+    int hmset(const string& sKey, Iterator begin, Iterator end)
+    {
+        string sCommand;
+
+        appendCommandHeader(sCommand, 2 + std::distance(begin, end) * 2);
+        appendCommandArg(sCommand, "HMSET", 5);
+        appendCommandArg(sCommand, sKey);
+
+        RedisCompressConf conf = getCompressConf();
+        string sPacked;
+
+        for (; begin != end; ++begin)
+        {
+            appendCommandArg(sCommand, argData(begin->first), argSize(begin->first));
+            appendValue(conf, sCommand, argData(begin->second), argSize(begin->second), sPacked);
+        }
+
+        return doStatusCommand(sCommand);
+    }
+
+    /**
+    * @brief hmset
+    *  
+    * @param sKey        
+    * @param mValue        
+    * @return 0 成功 -1 失败
+    * 将哈希表 key中的域field的值设为value。如果 key不存在，一个新的哈希表被创建并进行 HSE 操作。 如果域 field已经存在于哈希表中，旧值将被覆盖。
+    */
+    int hset(const string& sKey, const string& sField, const string& sValue)
+    {
+        string sCommand;
+        sCommand.reserve(64 + sKey.size() + sField.size() + sValue.size());
+
+        appendCommandHeader(sCommand, 4);
+        appendCommandArg(sCommand, "HSET", 4);
+        appendCommandArg(sCommand, sKey);
+        appendCommandArg(sCommand, sField);
+
+        string sPacked;
+        appendValue(getCompressConf(), sCommand, sValue.data(), sValue.size(), sPacked);
+
+        return doIntegerCommand(sCommand);
+    }
+
+    /**
+    * @brief hincby
+    *  
+    * @param sKey        
+    * @param sField
+    * @param sAddValue        
+    * @return 0 成功 -1 失败
+    */
+    int hincby(const string& sKey, const string& sField, const string& sAddValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("HINCRBY");
+        vPart.push_back(sKey);
+        vPart.push_back(sField);
+        vPart.push_back(sAddValue);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief zscore
+    *  
+    * @param sKey        
+    * @param sField
+    * @param sValue        
+    * @return 0 成功 -1 失败
+    * 返回有序集 key中，成员 member的score值。如果member元素不是有序集key的成员，或key不存在，返回 nil。
+    */
+    int zscore(const string& sKey, const string sField, string& sValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("ZSCORE");
+        vPart.push_back(sKey);
+        vPart.push_back(sField);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            sValue = vBuffer[0].second;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief zscore, double精度
+    *
+    * @param sKey
+    * @param sMember
+    * @param dScore
+    * @return 0 成功 1 不是成员或key不存在 -1 失败
+    */
+    int zscore(const string& sKey, const string& sMember, double& dScore)
+    {
+        string sCommand;
+        sCommand.reserve(32 + sKey.size() + sMember.size());
+
+        appendCommandHeader(sCommand, 3);
+        appendCommandArg(sCommand, "ZSCORE", 6);
+        appendCommandArg(sCommand, sKey);
+        appendCommandArg(sCommand, sMember);
+
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(sCommand);
+
+        const string &sBuffer = rsp->getBuffer();
+        size_t iPos = 0;
+        const char *p = NULL;
+        int64_t iLen = 0;
+
+        char f = RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen);
+
+        if (f == '$' || f == ',')
+        {
+            if (iLen < 0)
+            {
+                return 1;
+            }
+
+            dScore = parseScore(p);
+
+            return 0;
+        }
+
+        if (f == '_')
+        {
+            return 1;
+        }
+
+        return -1;
+    }
+
+    /**
+    * @brief sadd
+    *  
+    * @param sKey        
+    * @param vField
+    * @return 被添加到集合中的新元素的数量，不包括被忽略的元素
+    * 将一个或多个member元素加入到集合key当中，已经存在于集合的member元素将被忽略。假如key不存在，则创建一个只包含member元素作成员的集合。当key不是集合类型时，返回一个错误。
+    */
+    int sadd(const string& sKey, const vector<string>& vField)
+    {
+        return sadd(sKey, vField.begin(), vField.end());
+    }
+
+    /**
+    * @brief sadd, 元素为string, vector<char>或const char*, 直接从区间编码进命令, 不产生中间拷贝
+    *
+    * @param sKey
+    * @param begin, end  前向迭代器区间
+    * @return 被添加到集合中的新元素的数量, -1 失败
+    */
+    template<typename Iterator>
+    int sadd(const string& sKey, Iterator begin, Iterator end)
+    {
+        return doRangeCommand("SADD", sKey, begin, end);
+    }
+
+    /**
+    * @brief srem
+    *  
+    * @param sKey        
+    * @param vField
+    * @return 被成功移除的元素的数量，不包括被忽略的元素。
+    * 移除集合 key 中的一个或多个 member 元素，不存在的 member 元素会被忽略。
+    */
+    int srem(const string& sKey, const vector<string>& vField)
+    {
+        return srem(sKey, vField.begin(), vField.end());
+    }
+
+    /**
+    * @brief srem, 元素为string, vector<char>或const char*, 直接从区间编码进命令, 不产生中间拷贝
+    *
+    * @param sKey
+    * @param begin, end  前向迭代器区间
+    * @return 被成功移除的元素的数量, -1 失败
+    */
+    template<typename Iterator>
+    int srem(const string& sKey, Iterator begin, Iterator end)
+    {
+        return doRangeCommand("SREM", sKey, begin, end);
+    }
+
+    /**
+    * @brief srem
+    *  
+    * @param sKey        
+    * @param vField
+    * @return 0 成功 -1 失败
+    * 移除并返回集合中的一个随机元素。 如果只想获取一个随机元素，但不想该元素从集合中被移除的话，可以使用 SRANDMEMBER 命令。
+    */
+    int spop(const string& sKey, string& sValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("SPOP");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            sValue = vBuffer[0].second;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief srem
+    *  
+    * @param sKey        
+    * @param iMemberNum 返回集合中元素个数
+    * @return 0 成功 -1 失败
+    */
+    int scard(const string& sKey, int& iMemberNum)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("SCARD");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iMemberNum = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief sdiff
+    *  
+    * @param sKey        
+    * @param vKey
+    * @param vValue
+    * @return 0 成功 -1 失败
+    */
+    int sdiff(const string& sKey, const vector<string>& vKey, vector<string>& vValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("SDIFF");
+        vPart.push_back(sKey);
+
+        std::copy(vKey.begin(), vKey.end(), back_inserter(vPart));
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0)
+        {
+            for (size_t i = 0; i < vBuffer.size(); ++i)
+            {
+                vValue.push_back(vBuffer[i].second);
+            }
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief smembers
+    *  
+    * @param sKey        
+    * @param vValue
+    * @return 返回成员个数
+    * 返回集合key中的所有成员。不存在的key被视为空集合。
+    */
+    int smembers(const string& sKey, vector<string>& vValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("SMEMBERS");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        //成员直接从应答缓冲构造, 只拷贝一次
+        iRet = doArrayCommand(sCommand, [&](size_t i, const char *p, int64_t iLen)
+        {
+            if (i == 0)
+            {
+                vValue.reserve(vValue.size() + iLen);
+            }
+            else if (iLen >= 0)
+            {
+                vValue.push_back(string(p, iLen));
+            }
+        });
+
+        return iRet;
+    }
+
+    /**
+    * @brief smembers, 所有成员存放在同一个arena中, 一次申请一次释放
+    *
+    * @param sKey
+    * @param reply
+    * @return 返回成员个数, -1 失败
+    */
+    int smembers(const string& sKey, RedisArenaReply& reply)
+    {
+        return doArenaCommand("SMEMBERS", sKey, reply);
+    }
+
+    /**
+    * @brief smembers, 延迟解码: 只记录各成员的位置, 访问时才转换
+    *
+    * @return 返回成员个数, -1 失败
+    */
+    int smembers(const string& sKey, RedisLazyReply& reply)
+    {
+        vector<string> vPart;
+
+        vPart.push_back("SMEMBERS");
+        vPart.push_back(sKey);
+
+        return command(vPart, reply) == 0 ? (int)reply.size() : -1;
+    }
+
+#ifdef TARS_REDIS_PMR
+    /**
+    * @brief smembers, 成员从vValue的memory resource分配(如RedisArena, std::pmr::monotonic_buffer_resource)
+    *
+    * @return 返回成员个数, -1 失败
+    */
+    int smembers(const string& sKey, std::pmr::vector<std::pmr::string>& vValue)
+    {
+        string sCommand;
+
+        appendCommandHeader(sCommand, 2);
+        appendCommandArg(sCommand, "SMEMBERS", 8);
+        appendCommandArg(sCommand, sKey);
+
+        return doArrayCommand(sCommand, [&](size_t i, const char *p, int64_t iLen)
+        {
+            if (i == 0)
+            {
+                vValue.reserve(vValue.size() + iLen);
+            }
+            else if (iLen >= 0)
+            {
+                vValue.emplace_back(p, iLen);
+            }
+        });
+    }
+#endif
+
+    /**
+    * @brief sismember
+    *  
+    * @param sKey        
+    * @param sMember
+    * @return 如果 member 元素是集合的成员，返回 1 。 如果 member 元素不是集合的成员，或 key 不存在，返回 0 。
+    */
+    int sismember(const string& sKey, const string& sMember)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("SISMEMBER");
+        vPart.push_back(sKey);
+        vPart.push_back(sMember);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief zrange
+    *  
+    * @param sKey        
+    * @param iStart
+    * @param iStop
+    * @param bWithScores
+    * @param vValue
+    * @return 
+    * 返回有序集 key中，指定区间内的成员。下标参数 start和 stop都以0为底，也就是说，以 0表示有序集第一个成员，以 1表示有序集第二个成员，以此类推。你也可以使用负数下标，以 -1 表示最后一个成员， -2 表示倒数第二个成员，以此类推。
+    * 可以通过使用 WITHSCORES 选项，来让成员和它的 score 值一并返回，返回列表以 value1,score1, ..., valueN,scoreN 的格式表示。
+    * @deprecated score为float, 超过2^24会丢失精度, 使用double版本
+    */
+    int zrange(const string& sKey, int iStart, int iStop, bool bWithScores, vector<pair<string, float> >& vValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("ZRANGE");
+        vPart.push_back(sKey);
+        vPart.push_back(TC_Common::tostr(iStart));
+        vPart.push_back(TC_Common::tostr(iStop));
+
+        if (bWithScores)
+        {
+            vPart.push_back("WITHSCORES");
+        }
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0)
+        {
+            if (bWithScores)
+            {
+                for (size_t i = 0; i < vBuffer.size(); i += 2)
+                {
+                    vValue.push_back(make_pair(vBuffer[i].second, TC_Common::strto<float>(vBuffer[i+1].second)));
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < vBuffer.size(); ++i)
+                {
+                    vValue.push_back(make_pair(vBuffer[i].second, 0));
+                }
+            }
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief zrange, double精度
+    *
+    * @param sKey
+    * @param iStart
+    * @param iStop
+    * @param bWithScores 不带score时返回的score为0
+    * @param vValue      返回成员及score. 内容被覆盖, 复用其中已有字符串的内存, 调用方可反复使用同一个vector
+    * @return 0 成功 -1 失败
+    */
+    int zrange(const string& sKey, int iStart, int iStop, bool bWithScores, vector<pair<string, double> >& vValue)
+    {
+        return zrange("ZRANGE", sKey, iStart, iStop, bWithScores, vValue);
+    }
+
+    /**
+    * @brief zrange, 延迟解码. 带score时元素依次为member, score, member, score...(score用getDouble读取)
+    *
+    * @return 0 成功 -1 失败
+    */
+    int zrange(const string& sKey, int iStart, int iStop, bool bWithScores, RedisLazyReply& reply)
+    {
+        vector<string> vPart;
+
+        vPart.push_back("ZRANGE");
+        vPart.push_back(sKey);
+        vPart.push_back(TC_Common::tostr(iStart));
+        vPart.push_back(TC_Common::tostr(iStop));
+
+        if (bWithScores)
+        {
+            vPart.push_back("WITHSCORES");
+        }
+
+        return command(vPart, reply);
+    }
+
+    /**
+    * @brief lrange, 延迟解码
+    *
+    * @param sKey
+    * @param iStart
+    * @param iStop      下标规则同zrange, -1表示最后一个元素
+    * @param reply
+    * @return 0 成功 -1 失败
+    */
+    int lrange(const string& sKey, int iStart, int iStop, RedisLazyReply& reply)
+    {
+        vector<string> vPart;
+
+        vPart.push_back("LRANGE");
+        vPart.push_back(sKey);
+        vPart.push_back(TC_Common::tostr(iStart));
+        vPart.push_back(TC_Common::tostr(iStop));
+
+        return command(vPart, reply);
+    }
+
+    /**
+    * @brief 执行任意命令, 应答延迟解码
+    *
+    * @param vPart   命令及参数
+    * @param reply
+    * @return 0 成功 -1 失败(错误应答的内容见reply.getError())
+    */
+    int command(const vector<string>& vPart, RedisLazyReply& reply)
+    {
+        string sCommand;
+        buildCommand(vPart, sCommand);
+
+        if (reply.assign(doSwapCommand(sCommand)) != 0)
+        {
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << reply.getError() << endl;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    /**
+    * @brief zrevrange, 按score从大到小
+    *
+    * @param sKey
+    * @param iStart
+    * @param iStop
+    * @param bWithScores 不带score时返回的score为0
+    * @param vValue      返回成员及score. 内容被覆盖, 复用其中已有字符串的内存
+    * @return 0 成功 -1 失败
+    */
+    int zrevrange(const string& sKey, int iStart, int iStop, bool bWithScores, vector<pair<string, double> >& vValue)
+    {
+        return zrange("ZREVRANGE", sKey, iStart, iStop, bWithScores, vValue);
+    }
+
+    /**
+    * @brief lpush
+    *  
+    * @param sKey        
+    * @param vValue
+    * @return 0 成功 -1 失败
+    */
+    int lpush(const string& sKey, const vector<string>& vValue)
+    {
+        return lpush(sKey, vValue.begin(), vValue.end());
+    }
+
+    /**
+    * @brief lpush, 元素为string, vector<char>或const char*, 直接从区间编码进命令, 不产生中间拷贝
+    *
+    * @param sKey
+    * @param begin, end  前向迭代器区间
+    * @return 执行后list的长度, -1 失败
+    */
+    template<typename Iterator>
+    int lpush(const string& sKey, Iterator begin, Iterator end)
+    {
+        return doRangeCommand("LPUSH", sKey, begin, end);
+    }
+
+    /**
+    * @brief rpush
+    *  
+    * @param sKey        
+    * @param vValue
+    * @return 0 成功 -1 失败
+    */
+    int rpush(const string& sKey, const vector<string>& vValue)
+    {
+        return rpush(sKey, vValue.begin(), vValue.end());
+    }
+
+    /**
+    * @brief rpush, 元素为string, vector<char>或const char*, 直接从区间编码进命令, 不产生中间拷贝
+    *
+    * @param sKey
+    * @param begin, end  前向迭代器区间
+    * @return 执行后list的长度, -1 失败
+    */
+    template<typename Iterator>
+    int rpush(const string& sKey, Iterator begin, Iterator end)
+    {
+        return doRangeCommand("RPUSH", sKey, begin, end);
+    }
+
+    /**
+    * @brief ltrim
+    *  
+    * @param sKey        
+    * @param iStart
+    * @param iStop
+    * @return 0 trim size
+    *  对一个列表进行修剪(trim)，就是说，让列表只保留指定区间内的元素，不在指定区间之内的元素都将被删除。
+    */
+    int ltrim(const string& sKey, int iStart, int iStop)
+    {   
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("LTRIM");
+        vPart.push_back(sKey);
+        vPart.push_back(TC_Common::tostr(iStart));
+        vPart.push_back(TC_Common::tostr(iStop));
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief lpop
+    *  
+    * @param sKey        
+    * @param sValue
+    * @return 0 成功 -1 失败 
+    */
+    int lpop(const string& sKey, string& sValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("LPOP");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            sValue = vBuffer[0].second;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief rpop
+    *  
+    * @param sKey        
+    * @param sValue
+    * @return 0 成功 -1 失败 
+    */
+    int rpop(const string& sKey, string& sValue)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("RPOP");
+        vPart.push_back(sKey);
+
+        buildCommand(vPart, sCommand);
+
+        vector<pair<int, string> > vBuffer;
+
+        iRet = doCommand(sCommand, vBuffer);
+
+        if (iRet == 0 && vBuffer.size() == 1)
+        {
+            sValue = vBuffer[0].second;
+        }
+
+        return iRet;
+    }
+    /**
+    * @brief xadd
+    *
+    * @param sKey
+    * @param vField      消息内容
+    * @param sId         返回服务端生成的消息id
+    * @param iMaxLen     >0 时按 MAXLEN ~ iMaxLen 近似裁剪
+    * @return 0 成功 -1 失败
+    */
+    int xadd(const string& sKey, const vector<pair<string, string> >& vField, string& sId, size_t iMaxLen = 0)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+        vPart.reserve(vField.size() * 2 + 6);
+
+        vPart.push_back("XADD");
+        vPart.push_back(sKey);
+
+        if (iMaxLen > 0)
+        {
+            vPart.push_back("MAXLEN");
+            vPart.push_back("~");
+            vPart.push_back(TC_Common::tostr(iMaxLen));
+        }
+
+        vPart.push_back("*");
+
+        for (size_t i = 0; i < vField.size(); i++)
+        {
+            vPart.push_back(vField[i].first);
+            vPart.push_back(vField[i].second);
+        }
+
+        buildCommand(vPart, sCommand);
+
+        RedisReply reply;
+
+        iRet = doCommand(sCommand, reply);
+
+        if (iRet == 0 && reply.type == RedisReply::REPLY_STRING)
+        {
+            sId.swap(reply.str);
+        }
+        else
+        {
+            iRet = -1;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief xgroup create, 创建消费组
+    *
+    * @param sKey
+    * @param sGroup
+    * @param sId         从哪里开始消费, "$" 只消费新消息, "0" 从头开始
+    * @param bMkStream   stream不存在时是否创建
+    * @return 0 成功(组已存在也返回0) -1 失败
+    */
+    int xgroupCreate(const string& sKey, const string& sGroup, const string& sId = "$", bool bMkStream = true)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("XGROUP");
+        vPart.push_back("CREATE");
+        vPart.push_back(sKey);
+        vPart.push_back(sGroup);
+        vPart.push_back(sId);
+
+        if (bMkStream)
+        {
+            vPart.push_back("MKSTREAM");
+        }
+
+        buildCommand(vPart, sCommand);
+
+        RedisReply reply;
+
+        iRet = doCommand(sCommand, reply);
+
+        if (iRet != 0 && reply.isError() && reply.str.compare(0, 9, "BUSYGROUP") == 0)
+        {
+            iRet = 0;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief xreadgroup
+    *
+    * @param sKey
+    * @param sGroup
+    * @param sConsumer
+    * @param iCount      本次最多读取的条数
+    * @param vEntry      返回的消息
+    * @param iBlock      >=0 时没有消息最多阻塞等待的毫秒数(0为一直等待), 在阻塞命令连接池上执行; <0 不阻塞
+    * @param sId         ">" 读取新消息, 其他id读取本消费者大于该id的pending消息
+    * @return 0 成功(可能没有消息) -1 失败
+    */
+    int xreadgroup(const string& sKey, const string& sGroup, const string& sConsumer, size_t iCount,
+                   vector<RedisStreamEntry>& vEntry, int iBlock = -1, const string& sId = ">")
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("XREADGROUP");
+        vPart.push_back("GROUP");
+        vPart.push_back(sGroup);
+        vPart.push_back(sConsumer);
+        vPart.push_back("COUNT");
+        vPart.push_back(TC_Common::tostr(iCount));
+
+        if (iBlock >= 0)
+        {
+            vPart.push_back("BLOCK");
+            vPart.push_back(TC_Common::tostr(iBlock));
+        }
+
+        vPart.push_back("STREAMS");
+        vPart.push_back(sKey);
+        vPart.push_back(sId);
+
+        buildCommand(vPart, sCommand);
+
+        RedisReply reply;
+
+        if (iBlock >= 0)
+        {
+            iRet = doBlockingCommand(sCommand, reply, iBlock);
+        }
+        else
+        {
+            iRet = doCommand(sCommand, reply);
+        }
+
+        if (iRet == 0)
+        {
+            parseStreamReply(reply, vEntry);
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief xack, 一条命令确认一批消息
+    *
+    * @param sKey
+    * @param sGroup
+    * @param vId
+    * @return 确认成功的条数, -1 失败
+    */
+    int xack(const string& sKey, const string& sGroup, const vector<string>& vId)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+        vPart.reserve(vId.size() + 3);
+
+        vPart.push_back("XACK");
+        vPart.push_back(sKey);
+        vPart.push_back(sGroup);
+
+        std::copy(vId.begin(), vId.end(), back_inserter(vPart));
+
+        buildCommand(vPart, sCommand);
+
+        RedisReply reply;
+
+        iRet = doCommand(sCommand, reply);
+
+        if (iRet == 0)
+        {
+            iRet = (int)reply.integer;
+        }
+
+        return iRet;
+    }
+
+    /**
+    * @brief xautoclaim, 把空闲超过iMinIdle毫秒的pending消息(通常属于已退出的消费者)转给sConsumer
+    *
+    * @param sKey
+    * @param sGroup
+    * @param sConsumer
+    * @param iMinIdle    最小空闲时间(毫秒)
+    * @param sStart      扫描起始id, 首次为 "0-0"
+    * @param iCount      本次最多转移的条数
+    * @param sNext       返回下次扫描的起始id, "0-0" 表示已扫描完一轮
+    * @param vEntry      转移到sConsumer的消息
+    * @return 0 成功 -1 失败
+    */
+    int xautoclaim(const string& sKey, const string& sGroup, const string& sConsumer, int64_t iMinIdle,
+                   const string& sStart, size_t iCount, string& sNext, vector<RedisStreamEntry>& vEntry)
+    {
+        int iRet = -1;
+        string sCommand;
+
+        vector<string> vPart;
+
+        vPart.push_back("XAUTOCLAIM");
+        vPart.push_back(sKey);
+        vPart.push_back(sGroup);
+        vPart.push_back(sConsumer);
+        vPart.push_back(TC_Common::tostr(iMinIdle));
+        vPart.push_back(sStart);
+        vPart.push_back("COUNT");
+        vPart.push_back(TC_Common::tostr(iCount));
+
+        buildCommand(vPart, sCommand);
+
+        RedisReply reply;
+
+        iRet = doCommand(sCommand, reply);
+
+        if (iRet != 0)
+        {
+            return iRet;
+        }
+
+        //[next-start, [entries], (redis 7.0+)[deleted ids]]
+        if (reply.element.size() < 2)
+        {
+            return -1;
+        }
+
+        sNext.swap(reply.element[0].str);
+
+        RedisStreamEntry::parse(reply.element[1], vEntry);
+
+        return iRet;
+    }
+
+    /**
+    * @brief 设置阻塞命令(blpop/brpop/blmove/xread/xreadgroup带BLOCK)使用的独占连接池.
+    *        阻塞命令会一直占用连接, 因此不走ServantProxy的共享连接, 避免其他命令排在其后
+    *
+    * @param iMaxConn    最多连接数, 超出时调用方等待
+    * @param iWait       等待空闲连接的毫秒数, 超时返回失败
+    */
+    void setBlockingPool(size_t iMaxConn, int iWait = 1000)
+    {
+        RedisProxyContextPtr context = getContext();
+
+        std::lock_guard<std::mutex> lock(context->mutex);
+
+        context->iBlockingConn = iMaxConn;
+        context->iBlockingWait = iWait;
+
+        if (context->blockingPool)
+        {
+            context->blockingPool->init(getObjConf(), iMaxConn, iWait, tars_timeout());
+        }
+    }
+
+    /**
+    * @brief 开启value压缩.
+    *        set/setNx/mset/hset/hmset/getset写入不小于iThreshold字节的value时用sCodec压缩(压缩后没有变小则保存原始数据),
+    *        get/mget/hget/hgetall/getset读取时识别头部自动解压. 压缩解压都在调用线程执行.
+    *        经上述接口写入的原始value恰好以压缩头(0xF5 'R' 'Z')开始时会转义, 读取时原样返回;
+    *        其他客户端或append/setrange等接口写入的此类value不经转义, 头部校验(codec id, 长度)不符或解压失败时按原始数据返回,
+    *        校验通过且恰好能解压时会被误认, 这类数据与压缩不能混用
+    *
+    * @param sCodec      codec名字: gzip, lz4(TARS_REDIS_LZ4), zstd(TARS_REDIS_ZSTD)或自行注册的codec
+    * @param iThreshold  压缩的最小字节数
+    * @return 0 成功 -1 codec不存在
+    */
+    int setCompress(const string& sCodec, size_t iThreshold = 1024)
+    {
+        RedisCodecPtr codec = TC_Redis_Codec_Holder::getInstance()->get(sCodec);
+
+        if (!codec)
+        {
+            LOG_CONSOLE_DEBUG << "codec not exists:" << sCodec << endl;
+            return -1;
+        }
+
+        RedisProxyContextPtr context = getContext();
+
+        std::lock_guard<std::mutex> lock(context->mutex);
+
+        context->compress.codec       = codec;
+        context->compress.iThreshold  = iThreshold;
+        context->compress.bDecompress = true;
+
+        TC_Redis_Codec_Holder::getInstance()->setUsed();
+
+        return 0;
+    }
+
+    /**
+    * @brief 开启热点key的本地缓存: 上一个统计周期的热点key(见setHotKey), GET的结果在本地缓存iTtl毫秒,
+    *        缓存命中的请求仍计入热点统计. 只适用于能容忍iTtl毫秒内读到旧值的数据
+    *
+    * @param iTtl      缓存时间(毫秒), 0 关闭
+    * @param iMaxKeys  最多缓存的key数
+    */
+    void setHotKeyCache(int iTtl, size_t iMaxKeys = 1024)
+    {
+        RedisProxyContextPtr context = getContext();
+
+        std::lock_guard<std::mutex> lock(context->mutex);
+
+        context->hotCache.reset();
+
+        if (iTtl > 0)
+        {
+            context->hotCache = std::make_shared<RedisHotCache>(iTtl, iMaxKeys);
+
+            TC_Redis_HotKey_Holder::getInstance()->setCacheUsed();
+        }
+    }
+
+    /**
+    * @brief 开启本endpoint的自适应并发限制及熔断(同obj的proxy共用), conf.bLimit与conf.bBreaker都为false时关闭.
+    *        超过并发上限或熔断中的请求不发送, 命令直接返回失败; 阻塞命令的连接池不受限制
+    */
+    void setLimiter(const RedisLimiterConf& conf)
+    {
+        RedisProxyContextPtr context = getContext();
+
+        std::lock_guard<std::mutex> lock(context->mutex);
+
+        context->limiter.reset();
+
+        if (conf.bLimit || conf.bBreaker)
+        {
+            context->limiter = std::make_shared<RedisLimiter>(conf);
+
+            RedisLimiter::used() = true;
+        }
+    }
+
+    /**
+    * @brief 为一类命令设置超时(同obj的proxy共用), 如 setCommandTimeout("ZRANGEBYSCORE", 500).
+    *        短于proxy的超时时生效, 与当前线程的截止时间(RedisDeadlineScope)取较早的一个
+    *
+    * @param sCmd      命令名
+    * @param iTimeout  超时(毫秒), 0 取消
+    */
+    void setCommandTimeout(const string& sCmd, int iTimeout)
+    {
+        RedisProxyContextPtr context = getContext();
+
+        std::lock_guard<std::mutex> lock(context->mutex);
+
+        if (iTimeout > 0)
+        {
+            context->mCommandTimeout[TC_Common::upper(sCmd)] = iTimeout;
+
+            RedisDeadline::used() = true;
+        }
+        else
+        {
+            context->mCommandTimeout.erase(TC_Common::upper(sCmd));
+        }
+    }
+
+    /**
+    * @brief 因截止时间而未执行的请求数(所有proxy)
+    *
+    * @param iExpired    调用前已超时, 直接失败的
+    * @param iCancelled  在队列中超时, 发送时改为PING的
+    */
+    static void getDeadlineStat(uint64_t& iExpired, uint64_t& iCancelled)
+    {
+        iExpired   = RedisDeadline::expired().load(std::memory_order_relaxed);
+        iCancelled = RedisDeadline::cancelled().load(std::memory_order_relaxed);
+    }
+
+    /**
+    * @brief 并发限制及熔断的状态
+    *
+    * @return 0 成功 -1 未开启
+    */
+    int getLimiterStat(RedisLimiterStat& stat)
+    {
+        RedisLimiterPtr limiter = getLimiter();
+
+        if (!limiter)
+        {
+            return -1;
+        }
+
+        limiter->getStat(stat);
+
+        return 0;
+    }
+
+    /**
+    * @brief 只读取的一方开启自动解压(bDecompress=true), 或关闭压缩及解压(false)
+    */
+    void setDecompress(bool bDecompress)
+    {
+        RedisProxyContextPtr context = getContext();
+
+        std::lock_guard<std::mutex> lock(context->mutex);
+
+        context->compress.codec.reset();
+        context->compress.bDecompress = bDecompress;
+
+        if (bDecompress)
+        {
+            TC_Redis_Codec_Holder::getInstance()->setUsed();
+        }
+    }
+
+    /**
+    * @brief 各codec的压缩率及耗时统计
+    */
+    static vector<RedisCodecStat> getCodecStat()
+    {
+        return TC_Redis_Codec_Holder::getInstance()->getStat();
+    }
+
+    /**
+    * @brief 请求/应答对象及发送缓冲对象池的命中统计(所有线程)
+    */
+    static vector<RedisPoolStat> getPoolStat()
+    {
+        vector<RedisPoolStat> vStat;
+
+        vStat.push_back(RedisObjectPool<RedisReq>::getStat());
+        vStat.push_back(RedisObjectPool<RedisRsp>::getStat());
+        vStat.push_back(RedisObjectPool<TC_NetWorkBuffer::Buffer>::getStat());
+
+        return vStat;
+    }
+
+    /**
+    * @brief 各obj各命令的累计延时统计(微秒), 包括p50/p99/p999
+    */
+    static vector<RedisLatencyStat> getLatencyStat()
+    {
+        return TC_Redis_Stat_Holder::getInstance()->getStat();
+    }
+
+    /**
+    * @brief 开始把延时统计按周期上报到tars属性(Redis.<obj>.<命令>.<count|avg|p50|p99|p999|max>)
+    *
+    * @param iInterval  上报周期(秒)
+    */
+    void startLatencyReport(int iInterval = 60)
+    {
+        TC_Redis_Stat_Holder::getInstance()->startReport(tars_communicator()->getStatReport(), iInterval);
+    }
+
+    /**
+    * @brief 开关延时记录(所有proxy), 默认开启
+    */
+    static void setLatencyEnable(bool bEnable)
+    {
+        TC_Redis_Stat_Holder::getInstance()->setEnable(bEnable);
+    }
+
+    /**
+    * @brief 开关请求阶段(queue/encode/wire/decode/dispatch)耗时统计(所有proxy), 默认关闭.
+    *        阶段耗时与命令延时一起统计和上报, 命令名为 phase.<阶段>
+    */
+    static void setPhaseStat(bool bEnable)
+    {
+        TC_Redis_Trace_Holder::getInstance()->setPhaseStat(bEnable);
+    }
+
+    /**
+    * @brief 设置追踪钩子(所有proxy), 每个请求完成后在调用线程回调, NULL 取消.
+    *        RedisSpan::getAttributes按OpenTelemetry语义约定输出属性, 可直接用于生成span
+    */
+    static void setTraceHook(const RedisTraceHookPtr& hook)
+    {
+        TC_Redis_Trace_Holder::getInstance()->setHook(hook);
+    }
+
+    /**
+    * @brief 开关连接统计(所有proxy及RedisConnection), 默认开启.
+    *        统计随startLatencyReport一起上报, 属性名为 Redis.<obj>.conn.<指标>
+    */
+    static void setConnStatEnable(bool bEnable)
+    {
+        TC_Redis_Conn_Holder::getInstance()->setEnable(bEnable);
+    }
+
+    /**
+    * @brief 各连接的收发字节, 在途命令, 最大pipeline深度, 接收缓冲最大长度, 连接/AUTH失败/超时次数.
+    *        有密码时重连由AUTH识别, 断开时在途的命令立即计为丢失; 没有密码时识别不到重连,
+    *        这些命令在重连后的应答到来, 且发出超过RedisConnCounter::kStaleTime(60秒)后才计为丢失,
+    *        在此之前的在途命令数及最大pipeline深度偏大
+    */
+    static vector<RedisConnStat> getConnStat()
+    {
+        return TC_Redis_Conn_Holder::getInstance()->getStat();
+    }
+
+    /**
+    * @brief 配置慢命令记录(所有proxy). 默认记录耗时不小于20ms的命令, 每分钟保留最慢的32条
+    *
+    * @param iThreshold  慢命令阈值(微秒), 0 关闭
+    * @param iCapacity   每个周期保留的最慢命令数
+    * @param iSample     每iSample条慢命令记录1条
+    * @param iInterval   周期(秒)
+    */
+    static void setSlowLog(int64_t iThreshold, size_t iCapacity = 32, size_t iSample = 1, int iInterval = 60)
+    {
+        TC_Redis_SlowLog_Holder::getInstance()->setConf(iThreshold, iCapacity, iSample, iInterval);
+    }
+
+    /**
+    * @brief 上一个周期及当前周期的慢命令, 按耗时从大到小
+    */
+    static void getSlowLog(vector<RedisSlowCommand>& vLast, vector<RedisSlowCommand>& vCurrent)
+    {
+        TC_Redis_SlowLog_Holder::getInstance()->dump(vLast, vCurrent);
+    }
+
+    /**
+    * @brief 慢命令的文本形式, 每行一条, 可用于管理命令输出
+    */
+    static string dumpSlowLog()
+    {
+        return TC_Redis_SlowLog_Holder::getInstance()->dump();
+    }
+
+    /**
+    * @brief 配置大value检测(所有proxy). 默认请求或应答不小于1MB时计数, 记录最近32条并输出日志, 不限制请求大小.
+    *        计数随startLatencyReport一起上报, 属性名为 Redis.<obj>.bigvalue.<req|rsp>
+    *
+    * @param iWarnReq   请求不小于该字节数时记录, 0 不检测
+    * @param iWarnRsp   应答不小于该字节数时记录, 0 不检测
+    * @param iLimit     请求超过该字节数时不发送, 命令返回失败, 0 不限制
+    * @param bSplit     超过上限的MSET/HMSET/HSET/SADD/LPUSH/RPUSH拆成多条依次发送(不再是原子操作), 而不是拒绝
+    * @param iCapacity  保留最近的记录条数
+    */
+    static void setBigValue(size_t iWarnReq, size_t iWarnRsp, size_t iLimit = 0, bool bSplit = false, size_t iCapacity = 32)
+    {
+        TC_Redis_BigValue_Holder::getInstance()->setConf(iWarnReq, iWarnRsp, iLimit, bSplit, iCapacity);
+    }
+
+    /**
+    * @brief 开关按命令统计请求/应答大小(所有proxy), 默认关闭.
+    *        与延时一起统计和上报, 命令名为 size.req.<命令>, size.rsp.<命令>, 单位字节
+    */
+    static void setSizeStat(bool bEnable)
+    {
+        TC_Redis_BigValue_Holder::getInstance()->setSizeStat(bEnable);
+    }
+
+    /**
+    * @brief 设置当前线程的调用方标识(如servant及接口名), 记录大value时一并输出; 空串清除
+    */
+    static void setCaller(const string& sCaller)
+    {
+        TC_Redis_BigValue_Holder::setCaller(sCaller);
+    }
+
+    /**
+    * @brief 最近的大请求/应答, 从新到旧
+    */
+    static vector<RedisBigValue> getBigValues()
+    {
+        return TC_Redis_BigValue_Holder::getInstance()->getBigValues();
+    }
+
+    /**
+    * @brief 大请求/应答的文本形式, 每行一条, 可用于管理命令输出
+    */
+    static string dumpBigValues()
+    {
+        return TC_Redis_BigValue_Holder::getInstance()->dump();
+    }
+
+    /**
+    * @brief 开启热点key统计(所有proxy): 请求的key(命令的第一个参数)计入count-min sketch, 每个周期选出top-K.
+    *        统计随startLatencyReport一起上报, 属性名为 Redis.<obj>.hotkey.<max|hot>
+    *
+    * @param iTopK      每个周期保留的key数, 0 关闭
+    * @param iInterval  周期(秒)
+    * @param iHotCount  周期内估计次数不小于该值的top-K key为热点, 用于上报及本地缓存(setHotKeyCache)
+    * @param iWidth     sketch每行的计数器数
+    * @param iDepth     sketch的行数
+    */
+    static void setHotKey(size_t iTopK, int iInterval = 10, uint64_t iHotCount = 1000, size_t iWidth = 4096, size_t iDepth = 4)
+    {
+        TC_Redis_HotKey_Holder::getInstance()->setConf(iTopK, iInterval, iHotCount, iWidth, iDepth);
+    }
+
+    /**
+    * @brief 上一个完整周期的top-K key, 按估计次数从大到小
+    *
+    * @param iBegin  返回该周期的开始时间(毫秒)
+    * @param iTotal  返回该周期记录的总次数
+    */
+    static void getHotKeys(vector<RedisHotKey>& vKey, int64_t& iBegin, uint64_t& iTotal)
+    {
+        TC_Redis_HotKey_Holder::getInstance()->getHotKeys(vKey, iBegin, iTotal);
+    }
+
+    /**
+    * @brief 热点key的文本形式, 每行一个, 可用于管理命令输出
+    */
+    static string dumpHotKeys()
+    {
+        return TC_Redis_HotKey_Holder::getInstance()->dump();
+    }
+
+    /**
+    * @brief blpop
+    *
+    * @param vKey        依次检查的list
+    * @param iTimeout    最多阻塞的秒数, 0为一直等待
+    * @param sKey        返回弹出元素所在的list
+    * @param sValue      返回弹出的元素
+    * @return 0 成功 1 超时没有数据 -1 失败
+    */
+    int blpop(const vector<string>& vKey, int iTimeout, string& sKey, string& sValue)
+    {
+        return bpop("BLPOP", vKey, iTimeout, sKey, sValue);
     }
 
     /**
-    * @brief del
-    *  
-    * @param sKey        
-    * @return 0 成功 -1 失败
+    * @brief brpop
+    *
+    * @param vKey        依次检查的list
+    * @param iTimeout    最多阻塞的秒数, 0为一直等待
+    * @param sKey        返回弹出元素所在的list
+    * @param sValue      返回弹出的元素
+    * @return 0 成功 1 超时没有数据 -1 失败
     */
-    int del( const string& sKey )
+    int brpop(const vector<string>& vKey, int iTimeout, string& sKey, string& sValue)
     {
-        int iRet = -1;
+        return bpop("BRPOP", vKey, iTimeout, sKey, sValue);
+    }
 
+    /**
+    * @brief blmove
+    *
+    * @param sSrc
+    * @param sDst
+    * @param bSrcLeft    从sSrc的左端(true)还是右端(false)弹出
+    * @param bDstLeft    压入sDst的左端(true)还是右端(false)
+    * @param iTimeout    最多阻塞的秒数, 0为一直等待
+    * @param sValue      返回移动的元素
+    * @return 0 成功 1 超时没有数据 -1 失败
+    */
+    int blmove(const string& sSrc, const string& sDst, bool bSrcLeft, bool bDstLeft, int iTimeout, string& sValue)
+    {
         string sCommand;
 
         vector<string> vPart;
 
-        vPart.push_back("DEL");
-        vPart.push_back(sKey);
+        vPart.push_back("BLMOVE");
+        vPart.push_back(sSrc);
+        vPart.push_back(sDst);
+        vPart.push_back(bSrcLeft ? "LEFT" : "RIGHT");
+        vPart.push_back(bDstLeft ? "LEFT" : "RIGHT");
+        vPart.push_back(TC_Common::tostr(iTimeout));
 
         buildCommand(vPart, sCommand);
 
-        vector<pair<int, string> > vBuffer;
+        RedisReply reply;
 
-        iRet = doCommand(sCommand, vBuffer);
+        int iRet = doBlockingCommand(sCommand, reply, iTimeout * 1000);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (iRet == 0)
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            if (reply.isNil())
+            {
+                iRet = 1;
+            }
+            else
+            {
+                sValue.swap(reply.str);
+            }
         }
 
         return iRet;
     }
 
     /**
-    * @brief exists
-    *  
-    * @param sKey        
-    * @return 0-不存在；1-存在
+    * @brief xread
+    *
+    * @param sKey
+    * @param sId         读取大于该id的消息, "$" 只读之后的新消息
+    * @param iCount      本次最多读取的条数
+    * @param vEntry      返回的消息
+    * @param iBlock      >=0 时没有消息最多阻塞等待的毫秒数(0为一直等待), 在阻塞命令连接池上执行; <0 不阻塞
+    * @return 0 成功(可能没有消息) -1 失败
     */
-    int exists(const string& sKey)
+    int xread(const string& sKey, const string& sId, size_t iCount, vector<RedisStreamEntry>& vEntry, int iBlock = -1)
     {
-        int iRet = -1;
         string sCommand;
 
         vector<string> vPart;
 
-        vPart.push_back("EXISTS");
+        vPart.push_back("XREAD");
+        vPart.push_back("COUNT");
+        vPart.push_back(TC_Common::tostr(iCount));
+
+        if (iBlock >= 0)
+        {
+            vPart.push_back("BLOCK");
+            vPart.push_back(TC_Common::tostr(iBlock));
+        }
+
+        vPart.push_back("STREAMS");
         vPart.push_back(sKey);
+        vPart.push_back(sId);
 
         buildCommand(vPart, sCommand);
 
-        vector<pair<int, string> > vBuffer;
+        RedisReply reply;
 
-        iRet = doCommand(sCommand, vBuffer);
+        int iRet = iBlock >= 0 ? doBlockingCommand(sCommand, reply, iBlock) : doCommand(sCommand, reply);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (iRet == 0)
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            parseStreamReply(reply, vEntry);
         }
 
         return iRet;
     }
 
     /**
-    * @brief del
-    *  
-    * @param vKey        
-    * @return 
+    * @brief 追加命令头 "*<argc>\r\n"
     */
-    int del(const vector<string>& vKey)
+    static void appendCommandHeader(string& sCommand, size_t iArgc)
     {
-        int iRet = -1;
-
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("DEL");
-
-        for (size_t i = 0; i < vKey.size(); i++)
-        {
-            vPart.push_back(vKey[i]);
-        }
-        
-        buildCommand(vPart, sCommand);
-
-        vector<pair<int, string> > vBuffer;
-
-        iRet = doCommand(sCommand, vBuffer);
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "*%zu\r\n", iArgc);
+        sCommand.append(buf, n);
+    }
 
-        if (iRet == 0 && vBuffer.size() == 1)
-        {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
-        }
+    /**
+    * @brief 追加一个参数 "$<len>\r\n<arg>\r\n", 不产生临时对象
+    */
+    static void appendCommandArg(string& sCommand, const char* pArg, size_t iLen)
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "$%zu\r\n", iLen);
+        sCommand.append(buf, n);
+        sCommand.append(pArg, iLen);
+        sCommand.append("\r\n", 2);
+    }
 
-        return iRet;
+    static void appendCommandArg(string& sCommand, const string& sArg)
+    {
+        appendCommandArg(sCommand, sArg.data(), sArg.size());
     }
 
-    /**
-    *@brief 批量获取数据
-    *@param vKey
-    *@param mpValues:返回key value对集合
-    *@param vNoKey: 不存在的key集合
-    * @return 0 成功 -1 失败
-    */   
-    int get(const vector<string>& vKey, map<string,string>& mValues, vector<string>& vNoKey)
+    static void appendCommandArg(string& sCommand, const vector<char>& vArg)
     {
-        int iRet = -1;
+        appendCommandArg(sCommand, vArg.data(), vArg.size());
+    }
 
-        string sCommand;
+    static void appendCommandArg(string& sCommand, const char* pArg)
+    {
+        appendCommandArg(sCommand, pArg, strlen(pArg));
+    }
 
-        vector<string> vPart;
-        vPart.push_back("MGET");
+    /**
+    * @brief 区间/批量接口接受的参数类型: string, vector<char>, const char*
+    */
+    static const char* argData(const string& sArg) { return sArg.data(); }
 
-        for (size_t i=0; i < vKey.size(); i++)
-        {        
-            vPart.push_back(vKey[i]);
-        }
+    static const char* argData(const vector<char>& vArg) { return vArg.data(); }
 
-        buildCommand(vPart, sCommand);
+    static const char* argData(const char* pArg) { return pArg; }
 
-        vector<pair<int, string> > vBuffer;
+    static size_t argSize(const string& sArg) { return sArg.size(); }
 
-        iRet = doCommand(sCommand, vBuffer);
+    static size_t argSize(const vector<char>& vArg) { return vArg.size(); }
 
-        if (vKey.size() != vBuffer.size())
-        {
-            iRet = -1;
+    static size_t argSize(const char* pArg) { return strlen(pArg); }
 
-            return iRet;
-        }
-        
-        for (size_t i = 0; i < vKey.size(); i++)
-        {
-            if (vBuffer[i].first < 0)
-            {
-                vNoKey.push_back(vKey[i]);
-            }
-            else
-            {
-                mValues[vKey[i]] = vBuffer[i].second;
-            }
-        }
-        
-        return iRet;
+    /**
+    * @brief 追加一个score参数, 按最短可精确还原的形式格式化, 不产生临时对象
+    */
+    static void appendScore(string& sCommand, double dScore)
+    {
+        char buf[32];
+        int n = formatScore(dScore, buf, sizeof(buf));
+        appendCommandArg(sCommand, buf, n);
     }
 
     /**
-    * @brief incr
-    *  
-    * @param sKey        
-    * @param iResult        
-    * @return 0 成功 -1 失败
+    * @brief 格式化score: 无穷大为+inf/-inf, 其他按%.17g(double可精确还原)
+    *
+    * @return 写入的长度
     */
-    int incr(const string& sKey, int64_t& iResult)
+    static int formatScore(double dScore, char* buf, size_t iSize)
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("INCR");
-        vPart.push_back(sKey);
-
-        buildCommand(vPart, sCommand);
-
-        vector<pair<int, string> > vBuffer;
+        if (std::isinf(dScore))
+        {
+            return snprintf(buf, iSize, "%s", dScore > 0 ? "+inf" : "-inf");
+        }
 
-        iRet = doCommand(sCommand, vBuffer);
+        //先尝试较短的表示, 能精确还原就用它, 避免 0.1 变成 0.10000000000000001
+        int n = snprintf(buf, iSize, "%.15g", dScore);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (strtod(buf, NULL) != dScore)
         {
-            iResult = TC_Common::strto<int64_t>(vBuffer[0].second);
+            n = snprintf(buf, iSize, "%.17g", dScore);
         }
 
-        return iRet;
+        return n;
     }
 
     /**
-    * @brief incrby
-    *  
-    * @param sKey        
-    * @param iInrement        
-    * @param iResult        
-    * @return 0 成功 -1 失败
+    * @brief 解析score, p指向应答缓冲, 其后紧跟"\r\n", 无需拷贝
     */
-    int incrby(const string& sKey, int iInrement, int64_t& iResult)
+    static double parseScore(const char* p)
     {
-        int iRet = -1;
-
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("INCRBY");
-        vPart.push_back(sKey);
-        vPart.push_back(TC_Common::tostr(iInrement));
-
-        buildCommand(vPart, sCommand);
-
-        vector<pair<int, string> > vBuffer;
+        return strtod(p, NULL);
+    }
 
-        iRet = doCommand(sCommand, vBuffer);
+    /**
+    * @brief 按RESP协议组装命令
+    *
+    * @param vPart       命令及参数
+    * @param sCommand    组装后的命令
+    */
+    static void buildCommand(const vector<string>& vPart, string& sCommand)
+    {
+        stringstream ss;
+        ss << "*" << vPart.size() << "\r\n";
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        for (size_t i = 0; i < vPart.size(); i++)
         {
-            iResult = TC_Common::strto<int64_t>(vBuffer[0].second);
+            ss << "$" << vPart[i].size() << "\r\n" << vPart[i] << "\r\n";
         }
 
-        return iRet;
+        sCommand = ss.str();
     }
 
+private:
     /**
-    * @brief decr
-    *  
-    * @param sKey        
-    * @param iResult        
+    * @brief 解析单个bulk或元素都为bulk/整数的数组应答, 见RedisReplyParser::decodeBulks
+    *
     * @return 0 成功 -1 失败
     */
-    int decr(const string& sKey, int64_t& iResult)
+    int doMultiReplay(const string& sBuffer, vector<pair<int, string> >& vBuffer)
     {
-        int iRet = -1;
-
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("DECR");
-        vPart.push_back(sKey);
+        return RedisReplyParser::decodeBulks(sBuffer.data(), sBuffer.size(), vBuffer);
+    }
 
-        buildCommand(vPart, sCommand);
+    /**
+    * @brief 本obj的运行时状态
+    */
+    RedisProxyContextPtr getContext()
+    {
+        return TC_Redis_Context_Holder::getInstance()->get(tars_name());
+    }
 
-        vector<pair<int, string> > vBuffer;
+    /**
+    * @brief 从genRedisObj生成的obj名(TARS.RedisServer.RedisObj.<host>.<port>)还原连接配置
+    */
+    TC_RDConf getObjConf()
+    {
+        TC_RDConf tcRDConf;
 
-        iRet = doCommand(sCommand, vBuffer);
+        string sObj = tars_name();
+        string sPrefix = "TARS.RedisServer.RedisObj.";
+        string::size_type iPos = sObj.rfind('.');
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (sObj.compare(0, sPrefix.size(), sPrefix) == 0 && iPos != string::npos && iPos > sPrefix.size())
         {
-            iResult = TC_Common::strto<int64_t>(vBuffer[0].second);
+            tcRDConf._host = sObj.substr(sPrefix.size(), iPos - sPrefix.size());
+            tcRDConf._port = TC_Common::strto<int>(sObj.substr(iPos + 1));
         }
 
-        return iRet;
+        TC_Redis_Config_Holder::getInstance()->get_password(sObj, tcRDConf._password);
+
+        return tcRDConf;
     }
 
-    
     /**
-    * @brief decr
-    *  
-    * @param sKey        
-    * @param sMember        
-    * @param fValue        
+    * @brief 在阻塞命令连接池的独占连接上执行命令
+    *
+    * @param iBlock  命令在服务端最多阻塞的毫秒数, 0为一直等待; 网络超时在此基础上再加上调用超时
     * @return 0 成功 -1 失败
     */
-    int zAdd(const string& sKey, const string& sMember, const float& fValue)
+    int doBlockingCommand(const string& sCommand, RedisReply& reply, int iBlock)
     {
-        int iRet = -1;
+        shared_ptr<RedisConnectionPool> pool;
 
-        string sCommand;
+        {
+            RedisProxyContextPtr context = getContext();
 
-        vector<string> vPart;
+            std::lock_guard<std::mutex> lock(context->mutex);
 
-        vPart.push_back("ZADD");
-        vPart.push_back(sKey);
-        vPart.push_back(TC_Common::tostr(fValue));
-        vPart.push_back(sMember);
+            if (!context->blockingPool)
+            {
+                context->blockingPool = std::make_shared<RedisConnectionPool>();
+                context->blockingPool->init(getObjConf(), context->iBlockingConn, context->iBlockingWait, tars_timeout());
+            }
 
-        buildCommand(vPart, sCommand);
+            pool = context->blockingPool;
+        }
 
-        vector<pair<int, string> > vBuffer;
+        int64_t iWait = TC_Common::now2us();
 
-        iRet = doCommand(sCommand, vBuffer);
+        RedisConnectionPtr conn = pool->get();
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (!conn)
         {
-            int iSize = TC_Common::strto<int>(vBuffer[0].second);
-
-            if (iSize == 0 || iSize == 1)
-            {
-                iRet = 0;
-            }
-            else
-            {
-                iRet = -1;
-            }
+            LOG_CONSOLE_DEBUG << "no blocking connection available, obj:" << tars_name() << endl;
+            return -1;
         }
 
-        return iRet;
-    }
+        int iTimeout = iBlock > 0 ? iBlock + pool->getTimeout() : INT_MAX;
 
-    /**
-    * @brief zRem
-    *  
-    * @param sKey        
-    * @param sMember        
-    * @return 0 成功 -1 失败
-    */
-    int zRem(const string& sKey, const string& sMember)
-    {
-        int iRet = -1;
+        int64_t iBegin = TC_Common::now2us();
 
-        string sCommand;
+        int iRet = conn->call(sCommand, reply, iTimeout);
 
-        vector<string> vPart;
+        int64_t iCost = TC_Common::now2us() - iBegin;
 
-        vPart.push_back("ZREM");
-        vPart.push_back(sKey);
-        vPart.push_back(sMember);
+        recordLatency(sCommand, iCost);
 
-        buildCommand(vPart, sCommand);
+        //阻塞命令本身就可能很慢, 只记录网络调用之外的等待超过阈值的情况
+        if (TC_Redis_SlowLog_Holder::getInstance()->isSlow(iBegin - iWait))
+        {
+            recordSlow(sCommand, iBegin - iWait, iCost, 0, iRet != 0);
+        }
 
-        vector<pair<int, string> > vBuffer;
+        pool->put(conn);
 
-        iRet = doCommand(sCommand, vBuffer);
+        if (iRet != 0)
+        {
+            return -1;
+        }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (reply.isError())
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << reply.str << endl;
+            return -1;
         }
 
-        return iRet;
+        return 0;
     }
 
-    /**
-    * @brief zRem
-    *  
-    * @param sKey        
-    * @param vMember        
-    * @return 0 成功 -1 失败
-    */
-    int zRem(const string& sKey, const vector<string>& vMember)
+    int bpop(const string& sCmd, const vector<string>& vKey, int iTimeout, string& sKey, string& sValue)
     {
-        int iRet = -1;
         string sCommand;
 
         vector<string> vPart;
+        vPart.reserve(vKey.size() + 2);
 
-        vPart.push_back("ZREM");
-        vPart.push_back(sKey);
+        vPart.push_back(sCmd);
 
-        for (size_t i = 0; i < vMember.size(); i++)
-        {
-            vPart.push_back(vMember[i]);
-        }
+        std::copy(vKey.begin(), vKey.end(), back_inserter(vPart));
+
+        vPart.push_back(TC_Common::tostr(iTimeout));
 
         buildCommand(vPart, sCommand);
 
-        vector<pair<int, string> > vBuffer;
+        RedisReply reply;
 
-        iRet = doCommand(sCommand, vBuffer);
+        int iRet = doBlockingCommand(sCommand, reply, iTimeout * 1000);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (iRet == 0)
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            if (reply.isNil() || reply.element.size() != 2)
+            {
+                iRet = 1;
+            }
+            else
+            {
+                sKey.swap(reply.element[0].str);
+                sValue.swap(reply.element[1].str);
+            }
         }
 
         return iRet;
     }
-    
+
     /**
-    * @brief zRangeByScore
-    *  
-    * @param sKey        
-    * @param vKeyList        
-    * @param fStart        
-    * @param fEnd        
-    * @return 0 成功 -1 失败
+    * @brief 解析XREAD/XREADGROUP的应答
     */
-    int zRangeByScore(const string& sKey, vector<pair<string, float> >& vKeyList, float fStart = FLT_MIN, float fEnd = FLT_MAX)
+    static void parseStreamReply(RedisReply& reply, vector<RedisStreamEntry>& vEntry)
     {
-        int iRet = -1;
+        if (reply.type == RedisReply::REPLY_MAP)
+        {
+            //RESP3: {key: [entries]}
+            for (size_t i = 1; i < reply.element.size(); i += 2)
+            {
+                RedisStreamEntry::parse(reply.element[i], vEntry);
+            }
+        }
+        else
+        {
+            //RESP2: [[key, [entries]]], 没有数据时为nil
+            for (size_t i = 0; i < reply.element.size(); i++)
+            {
+                if (reply.element[i].element.size() == 2)
+                {
+                    RedisStreamEntry::parse(reply.element[i].element[1], vEntry);
+                }
+            }
+        }
+    }
 
-        string sCommand;
+    /**
+    * @brief 执行命令, 返回原始应答, 调用方直接从应答缓冲中解析, 不经过vBuffer拷贝
+    */
+    shared_ptr<TC_CustomProtoRsp> doRawCommand(const string& sCommand)
+    {
+        shared_ptr<RedisReq> req = RedisObjectPool<RedisReq>::get();
+        req->sendBuffer(sCommand);
 
-        vector<string> vPart;
+        return invoke(req);
+    }
 
-        vPart.push_back("ZRANGEBYSCORE");
-        vPart.push_back(sKey);
-        vPart.push_back(TC_Common::tostr(fStart));
-        vPart.push_back(TC_Common::tostr(fEnd));
-        vPart.push_back("WITHSCORES");
+    /**
+    * @brief 发送请求. 请求/应答对象及网络线程的发送缓冲都取自线程私有的对象池
+    */
+    shared_ptr<TC_CustomProtoRsp> invoke(const shared_ptr<RedisReq>& redisReq)
+    {
+        if (TC_Redis_BigValue_Holder::getInstance()->isLimited(redisReq->getBuffer().size()))
+        {
+            return invokeLimited(*redisReq);
+        }
 
-        buildCommand(vPart, sCommand);
+        int64_t iDeadline = getDeadline(redisReq->getBuffer());
 
-        vector<pair<int, string> > vBuffer;
+        if (iDeadline != 0)
+        {
+            if (iDeadline <= TC_Common::now2us())
+            {
+                RedisDeadline::expired().fetch_add(1, std::memory_order_relaxed);
 
-        iRet = doCommand(sCommand, vBuffer);
+                return makeReply("-ERR deadline exceeded\r\n");
+            }
 
-        if (vBuffer.size() % 2 != 0)
-        {
-            return iRet;
+            redisReq->setDeadline(iDeadline);
         }
-        
-        for (size_t i = 0; i < vBuffer.size(); i += 2) 
+
+        RedisLimiterPtr limiter = getLimiter();
+        bool bProbe = false;
+
+        if (limiter)
         {
-            vKeyList.push_back(make_pair(vBuffer[i].second, TC_Common::strto<float>(vBuffer[i+1].second)));
+            int iRet = limiter->acquire(bProbe);
+
+            if (iRet != RedisLimiter::ACQUIRE_OK)
+            {
+                return makeReply(iRet == RedisLimiter::ACQUIRE_OPEN ? "-ERR circuit breaker open\r\n" : "-ERR concurrency limit reached\r\n");
+            }
         }
 
-        return iRet;
-    }
+        shared_ptr<TC_CustomProtoReq> req = redisReq;
 
-    /**
-    * @brief setNx
-    *  
-    * @param sKey        
-    * @param sValue        
-    * @return 0 成功 -1 失败
-    */
-    int setNx(const string& sKey, const string& sValue)
-    {
-        int iRet = -1;
+        //应答由redisResponse在网络线程创建, 调用返回时替换rsp
+        shared_ptr<TC_CustomProtoRsp> rsp;
 
-        string sCommand;
+        int64_t iBegin = TC_Common::now2us();
 
-        vector<string> vPart;
+        RedisLimiterGuard guard(limiter.get(), bProbe, iBegin);
 
-        vPart.push_back("SETNX");
-        vPart.push_back(sKey);
-        vPart.push_back(sValue);
+        //剩余时间短于proxy的超时时, 本次调用使用剩余时间. 只对本线程接下来的一次调用生效, 所以紧挨着发送设置
+        if (iDeadline != 0)
+        {
+            int iTimeout = (int)std::max<int64_t>((iDeadline - iBegin + 999) / 1000, 1);
 
-        buildCommand(vPart, sCommand);
+            if (iTimeout < tars_timeout())
+            {
+                tars_set_timeout(iTimeout);
+            }
+        }
 
-        vector<pair<int, string> > vBuffer;
+        try
+        {
+            common_protocol_call("redis", req, rsp);
 
-        iRet = doCommand(sCommand, vBuffer);
+            guard.setSuccess();
+        }
+        catch (TarsSyncCallTimeoutException &ex)
+        {
+            //调用方自己的截止时间导致的超时不是服务端的故障, 不计入熔断
+            if (iDeadline != 0 && TC_Common::now2us() >= iDeadline)
+            {
+                guard.setIgnore();
+            }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+            if (TC_Redis_Conn_Holder::getInstance()->isEnable())
+            {
+                TC_Redis_Conn_Holder::getInstance()->getObjCounter(tars_name())->onTimeout();
+            }
+
+            invokeFailed(*redisReq, iBegin, ex.what());
+            throw;
+        }
+        catch (exception &ex)
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            invokeFailed(*redisReq, iBegin, ex.what());
+            throw;
+        }
+        catch (...)
+        {
+            invokeFailed(*redisReq, iBegin, "unknown exception");
+            throw;
         }
 
-        return iRet;
-    }
-
-    /**
-    * @brief setExpire
-    *  
-    * @param sKey        
-    * @param expir        
-    * @return 0 成功 -1 失败
-    */
-    int setExpire(const string& sKey, unsigned int expir = 0)
-    {
-        int iRet = -1;
-        string sCommand;
+        int64_t iCost = TC_Common::now2us() - iBegin;
 
-        vector<string> vPart;
+        //截止时间与调用超时按毫秒取整有误差, 调用方可能在超时之前收到PING的应答
+        if (redisReq->isCancelled())
+        {
+            rsp = makeReply("-ERR deadline exceeded\r\n");
+        }
 
-        vPart.push_back("EXPIRE");
-        vPart.push_back(sKey);
-        vPart.push_back(TC_Common::tostr(expir));
+        recordLatency(redisReq->getBuffer(), iCost);
 
-        buildCommand(vPart, sCommand);
+        recordKey(redisReq->getBuffer(), iBegin);
 
-        vector<pair<int, string> > vBuffer;
+        recordSize(redisReq->getBuffer(), rsp->getBuffer().size());
 
-        iRet = doCommand(sCommand, vBuffer);
+        if (TC_Redis_SlowLog_Holder::getInstance()->isSlow(iCost))
+        {
+            recordSlow(redisReq->getBuffer(), 0, iCost, rsp->getBuffer().size(), false);
+        }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (TC_Redis_Trace_Holder::getInstance()->isEnable())
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            recordTrace(*redisReq, dynamic_cast<RedisRsp*>(rsp.get()), iBegin, iBegin + iCost, NULL);
         }
 
-        return iRet;
+        return rsp;
     }
 
     /**
-    * @brief getset
-    *  
-    * @param sKey        
-    * @param sSetValue        
-    * @param sReturnValue        
-    * @return 0 成功 -1 失败
+    * @brief 请求超过上限: 可以拆分的批量写入拆成多条依次发送, 否则拒绝, 返回错误应答.
+    *        拆分后遇到错误应答即停止, 之前的部分已写入
     */
-    int getset(const string& sKey, const string& sSetValue, string& sReturnValue)
+    shared_ptr<TC_CustomProtoRsp> invokeLimited(const RedisReq& redisReq)
     {
-        int iRet = -1;
-
-        string sCommand;
+        TC_Redis_BigValue_Holder *holder = TC_Redis_BigValue_Holder::getInstance();
 
-        vector<string> vPart;
+        const string &sCommand = redisReq.getBuffer();
 
-        vPart.push_back("GETSET");
-        vPart.push_back(sKey);
-        vPart.push_back(sSetValue);
+        vector<string> vCommand;
+        bool bSum = false;
 
-        buildCommand(vPart, sCommand);
+        if (!holder->isSplit() || !splitCommand(sCommand, holder->getLimit(), vCommand, bSum))
+        {
+            recordBigValue(sCommand, 0, true);
 
-        vector<pair<int, string> > vBuffer;
+            return makeReply("-ERR request of " + TC_Common::tostr(sCommand.size()) + " bytes exceeds limit "
+                + TC_Common::tostr(holder->getLimit()) + "\r\n");
+        }
 
-        iRet = doCommand(sCommand, vBuffer);
+        shared_ptr<TC_CustomProtoRsp> rsp;
+        int64_t iSum = 0;
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        for (size_t i = 0; i < vCommand.size(); i++)
         {
-            iRet = 0;
+            rsp = doSwapCommand(vCommand[i]);
 
-            if (vBuffer[0].first == -1)
+            const string &sBuffer = rsp->getBuffer();
+            size_t iPos   = 0;
+            const char *p = NULL;
+            int64_t iLen  = 0;
+
+            char c = RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen);
+
+            if (c != ':' && c != '+')
             {
-                iRet = 1;
+                return rsp;
             }
-            else
+
+            if (c == ':')
             {
-                sReturnValue = vBuffer[0].second;
-                iRet = 0;
+                iSum += strtoll(p, NULL, 10);
             }
         }
-        else
-        {
-            iRet = -1;
-        }
 
-        return iRet;
+        return bSum ? makeReply(":" + TC_Common::tostr(iSum) + "\r\n") : rsp;
     }
 
     /**
-    * @brief list
-    *  
-    * @param sKey        
-    * @param vValue        
-    * @return 0 成功 -1 失败
-    *  查找所有符合给定模式 pattern 的 key 
-        KEYS * 匹配数据库中所有 key
-        KEYS h?llo 匹配 hello ， hallo 和 hxllo 等
-        KEYS h*llo 匹配 hllo 和 heeeeello 等。
-        KEYS h[ae]llo 匹配 hello 和 hallo ，但不匹配 hillo 
+    * @brief 把超过iLimit字节的批量写入命令按参数组拆成多条, 每条不超过iLimit字节.
+    *        支持MSET/HMSET/HSET/SADD/LPUSH/RPUSH, 拆分后依次执行的结果与原命令相同, 但不再是原子操作
+    *
+    * @param bSum  返回合并应答的方式: true 各条的整数应答相加(HSET/SADD), false 取最后一条的应答
+    * @return 是否可以拆分(不支持的命令, 只有一组参数, 或单组参数已超过上限时不能拆分)
     */
-    int list(const string& sKey, vector<string>& vValue)
+    static bool splitCommand(const string& sCommand, size_t iLimit, vector<string>& vCommand, bool& bSum)
     {
-        int iRet = -1;
-        string sCommand;
+        struct SplitRule
+        {
+            const char *pCmd;
+            size_t      iPrefix;
+            size_t      iGroup;
+            bool        bSum;
+        };
 
-        vector<string> vPart;
+        static const SplitRule kRule[] =
+        {
+            { "MSET",  1, 2, false },
+            { "HMSET", 2, 2, false },
+            { "HSET",  2, 2, true  },
+            { "SADD",  2, 1, true  },
+            { "LPUSH", 2, 1, false },
+            { "RPUSH", 2, 1, false },
+        };
+
+        size_t iPos   = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        if (RedisReplyParser::readElement(sCommand.data(), sCommand.size(), iPos, p, iLen) != '*' || iLen < 2)
+        {
+            return false;
+        }
 
-        vPart.push_back("KEYS");
-        vPart.push_back(sKey);
+        vector<pair<const char*, size_t> > vArg((size_t)iLen);
 
-        buildCommand(vPart, sCommand);
+        for (size_t i = 0; i < vArg.size(); i++)
+        {
+            if (RedisReplyParser::readElement(sCommand.data(), sCommand.size(), iPos, p, iLen) != '$')
+            {
+                return false;
+            }
 
-        vector<pair<int, string> > vBuffer;
+            vArg[i] = make_pair(p, (size_t)iLen);
+        }
 
-        iRet = doCommand(sCommand, vBuffer);
+        const SplitRule *rule = NULL;
 
-        if (iRet == 0)
+        for (size_t i = 0; i < sizeof(kRule) / sizeof(kRule[0]); i++)
         {
-            if (vBuffer.empty())
+            if (vArg[0].second == strlen(kRule[i].pCmd) && TC_Port::strncasecmp(vArg[0].first, kRule[i].pCmd, vArg[0].second) == 0)
             {
-                iRet = 1;
+                rule = &kRule[i];
+                break;
             }
-            else
-            {
-                for (size_t i = 0; i < vBuffer.size(); ++i)
-                {
-                    if (vBuffer[i].first > 0)
-                    {
-                        vValue.push_back(vBuffer[i].second);
-                    }
-                }
+        }
 
-                iRet = 0;
-            }
+        if (rule == NULL || vArg.size() <= rule->iPrefix + rule->iGroup || (vArg.size() - rule->iPrefix) % rule->iGroup != 0)
+        {
+            return false;
         }
 
-        return iRet;
-    }
+        //参数编码后的大小: $<len>\r\n<data>\r\n
+        auto argSize = [](size_t iLen) { return iLen + TC_Common::tostr(iLen).size() + 5; };
 
-    /**
-    * @brief hgetall
-    *  
-    * @param sKey        
-    * @param mValue        
-    * @return 0 成功 -1 失败
-    * 返回哈希表 key中，所有的域和值。在返回值里，紧跟每个域名(field name)之后是域的值(value)，所以返回值的长度是哈希表大小的两倍。
-    */
-    int hgetall(const string& sKey, map<string, string>& mValue)
-    {
-        int iRet = -1;
+        //头部*<argc>\r\n按最大20位预留
+        size_t iPrefixSize = 23;
 
-        string sCommand;
+        for (size_t i = 0; i < rule->iPrefix; i++)
+        {
+            iPrefixSize += argSize(vArg[i].second);
+        }
 
-        vector<string> vPart;
+        //每条命令包含的参数组[begin, end)
+        vector<pair<size_t, size_t> > vRange;
+        size_t iSize = iPrefixSize;
 
-        vPart.push_back("HGETALL");
-        vPart.push_back(sKey);
+        for (size_t i = rule->iPrefix; i < vArg.size(); i += rule->iGroup)
+        {
+            size_t iGroupSize = 0;
 
-        buildCommand(vPart, sCommand);
+            for (size_t j = 0; j < rule->iGroup; j++)
+            {
+                iGroupSize += argSize(vArg[i + j].second);
+            }
+
+            if (iPrefixSize + iGroupSize > iLimit)
+            {
+                return false;
+            }
+
+            if (vRange.empty() || iSize + iGroupSize > iLimit)
+            {
+                vRange.push_back(make_pair(i, i));
+                iSize = iPrefixSize;
+            }
 
-        vector<pair<int, string> > vBuffer;
+            vRange.back().second = i + rule->iGroup;
+            iSize += iGroupSize;
+        }
 
-        iRet = doCommand(sCommand, vBuffer);
+        vCommand.resize(vRange.size());
 
-        if (iRet == 0)
+        for (size_t i = 0; i < vRange.size(); i++)
         {
-            if (vBuffer.empty())
+            string &sPart = vCommand[i];
+
+            appendCommandHeader(sPart, rule->iPrefix + vRange[i].second - vRange[i].first);
+
+            for (size_t j = 0; j < rule->iPrefix; j++)
             {
-                iRet = 1;
+                appendCommandArg(sPart, vArg[j].first, vArg[j].second);
             }
-            else
-            {
-                iRet = 0;
 
-                for (size_t i = 0; i < vBuffer.size(); i += 2)
-                {
-                    if (i + 1 < vBuffer.size())
-                    {
-                        mValue[vBuffer[i].second] = vBuffer[i+1].second;
-                    }
-                }
+            for (size_t j = vRange[i].first; j < vRange[i].second; j++)
+            {
+                appendCommandArg(sPart, vArg[j].first, vArg[j].second);
             }
         }
 
-        return iRet;
+        bSum = rule->bSum;
+
+        return true;
     }
 
     /**
-    * @brief hget
-    *  
-    * @param sKey        
-    * @param mValue        
-    * @return 0 成功 1-不存在 -1 失败
+    * @brief 构造本地的应答, 如拒绝请求时的错误
     */
-    int hget(const string& sKey, const string& sField, string& sValue)
+    static shared_ptr<TC_CustomProtoRsp> makeReply(const string& sReply)
     {
-        int iRet = -1;
+        shared_ptr<RedisRsp> rsp = RedisObjectPool<RedisRsp>::get();
 
-        string sCommand;
+        TC_NetWorkBuffer::Buffer buff;
+        buff.addBuffer(sReply);
 
-        vector<string> vPart;
+        rsp->decode(buff);
 
-        vPart.push_back("HGET");
-        vPart.push_back(sKey);
-        vPart.push_back(sField);
+        return rsp;
+    }
 
-        buildCommand(vPart, sCommand);
+    /**
+    * @brief 记录大请求/应答
+    */
+    void recordBigValue(const string& sCommand, size_t iRspBytes, bool bRejected)
+    {
+        TC_RDConf tcRDConf = getObjConf();
 
-        vector<pair<int, string> > vBuffer;
+        RedisBigValue big;
 
-        iRet = doCommand(sCommand, vBuffer);
+        big.iTime     = TC_Common::now2ms();
+        big.sObj      = tars_name();
+        big.sEndpoint = tcRDConf._host + ":" + TC_Common::tostr(tcRDConf._port);
+        big.iReqBytes = sCommand.size();
+        big.iRspBytes = iRspBytes;
+        big.bRejected = bRejected;
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        TC_Redis_BigValue_Holder::getInstance()->add(big, sCommand);
+    }
+
+    /**
+    * @brief 大value检测, 及开启时按命令名记录请求/应答大小到本线程的直方图
+    */
+    void recordSize(const string& sCommand, size_t iRspBytes)
+    {
+        TC_Redis_BigValue_Holder *holder = TC_Redis_BigValue_Holder::getInstance();
+
+        if (holder->isBig(sCommand.size(), iRspBytes))
         {
-            if (vBuffer[0].first == -1)
-            {
-                iRet = 1;
-            }
-            else
-            {
-                sValue = vBuffer[0].second;
-                iRet = 0;
-            }
+            recordBigValue(sCommand, iRspBytes, false);
         }
-        else
+
+        if (!holder->isSizeStat() || !TC_Redis_Stat_Holder::getInstance()->isEnable())
         {
-            iRet = 1;
+            return;
         }
 
-        return iRet;
+        char buf[48];
+        size_t iLen = getCommandName(sCommand, buf + 9, sizeof(buf) - 9);
+
+        memcpy(buf, "size.req.", 9);
+        TC_Redis_Stat_Holder::getInstance()->record(this, [this]{ return tars_name(); }, buf, iLen + 9, sCommand.size());
+
+        memcpy(buf, "size.rsp.", 9);
+        TC_Redis_Stat_Holder::getInstance()->record(this, [this]{ return tars_name(); }, buf, iLen + 9, iRspBytes);
     }
 
     /**
-    * @brief hdel
-    *  
-    * @param sKey        
-    * @param sField        
-    * @return 0 成功 -1 失败
+    * @brief 调用异常时记录延时, 慢命令及追踪
     */
-    int hdel(const string& sKey, const string& sField)
+    void invokeFailed(const RedisReq& req, int64_t iBegin, const char* pError)
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("HDEL");
-        vPart.push_back(sKey);
-        vPart.push_back(sField);
-
-        buildCommand(vPart, sCommand);
+        int64_t iEnd = TC_Common::now2us();
 
-        vector<pair<int, string> > vBuffer;
+        invalidateHotCache(req.getBuffer());
 
-        iRet = doCommand(sCommand, vBuffer);
+        recordLatency(req.getBuffer(), iEnd - iBegin);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (TC_Redis_SlowLog_Holder::getInstance()->isSlow(iEnd - iBegin))
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            recordSlow(req.getBuffer(), 0, iEnd - iBegin, 0, true);
         }
 
-        return iRet;
+        if (TC_Redis_Trace_Holder::getInstance()->isEnable())
+        {
+            recordTrace(req, NULL, iBegin, iEnd, pError);
+        }
     }
 
-    // 0-不存在 1-存在
-    int hexists(const string& sKey, const string& sField)
+    /**
+    * @brief 由请求/应答上的时间点计算各阶段耗时, 计入阶段直方图并回调追踪钩子
+    *
+    * @param rsp     应答, 异常结束时为NULL
+    * @param pError  异常信息, 正常结束时为NULL
+    */
+    void recordTrace(const RedisReq& req, const RedisRsp* rsp, int64_t iBegin, int64_t iEnd, const char* pError)
     {
-        int iRet = -1;
-        string sCommand;
+        TC_Redis_Trace_Holder *holder = TC_Redis_Trace_Holder::getInstance();
 
-        vector<string> vPart;
+        RedisSpan span;
 
-        vPart.push_back("HEXISTS");
-        vPart.push_back(sKey);
-        vPart.push_back(sField);
+        span.iStartUs  = iBegin;
+        span.iEndUs    = iEnd;
+        span.iReqBytes = req.getBuffer().size();
+        span.iRspBytes = rsp ? rsp->getBuffer().size() : 0;
+        span.bError    = pError != NULL;
+        span.sError    = pError ? pError : "";
 
-        buildCommand(vPart, sCommand);
+        for (int i = 0; i < RedisSpan::PHASE_MAX; i++)
+        {
+            span.vPhaseUs[i] = 0;
+        }
 
-        vector<pair<int, string> > vBuffer;
+        //请求在网络线程编码后才有后续阶段; 开关在请求中途打开时缺少的时间点按0处理
+        int64_t iEncodeBegin = req.getEncodeBegin();
 
-        iRet = doCommand(sCommand, vBuffer);
+        if (iEncodeBegin > 0)
+        {
+            int64_t iEncodeEnd = req.getEncodeEnd();
+            int64_t iFrame     = rsp && rsp->getFrameTime() > 0 ? rsp->getFrameTime() : iEnd;
+            int64_t iDecode    = rsp ? rsp->getDecodeCost() : 0;
+
+            span.vPhaseUs[RedisSpan::PHASE_QUEUE]    = iEncodeBegin - iBegin;
+            span.vPhaseUs[RedisSpan::PHASE_ENCODE]   = iEncodeEnd - iEncodeBegin;
+            span.vPhaseUs[RedisSpan::PHASE_WIRE]     = std::max<int64_t>(iFrame - iEncodeEnd - iDecode, 0);
+            span.vPhaseUs[RedisSpan::PHASE_DECODE]   = iDecode;
+            span.vPhaseUs[RedisSpan::PHASE_DISPATCH] = iEnd - iFrame;
+        }
+        else
+        {
+            span.vPhaseUs[RedisSpan::PHASE_QUEUE] = iEnd - iBegin;
+        }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        char buf[32];
+        size_t iLen = getCommandName(req.getBuffer(), buf, sizeof(buf));
+
+        span.sCmd.assign(buf, iLen);
+
+        if (holder->isPhaseStat() && TC_Redis_Stat_Holder::getInstance()->isEnable())
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            for (int i = 0; i < RedisSpan::PHASE_MAX; i++)
+            {
+                string sPhase = string("phase.") + RedisSpan::phaseName(i);
+
+                TC_Redis_Stat_Holder::getInstance()->record(this, [this]{ return tars_name(); }, sPhase.c_str(), sPhase.size(), std::max<int64_t>(span.vPhaseUs[i], 0));
+            }
         }
 
-        return iRet;
+        RedisTraceHookPtr hook = holder->getHook();
+
+        if (hook)
+        {
+            TC_RDConf tcRDConf = getObjConf();
+
+            span.sObj   = tars_name();
+            span.sHost  = tcRDConf._host;
+            span.iPort  = tcRDConf._port;
+            span.iIndex = tcRDConf._index;
+
+            hook->onSpan(span);
+        }
     }
 
     /**
-    * @brief hmset
-    *  
-    * @param sKey        
-    * @param mValue        
-    * @return 0 成功 -1 失败
-    * 同时将多个field-value(域-值)对设置到哈希表 key中。此命令会覆盖哈希表中已存在的域。如果 key不存在，一个空哈希表被创建并执行 HMSET操作。
+    * @brief 记录慢命令, 只在耗时超过阈值时调用
     */
-    int hmset(const string& sKey, const map<string, string>& mValue)
+    void recordSlow(const string& sCommand, int64_t iWait, int64_t iCall, size_t iRspBytes, bool bException)
     {
-        int iRet = -1;
-        string sCommand;
+        TC_RDConf tcRDConf = getObjConf();
 
-        vector<string> vPart;
+        RedisSlowCommand slow;
 
-        vPart.push_back("HMSET");
-        vPart.push_back(sKey);
+        slow.iTime      = TC_Common::now2ms();
+        slow.sObj       = tars_name();
+        slow.sEndpoint  = tcRDConf._host + ":" + TC_Common::tostr(tcRDConf._port);
+        slow.iRspBytes  = iRspBytes;
+        slow.iCostUs    = iWait + iCall;
+        slow.iWaitUs    = iWait;
+        slow.iCallUs    = iCall;
+        slow.bException = bException;
 
-        for (map<string, string>::const_iterator iter = mValue.begin(); iter != mValue.end(); ++iter)
+        TC_Redis_SlowLog_Holder::getInstance()->add(slow, sCommand);
+    }
+
+    /**
+    * @brief 热点key统计, 及本地缓存开启时使非GET命令涉及的key失效
+    *
+    * @param iNow 当前时间(微秒)
+    */
+    void recordKey(const string& sCommand, int64_t iNow)
+    {
+        TC_Redis_HotKey_Holder *holder = TC_Redis_HotKey_Holder::getInstance();
+
+        if (!holder->isEnable() && !holder->isCacheUsed())
         {
-            vPart.push_back(iter->first);
-            vPart.push_back(iter->second);
+            return;
         }
 
-        buildCommand(vPart, sCommand);
-
-        vector<pair<int, string> > vBuffer;
+        const char *pCmd = NULL, *pKey = NULL;
+        int64_t iCmdLen  = 0, iKeyLen = 0;
 
-        iRet = doCommand(sCommand, vBuffer);
+        bool bKey = getCommandKey(sCommand, pCmd, iCmdLen, pKey, iKeyLen);
 
-        if (iRet == 0 && vBuffer.size() == 1)
-        {
-            iRet = 0;
-        }
-        else
+        if (bKey)
         {
-            iRet = -1;
+            holder->record([this]{ return tars_name(); }, pKey, iKeyLen, iNow);
         }
 
-        return iRet;
+        invalidateHotCache(sCommand);
     }
 
     /**
-    * @brief hmset
-    *  
-    * @param sKey        
-    * @param mValue        
-    * @return 0 成功 -1 失败
-    * 将哈希表 key中的域field的值设为value。如果 key不存在，一个新的哈希表被创建并进行 HSE 操作。 如果域 field已经存在于哈希表中，旧值将被覆盖。
+    * @brief 本地缓存开启时使非GET命令涉及的key失效.
+    *        调用失败(如超时)时命令仍可能已在服务端执行, 同样需要失效
     */
-    int hset(const string& sKey, const string& sField, const string& sValue)
+    void invalidateHotCache(const string& sCommand)
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("HSET");
-        vPart.push_back(sKey);
-        vPart.push_back(sField);
-        vPart.push_back(sValue);
+        if (!TC_Redis_HotKey_Holder::getInstance()->isCacheUsed())
+        {
+            return;
+        }
 
-        buildCommand(vPart, sCommand);
+        char buf[8];
 
-        vector<pair<int, string> > vBuffer;
+        if (getCommandName(sCommand, buf, sizeof(buf)) == 3 && memcmp(buf, "GET", 3) == 0)
+        {
+            return;
+        }
 
-        iRet = doCommand(sCommand, vBuffer);
+        RedisHotCachePtr cache = getHotCache();
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (cache)
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            cache->invalidate(sCommand);
         }
-
-        return iRet;
     }
 
     /**
-    * @brief hincby
-    *  
-    * @param sKey        
-    * @param sField
-    * @param sAddValue        
-    * @return 0 成功 -1 失败
+    * @brief 本次调用的截止时间(微秒): 当前线程的截止时间与按命令配置的超时中较早的一个, 0 没有
     */
-    int hincby(const string& sKey, const string& sField, const string& sAddValue)
+    int64_t getDeadline(const string& sCommand)
     {
-        int iRet = -1;
-        string sCommand;
+        int64_t iDeadline = RedisDeadline::current();
 
-        vector<string> vPart;
+        if (!RedisDeadline::used().load(std::memory_order_relaxed))
+        {
+            return iDeadline;
+        }
 
-        vPart.push_back("HINCRBY");
-        vPart.push_back(sKey);
-        vPart.push_back(sField);
-        vPart.push_back(sAddValue);
+        char buf[32];
+        string sCmd(buf, getCommandName(sCommand, buf, sizeof(buf)));
 
-        buildCommand(vPart, sCommand);
+        int iTimeout = 0;
 
-        vector<pair<int, string> > vBuffer;
+        {
+            RedisProxyContextPtr context = getContext();
 
-        iRet = doCommand(sCommand, vBuffer);
+            std::lock_guard<std::mutex> lock(context->mutex);
 
-        if (iRet == 0 && vBuffer.size() == 1)
-        {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            map<string, int>::const_iterator it = context->mCommandTimeout.find(sCmd);
+
+            if (it == context->mCommandTimeout.end())
+            {
+                return iDeadline;
+            }
+
+            iTimeout = it->second;
         }
 
-        return iRet;
+        int64_t iCommand = TC_Common::now2us() + iTimeout * 1000LL;
+
+        return (iDeadline == 0 || iCommand < iDeadline) ? iCommand : iDeadline;
     }
 
     /**
-    * @brief zscore
-    *  
-    * @param sKey        
-    * @param sField
-    * @param sValue        
-    * @return 0 成功 -1 失败
-    * 返回有序集 key中，成员 member的score值。如果member元素不是有序集key的成员，或key不存在，返回 nil。
+    * @brief 并发限制及熔断, 没有任何proxy开启时不查询
     */
-    int zscore(const string& sKey, const string sField, string& sValue)
+    RedisLimiterPtr getLimiter()
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("ZSCORE");
-        vPart.push_back(sKey);
-        vPart.push_back(sField);
+        if (!RedisLimiter::used().load(std::memory_order_relaxed))
+        {
+            return RedisLimiterPtr();
+        }
 
-        buildCommand(vPart, sCommand);
+        RedisProxyContextPtr context = getContext();
 
-        vector<pair<int, string> > vBuffer;
+        std::lock_guard<std::mutex> lock(context->mutex);
 
-        iRet = doCommand(sCommand, vBuffer);
+        return context->limiter;
+    }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+    /**
+    * @brief 热点key的本地缓存, 没有任何proxy开启时不查询
+    */
+    RedisHotCachePtr getHotCache()
+    {
+        if (!TC_Redis_HotKey_Holder::getInstance()->isCacheUsed())
         {
-            sValue = vBuffer[0].second;
+            return RedisHotCachePtr();
         }
 
-        return iRet;
+        RedisProxyContextPtr context = getContext();
+
+        std::lock_guard<std::mutex> lock(context->mutex);
+
+        return context->hotCache;
     }
 
     /**
-    * @brief sadd
-    *  
-    * @param sKey        
-    * @param vField
-    * @return 被添加到集合中的新元素的数量，不包括被忽略的元素
-    * 将一个或多个member元素加入到集合key当中，已经存在于集合的member元素将被忽略。假如key不存在，则创建一个只包含member元素作成员的集合。当key不是集合类型时，返回一个错误。
+    * @brief 从编码后的命令中取出命令名及key, 指向sCommand内部.
+    *        一般是第一个参数; 第一个参数不是key的命令按kKeyPos表处理(没有key或key在子命令之后)
+    *
+    * @return 是否有key
     */
-    int sadd(const string& sKey, const vector<string>& vField)
+    static bool getCommandKey(const string& sCommand, const char*& pCmd, int64_t& iCmdLen, const char*& pKey, int64_t& iKeyLen)
     {
-        int iRet = -1;
-        string sCommand;
+        //key所在的参数位置(命令名之后从1开始), 0 没有key
+        struct KeyPos
+        {
+            const char *pCmd;
+            int         iPos;
+        };
 
-        vector<string> vPart;
+        static const KeyPos kKeyPos[] =
+        {
+            { "SCAN",       0 }, { "KEYS",     0 }, { "RANDOMKEY", 0 }, { "DBSIZE",   0 },
+            { "EVAL",       0 }, { "EVALSHA",  0 }, { "EVAL_RO",   0 }, { "EVALSHA_RO", 0 },
+            { "FCALL",      0 }, { "FCALL_RO", 0 }, { "SCRIPT",    0 }, { "FUNCTION", 0 },
+            { "PUBLISH",    0 }, { "SPUBLISH", 0 }, { "SUBSCRIBE", 0 }, { "PSUBSCRIBE", 0 },
+            { "UNSUBSCRIBE", 0 }, { "PUNSUBSCRIBE", 0 }, { "PUBSUB", 0 },
+            { "XREAD",      0 }, { "XREADGROUP", 0 }, { "INFO",    0 }, { "CONFIG",   0 },
+            { "CLIENT",     0 }, { "CLUSTER",  0 }, { "COMMAND",   0 }, { "SLOWLOG",  0 },
+            { "LATENCY",    0 }, { "ACL",      0 }, { "MODULE",    0 }, { "DEBUG",    0 },
+            { "AUTH",       0 }, { "HELLO",    0 }, { "SELECT",    0 }, { "SWAPDB",   0 },
+            { "PING",       0 }, { "ECHO",     0 }, { "WAIT",      0 }, { "FLUSHDB",  0 },
+            { "FLUSHALL",   0 }, { "TIME",     0 },
+            { "XGROUP",     2 }, { "XINFO",    2 }, { "OBJECT",    2 }, { "MEMORY",   2 },
+            { "BITOP",      2 },
+        };
+
+        size_t iPos = sCommand.find('\n');
+
+        if (iPos == string::npos)
+        {
+            return false;
+        }
 
-        vPart.push_back("SADD");
-        vPart.push_back(sKey);
+        ++iPos;
+
+        if (RedisReplyParser::readElement(sCommand.data(), sCommand.size(), iPos, pCmd, iCmdLen) != '$')
+        {
+            return false;
+        }
+
+        int iKeyPos = 1;
+
+        for (size_t i = 0; i < sizeof(kKeyPos) / sizeof(kKeyPos[0]); i++)
+        {
+            if ((size_t)iCmdLen == strlen(kKeyPos[i].pCmd) && TC_Port::strncasecmp(pCmd, kKeyPos[i].pCmd, iCmdLen) == 0)
+            {
+                iKeyPos = kKeyPos[i].iPos;
+                break;
+            }
+        }
 
-        for (size_t i = 0; i < vField.size(); ++i)
+        for (int i = 0; i < iKeyPos; i++)
         {
-            vPart.push_back(vField[i]);
+            if (RedisReplyParser::readElement(sCommand.data(), sCommand.size(), iPos, pKey, iKeyLen) != '$')
+            {
+                return false;
+            }
         }
 
-        buildCommand(vPart, sCommand);
-
-        vector<pair<int, string> > vBuffer;
+        return iKeyPos > 0;
+    }
 
-        iRet = doCommand(sCommand, vBuffer);
+    /**
+    * @brief 按命令名记录延时到本线程的直方图
+    */
+    void recordLatency(const string& sCommand, int64_t iCost)
+    {
+        TC_Redis_Stat_Holder *holder = TC_Redis_Stat_Holder::getInstance();
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (!holder->isEnable())
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            return;
         }
 
-        return iRet;
+        char buf[32];
+        size_t iLen = getCommandName(sCommand, buf, sizeof(buf));
+
+        holder->record(this, [this]{ return tars_name(); }, buf, iLen, iCost > 0 ? iCost : 0);
     }
 
     /**
-    * @brief srem
-    *  
-    * @param sKey        
-    * @param vField
-    * @return 被成功移除的元素的数量，不包括被忽略的元素。
-    * 移除集合 key 中的一个或多个 member 元素，不存在的 member 元素会被忽略。
+    * @brief 从编码后的命令中取出命令名(大写), 写入buf
+    *
+    * @return 命令名长度
     */
-	int srem(const string& sKey, const vector<string>& vField)
+    static size_t getCommandName(const string& sCommand, char* buf, size_t iSize)
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
+        size_t iPos   = sCommand.find('\n');
+        const char *p = NULL;
+        int64_t iLen  = 0;
 
-        vPart.push_back("SREM");
-        vPart.push_back(sKey);
-
-        for (size_t i = 0; i < vField.size(); ++i)
+        if (iPos == string::npos || RedisReplyParser::readElement(sCommand.data(), sCommand.size(), ++iPos, p, iLen) != '$')
         {
-            vPart.push_back(vField[i]);
+            memcpy(buf, "UNKNOWN", 7);
+            return 7;
         }
 
-        buildCommand(vPart, sCommand);
-
-        vector<pair<int, string> > vBuffer;
-
-        iRet = doCommand(sCommand, vBuffer);
+        size_t n = std::min((size_t)iLen, iSize);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        for (size_t i = 0; i < n; i++)
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            buf[i] = toupper((unsigned char)p[i]);
         }
 
-        return iRet;
+        return n;
     }
 
     /**
-    * @brief srem
-    *  
-    * @param sKey        
-    * @param vField
-    * @return 0 成功 -1 失败
-    * 移除并返回集合中的一个随机元素。 如果只想获取一个随机元素，但不想该元素从集合中被移除的话，可以使用 SRANDMEMBER 命令。
+    * @brief 当前的压缩配置, 没有任何proxy开启压缩时不查询
     */
-    int spop(const string& sKey, string& sValue)
+    RedisCompressConf getCompressConf()
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
+        RedisCompressConf conf;
 
-        vPart.push_back("SPOP");
-        vPart.push_back(sKey);
+        if (TC_Redis_Codec_Holder::getInstance()->isUsed())
+        {
+            RedisProxyContextPtr context = getContext();
 
-        buildCommand(vPart, sCommand);
+            std::lock_guard<std::mutex> lock(context->mutex);
 
-        vector<pair<int, string> > vBuffer;
+            conf = context->compress;
+        }
 
-        iRet = doCommand(sCommand, vBuffer);
+        return conf;
+    }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+    /**
+    * @brief 按配置压缩value
+    *
+    * @return 实际写入的value: sValue或者编码到sPacked中的结果
+    */
+    static const string& packValue(const RedisCompressConf& conf, const string& sValue, string& sPacked)
+    {
+        if (conf.codec || conf.bDecompress)
         {
-            sValue = vBuffer[0].second;
+            if (TC_Redis_Codec_Holder::pack(conf.codec, conf.iThreshold, sValue.data(), sValue.size(), sPacked))
+            {
+                return sPacked;
+            }
         }
 
-        return iRet;
+        return sValue;
     }
 
     /**
-    * @brief srem
-    *  
-    * @param sKey        
-    * @param iMemberNum 返回集合中元素个数
+    * @brief 按配置识别并解压[p, p + iLen), 解压结果放在sOut中, 并让p, iLen指向它
+    *
     * @return 0 成功 -1 失败
     */
-    int scard(const string& sKey, int& iMemberNum)
+    static int unpackValue(const RedisCompressConf& conf, const char*& p, int64_t& iLen, string& sOut)
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("SCARD");
-        vPart.push_back(sKey);
-
-        buildCommand(vPart, sCommand);
-
-        vector<pair<int, string> > vBuffer;
+        if (!conf.bDecompress)
+        {
+            return 0;
+        }
 
-        iRet = doCommand(sCommand, vBuffer);
+        int iRet = TC_Redis_Codec_Holder::getInstance()->unpack(p, iLen, sOut);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (iRet > 0)
         {
-            iMemberNum = TC_Common::strto<int>(vBuffer[0].second);
+            p    = sOut.data();
+            iLen = sOut.size();
+        }
+        else if (iRet < 0)
+        {
+            LOG_CONSOLE_DEBUG << "uncompress value error" << endl;
+            return -1;
         }
 
-        return iRet;
+        return 0;
     }
 
     /**
-    * @brief sdiff
-    *  
-    * @param sKey        
-    * @param vKey
-    * @param vValue
+    * @brief 按配置原地解压sValue
+    *
     * @return 0 成功 -1 失败
     */
-    int sdiff(const string& sKey, const vector<string>& vKey, vector<string>& vValue)
+    static int unpackValue(const RedisCompressConf& conf, string& sValue)
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("SDIFF");
-        vPart.push_back(sKey);
-
-        std::copy(vKey.begin(), vKey.end(), back_inserter(vPart));
+        if (!conf.bDecompress || !TC_Redis_Codec_Holder::hasHead(sValue.data(), sValue.size()))
+        {
+            return 0;
+        }
 
-        buildCommand(vPart, sCommand);
+        const char *p = sValue.data();
+        int64_t iLen  = sValue.size();
 
-        vector<pair<int, string> > vBuffer;
+        string &sOut = getUnpackBuffer();
 
-        iRet = doCommand(sCommand, vBuffer);
+        int iRet = TC_Redis_Codec_Holder::getInstance()->unpack(p, iLen, sOut);
 
-        if (iRet == 0)
+        if (iRet > 0)
         {
-            for (size_t i = 0; i < vBuffer.size(); ++i)
-            {
-                vValue.push_back(vBuffer[i].second);
-            }
+            sValue.swap(sOut);
+        }
+        else if (iRet == 0)
+        {
+            sValue.erase(0, p - sValue.data());
+        }
+        else
+        {
+            LOG_CONSOLE_DEBUG << "uncompress value error" << endl;
+            return -1;
         }
 
-        return iRet;
+        return 0;
     }
 
     /**
-    * @brief smembers
-    *  
-    * @param sKey        
-    * @param vValue
-    * @return 返回成员个数
-    * 返回集合key中的所有成员。不存在的key被视为空集合。
+    * @brief 线程私有的解压缓冲
     */
-    int smembers(const string& sKey, vector<string>& vValue)
+    static string& getUnpackBuffer()
     {
-        int iRet = -1;
-        string sCommand;
+        static thread_local string sBuffer;
 
-        vector<string> vPart;
+        return sBuffer;
+    }
 
-        vPart.push_back("SMEMBERS");
-        vPart.push_back(sKey);
+    /**
+    * @brief 按配置压缩value后追加到命令
+    */
+    static void appendValue(const RedisCompressConf& conf, string& sCommand, const char* pValue, size_t iLen, string& sPacked)
+    {
+        if ((conf.codec || conf.bDecompress) && TC_Redis_Codec_Holder::pack(conf.codec, conf.iThreshold, pValue, iLen, sPacked))
+        {
+            appendCommandArg(sCommand, sPacked);
+        }
+        else
+        {
+            appendCommandArg(sCommand, pValue, iLen);
+        }
+    }
 
-        buildCommand(vPart, sCommand);
+    /**
+    * @brief 执行应答为状态(+OK)的命令, sCommand交换进请求
+    *
+    * @return 0 成功 -1 失败
+    */
+    int doStatusCommand(string& sCommand)
+    {
+        shared_ptr<TC_CustomProtoRsp> rsp = doSwapCommand(sCommand);
 
-        vector<pair<int, string> > vBuffer;
+        const string &sBuffer = rsp->getBuffer();
+        size_t iPos   = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
 
-        iRet = doCommand(sCommand, vBuffer);
+        char c = RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen);
 
-        if (iRet == 0)
+        if (c == '+')
         {
-            for (size_t i = 0; i < vBuffer.size(); ++i)
-            {
-                vValue.push_back(vBuffer[i].second);
-            }
+            return 0;
+        }
 
-            iRet = vBuffer.size();
+        if (c == '-')
+        {
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << string(p, iLen) << endl;
         }
 
-        return iRet;
+        return -1;
     }
 
     /**
-    * @brief sismember
-    *  
-    * @param sKey        
-    * @param sMember
-    * @return 如果 member 元素是集合的成员，返回 1 。 如果 member 元素不是集合的成员，或 key 不存在，返回 0 。
+    * @brief 执行应答为整数的命令, sCommand交换进请求
+    *
+    * @return 应答的整数, -1 失败
     */
-    int sismember(const string& sKey, const string& sMember)
+    int doIntegerCommand(string& sCommand)
     {
-        int iRet = -1;
-        string sCommand;
-
-        vector<string> vPart;
-
-        vPart.push_back("SISMEMBER");
-        vPart.push_back(sKey);
-        vPart.push_back(sMember);
+        shared_ptr<TC_CustomProtoRsp> rsp = doSwapCommand(sCommand);
 
-        buildCommand(vPart, sCommand);
+        const string &sBuffer = rsp->getBuffer();
+        size_t iPos   = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
 
-        vector<pair<int, string> > vBuffer;
+        char c = RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen);
 
-        iRet = doCommand(sCommand, vBuffer);
+        if (c == ':')
+        {
+            //内容后紧跟"\r\n", strtoll在此停止
+            return strtoll(p, NULL, 10);
+        }
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (c == '-')
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << string(p, iLen) << endl;
         }
 
-        return iRet;
+        return -1;
     }
 
     /**
-    * @brief zrange
-    *  
-    * @param sKey        
-    * @param iStart
-    * @param iStop
-    * @param bWithScores
-    * @param vValue
-    * @return 
-    * 返回有序集 key中，指定区间内的成员。下标参数 start和 stop都以0为底，也就是说，以 0表示有序集第一个成员，以 1表示有序集第二个成员，以此类推。你也可以使用负数下标，以 -1 表示最后一个成员， -2 表示倒数第二个成员，以此类推。
-    * 可以通过使用 WITHSCORES 选项，来让成员和它的 score 值一并返回，返回列表以 value1,score1, ..., valueN,scoreN 的格式表示。
+    * @brief 执行 <sCmd> <sKey> <arg>... 形式且应答为整数的命令, 参数直接从区间编码
     */
-    int zrange(const string& sKey, int iStart, int iStop, bool bWithScores, vector<pair<string, float> >& vValue)
+    template<typename Iterator>
+    int doRangeCommand(const char* sCmd, const string& sKey, Iterator begin, Iterator end)
     {
-        int iRet = -1;
         string sCommand;
 
-        vector<string> vPart;
-
-        vPart.push_back("ZRANGE");
-        vPart.push_back(sKey);
-        vPart.push_back(TC_Common::tostr(iStart));
-        vPart.push_back(TC_Common::tostr(iStop));
+        appendCommandHeader(sCommand, 2 + std::distance(begin, end));
+        appendCommandArg(sCommand, sCmd, strlen(sCmd));
+        appendCommandArg(sCommand, sKey);
 
-        if (bWithScores)
+        for (; begin != end; ++begin)
         {
-            vPart.push_back("WITHSCORES");
+            appendCommandArg(sCommand, argData(*begin), argSize(*begin));
         }
 
-        buildCommand(vPart, sCommand);
+        return doIntegerCommand(sCommand);
+    }
 
-        vector<pair<int, string> > vBuffer;
+    /**
+    * @brief 执行命令, sCommand交换进请求不做拷贝, 调用后sCommand为空
+    */
+    shared_ptr<TC_CustomProtoRsp> doSwapCommand(string& sCommand)
+    {
+        shared_ptr<RedisReq> req = RedisObjectPool<RedisReq>::get();
+        req->swapBuffer(sCommand);
 
-        iRet = doCommand(sCommand, vBuffer);
+        return invoke(req);
+    }
 
-        if (iRet == 0)
+    /**
+    * @brief 线程私有的序列化缓冲, 每次取用前清空, 内存复用
+    */
+    static TarsOutputStream<BufferWriterString>& getStructWriter()
+    {
+        static thread_local TarsOutputStream<BufferWriterString> os;
+
+        os.reset();
+
+        return os;
+    }
+
+    /**
+    * @brief 从[p, p + iLen)反序列化tars结构体
+    */
+    template<typename T>
+    static bool readStruct(const char* p, int64_t iLen, T& t)
+    {
+        try
         {
-            if (bWithScores)
-            {
-                for (size_t i = 0; i < vBuffer.size(); i += 2)
-                {
-                    vValue.push_back(make_pair(vBuffer[i].second, TC_Common::strto<float>(vBuffer[i+1].second)));
-                }
-            }
-            else
-            {
-                for (size_t i = 0; i < vBuffer.size(); ++i)
-                {
-                    vValue.push_back(make_pair(vBuffer[i].second, 0));
-                }
-            }
+            TarsInputStream<BufferReader> is;
+            is.setBuffer(p, iLen);
+
+            t.readFrom(is);
+        }
+        catch (exception& ex)
+        {
+            LOG_CONSOLE_DEBUG << "readFrom exception:" << ex.what() << endl;
+            return false;
         }
 
-        return iRet;
+        return true;
     }
 
     /**
-    * @brief lpush
-    *  
-    * @param sKey        
-    * @param vValue
-    * @return 0 成功 -1 失败
+    * @brief 执行应答为数组(RESP3的set/map按展开的元素)的命令, 元素不做拷贝, 逐个回调
+    *        func(0, NULL, 元素个数), 然后func(i, 内容, 长度)(i从1开始, nil长度为-1)
+    *
+    * @return 元素个数, -1 失败或者包含嵌套元素
     */
-    int lpush(const string& sKey, const vector<string>& vValue)
+    template<typename F>
+    int doArrayCommand(const string& sCommand, F func)
     {
-        int iRet = -1;
-        string sCommand;
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(sCommand);
 
-        vector<string> vPart;
+        const string &sBuffer = rsp->getBuffer();
+        size_t iPos   = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
 
-        vPart.push_back("LPUSH");
-        vPart.push_back(sKey);
+        char c = RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen);
+
+        if (c == '-' || c == '!')
+        {
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << string(p, iLen) << endl;
+            return -1;
+        }
+
+        if (c != '*' && c != '~' && c != '%')
+        {
+            return -1;
+        }
+
+        int64_t iCount = iLen <= 0 ? 0 : (c == '%' ? iLen * 2 : iLen);
+
+        func(0, (const char *)NULL, iCount);
 
-        for (size_t i = 0; i < vValue.size(); ++i)
+        for (int64_t i = 1; i <= iCount; i++)
         {
-            vPart.push_back(vValue[i]);
+            c = RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen);
+
+            if (c == 0 || c == '*' || c == '~' || c == '%' || c == '>')
+            {
+                return -1;
+            }
+
+            func(i, p, c == '_' ? -1 : iLen);
         }
 
-        buildCommand(vPart, sCommand);
+        return iCount;
+    }
 
-        vector<pair<int, string> > vBuffer;
+    /**
+    * @brief 编码MGET命令
+    */
+    static string buildMget(const vector<string>& vKey)
+    {
+        string sCommand;
+        sCommand.reserve(32 + vKey.size() * 32);
 
-        iRet = doCommand(sCommand, vBuffer);
+        appendCommandHeader(sCommand, 1 + vKey.size());
+        appendCommandArg(sCommand, "MGET", 4);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        for (size_t i = 0; i < vKey.size(); i++)
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+            appendCommandArg(sCommand, vKey[i]);
         }
 
-        return iRet;
+        return sCommand;
     }
 
     /**
-    * @brief rpush
-    *  
-    * @param sKey        
-    * @param vValue
-    * @return 0 成功 -1 失败
+    * @brief 执行 <sCmd> <sKey> 形式且应答为数组的命令, 结果解析到arena
+    *
+    * @return 元素个数, -1 失败
     */
-    int rpush(const string& sKey, const vector<string>& vValue)
+    int doArenaCommand(const char* sCmd, const string& sKey, RedisArenaReply& reply)
     {
-        int iRet = -1;
         string sCommand;
+        sCommand.reserve(32 + sKey.size());
 
-        vector<string> vPart;
+        appendCommandHeader(sCommand, 2);
+        appendCommandArg(sCommand, sCmd, strlen(sCmd));
+        appendCommandArg(sCommand, sKey);
 
-        vPart.push_back("RPUSH");
-        vPart.push_back(sKey);
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(sCommand);
+
+        const string &sBuffer = rsp->getBuffer();
 
-        for (size_t i = 0; i < vValue.size(); ++i)
+        if (reply.assign(sBuffer.data(), sBuffer.size()) != 0)
         {
-            vPart.push_back(vValue[i]);
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << reply.getError() << endl;
+            return -1;
         }
 
-        buildCommand(vPart, sCommand);
+        return reply.size();
+    }
 
-        vector<pair<int, string> > vBuffer;
+    /**
+    * @brief 执行应答为单个bulk的命令, p指向应答缓冲中的数据, 不做拷贝; rsp持有应答缓冲, 使用p期间不能释放
+    *
+    * @return 0 成功 1 nil -1 失败
+    */
+    int doBulkCommand(const string& sCommand, shared_ptr<TC_CustomProtoRsp>& rsp, const char*& p, int64_t& iLen)
+    {
+        rsp = doRawCommand(sCommand);
 
-        iRet = doCommand(sCommand, vBuffer);
+        const string &sBuffer = rsp->getBuffer();
+        size_t iPos = 0;
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        char f = RedisReplyParser::readElement(sBuffer.data(), sBuffer.size(), iPos, p, iLen);
+
+        switch (f)
         {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
+        case '$':
+        case '+':
+            return iLen < 0 ? 1 : 0;
+        case '_':
+            return 1;
+        case '-':
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << string(p, iLen) << endl;
+            return -1;
+        default:
+            return -1;
         }
-
-        return iRet;
     }
 
     /**
-    * @brief ltrim
-    *  
-    * @param sKey        
-    * @param iStart
-    * @param iStop
-    * @return 0 trim size
-    *  对一个列表进行修剪(trim)，就是说，让列表只保留指定区间内的元素，不在指定区间之内的元素都将被删除。
+    * @brief 执行 <sCmd> <sKey> 形式且应答为单个bulk的命令(GET等)
     */
-    int ltrim(const string& sKey, int iStart, int iStop)
-    {   
-        int iRet = -1;
+    int doKeyBulkCommand(const char* sCmd, const string& sKey, shared_ptr<TC_CustomProtoRsp>& rsp, const char*& p, int64_t& iLen)
+    {
         string sCommand;
+        sCommand.reserve(32 + sKey.size());
 
-        vector<string> vPart;
-
-        vPart.push_back("LTRIM");
-        vPart.push_back(sKey);
-        vPart.push_back(TC_Common::tostr(iStart));
-        vPart.push_back(TC_Common::tostr(iStop));
-
-        buildCommand(vPart, sCommand);
-
-        vector<pair<int, string> > vBuffer;
-
-        iRet = doCommand(sCommand, vBuffer);
-
-        if (iRet == 0 && vBuffer.size() == 1)
-        {
-            iRet = TC_Common::strto<int>(vBuffer[0].second);
-        }
+        appendCommandHeader(sCommand, 2);
+        appendCommandArg(sCommand, sCmd, strlen(sCmd));
+        appendCommandArg(sCommand, sKey);
 
-        return iRet;
+        return doBulkCommand(sCommand, rsp, p, iLen);
     }
 
     /**
-    * @brief lpop
-    *  
-    * @param sKey        
-    * @param sValue
-    * @return 0 成功 -1 失败 
+    * @brief 从 [member, score, member, score...] 或 [member...] 应答中读取结果到vValue,
+    *        vValue中已有的字符串被复用(assign不重新分配), 只在数量不够时扩容
+    *
+    * @return 0 成功 -1 失败
     */
-    int lpop(const string& sKey, string& sValue)
+    static int readScoreMembers(const string& sBuffer, bool bWithScores, vector<pair<string, double> >& vValue)
     {
-        int iRet = -1;
-        string sCommand;
+        const char *data = sBuffer.data();
+        size_t len       = sBuffer.size();
+        size_t iPos      = 0;
+        const char *p    = NULL;
+        int64_t iNum     = 0;
 
-        vector<string> vPart;
+        char f = RedisReplyParser::readElement(data, len, iPos, p, iNum);
 
-        vPart.push_back("LPOP");
-        vPart.push_back(sKey);
+        if (f != '*')
+        {
+            if (f == '-')
+            {
+                LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << string(p, iNum) << endl;
+            }
 
-        buildCommand(vPart, sCommand);
+            return -1;
+        }
 
-        vector<pair<int, string> > vBuffer;
+        size_t iCount = iNum <= 0 ? 0 : (bWithScores ? iNum / 2 : iNum);
 
-        iRet = doCommand(sCommand, vBuffer);
+        vValue.resize(iCount);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        for (size_t i = 0; i < iCount; i++)
         {
-            sValue = vBuffer[0].second;
-        }
+            int64_t iLen = 0;
 
-        return iRet;
-    }
+            if (RedisReplyParser::readElement(data, len, iPos, p, iLen) == 0 || iLen < 0)
+            {
+                vValue.clear();
+                return -1;
+            }
 
-    /**
-    * @brief rpop
-    *  
-    * @param sKey        
-    * @param sValue
-    * @return 0 成功 -1 失败 
-    */
-    int rpop(const string& sKey, string& sValue)
-    {
-        int iRet = -1;
-        string sCommand;
+            vValue[i].first.assign(p, iLen);
+            vValue[i].second = 0;
 
-        vector<string> vPart;
+            if (bWithScores)
+            {
+                if (RedisReplyParser::readElement(data, len, iPos, p, iLen) == 0 || iLen < 0)
+                {
+                    vValue.clear();
+                    return -1;
+                }
 
-        vPart.push_back("RPOP");
-        vPart.push_back(sKey);
+                vValue[i].second = parseScore(p);
+            }
+        }
 
-        buildCommand(vPart, sCommand);
+        return 0;
+    }
 
-        vector<pair<int, string> > vBuffer;
+    int zRangeByScore(const char* sCmd, const string& sKey, double dFrom, double dTo, size_t iOffset, size_t iCount,
+                      vector<pair<string, double> >& vValue)
+    {
+        string sCommand;
+        sCommand.reserve(128 + sKey.size());
 
-        iRet = doCommand(sCommand, vBuffer);
+        appendCommandHeader(sCommand, iCount > 0 ? 8 : 5);
+        appendCommandArg(sCommand, sCmd, strlen(sCmd));
+        appendCommandArg(sCommand, sKey);
+        appendScore(sCommand, dFrom);
+        appendScore(sCommand, dTo);
+        appendCommandArg(sCommand, "WITHSCORES", 10);
 
-        if (iRet == 0 && vBuffer.size() == 1)
+        if (iCount > 0)
         {
-            sValue = vBuffer[0].second;
+            char buf[32];
+
+            appendCommandArg(sCommand, "LIMIT", 5);
+            appendCommandArg(sCommand, buf, snprintf(buf, sizeof(buf), "%zu", iOffset));
+            appendCommandArg(sCommand, buf, snprintf(buf, sizeof(buf), "%zu", iCount));
         }
 
-        return iRet;
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(sCommand);
+
+        return readScoreMembers(rsp->getBuffer(), true, vValue);
     }
-private:
-    void buildCommand(const vector<string>& vPart, string& sCommand)
+
+    int zrange(const char* sCmd, const string& sKey, int iStart, int iStop, bool bWithScores, vector<pair<string, double> >& vValue)
     {
-        stringstream ss;
-        ss << "*" << vPart.size() << "\r\n";
+        char buf[32];
+        string sCommand;
+        sCommand.reserve(96 + sKey.size());
 
-        for (size_t i = 0; i < vPart.size(); i++)
+        appendCommandHeader(sCommand, bWithScores ? 5 : 4);
+        appendCommandArg(sCommand, sCmd, strlen(sCmd));
+        appendCommandArg(sCommand, sKey);
+        appendCommandArg(sCommand, buf, snprintf(buf, sizeof(buf), "%d", iStart));
+        appendCommandArg(sCommand, buf, snprintf(buf, sizeof(buf), "%d", iStop));
+
+        if (bWithScores)
         {
-            ss << "$" << vPart[i].size() << "\r\n" << vPart[i] << "\r\n";
+            appendCommandArg(sCommand, "WITHSCORES", 10);
         }
 
-        sCommand = ss.str();
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(sCommand);
+
+        return readScoreMembers(rsp->getBuffer(), bWithScores, vValue);
     }
 
     int doCommand(const string& sCommand, vector<pair<int, string> >& vBuffer)
     {
         int iRet = -1;
 
-        shared_ptr<TC_CustomProtoReq> req = std::make_shared<RedisReq>();
-        req->sendBuffer(sCommand);
-
-        shared_ptr<TC_CustomProtoRsp> rsp = std::make_shared<RedisRsp>();
-        common_protocol_call("redis", req, rsp);
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(sCommand);
 
-        string sBuffer = rsp->getBuffer();
+        const string &sBuffer = rsp->getBuffer();
         string sSep = "\r\n";
         string sData;
         size_t iPos;
@@ -1922,88 +7889,53 @@ private:
 
             break;
         case '$':
-            iPos = sBuffer.find(sSep);
-
-            if (iPos != string::npos)
-            {
-                int iLen = TC_Common::strto<size_t>(sBuffer.substr(1, iPos));
-
-                string sDataBuffer = sBuffer.substr(iPos + sSep.size());
-
-                if (iLen > 0 && sDataBuffer.size() == (iLen + sSep.size()))
-                {
-                    sData = sDataBuffer.substr(0, sDataBuffer.size() - sSep.size());
-
-                    vBuffer.push_back(make_pair(sData.size(), sData));
-
-                    iRet = 0;
-
-                    return iRet;
-                }
-                else if (iLen == 0)
-                {
-                    vBuffer.push_back(make_pair(0, ""));
-
-                    iRet = 0;
-
-                    return iRet;
-                }
-                else if(iLen == -1)
-                {
-                    vBuffer.push_back(make_pair(-1, ""));
-
-                    iRet = 0;
-
-                    return iRet;
-                }
-            } 
+        case '*':
+            //应答按长度线性解析, 每个元素只拷贝一次(大应答不再反复substr)
+            iRet = doMultiReplay(sBuffer, vBuffer);
 
+            break;
+        default:
             iRet = -1;
-
             break;
-        case '*':
-            iPos = sBuffer.find(sSep);
+        }
 
-            if (iPos != string::npos)
-            {
-                int iLen = TC_Common::strto<size_t>(sBuffer.substr(1, iPos));
+        return iRet;
+    }
 
-                string sDataBuffer = sBuffer.substr(iPos + sSep.size());
+    /**
+    * @brief 执行命令, 应答完整解码(支持嵌套及RESP3)
+    *
+    * @return 0 成功 -1 失败(错误应答的内容保留在reply中)
+    */
+    int doCommand(const string& sCommand, RedisReply& reply)
+    {
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(sCommand);
 
-                iRet = doMultiReplay(sDataBuffer, iLen, vBuffer);
+        const string &sBuffer = rsp->getBuffer();
+        size_t iPos = 0;
 
-                if (iRet == 0)
-                {
-                    return iRet;
-                }
-                else
-                {
-                    break;
-                }
-            }
+        if (RedisReplyParser::decode(sBuffer.data(), sBuffer.size(), iPos, reply) != 0)
+        {
+            return -1;
+        }
 
-            iRet = -1;
+        if (reply.isError())
+        {
+            LOG_CONSOLE_DEBUG << "iRet:-1 sData:" << reply.str << endl;
 
-            break;
-        default:
-            iRet = -1;
-            break;
+            return -1;
         }
 
-        return iRet;
+        return 0;
     }
-   
+
     int doCommand(const string& sCommand)
     {
         int iRet = -1;
 
-        shared_ptr<TC_CustomProtoReq> req = std::make_shared<RedisReq>();
-        req->sendBuffer(sCommand);
-        shared_ptr<TC_CustomProtoRsp> rsp = std::make_shared<RedisRsp>();
-        
-        common_protocol_call("redis", req, rsp);
+        shared_ptr<TC_CustomProtoRsp> rsp = doRawCommand(sCommand);
 
-        string sBuffer = rsp->getBuffer();
+        const string &sBuffer = rsp->getBuffer();
 
         string sRightRet = "+OK\r\n+QUEUED\r\n*1\r\n+OK\r\n";
         
@@ -2023,67 +7955,109 @@ private:
         return iRet;
     }
 
-    int doMultiReplay(const string& sBuffer, const size_t& iSize, vector<pair<int, string> >& vBuffer)
+    /**
+    * 配置
+    */
+    TC_RDConf   _rdConf;
+};
+typedef tars::TC_AutoPtr<RedisProxy> RedisPrx;
+
+inline int RedisConnection::connect()
+{
+    close();
+
+    try
     {
-        int iRet = -1;
-        string sSep = "\r\n";
+        _socket.createSocket();
+        _socket.setblock(false);
 
-        string sBufferStream = sBuffer;
+        if (_socket.connectNoThrow(_rdConf._host, _rdConf._port) < 0 && errno != EINPROGRESS)
+        {
+            close();
+            return -1;
+        }
 
-        while (!sBufferStream.empty())
+        int iRet = wait(POLLOUT, _iTimeout);
+
+        if (iRet == 0 && _counter)
         {
-            size_t iPos = sBufferStream.find(sSep);
+            _counter->onTimeout();
+        }
 
-            if (iPos != string::npos)
-            {
-                int iLen = TC_Common::strto<int>(sBufferStream.substr(1, iPos));
+        if (iRet <= 0)
+        {
+            close();
+            return -1;
+        }
 
-                if (iLen < 0)
-                {
-                    vBuffer.push_back(make_pair(iLen, ""));
+        int iError     = 0;
+        socklen_t iLen = sizeof(iError);
 
-                    sBufferStream = sBufferStream.substr(iPos + sSep.size());
-                }
-                else
-                {
-                    size_t iSubLen = iPos + sSep.size() + iLen + sSep.size();
+        if (getsockopt(_socket.getfd(), SOL_SOCKET, SO_ERROR, (char *)&iError, &iLen) < 0 || iError != 0)
+        {
+            close();
+            return -1;
+        }
 
-                    if (iSubLen > sBufferStream.size())
-                    {
-                        break;
-                    }
-                    
-                    string sDataBuffer = sBufferStream.substr(iPos + sSep.size(), iLen);
+        _socket.setTcpNoDelay();
+        _socket.setKeepAlive();
+    }
+    catch (exception &ex)
+    {
+        LOG_CONSOLE_DEBUG << "connect " << _rdConf._host << ":" << _rdConf._port << " error:" << ex.what() << endl;
+        close();
+        return -1;
+    }
 
-                    vBuffer.push_back(make_pair(sDataBuffer.size(), sDataBuffer));
+    _bConnected = true;
 
-                    sBufferStream = sBufferStream.substr(iSubLen);
-                }
-            }
-            else
+    if (_counter)
+    {
+        _counter->onConnect();
+    }
+
+    vector<string> vPart;
+    string sCommand;
+    RedisReply reply;
+
+    if (!_rdConf._password.empty())
+    {
+        vPart.push_back("AUTH");
+        vPart.push_back(_rdConf._password);
+
+        RedisProxy::buildCommand(vPart, sCommand);
+
+        if (call(sCommand, reply) != 0 || reply.isError())
+        {
+            if (_counter)
             {
-                break;
+                _counter->onAuthFailed();
             }
+
+            LOG_CONSOLE_DEBUG << "auth " << _rdConf._host << ":" << _rdConf._port << " error:" << reply.str << endl;
+            close();
+            return -1;
         }
-        
-        if (vBuffer.size() == iSize)
-        {
-            iRet = 0;
-        }
-        else
+    }
+
+    if (_rdConf._index != 0)
+    {
+        vPart.clear();
+        vPart.push_back("SELECT");
+        vPart.push_back(TC_Common::tostr(_rdConf._index));
+
+        RedisProxy::buildCommand(vPart, sCommand);
+
+        if (call(sCommand, reply) != 0 || reply.isError())
         {
-            vBuffer.clear();
+            LOG_CONSOLE_DEBUG << "select " << _rdConf._index << " error:" << reply.str << endl;
+            close();
+            return -1;
         }
-        
-        return iRet;
     }
 
-    /**
-    * 配置
-    */
-    TC_RDConf   _rdConf;
-};
-typedef tars::TC_AutoPtr<RedisProxy> RedisPrx;
+    return 0;
+}
 
 }
 #endif
@@ -0,0 +1,375 @@
+#ifndef tc_redis_bulkloader_h__
+#define tc_redis_bulkloader_h__
+#include "tc_redis.h"
+#include <deque>
+#include <fstream>
+#include <functional>
+
+namespace tars
+{
+
+/////////////////////////////////////////////////
+/**
+* @file  tc_redis_bulkloader.h
+* @brief redis批量导入, 类似 redis-cli --pipe.
+*
+* 在一条独占的RedisConnection上流水线发送命令: 命令直接编码进发送缓冲, 攒够一批再发送;
+* 在途(已发送未收到应答)的命令数不超过窗口大小, 发送间隙非阻塞地收取应答并计数,
+* 错误应答按key回调给调用方.
+*/
+/////////////////////////////////////////////////
+class RedisBulkLoader
+{
+public:
+    /**
+    * 数据源: 填充下一对key/value, 没有数据时返回false
+    */
+    typedef std::function<bool(string &sKey, string &sValue)> KVGenerator;
+
+    /**
+    * 数据源: 填充下一条命令(vPart[1]作为key用于报错), 没有数据时返回false
+    */
+    typedef std::function<bool(vector<string> &vPart)> CommandGenerator;
+
+    /**
+    * 错误回调: 出错的key及错误信息
+    */
+    typedef std::function<void(const string &sKey, const string &sError)> ErrorFunc;
+
+    RedisBulkLoader()
+        : _iWindow(1000)
+        , _iBatchBytes(64 * 1024)
+        , _iExpire(0)
+        , _iSent(0)
+        , _iSucc(0)
+        , _iFailed(0)
+        , _iCost(0)
+    {
+    }
+
+    /**
+    * @brief 初始化
+    *
+    * @param tcRDConf    redis配置
+    * @param iWindow     在途命令数上限
+    * @param iBatchBytes 攒批发送的字节数
+    * @param iTimeout    网络超时(毫秒), 超过该时间没有任何应答则放弃
+    */
+    void init(const TC_RDConf &tcRDConf, size_t iWindow = 1000, size_t iBatchBytes = 64 * 1024, int iTimeout = 3000)
+    {
+        _conn.init(tcRDConf, iTimeout);
+
+        _iWindow     = iWindow > 0 ? iWindow : 1;
+        _iBatchBytes = iBatchBytes > 0 ? iBatchBytes : 1;
+    }
+
+    /**
+    * @brief key/value导入时的过期时间(秒), 0 不过期
+    */
+    void setExpire(unsigned int iExpire) { _iExpire = iExpire; }
+
+    void setErrorCallback(const ErrorFunc &func) { _errorFunc = func; }
+
+    /**
+    * @brief 从生成器导入key/value(SET/SETEX)
+    *
+    * @return 失败的条数, -1 连接失败或中断
+    */
+    int load(const KVGenerator &gen)
+    {
+        string sValue;
+        char buf[32];
+
+        return run([&](string &sBuffer, string &sKey) -> bool
+        {
+            if (!gen(sKey, sValue))
+            {
+                return false;
+            }
+
+            encodeSet(sBuffer, sKey, sValue, buf);
+
+            return true;
+        });
+    }
+
+    /**
+    * @brief 从迭代器区间导入, 元素需有first(key)/second(value)
+    *
+    * @return 失败的条数, -1 连接失败或中断
+    */
+    template<typename Iterator>
+    int load(Iterator begin, Iterator end)
+    {
+        char buf[32];
+
+        return run([&](string &sBuffer, string &sKey) -> bool
+        {
+            if (begin == end)
+            {
+                return false;
+            }
+
+            sKey.assign(begin->first);
+
+            encodeSet(sBuffer, begin->first, begin->second, buf);
+
+            ++begin;
+
+            return true;
+        });
+    }
+
+    /**
+    * @brief 从文件导入, 每行一条: key<cSep>value
+    *
+    * @return 失败的条数, -1 文件打开失败, 连接失败或中断
+    */
+    int loadFile(const string &sFile, char cSep = '\t')
+    {
+        std::ifstream ifs(sFile.c_str());
+
+        if (!ifs)
+        {
+            LOG_CONSOLE_DEBUG << "open file error:" << sFile << endl;
+            return -1;
+        }
+
+        string sLine;
+
+        return load([&](string &sKey, string &sValue) -> bool
+        {
+            while (std::getline(ifs, sLine))
+            {
+                string::size_type iPos = sLine.find(cSep);
+
+                if (iPos == string::npos)
+                {
+                    continue;
+                }
+
+                sKey.assign(sLine, 0, iPos);
+                sValue.assign(sLine, iPos + 1, string::npos);
+
+                return true;
+            }
+
+            return false;
+        });
+    }
+
+    /**
+    * @brief 从生成器导入任意命令
+    *
+    * @return 失败的条数, -1 连接失败或中断
+    */
+    int loadCommand(const CommandGenerator &gen)
+    {
+        vector<string> vPart;
+
+        return run([&](string &sBuffer, string &sKey) -> bool
+        {
+            vPart.clear();
+
+            if (!gen(vPart) || vPart.empty())
+            {
+                return false;
+            }
+
+            sKey = vPart.size() > 1 ? vPart[1] : vPart[0];
+
+            RedisProxy::appendCommandHeader(sBuffer, vPart.size());
+
+            for (size_t i = 0; i < vPart.size(); i++)
+            {
+                RedisProxy::appendCommandArg(sBuffer, vPart[i]);
+            }
+
+            return true;
+        });
+    }
+
+    /**
+    * @brief 上次导入发送的命令数
+    */
+    size_t getSent() const { return _iSent; }
+
+    /**
+    * @brief 上次导入成功的命令数
+    */
+    size_t getSucc() const { return _iSucc; }
+
+    /**
+    * @brief 上次导入失败的命令数
+    */
+    size_t getFailed() const { return _iFailed; }
+
+    /**
+    * @brief 上次导入耗时(毫秒)
+    */
+    int64_t getCost() const { return _iCost; }
+
+protected:
+    typedef std::function<bool(string &sBuffer, string &sKey)> EncodeFunc;
+
+    void encodeSet(string &sBuffer, const string &sKey, const string &sValue, char *buf)
+    {
+        if (_iExpire == 0)
+        {
+            RedisProxy::appendCommandHeader(sBuffer, 3);
+            RedisProxy::appendCommandArg(sBuffer, "SET", 3);
+            RedisProxy::appendCommandArg(sBuffer, sKey);
+        }
+        else
+        {
+            RedisProxy::appendCommandHeader(sBuffer, 4);
+            RedisProxy::appendCommandArg(sBuffer, "SETEX", 5);
+            RedisProxy::appendCommandArg(sBuffer, sKey);
+            RedisProxy::appendCommandArg(sBuffer, buf, snprintf(buf, 32, "%u", _iExpire));
+        }
+
+        RedisProxy::appendCommandArg(sBuffer, sValue);
+    }
+
+    /**
+    * @brief 发送/收取主循环
+    */
+    int run(const EncodeFunc &encode)
+    {
+        _iSent   = 0;
+        _iSucc   = 0;
+        _iFailed = 0;
+
+        int64_t iBegin = TC_Common::now2ms();
+
+        if (_conn.connect() != 0)
+        {
+            return -1;
+        }
+
+        //在途命令的key, 按发送顺序与应答一一对应
+        std::deque<string> qKey;
+
+        string sBuffer;
+        sBuffer.reserve(_iBatchBytes * 2);
+
+        string sKey;
+        bool bEnd = false;
+        int iRet  = 0;
+
+        while (!bEnd || !qKey.empty())
+        {
+            //窗口未满时编码并发送一批
+            if (!bEnd && qKey.size() < _iWindow)
+            {
+                size_t iBatch = 0;
+
+                sBuffer.clear();
+
+                while (qKey.size() < _iWindow && sBuffer.size() < _iBatchBytes)
+                {
+                    if (!encode(sBuffer, sKey))
+                    {
+                        bEnd = true;
+                        break;
+                    }
+
+                    qKey.push_back(string());
+                    qKey.back().swap(sKey);
+
+                    ++iBatch;
+                }
+
+                if (iBatch > 0)
+                {
+                    if (_conn.send(sBuffer.data(), sBuffer.size(), iBatch) != 0)
+                    {
+                        iRet = -1;
+                        break;
+                    }
+
+                    _iSent += iBatch;
+                }
+            }
+
+            if (qKey.empty())
+            {
+                continue;
+            }
+
+            //还能继续发送时只收取已到达的应答, 否则等待应答
+            bool bWait = bEnd || qKey.size() >= _iWindow;
+
+            int iRecv = _conn.recv(bWait ? _conn.getTimeout() : 0);
+
+            if (iRecv < 0 || (iRecv == 0 && bWait))
+            {
+                LOG_CONSOLE_DEBUG << "bulk load " << (iRecv < 0 ? "connection closed" : "timeout") << ", in flight:" << qKey.size() << endl;
+                iRet = -1;
+                break;
+            }
+
+            RedisReply reply;
+
+            while (!qKey.empty() && _conn.nextReply(reply) > 0)
+            {
+                if (reply.isError())
+                {
+                    ++_iFailed;
+
+                    if (_errorFunc)
+                    {
+                        _errorFunc(qKey.front(), reply.str);
+                    }
+                }
+                else
+                {
+                    ++_iSucc;
+                }
+
+                qKey.pop_front();
+            }
+        }
+
+        //中断时在途的命令结果未知, 按失败上报
+        while (!qKey.empty())
+        {
+            ++_iFailed;
+
+            if (_errorFunc)
+            {
+                _errorFunc(qKey.front(), "no reply");
+            }
+
+            qKey.pop_front();
+        }
+
+        _conn.close();
+
+        _iCost = TC_Common::now2ms() - iBegin;
+
+        return iRet < 0 ? iRet : (int)_iFailed;
+    }
+
+protected:
+    RedisConnection _conn;
+
+    size_t          _iWindow;
+
+    size_t          _iBatchBytes;
+
+    unsigned int    _iExpire;
+
+    ErrorFunc       _errorFunc;
+
+    size_t          _iSent;
+
+    size_t          _iSucc;
+
+    size_t          _iFailed;
+
+    int64_t         _iCost;
+};
+
+}
+#endif
@@ -0,0 +1,515 @@
+#ifndef tc_redis_codec_h__
+#define tc_redis_codec_h__
+#include "util/tc_common.h"
+#include "util/tc_gzip.h"
+#include "util/tc_thread_rwlock.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <new>
+#include <string.h>
+
+#ifdef TARS_REDIS_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef TARS_REDIS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace tars
+{
+
+/////////////////////////////////////////////////
+/**
+* @file  tc_redis_codec.h
+* @brief redis value压缩编解码.
+*
+* 压缩后的value带8字节头: 0xF5 'R' 'Z' <codec id> <原始长度, 4字节小端>, 读取时据此识别并解压.
+* codec id为0表示未压缩的原始数据, 用于转义恰好以该头开始的原始value.
+* 未经转义写入的此类value(如其他客户端写入), 头部的codec id未注册, 长度不符或解压失败时按原始数据读取.
+* 内置gzip(TC_GZip), lz4/zstd需定义TARS_REDIS_LZ4/TARS_REDIS_ZSTD并链接对应的库.
+* 压缩和解压都在调用线程执行, 网络线程只收发字节.
+*/
+/////////////////////////////////////////////////
+
+/**
+* @brief 单个codec的统计
+*/
+struct RedisCodecStat
+{
+    string   sName;
+
+    /**
+    * 压缩次数
+    */
+    uint64_t iCompress;
+
+    /**
+    * 压缩后没有变小而按原始数据保存的次数
+    */
+    uint64_t iSkip;
+
+    /**
+    * 压缩前/后的总字节数, 比值即压缩率
+    */
+    uint64_t iRawBytes;
+    uint64_t iCompressedBytes;
+
+    /**
+    * 压缩耗时(微秒)
+    */
+    uint64_t iCompressUs;
+
+    /**
+    * 解压次数及耗时(微秒)
+    */
+    uint64_t iUncompress;
+    uint64_t iUncompressUs;
+
+    /**
+    * 解压失败次数
+    */
+    uint64_t iError;
+};
+
+/**
+* @brief codec基类, 实现compress/uncompress并通过TC_Redis_Codec_Holder注册即可扩展
+*/
+class RedisCodec
+{
+public:
+    /**
+    * @param iId    写入头部的id, 1~255, 0保留给原始数据
+    * @param sName  名字, RedisProxy::setCompress按名字选择
+    */
+    RedisCodec(uint8_t iId, const string &sName)
+        : _iId(iId), _sName(sName)
+        , _iCompress(0), _iSkip(0), _iRawBytes(0), _iCompressedBytes(0)
+        , _iCompressUs(0), _iUncompress(0), _iUncompressUs(0), _iError(0)
+    {
+    }
+
+    virtual ~RedisCodec() {}
+
+    uint8_t getId() const { return _iId; }
+
+    const string &getName() const { return _sName; }
+
+    /**
+    * @brief 压缩[src, src + iLen), 结果追加到sOut之后
+    * @return 成功返回true
+    */
+    virtual bool compress(const char *src, size_t iLen, string &sOut) = 0;
+
+    /**
+    * @brief 解压[src, src + iLen), 结果写入sOut(覆盖)
+    *
+    * @param iRawLen  头部记录的原始长度
+    * @return 成功返回true
+    */
+    virtual bool uncompress(const char *src, size_t iLen, size_t iRawLen, string &sOut) = 0;
+
+    /**
+    * @brief 压缩统计
+    */
+    void addCompress(size_t iRaw, size_t iCompressed, int64_t iUs, bool bSkip)
+    {
+        ++_iCompress;
+        _iRawBytes        += iRaw;
+        _iCompressedBytes += iCompressed;
+        _iCompressUs      += iUs;
+
+        if (bSkip)
+        {
+            ++_iSkip;
+        }
+    }
+
+    /**
+    * @brief 解压统计
+    */
+    void addUncompress(int64_t iUs, bool bSucc)
+    {
+        ++_iUncompress;
+        _iUncompressUs += iUs;
+
+        if (!bSucc)
+        {
+            ++_iError;
+        }
+    }
+
+    RedisCodecStat getStat() const
+    {
+        RedisCodecStat stat;
+
+        stat.sName            = _sName;
+        stat.iCompress        = _iCompress;
+        stat.iSkip            = _iSkip;
+        stat.iRawBytes        = _iRawBytes;
+        stat.iCompressedBytes = _iCompressedBytes;
+        stat.iCompressUs      = _iCompressUs;
+        stat.iUncompress      = _iUncompress;
+        stat.iUncompressUs    = _iUncompressUs;
+        stat.iError           = _iError;
+
+        return stat;
+    }
+
+protected:
+    uint8_t                 _iId;
+
+    string                  _sName;
+
+    std::atomic<uint64_t>   _iCompress;
+
+    std::atomic<uint64_t>   _iSkip;
+
+    std::atomic<uint64_t>   _iRawBytes;
+
+    std::atomic<uint64_t>   _iCompressedBytes;
+
+    std::atomic<uint64_t>   _iCompressUs;
+
+    std::atomic<uint64_t>   _iUncompress;
+
+    std::atomic<uint64_t>   _iUncompressUs;
+
+    std::atomic<uint64_t>   _iError;
+};
+
+typedef shared_ptr<RedisCodec> RedisCodecPtr;
+
+/**
+* @brief gzip(zlib), TC_GZip实现
+*/
+class RedisGZipCodec : public RedisCodec
+{
+public:
+    RedisGZipCodec() : RedisCodec(1, "gzip") {}
+
+    virtual bool compress(const char *src, size_t iLen, string &sOut)
+    {
+        static thread_local string sTmp;
+
+        sTmp.clear();
+
+        if (!TC_GZip::compress(src, iLen, sTmp))
+        {
+            return false;
+        }
+
+        sOut.append(sTmp);
+
+        return true;
+    }
+
+    virtual bool uncompress(const char *src, size_t iLen, size_t iRawLen, string &sOut)
+    {
+        sOut.clear();
+        sOut.reserve(iRawLen);
+
+        return TC_GZip::uncompress(src, iLen, sOut) && sOut.size() == iRawLen;
+    }
+};
+
+#ifdef TARS_REDIS_LZ4
+/**
+* @brief lz4, 压缩结果直接写入sOut
+*/
+class RedisLZ4Codec : public RedisCodec
+{
+public:
+    RedisLZ4Codec() : RedisCodec(2, "lz4") {}
+
+    virtual bool compress(const char *src, size_t iLen, string &sOut)
+    {
+        size_t iPos = sOut.size();
+
+        sOut.resize(iPos + LZ4_compressBound(iLen));
+
+        int n = LZ4_compress_default(src, &sOut[iPos], iLen, sOut.size() - iPos);
+
+        sOut.resize(n > 0 ? iPos + n : iPos);
+
+        return n > 0;
+    }
+
+    virtual bool uncompress(const char *src, size_t iLen, size_t iRawLen, string &sOut)
+    {
+        sOut.resize(iRawLen);
+
+        return LZ4_decompress_safe(src, &sOut[0], iLen, iRawLen) == (int)iRawLen;
+    }
+};
+#endif
+
+#ifdef TARS_REDIS_ZSTD
+/**
+* @brief zstd, 压缩结果直接写入sOut
+*/
+class RedisZstdCodec : public RedisCodec
+{
+public:
+    /**
+    * @param iLevel 压缩级别
+    */
+    RedisZstdCodec(int iLevel = 1) : RedisCodec(3, "zstd"), _iLevel(iLevel) {}
+
+    virtual bool compress(const char *src, size_t iLen, string &sOut)
+    {
+        size_t iPos = sOut.size();
+
+        sOut.resize(iPos + ZSTD_compressBound(iLen));
+
+        size_t n = ZSTD_compress(&sOut[iPos], sOut.size() - iPos, src, iLen, _iLevel);
+
+        if (ZSTD_isError(n))
+        {
+            sOut.resize(iPos);
+            return false;
+        }
+
+        sOut.resize(iPos + n);
+
+        return true;
+    }
+
+    virtual bool uncompress(const char *src, size_t iLen, size_t iRawLen, string &sOut)
+    {
+        sOut.resize(iRawLen);
+
+        return ZSTD_decompress(&sOut[0], iRawLen, src, iLen) == iRawLen;
+    }
+
+protected:
+    int _iLevel;
+};
+#endif
+
+/**
+* @brief 全局codec注册表, 解压时按头部的id查找
+*/
+class TC_Redis_Codec_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_Codec_Holder>
+{
+public:
+    enum
+    {
+        kHeadLen = 8,
+    };
+
+    TC_Redis_Codec_Holder()
+        : _bUsed(false)
+    {
+        registerCodec(std::make_shared<RedisGZipCodec>());
+#ifdef TARS_REDIS_LZ4
+        registerCodec(std::make_shared<RedisLZ4Codec>());
+#endif
+#ifdef TARS_REDIS_ZSTD
+        registerCodec(std::make_shared<RedisZstdCodec>());
+#endif
+    }
+
+    /**
+    * @brief 设置解压后的最大长度, 默认512M(同redis的proto-max-bulk-len).
+    *        超过的value不压缩; 读取时头部记录的原始长度超过该值的按原始数据返回, 避免异常头部导致超大分配
+    */
+    static void setMaxRawLen(size_t iMax)
+    {
+        maxRawLen().store(std::min<size_t>(iMax, 0xFFFFFFFFUL), std::memory_order_relaxed);
+    }
+
+    static std::atomic<size_t> &maxRawLen()
+    {
+        static std::atomic<size_t> iMax(512 * 1024 * 1024UL);
+
+        return iMax;
+    }
+
+    /**
+    * @brief 注册codec, 同id的会被替换
+    */
+    void registerCodec(const RedisCodecPtr &codec)
+    {
+        TC_ThreadWLock w(_rwl);
+
+        _mCodec[codec->getId()] = codec;
+    }
+
+    RedisCodecPtr get(uint8_t iId)
+    {
+        TC_ThreadRLock r(_rwl);
+
+        map<uint8_t, RedisCodecPtr>::iterator it = _mCodec.find(iId);
+
+        return it == _mCodec.end() ? RedisCodecPtr() : it->second;
+    }
+
+    RedisCodecPtr get(const string &sName)
+    {
+        TC_ThreadRLock r(_rwl);
+
+        for (map<uint8_t, RedisCodecPtr>::iterator it = _mCodec.begin(); it != _mCodec.end(); ++it)
+        {
+            if (it->second->getName() == sName)
+            {
+                return it->second;
+            }
+        }
+
+        return RedisCodecPtr();
+    }
+
+    /**
+    * @brief 有proxy开启了压缩或解压, 都未开启时读写不必查询压缩配置
+    */
+    void setUsed() { _bUsed = true; }
+
+    bool isUsed() const { return _bUsed; }
+
+    /**
+    * @brief 所有codec的统计
+    */
+    vector<RedisCodecStat> getStat()
+    {
+        vector<RedisCodecStat> vStat;
+
+        TC_ThreadRLock r(_rwl);
+
+        for (map<uint8_t, RedisCodecPtr>::iterator it = _mCodec.begin(); it != _mCodec.end(); ++it)
+        {
+            vStat.push_back(it->second->getStat());
+        }
+
+        return vStat;
+    }
+
+    /**
+    * @brief [p, p + iLen)是否以压缩头开始
+    */
+    static bool hasHead(const char *p, size_t iLen)
+    {
+        return iLen >= kHeadLen && (uint8_t)p[0] == 0xF5 && p[1] == 'R' && p[2] == 'Z';
+    }
+
+    /**
+    * @brief 在sOut后追加头
+    */
+    static void appendHead(string &sOut, uint8_t iId, size_t iRawLen)
+    {
+        char head[kHeadLen] = { (char)0xF5, 'R', 'Z', (char)iId,
+            (char)(iRawLen & 0xFF), (char)((iRawLen >> 8) & 0xFF), (char)((iRawLen >> 16) & 0xFF), (char)((iRawLen >> 24) & 0xFF) };
+
+        sOut.append(head, kHeadLen);
+    }
+
+    /**
+    * @brief 按codec编码value, codec为空, 小于iThreshold或压缩后没有变小时按原始数据保存
+    *
+    * @param sOut  编码结果(覆盖)
+    * @return 是否编码到了sOut, false表示直接使用原始value即可
+    */
+    static bool pack(const RedisCodecPtr &codec, size_t iThreshold, const char *p, size_t iLen, string &sOut)
+    {
+        if (codec && iLen >= iThreshold && iLen <= maxRawLen().load(std::memory_order_relaxed))
+        {
+            int64_t iBegin = TC_Common::now2us();
+
+            sOut.clear();
+            sOut.reserve(kHeadLen + iLen);
+
+            appendHead(sOut, codec->getId(), iLen);
+
+            bool bSucc = codec->compress(p, iLen, sOut) && sOut.size() < iLen;
+
+            codec->addCompress(iLen, bSucc ? sOut.size() : iLen, TC_Common::now2us() - iBegin, !bSucc);
+
+            if (bSucc)
+            {
+                return true;
+            }
+        }
+
+        //原始value恰好以压缩头开始时需转义, 否则读取时会被误认
+        if (hasHead(p, iLen))
+        {
+            sOut.clear();
+            sOut.reserve(kHeadLen + iLen);
+
+            appendHead(sOut, 0, iLen);
+            sOut.append(p, iLen);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+    * @brief 识别并解码value
+    *
+    *        头部的codec id未注册, 原始长度超过maxRawLen或解压失败时, 视为恰好以压缩头开始的原始数据, 原样返回
+    *        (解压失败计入codec的统计)
+    *
+    * @param p, iLen  输入value; 返回0且是转义的原始数据时, 指向去掉头后的数据
+    * @param sOut     解压结果(覆盖)
+    * @return 1 已解压到sOut, 0 无需解压(使用p, iLen)
+    */
+    int unpack(const char *&p, int64_t &iLen, string &sOut)
+    {
+        if (!hasHead(p, iLen))
+        {
+            return 0;
+        }
+
+        const uint8_t *h = (const uint8_t *)p;
+
+        size_t iRawLen = h[4] | (h[5] << 8) | (h[6] << 16) | ((size_t)h[7] << 24);
+
+        //头部校验不符的是未经转义写入的原始数据, 原样返回
+        if (h[3] == 0)
+        {
+            if ((size_t)iLen - kHeadLen == iRawLen)
+            {
+                p    += kHeadLen;
+                iLen -= kHeadLen;
+            }
+
+            return 0;
+        }
+
+        RedisCodecPtr codec = get(h[3]);
+
+        if (!codec || iRawLen > maxRawLen().load(std::memory_order_relaxed))
+        {
+            return 0;
+        }
+
+        int64_t iBegin = TC_Common::now2us();
+
+        bool bSucc = false;
+
+        try
+        {
+            bSucc = codec->uncompress(p + kHeadLen, iLen - kHeadLen, iRawLen, sOut);
+        }
+        catch (std::bad_alloc &)
+        {
+        }
+
+        codec->addUncompress(TC_Common::now2us() - iBegin, bSucc);
+
+        return bSucc ? 1 : 0;
+    }
+
+protected:
+    TC_ThreadRWLocker           _rwl;
+
+    map<uint8_t, RedisCodecPtr> _mCodec;
+
+    std::atomic<bool>           _bUsed;
+};
+
+}
+#endif
@@ -0,0 +1,1992 @@
+#ifndef tc_redis_mockserver_h__
+#define tc_redis_mockserver_h__
+#include "tc_redis.h"
+#include "util/tc_epoll_server.h"
+#include <deque>
+#include <set>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+
+namespace tars
+{
+
+/////////////////////////////////////////////////
+/**
+* @file  tc_redis_mockserver.h
+* @brief 进程内的RESP模拟服务端, 用于测试和压测客户端, 不依赖真实的redis.
+*
+* 基于TC_EpollServer, 数据(string/hash/set/zset/list)保存在内存中, 只有一个库.
+* 可以注入: 应答延时, 把应答拆成小块分别发送(模拟TCP分片), 按概率返回错误应答或关闭连接.
+* 同一连接的请求在同一个处理线程中顺序处理(队列模式), 延时及分片的应答由调度线程按时发送,
+* 同一连接的应答保持请求的顺序.
+*/
+/////////////////////////////////////////////////
+
+/**
+* @brief 内存中的一个value
+*/
+struct RedisMockValue
+{
+    enum
+    {
+        T_STRING = 0,
+        T_HASH,
+        T_SET,
+        T_ZSET,
+        T_LIST,
+    };
+
+    RedisMockValue() : iType(T_STRING), iExpire(0) {}
+
+    int                     iType;
+
+    string                  sValue;
+
+    map<string, string>     mHash;
+
+    std::set<string>        setValue;
+
+    map<string, double>     mZset;
+
+    std::deque<string>      qList;
+
+    /**
+    * 过期的时间点(毫秒), 0 不过期
+    */
+    int64_t                 iExpire;
+};
+
+/**
+* @brief 内存数据及命令执行, 所有命令在一把锁内执行
+*/
+class RedisMockStore
+{
+public:
+    RedisMockStore()
+    {
+        add("PING", 1, &RedisMockStore::ping);
+        add("ECHO", 2, &RedisMockStore::echo);
+        add("AUTH", 2, &RedisMockStore::auth);
+        add("SELECT", 2, &RedisMockStore::ok);
+        add("DBSIZE", 1, &RedisMockStore::dbsize);
+        add("FLUSHDB", 1, &RedisMockStore::flushdb);
+        add("FLUSHALL", 1, &RedisMockStore::flushdb);
+        add("DEL", 2, &RedisMockStore::del);
+        add("EXISTS", 2, &RedisMockStore::exists);
+        add("TYPE", 2, &RedisMockStore::type);
+        add("EXPIRE", 3, &RedisMockStore::expire);
+        add("PEXPIRE", 3, &RedisMockStore::expire);
+        add("PERSIST", 2, &RedisMockStore::persist);
+        add("TTL", 2, &RedisMockStore::ttl);
+        add("PTTL", 2, &RedisMockStore::ttl);
+
+        add("GET", 2, &RedisMockStore::get);
+        add("SET", 3, &RedisMockStore::set);
+        add("SETEX", 4, &RedisMockStore::setex);
+        add("SETNX", 3, &RedisMockStore::setnx);
+        add("GETSET", 3, &RedisMockStore::getset);
+        add("MGET", 2, &RedisMockStore::mget);
+        add("MSET", 3, &RedisMockStore::mset);
+        add("APPEND", 3, &RedisMockStore::append);
+        add("STRLEN", 2, &RedisMockStore::strlen);
+        add("INCR", 2, &RedisMockStore::incrby);
+        add("DECR", 2, &RedisMockStore::incrby);
+        add("INCRBY", 3, &RedisMockStore::incrby);
+        add("DECRBY", 3, &RedisMockStore::incrby);
+
+        add("HSET", 4, &RedisMockStore::hset);
+        add("HMSET", 4, &RedisMockStore::hset);
+        add("HSETNX", 4, &RedisMockStore::hsetnx);
+        add("HGET", 3, &RedisMockStore::hget);
+        add("HMGET", 3, &RedisMockStore::hmget);
+        add("HGETALL", 2, &RedisMockStore::hgetall);
+        add("HKEYS", 2, &RedisMockStore::hgetall);
+        add("HVALS", 2, &RedisMockStore::hgetall);
+        add("HDEL", 3, &RedisMockStore::hdel);
+        add("HLEN", 2, &RedisMockStore::hlen);
+        add("HEXISTS", 3, &RedisMockStore::hexists);
+        add("HINCRBY", 4, &RedisMockStore::hincrby);
+
+        add("SADD", 3, &RedisMockStore::sadd);
+        add("SREM", 3, &RedisMockStore::srem);
+        add("SMEMBERS", 2, &RedisMockStore::smembers);
+        add("SISMEMBER", 3, &RedisMockStore::sismember);
+        add("SCARD", 2, &RedisMockStore::scard);
+
+        add("ZADD", 4, &RedisMockStore::zadd);
+        add("ZINCRBY", 4, &RedisMockStore::zincrby);
+        add("ZREM", 3, &RedisMockStore::zrem);
+        add("ZSCORE", 3, &RedisMockStore::zscore);
+        add("ZCARD", 2, &RedisMockStore::zcard);
+        add("ZRANGE", 4, &RedisMockStore::zrange);
+        add("ZREVRANGE", 4, &RedisMockStore::zrange);
+        add("ZRANGEBYSCORE", 4, &RedisMockStore::zrangebyscore);
+
+        add("LPUSH", 3, &RedisMockStore::push);
+        add("RPUSH", 3, &RedisMockStore::push);
+        add("LPOP", 2, &RedisMockStore::pop);
+        add("RPOP", 2, &RedisMockStore::pop);
+        add("LLEN", 2, &RedisMockStore::llen);
+        add("LINDEX", 3, &RedisMockStore::lindex);
+        add("LRANGE", 4, &RedisMockStore::lrange);
+        add("LTRIM", 4, &RedisMockStore::ltrim);
+    }
+
+    /**
+    * @brief AUTH校验的密码, 空则任何密码都通过. 只校验AUTH命令本身, 不限制未认证连接
+    */
+    void setPassword(const string &sPassword)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _sPassword = sPassword;
+    }
+
+    /**
+    * @brief 执行一条命令, 应答追加到sOut
+    *
+    * @param vArg  命令及参数, vArg[0]已转为大写
+    */
+    void execute(const vector<string> &vArg, string &sOut)
+    {
+        map<string, Command>::const_iterator it = _mCommand.find(vArg[0]);
+
+        if (it == _mCommand.end())
+        {
+            error(sOut, "ERR unknown command '" + vArg[0] + "'");
+            return;
+        }
+
+        if (vArg.size() < it->second.iArity)
+        {
+            error(sOut, "ERR wrong number of arguments for '" + vArg[0] + "' command");
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        (this->*(it->second.func))(vArg, sOut);
+    }
+
+    /**
+    * @brief 是否支持该命令(大写)
+    */
+    bool hasCommand(const string &sCmd) const
+    {
+        return _mCommand.find(sCmd) != _mCommand.end();
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _mData.size();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _mData.clear();
+    }
+
+public:
+    /**
+    * @brief RESP应答的编码
+    */
+    static void status(string &sOut, const string &s)
+    {
+        sOut += '+';
+        sOut += s;
+        sOut += "\r\n";
+    }
+
+    static void error(string &sOut, const string &s)
+    {
+        sOut += '-';
+        sOut += s;
+        sOut += "\r\n";
+    }
+
+    static void integer(string &sOut, int64_t i)
+    {
+        char buf[32];
+        sOut.append(buf, snprintf(buf, sizeof(buf), ":%lld\r\n", (long long)i));
+    }
+
+    static void bulk(string &sOut, const string &s)
+    {
+        char buf[32];
+        sOut.append(buf, snprintf(buf, sizeof(buf), "$%zu\r\n", s.size()));
+        sOut += s;
+        sOut += "\r\n";
+    }
+
+    static void nil(string &sOut)
+    {
+        sOut += "$-1\r\n";
+    }
+
+    static void array(string &sOut, size_t iCount)
+    {
+        char buf[32];
+        sOut.append(buf, snprintf(buf, sizeof(buf), "*%zu\r\n", iCount));
+    }
+
+    static string score(double d)
+    {
+        char buf[64];
+        return string(buf, snprintf(buf, sizeof(buf), "%.17g", d));
+    }
+
+protected:
+    typedef void (RedisMockStore::*CommandFunc)(const vector<string> &vArg, string &sOut);
+
+    struct Command
+    {
+        size_t      iArity;
+
+        CommandFunc func;
+    };
+
+    void add(const string &sCmd, size_t iArity, CommandFunc func)
+    {
+        Command &cmd = _mCommand[sCmd];
+        cmd.iArity = iArity;
+        cmd.func   = func;
+    }
+
+    static void wrongType(string &sOut)
+    {
+        error(sOut, "WRONGTYPE Operation against a key holding the wrong kind of value");
+    }
+
+    static bool toInt(const string &s, int64_t &i)
+    {
+        char *end = NULL;
+
+        errno = 0;
+        i = strtoll(s.c_str(), &end, 10);
+
+        return !s.empty() && errno == 0 && *end == '\0';
+    }
+
+    static bool toDouble(const string &s, double &d)
+    {
+        string sLower = TC_Common::lower(s);
+
+        if (sLower == "+inf" || sLower == "inf")
+        {
+            d = HUGE_VAL;
+            return true;
+        }
+
+        if (sLower == "-inf")
+        {
+            d = -HUGE_VAL;
+            return true;
+        }
+
+        char *end = NULL;
+        d = strtod(s.c_str(), &end);
+
+        return !s.empty() && *end == '\0';
+    }
+
+    /**
+    * @brief 查找key, 过期的key在这里删除
+    *
+    * @return 0 存在 1 不存在 -1 类型不符(已写入错误应答)
+    */
+    int lookup(const string &sKey, int iType, RedisMockValue *&value, string &sOut)
+    {
+        map<string, RedisMockValue>::iterator it = _mData.find(sKey);
+
+        if (it == _mData.end())
+        {
+            return 1;
+        }
+
+        if (it->second.iExpire != 0 && it->second.iExpire <= TC_Common::now2ms())
+        {
+            _mData.erase(it);
+            return 1;
+        }
+
+        if (iType >= 0 && it->second.iType != iType)
+        {
+            wrongType(sOut);
+            return -1;
+        }
+
+        value = &it->second;
+
+        return 0;
+    }
+
+    /**
+    * @brief 查找key, 不存在时创建
+    *
+    * @return NULL 类型不符(已写入错误应答)
+    */
+    RedisMockValue *create(const string &sKey, int iType, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(sKey, iType, value, sOut);
+
+        if (iRet < 0)
+        {
+            return NULL;
+        }
+
+        if (iRet > 0)
+        {
+            value = &_mData[sKey];
+            value->iType = iType;
+        }
+
+        return value;
+    }
+
+    /**
+    * @brief 集合类型删空后删除key
+    */
+    void eraseEmpty(const string &sKey, const RedisMockValue *value)
+    {
+        if (value->mHash.empty() && value->setValue.empty() && value->mZset.empty() && value->qList.empty() && value->iType != RedisMockValue::T_STRING)
+        {
+            _mData.erase(sKey);
+        }
+    }
+
+    /**
+    * @brief 把[iStart, iStop](可以为负)规范到[0, iSize)
+    *
+    * @return false 区间为空
+    */
+    static bool range(int64_t iSize, int64_t &iStart, int64_t &iStop)
+    {
+        if (iStart < 0) iStart += iSize;
+        if (iStop < 0) iStop += iSize;
+        if (iStart < 0) iStart = 0;
+        if (iStop >= iSize) iStop = iSize - 1;
+
+        return iStart <= iStop && iStart < iSize;
+    }
+
+    void ping(const vector<string> &vArg, string &sOut)
+    {
+        if (vArg.size() > 1)
+        {
+            bulk(sOut, vArg[1]);
+        }
+        else
+        {
+            status(sOut, "PONG");
+        }
+    }
+
+    void echo(const vector<string> &vArg, string &sOut)
+    {
+        bulk(sOut, vArg[1]);
+    }
+
+    void auth(const vector<string> &vArg, string &sOut)
+    {
+        if (!_sPassword.empty() && vArg.back() != _sPassword)
+        {
+            error(sOut, "WRONGPASS invalid username-password pair");
+            return;
+        }
+
+        status(sOut, "OK");
+    }
+
+    void ok(const vector<string> &, string &sOut)
+    {
+        status(sOut, "OK");
+    }
+
+    void dbsize(const vector<string> &, string &sOut)
+    {
+        integer(sOut, _mData.size());
+    }
+
+    void flushdb(const vector<string> &, string &sOut)
+    {
+        _mData.clear();
+        status(sOut, "OK");
+    }
+
+    void del(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iCount = 0;
+
+        for (size_t i = 1; i < vArg.size(); i++)
+        {
+            RedisMockValue *value = NULL;
+
+            if (lookup(vArg[i], -1, value, sOut) == 0)
+            {
+                _mData.erase(vArg[i]);
+                ++iCount;
+            }
+        }
+
+        integer(sOut, iCount);
+    }
+
+    void exists(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iCount = 0;
+
+        for (size_t i = 1; i < vArg.size(); i++)
+        {
+            RedisMockValue *value = NULL;
+
+            if (lookup(vArg[i], -1, value, sOut) == 0)
+            {
+                ++iCount;
+            }
+        }
+
+        integer(sOut, iCount);
+    }
+
+    void type(const vector<string> &vArg, string &sOut)
+    {
+        static const char *sType[] = { "string", "hash", "set", "zset", "list" };
+
+        RedisMockValue *value = NULL;
+
+        status(sOut, lookup(vArg[1], -1, value, sOut) == 0 ? sType[value->iType] : "none");
+    }
+
+    void expire(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iTime;
+
+        if (!toInt(vArg[2], iTime))
+        {
+            error(sOut, "ERR value is not an integer or out of range");
+            return;
+        }
+
+        RedisMockValue *value = NULL;
+
+        if (lookup(vArg[1], -1, value, sOut) != 0)
+        {
+            integer(sOut, 0);
+            return;
+        }
+
+        value->iExpire = TC_Common::now2ms() + (vArg[0] == "EXPIRE" ? iTime * 1000 : iTime);
+
+        integer(sOut, 1);
+    }
+
+    void persist(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        if (lookup(vArg[1], -1, value, sOut) != 0 || value->iExpire == 0)
+        {
+            integer(sOut, 0);
+            return;
+        }
+
+        value->iExpire = 0;
+
+        integer(sOut, 1);
+    }
+
+    void ttl(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        if (lookup(vArg[1], -1, value, sOut) != 0)
+        {
+            integer(sOut, -2);
+        }
+        else if (value->iExpire == 0)
+        {
+            integer(sOut, -1);
+        }
+        else
+        {
+            int64_t iLeft = value->iExpire - TC_Common::now2ms();
+
+            integer(sOut, vArg[0] == "TTL" ? (iLeft + 500) / 1000 : iLeft);
+        }
+    }
+
+    void get(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_STRING, value, sOut);
+
+        if (iRet == 0)
+        {
+            bulk(sOut, value->sValue);
+        }
+        else if (iRet > 0)
+        {
+            nil(sOut);
+        }
+    }
+
+    /**
+    * @brief SET key value [EX seconds|PX milliseconds] [NX|XX]
+    */
+    void set(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iExpire = 0;
+        bool bNX = false, bXX = false;
+
+        for (size_t i = 3; i < vArg.size(); i++)
+        {
+            string sOpt = TC_Common::upper(vArg[i]);
+
+            if ((sOpt == "EX" || sOpt == "PX") && i + 1 < vArg.size() && toInt(vArg[i + 1], iExpire) && iExpire > 0)
+            {
+                iExpire = TC_Common::now2ms() + (sOpt == "EX" ? iExpire * 1000 : iExpire);
+                ++i;
+            }
+            else if (sOpt == "NX")
+            {
+                bNX = true;
+            }
+            else if (sOpt == "XX")
+            {
+                bXX = true;
+            }
+            else
+            {
+                error(sOut, "ERR syntax error");
+                return;
+            }
+        }
+
+        RedisMockValue *value = NULL;
+        bool bExists = lookup(vArg[1], -1, value, sOut) == 0;
+
+        if ((bNX && bExists) || (bXX && !bExists))
+        {
+            nil(sOut);
+            return;
+        }
+
+        RedisMockValue &v = _mData[vArg[1]];
+        v = RedisMockValue();
+        v.sValue  = vArg[2];
+        v.iExpire = iExpire;
+
+        status(sOut, "OK");
+    }
+
+    void setex(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iExpire;
+
+        if (!toInt(vArg[2], iExpire) || iExpire <= 0)
+        {
+            error(sOut, "ERR invalid expire time in 'setex' command");
+            return;
+        }
+
+        RedisMockValue &v = _mData[vArg[1]];
+        v = RedisMockValue();
+        v.sValue  = vArg[3];
+        v.iExpire = TC_Common::now2ms() + iExpire * 1000;
+
+        status(sOut, "OK");
+    }
+
+    void setnx(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        if (lookup(vArg[1], -1, value, sOut) == 0)
+        {
+            integer(sOut, 0);
+            return;
+        }
+
+        _mData[vArg[1]].sValue = vArg[2];
+
+        integer(sOut, 1);
+    }
+
+    void getset(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_STRING, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        if (iRet == 0)
+        {
+            bulk(sOut, value->sValue);
+        }
+        else
+        {
+            nil(sOut);
+        }
+
+        RedisMockValue &v = _mData[vArg[1]];
+        v = RedisMockValue();
+        v.sValue = vArg[2];
+    }
+
+    void mget(const vector<string> &vArg, string &sOut)
+    {
+        array(sOut, vArg.size() - 1);
+
+        for (size_t i = 1; i < vArg.size(); i++)
+        {
+            map<string, RedisMockValue>::iterator it = _mData.find(vArg[i]);
+
+            if (it == _mData.end() || it->second.iType != RedisMockValue::T_STRING || (it->second.iExpire != 0 && it->second.iExpire <= TC_Common::now2ms()))
+            {
+                nil(sOut);
+            }
+            else
+            {
+                bulk(sOut, it->second.sValue);
+            }
+        }
+    }
+
+    void mset(const vector<string> &vArg, string &sOut)
+    {
+        if (vArg.size() % 2 == 0)
+        {
+            error(sOut, "ERR wrong number of arguments for 'mset' command");
+            return;
+        }
+
+        for (size_t i = 1; i + 1 < vArg.size(); i += 2)
+        {
+            RedisMockValue &v = _mData[vArg[i]];
+            v = RedisMockValue();
+            v.sValue = vArg[i + 1];
+        }
+
+        status(sOut, "OK");
+    }
+
+    void append(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_STRING, sOut);
+
+        if (value != NULL)
+        {
+            value->sValue += vArg[2];
+            integer(sOut, value->sValue.size());
+        }
+    }
+
+    void strlen(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_STRING, value, sOut);
+
+        if (iRet >= 0)
+        {
+            integer(sOut, iRet == 0 ? value->sValue.size() : 0);
+        }
+    }
+
+    void incrby(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iBy = 1;
+
+        if (vArg.size() > 2 && !toInt(vArg[2], iBy))
+        {
+            error(sOut, "ERR value is not an integer or out of range");
+            return;
+        }
+
+        if (vArg[0] == "DECR" || vArg[0] == "DECRBY")
+        {
+            iBy = -iBy;
+        }
+
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_STRING, sOut);
+
+        if (value == NULL)
+        {
+            return;
+        }
+
+        int64_t iValue = 0;
+
+        if (!value->sValue.empty() && !toInt(value->sValue, iValue))
+        {
+            error(sOut, "ERR value is not an integer or out of range");
+            return;
+        }
+
+        iValue += iBy;
+        value->sValue = TC_Common::tostr(iValue);
+
+        integer(sOut, iValue);
+    }
+
+    /**
+    * @brief HSET/HMSET key field value [field value ...]
+    */
+    void hset(const vector<string> &vArg, string &sOut)
+    {
+        if (vArg.size() % 2 != 0)
+        {
+            error(sOut, "ERR wrong number of arguments for '" + TC_Common::lower(vArg[0]) + "' command");
+            return;
+        }
+
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_HASH, sOut);
+
+        if (value == NULL)
+        {
+            return;
+        }
+
+        int64_t iNew = 0;
+
+        for (size_t i = 2; i + 1 < vArg.size(); i += 2)
+        {
+            iNew += value->mHash.count(vArg[i]) == 0 ? 1 : 0;
+            value->mHash[vArg[i]] = vArg[i + 1];
+        }
+
+        if (vArg[0] == "HMSET")
+        {
+            status(sOut, "OK");
+        }
+        else
+        {
+            integer(sOut, iNew);
+        }
+    }
+
+    void hsetnx(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_HASH, sOut);
+
+        if (value != NULL)
+        {
+            integer(sOut, value->mHash.insert(make_pair(vArg[2], vArg[3])).second ? 1 : 0);
+        }
+    }
+
+    void hget(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_HASH, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        map<string, string>::iterator it;
+
+        if (iRet > 0 || (it = value->mHash.find(vArg[2])) == value->mHash.end())
+        {
+            nil(sOut);
+        }
+        else
+        {
+            bulk(sOut, it->second);
+        }
+    }
+
+    void hmget(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_HASH, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        array(sOut, vArg.size() - 2);
+
+        for (size_t i = 2; i < vArg.size(); i++)
+        {
+            map<string, string>::iterator it;
+
+            if (iRet > 0 || (it = value->mHash.find(vArg[i])) == value->mHash.end())
+            {
+                nil(sOut);
+            }
+            else
+            {
+                bulk(sOut, it->second);
+            }
+        }
+    }
+
+    /**
+    * @brief HGETALL/HKEYS/HVALS
+    */
+    void hgetall(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_HASH, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        if (iRet > 0)
+        {
+            array(sOut, 0);
+            return;
+        }
+
+        bool bKey   = vArg[0] != "HVALS";
+        bool bValue = vArg[0] != "HKEYS";
+
+        array(sOut, value->mHash.size() * ((bKey ? 1 : 0) + (bValue ? 1 : 0)));
+
+        for (map<string, string>::iterator it = value->mHash.begin(); it != value->mHash.end(); ++it)
+        {
+            if (bKey) bulk(sOut, it->first);
+            if (bValue) bulk(sOut, it->second);
+        }
+    }
+
+    void hdel(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_HASH, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        int64_t iCount = 0;
+
+        for (size_t i = 2; iRet == 0 && i < vArg.size(); i++)
+        {
+            iCount += value->mHash.erase(vArg[i]);
+        }
+
+        if (iRet == 0)
+        {
+            eraseEmpty(vArg[1], value);
+        }
+
+        integer(sOut, iCount);
+    }
+
+    void hlen(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_HASH, value, sOut);
+
+        if (iRet >= 0)
+        {
+            integer(sOut, iRet == 0 ? value->mHash.size() : 0);
+        }
+    }
+
+    void hexists(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_HASH, value, sOut);
+
+        if (iRet >= 0)
+        {
+            integer(sOut, iRet == 0 ? value->mHash.count(vArg[2]) : 0);
+        }
+    }
+
+    void hincrby(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iBy, iValue = 0;
+
+        if (!toInt(vArg[3], iBy))
+        {
+            error(sOut, "ERR value is not an integer or out of range");
+            return;
+        }
+
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_HASH, sOut);
+
+        if (value == NULL)
+        {
+            return;
+        }
+
+        string &sField = value->mHash[vArg[2]];
+
+        if (!sField.empty() && !toInt(sField, iValue))
+        {
+            error(sOut, "ERR hash value is not an integer");
+            return;
+        }
+
+        iValue += iBy;
+        sField = TC_Common::tostr(iValue);
+
+        integer(sOut, iValue);
+    }
+
+    void sadd(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_SET, sOut);
+
+        if (value == NULL)
+        {
+            return;
+        }
+
+        int64_t iCount = 0;
+
+        for (size_t i = 2; i < vArg.size(); i++)
+        {
+            iCount += value->setValue.insert(vArg[i]).second ? 1 : 0;
+        }
+
+        integer(sOut, iCount);
+    }
+
+    void srem(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_SET, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        int64_t iCount = 0;
+
+        for (size_t i = 2; iRet == 0 && i < vArg.size(); i++)
+        {
+            iCount += value->setValue.erase(vArg[i]);
+        }
+
+        if (iRet == 0)
+        {
+            eraseEmpty(vArg[1], value);
+        }
+
+        integer(sOut, iCount);
+    }
+
+    void smembers(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_SET, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        array(sOut, iRet == 0 ? value->setValue.size() : 0);
+
+        for (std::set<string>::iterator it = value->setValue.begin(); iRet == 0 && it != value->setValue.end(); ++it)
+        {
+            bulk(sOut, *it);
+        }
+    }
+
+    void sismember(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_SET, value, sOut);
+
+        if (iRet >= 0)
+        {
+            integer(sOut, iRet == 0 ? value->setValue.count(vArg[2]) : 0);
+        }
+    }
+
+    void scard(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_SET, value, sOut);
+
+        if (iRet >= 0)
+        {
+            integer(sOut, iRet == 0 ? value->setValue.size() : 0);
+        }
+    }
+
+    /**
+    * @brief ZADD key score member [score member ...], 不支持NX/XX等选项
+    */
+    void zadd(const vector<string> &vArg, string &sOut)
+    {
+        if (vArg.size() % 2 != 0)
+        {
+            error(sOut, "ERR syntax error");
+            return;
+        }
+
+        vector<double> vScore(vArg.size() / 2);
+
+        for (size_t i = 2; i + 1 < vArg.size(); i += 2)
+        {
+            if (!toDouble(vArg[i], vScore[i / 2 - 1]))
+            {
+                error(sOut, "ERR value is not a valid float");
+                return;
+            }
+        }
+
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_ZSET, sOut);
+
+        if (value == NULL)
+        {
+            return;
+        }
+
+        int64_t iNew = 0;
+
+        for (size_t i = 2; i + 1 < vArg.size(); i += 2)
+        {
+            iNew += value->mZset.count(vArg[i + 1]) == 0 ? 1 : 0;
+            value->mZset[vArg[i + 1]] = vScore[i / 2 - 1];
+        }
+
+        integer(sOut, iNew);
+    }
+
+    void zincrby(const vector<string> &vArg, string &sOut)
+    {
+        double dBy;
+
+        if (!toDouble(vArg[2], dBy))
+        {
+            error(sOut, "ERR value is not a valid float");
+            return;
+        }
+
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_ZSET, sOut);
+
+        if (value != NULL)
+        {
+            double &dScore = value->mZset[vArg[3]];
+            dScore += dBy;
+
+            bulk(sOut, score(dScore));
+        }
+    }
+
+    void zrem(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_ZSET, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        int64_t iCount = 0;
+
+        for (size_t i = 2; iRet == 0 && i < vArg.size(); i++)
+        {
+            iCount += value->mZset.erase(vArg[i]);
+        }
+
+        if (iRet == 0)
+        {
+            eraseEmpty(vArg[1], value);
+        }
+
+        integer(sOut, iCount);
+    }
+
+    void zscore(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_ZSET, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        map<string, double>::iterator it;
+
+        if (iRet > 0 || (it = value->mZset.find(vArg[2])) == value->mZset.end())
+        {
+            nil(sOut);
+        }
+        else
+        {
+            bulk(sOut, score(it->second));
+        }
+    }
+
+    void zcard(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_ZSET, value, sOut);
+
+        if (iRet >= 0)
+        {
+            integer(sOut, iRet == 0 ? value->mZset.size() : 0);
+        }
+    }
+
+    /**
+    * @brief 按(score, member)排序的成员
+    */
+    static void sorted(const RedisMockValue *value, vector<pair<double, string> > &vSorted)
+    {
+        for (map<string, double>::const_iterator it = value->mZset.begin(); it != value->mZset.end(); ++it)
+        {
+            vSorted.push_back(make_pair(it->second, it->first));
+        }
+
+        std::sort(vSorted.begin(), vSorted.end());
+    }
+
+    static void zreply(const vector<pair<double, string> > &vSorted, size_t iBegin, size_t iEnd, bool bReverse, bool bWithScores, string &sOut)
+    {
+        array(sOut, (iEnd - iBegin) * (bWithScores ? 2 : 1));
+
+        for (size_t i = iBegin; i < iEnd; i++)
+        {
+            const pair<double, string> &item = vSorted[bReverse ? vSorted.size() - 1 - i : i];
+
+            bulk(sOut, item.second);
+
+            if (bWithScores)
+            {
+                bulk(sOut, score(item.first));
+            }
+        }
+    }
+
+    /**
+    * @brief ZRANGE/ZREVRANGE key start stop [WITHSCORES]
+    */
+    void zrange(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iStart, iStop;
+
+        if (!toInt(vArg[2], iStart) || !toInt(vArg[3], iStop))
+        {
+            error(sOut, "ERR value is not an integer or out of range");
+            return;
+        }
+
+        bool bWithScores = vArg.size() > 4 && TC_Common::upper(vArg[4]) == "WITHSCORES";
+
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_ZSET, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        vector<pair<double, string> > vSorted;
+
+        if (iRet == 0)
+        {
+            sorted(value, vSorted);
+        }
+
+        if (!range(vSorted.size(), iStart, iStop))
+        {
+            array(sOut, 0);
+            return;
+        }
+
+        zreply(vSorted, iStart, iStop + 1, vArg[0] == "ZREVRANGE", bWithScores, sOut);
+    }
+
+    /**
+    * @brief ZRANGEBYSCORE key min max [WITHSCORES], min/max支持-inf/+inf及'('开区间
+    */
+    void zrangebyscore(const vector<string> &vArg, string &sOut)
+    {
+        bool bMinOpen = !vArg[2].empty() && vArg[2][0] == '(';
+        bool bMaxOpen = !vArg[3].empty() && vArg[3][0] == '(';
+        double dMin, dMax;
+
+        if (!toDouble(vArg[2].substr(bMinOpen ? 1 : 0), dMin) || !toDouble(vArg[3].substr(bMaxOpen ? 1 : 0), dMax))
+        {
+            error(sOut, "ERR min or max is not a float");
+            return;
+        }
+
+        bool bWithScores = vArg.size() > 4 && TC_Common::upper(vArg[4]) == "WITHSCORES";
+
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_ZSET, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        vector<pair<double, string> > vSorted, vMatch;
+
+        if (iRet == 0)
+        {
+            sorted(value, vSorted);
+        }
+
+        for (size_t i = 0; i < vSorted.size(); i++)
+        {
+            double d = vSorted[i].first;
+
+            if ((bMinOpen ? d > dMin : d >= dMin) && (bMaxOpen ? d < dMax : d <= dMax))
+            {
+                vMatch.push_back(vSorted[i]);
+            }
+        }
+
+        zreply(vMatch, 0, vMatch.size(), false, bWithScores, sOut);
+    }
+
+    /**
+    * @brief LPUSH/RPUSH
+    */
+    void push(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = create(vArg[1], RedisMockValue::T_LIST, sOut);
+
+        if (value == NULL)
+        {
+            return;
+        }
+
+        for (size_t i = 2; i < vArg.size(); i++)
+        {
+            if (vArg[0] == "LPUSH")
+            {
+                value->qList.push_front(vArg[i]);
+            }
+            else
+            {
+                value->qList.push_back(vArg[i]);
+            }
+        }
+
+        integer(sOut, value->qList.size());
+    }
+
+    /**
+    * @brief LPOP/RPOP, 不支持count参数
+    */
+    void pop(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_LIST, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        if (iRet > 0)
+        {
+            nil(sOut);
+            return;
+        }
+
+        if (vArg[0] == "LPOP")
+        {
+            bulk(sOut, value->qList.front());
+            value->qList.pop_front();
+        }
+        else
+        {
+            bulk(sOut, value->qList.back());
+            value->qList.pop_back();
+        }
+
+        eraseEmpty(vArg[1], value);
+    }
+
+    void llen(const vector<string> &vArg, string &sOut)
+    {
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_LIST, value, sOut);
+
+        if (iRet >= 0)
+        {
+            integer(sOut, iRet == 0 ? value->qList.size() : 0);
+        }
+    }
+
+    void lindex(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iIndex;
+
+        if (!toInt(vArg[2], iIndex))
+        {
+            error(sOut, "ERR value is not an integer or out of range");
+            return;
+        }
+
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_LIST, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        int64_t iSize = iRet == 0 ? value->qList.size() : 0;
+
+        if (iIndex < 0)
+        {
+            iIndex += iSize;
+        }
+
+        if (iIndex < 0 || iIndex >= iSize)
+        {
+            nil(sOut);
+        }
+        else
+        {
+            bulk(sOut, value->qList[iIndex]);
+        }
+    }
+
+    void lrange(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iStart, iStop;
+
+        if (!toInt(vArg[2], iStart) || !toInt(vArg[3], iStop))
+        {
+            error(sOut, "ERR value is not an integer or out of range");
+            return;
+        }
+
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_LIST, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        if (iRet > 0 || !range(value->qList.size(), iStart, iStop))
+        {
+            array(sOut, 0);
+            return;
+        }
+
+        array(sOut, iStop - iStart + 1);
+
+        for (int64_t i = iStart; i <= iStop; i++)
+        {
+            bulk(sOut, value->qList[i]);
+        }
+    }
+
+    void ltrim(const vector<string> &vArg, string &sOut)
+    {
+        int64_t iStart, iStop;
+
+        if (!toInt(vArg[2], iStart) || !toInt(vArg[3], iStop))
+        {
+            error(sOut, "ERR value is not an integer or out of range");
+            return;
+        }
+
+        RedisMockValue *value = NULL;
+
+        int iRet = lookup(vArg[1], RedisMockValue::T_LIST, value, sOut);
+
+        if (iRet < 0)
+        {
+            return;
+        }
+
+        if (iRet == 0)
+        {
+            if (!range(value->qList.size(), iStart, iStop))
+            {
+                value->qList.clear();
+            }
+            else
+            {
+                value->qList.erase(value->qList.begin() + iStop + 1, value->qList.end());
+                value->qList.erase(value->qList.begin(), value->qList.begin() + iStart);
+            }
+
+            eraseEmpty(vArg[1], value);
+        }
+
+        status(sOut, "OK");
+    }
+
+protected:
+    std::mutex                      _mutex;
+
+    map<string, Command>            _mCommand;
+
+    map<string, RedisMockValue>     _mData;
+
+    string                          _sPassword;
+};
+
+class RedisMockServer;
+
+/**
+* @brief 模拟服务端的处理线程
+*/
+class RedisMockHandle : public TC_EpollServer::Handle
+{
+public:
+    RedisMockHandle(RedisMockServer *server) : _server(server) {}
+
+    virtual void handle(const shared_ptr<TC_EpollServer::RecvContext> &data);
+
+    /**
+    * @brief 供调度线程发送延时的应答
+    */
+    void reply(const shared_ptr<TC_EpollServer::SendContext> &send) { sendResponse(send); }
+
+    void closeConnection(const shared_ptr<TC_EpollServer::RecvContext> &data) { close(data); }
+
+protected:
+    RedisMockServer *_server;
+};
+
+/**
+* @brief 进程内的RESP模拟服务端
+*/
+class RedisMockServer
+{
+public:
+    RedisMockServer()
+        : _epollServer(NULL)
+        , _iPort(0)
+        , _iMinLatency(0)
+        , _iMaxLatency(0)
+        , _iFragment(0)
+        , _iFragmentDelay(0)
+        , _dErrorRate(0)
+        , _dCloseRate(0)
+        , _iRequest(0)
+        , _iSeq(0)
+        , _bTerminate(false)
+    {
+    }
+
+    ~RedisMockServer()
+    {
+        stop();
+    }
+
+    /**
+    * @brief 启动服务, 返回后即可连接
+    *
+    * @param sHost     监听地址
+    * @param iPort     监听端口
+    * @param iThreads  处理线程数, 同一连接的请求总在同一线程处理
+    * @return 0 成功 -1 监听失败
+    */
+    int start(const string &sHost, int iPort, size_t iThreads = 1)
+    {
+        if (_epollServer)
+        {
+            return 0;
+        }
+
+        _sHost = sHost;
+        _iPort = iPort;
+
+        try
+        {
+            _epollServer = new TC_EpollServer(1);
+
+            string sEndpoint = "tcp -h " + sHost + " -p " + TC_Common::tostr(iPort) + " -t 60000";
+
+            TC_EpollServer::BindAdapterPtr adapter = _epollServer->createBindAdapter<RedisMockHandle>("RedisMockAdapter", sEndpoint, iThreads > 0 ? iThreads : 1, this);
+
+            adapter->enableQueueMode();
+            adapter->setProtocol(&RedisMockServer::parseRequest);
+        }
+        catch (exception &ex)
+        {
+            LOG_CONSOLE_DEBUG << "mock server bind error:" << sHost << ":" << iPort << ", " << ex.what() << endl;
+            delete _epollServer;
+            _epollServer = NULL;
+            return -1;
+        }
+
+        _bTerminate = false;
+
+        _serverThread = std::thread([this]{ _epollServer->waitForShutdown(); });
+        _delayThread  = std::thread(&RedisMockServer::delayLoop, this);
+
+        return 0;
+    }
+
+    void stop()
+    {
+        if (!_epollServer)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _bTerminate = true;
+            _cond.notify_all();
+        }
+
+        _delayThread.join();
+
+        _epollServer->terminate();
+        _serverThread.join();
+
+        delete _epollServer;
+        _epollServer = NULL;
+    }
+
+    /**
+    * @brief 连接本服务的配置, 可直接用于RedisProxy::genRedisObj或RedisConnection
+    */
+    TC_RDConf getConf() const
+    {
+        TC_RDConf tcRDConf;
+        tcRDConf._host = _sHost;
+        tcRDConf._port = _iPort;
+
+        return tcRDConf;
+    }
+
+    /**
+    * @brief 内存数据, 可用于预置或检查数据
+    */
+    RedisMockStore &getStore() { return _store; }
+
+    /**
+    * @brief 每个应答的延时(微秒), 在[iMin, iMax]间均匀分布; 同一连接的应答不会因延时乱序
+    */
+    void setLatency(int64_t iMin, int64_t iMax = -1)
+    {
+        _iMinLatency = iMin > 0 ? iMin : 0;
+        _iMaxLatency = iMax < _iMinLatency ? _iMinLatency.load() : iMax;
+    }
+
+    /**
+    * @brief 把应答拆成iBytes字节的小块分别发送, 块之间间隔iDelay微秒(不为0时更容易形成独立的TCP分段)
+    *
+    * @param iBytes  0 不拆分
+    */
+    void setFragment(size_t iBytes, int64_t iDelay = 0)
+    {
+        _iFragment      = iBytes;
+        _iFragmentDelay = iDelay > 0 ? iDelay : 0;
+    }
+
+    /**
+    * @brief 按概率把应答替换为错误应答
+    *
+    * @param dRate   概率(0~1)
+    * @param sCmd    只对该命令(大写)注入, 空表示所有命令
+    * @param sError  错误信息, 不含'-'
+    */
+    void setErrorRate(double dRate, const string &sCmd = "", const string &sError = "ERR injected error")
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _dErrorRate = dRate;
+        _sErrorCmd  = sCmd;
+        _sError     = sError;
+    }
+
+    /**
+    * @brief 按概率不应答并关闭连接
+    */
+    void setCloseRate(double dRate) { _dCloseRate = dRate; }
+
+    /**
+    * @brief 收到的请求数
+    */
+    uint64_t getRequestCount() const { return _iRequest; }
+
+    /**
+    * @brief 分帧: 一个请求是一个bulk string数组
+    */
+    static TC_NetWorkBuffer::PACKET_TYPE parseRequest(TC_NetWorkBuffer &in, vector<char> &out)
+    {
+        if (in.empty())
+        {
+            return TC_NetWorkBuffer::PACKET_LESS;
+        }
+
+        in.mergeBuffers();
+
+        pair<const char*, size_t> data = in.getBufferPointer();
+
+        if (data.first[0] != '*')
+        {
+            return TC_NetWorkBuffer::PACKET_ERR;
+        }
+
+        RedisReplyParser parser;
+
+        int64_t iFrame = parser.scan(data.first, data.second);
+
+        if (iFrame < 0)
+        {
+            return TC_NetWorkBuffer::PACKET_ERR;
+        }
+
+        if (iFrame == 0)
+        {
+            return TC_NetWorkBuffer::PACKET_LESS;
+        }
+
+        out.assign(data.first, data.first + iFrame);
+        in.moveHeader(iFrame);
+
+        return TC_NetWorkBuffer::PACKET_FULL;
+    }
+
+    /**
+    * @brief 处理一个请求, 由处理线程调用
+    */
+    void process(RedisMockHandle *handle, const shared_ptr<TC_EpollServer::RecvContext> &data)
+    {
+        ++_iRequest;
+
+        vector<string> vArg;
+
+        if (!decodeRequest(data->buffer(), vArg))
+        {
+            handle->closeConnection(data);
+            return;
+        }
+
+        std::mt19937_64 &rng = getRandom();
+
+        if (_dCloseRate > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < _dCloseRate)
+        {
+            schedule(handle, data, string(), true);
+            return;
+        }
+
+        string sOut;
+
+        if (!inject(vArg[0], rng, sOut))
+        {
+            _store.execute(vArg, sOut);
+        }
+
+        schedule(handle, data, sOut, false);
+    }
+
+protected:
+    /**
+    * @brief 待发送的应答
+    */
+    struct Delayed
+    {
+        int64_t                                 iDue;
+
+        uint64_t                                iSeq;
+
+        RedisMockHandle                         *handle;
+
+        shared_ptr<TC_EpollServer::RecvContext> data;
+
+        string                                  sBuffer;
+
+        bool                                    bClose;
+
+        bool operator<(const Delayed &d) const
+        {
+            //priority_queue是大顶堆, 时间早的在堆顶
+            return iDue != d.iDue ? iDue > d.iDue : iSeq > d.iSeq;
+        }
+    };
+
+    /**
+    * @brief 一个连接待发送的应答数及最后一个应答的发送时间
+    */
+    struct Pending
+    {
+        Pending() : iCount(0), iLastDue(0) {}
+
+        size_t  iCount;
+
+        int64_t iLastDue;
+    };
+
+    static std::mt19937_64 &getRandom()
+    {
+        static thread_local std::mt19937_64 rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        return rng;
+    }
+
+    static bool decodeRequest(const vector<char> &vBuffer, vector<string> &vArg)
+    {
+        const char *data = vBuffer.data();
+        size_t len  = vBuffer.size();
+        size_t iPos = 0;
+        const char *p = NULL;
+        int64_t iLen  = 0;
+
+        if (RedisReplyParser::readElement(data, len, iPos, p, iLen) != '*' || iLen <= 0)
+        {
+            return false;
+        }
+
+        vArg.resize(iLen);
+
+        for (size_t i = 0; i < vArg.size(); i++)
+        {
+            if (RedisReplyParser::readElement(data, len, iPos, p, iLen) != '$' || iLen < 0)
+            {
+                return false;
+            }
+
+            vArg[i].assign(p, iLen);
+        }
+
+        vArg[0] = TC_Common::upper(vArg[0]);
+
+        return true;
+    }
+
+    /**
+    * @brief 按配置注入错误应答
+    *
+    * @return true 已注入
+    */
+    bool inject(const string &sCmd, std::mt19937_64 &rng, string &sOut)
+    {
+        if (_dErrorRate <= 0)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if ((!_sErrorCmd.empty() && _sErrorCmd != sCmd) || std::uniform_real_distribution<double>(0, 1)(rng) >= _dErrorRate)
+        {
+            return false;
+        }
+
+        RedisMockStore::error(sOut, _sError);
+
+        return true;
+    }
+
+    /**
+    * @brief 没有延时及分片时直接发送, 否则交给调度线程.
+    *        同一连接的应答时间不早于它之前的应答, 保证不乱序
+    */
+    void schedule(RedisMockHandle *handle, const shared_ptr<TC_EpollServer::RecvContext> &data, const string &sOut, bool bClose)
+    {
+        int64_t iLatency = _iMinLatency;
+
+        if (_iMaxLatency > iLatency)
+        {
+            iLatency = std::uniform_int_distribution<int64_t>(iLatency, _iMaxLatency)(getRandom());
+        }
+
+        size_t iFragment = _iFragment;
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        map<uint32_t, Pending>::iterator it = _mPending.find(data->uid());
+
+        if (iLatency == 0 && (iFragment == 0 || iFragment >= sOut.size()) && it == _mPending.end())
+        {
+            lock.unlock();
+
+            send(handle, data, sOut, bClose);
+            return;
+        }
+
+        Pending &pending = _mPending[data->uid()];
+        int64_t iDue     = std::max(TC_Common::now2us() + iLatency, pending.iLastDue);
+
+        Delayed d;
+        d.handle = handle;
+        d.data   = data;
+        d.bClose = false;
+
+        if (iFragment == 0 || bClose)
+        {
+            iFragment = sOut.size();
+        }
+
+        for (size_t i = 0; i < sOut.size(); i += iFragment, iDue += _iFragmentDelay)
+        {
+            d.iDue = iDue;
+            d.iSeq = _iSeq++;
+            d.sBuffer.assign(sOut, i, iFragment);
+
+            _qDelay.push(d);
+            ++pending.iCount;
+        }
+
+        if (bClose)
+        {
+            d.iDue   = iDue;
+            d.iSeq   = _iSeq++;
+            d.bClose = true;
+            d.sBuffer.clear();
+
+            _qDelay.push(d);
+            ++pending.iCount;
+        }
+
+        pending.iLastDue = iDue;
+
+        _cond.notify_one();
+    }
+
+    static void send(RedisMockHandle *handle, const shared_ptr<TC_EpollServer::RecvContext> &data, const string &sBuffer, bool bClose)
+    {
+        if (bClose)
+        {
+            handle->closeConnection(data);
+            return;
+        }
+
+        shared_ptr<TC_EpollServer::SendContext> send = data->createSendContext();
+        send->buffer()->addBuffer(sBuffer);
+
+        handle->reply(send);
+    }
+
+    /**
+    * @brief 调度线程: 到时间的应答依次发送
+    */
+    void delayLoop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (!_bTerminate)
+        {
+            if (_qDelay.empty())
+            {
+                _cond.wait(lock);
+                continue;
+            }
+
+            int64_t iNow = TC_Common::now2us();
+
+            if (_qDelay.top().iDue > iNow)
+            {
+                _cond.wait_for(lock, std::chrono::microseconds(_qDelay.top().iDue - iNow));
+                continue;
+            }
+
+            Delayed d = _qDelay.top();
+            _qDelay.pop();
+
+            lock.unlock();
+
+            send(d.handle, d.data, d.sBuffer, d.bClose);
+
+            lock.lock();
+
+            //发送之后才减计数, 保证处理线程直接发送的应答不会越过它
+            map<uint32_t, Pending>::iterator it = _mPending.find(d.data->uid());
+
+            if (it != _mPending.end() && --it->second.iCount == 0)
+            {
+                _mPending.erase(it);
+            }
+        }
+    }
+
+protected:
+    TC_EpollServer                  *_epollServer;
+
+    string                          _sHost;
+
+    int                             _iPort;
+
+    RedisMockStore                  _store;
+
+    std::atomic<int64_t>            _iMinLatency;
+
+    std::atomic<int64_t>            _iMaxLatency;
+
+    std::atomic<size_t>             _iFragment;
+
+    std::atomic<int64_t>            _iFragmentDelay;
+
+    std::atomic<double>             _dErrorRate;
+
+    string                          _sErrorCmd;
+
+    string                          _sError;
+
+    std::atomic<double>             _dCloseRate;
+
+    std::atomic<uint64_t>           _iRequest;
+
+    std::mutex                      _mutex;
+
+    std::condition_variable         _cond;
+
+    std::priority_queue<Delayed>    _qDelay;
+
+    map<uint32_t, Pending>          _mPending;
+
+    uint64_t                        _iSeq;
+
+    bool                            _bTerminate;
+
+    std::thread                     _serverThread;
+
+    std::thread                     _delayThread;
+};
+
+inline void RedisMockHandle::handle(const shared_ptr<TC_EpollServer::RecvContext> &data)
+{
+    _server->process(this, data);
+}
+
+}
+#endif
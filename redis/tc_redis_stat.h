@@ -0,0 +1,2514 @@
+#ifndef tc_redis_stat_h__
+#define tc_redis_stat_h__
+#include "util/tc_common.h"
+#include "util/tc_thread_rwlock.h"
+#include "servant/StatReport.h"
+#include <atomic>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+namespace tars
+{
+
+/////////////////////////////////////////////////
+/**
+* @file  tc_redis_stat.h
+* @brief redis客户端延时统计.
+*
+* 每个线程按(proxy, 命令)各自记录到本线程的直方图, 记录时没有锁和原子读改写;
+* 取统计或上报时把各线程的直方图合并. 直方图为对数线性分桶(HDR风格), 相对误差约6%.
+*/
+/////////////////////////////////////////////////
+
+/**
+* @brief 对数线性直方图, 单位微秒.
+*        小于16的值各占一个桶, 之后每个2的幂区间再均分16个桶
+*/
+class RedisHistogram
+{
+public:
+    enum
+    {
+        kSubBits = 4,
+        kSub     = 1 << kSubBits,
+        kMaxExp  = 40,
+        kBuckets = kSub + (kMaxExp - kSubBits) * kSub,
+    };
+
+    RedisHistogram()
+    {
+        for (size_t i = 0; i < kBuckets; i++)
+        {
+            _vBucket[i] = 0;
+        }
+
+        _iCount = 0;
+        _iSum   = 0;
+        _iMax   = 0;
+    }
+
+    /**
+    * @brief 记录一个值. 只能由一个线程调用, 与merge可以并发
+    */
+    void record(uint64_t iValue)
+    {
+        add(_vBucket[index(iValue)], 1);
+        add(_iCount, 1);
+        add(_iSum, iValue);
+
+        if (iValue > _iMax.load(std::memory_order_relaxed))
+        {
+            _iMax.store(iValue, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+    * @brief 把本直方图累加到vBucket等
+    */
+    void mergeTo(vector<uint64_t> &vBucket, uint64_t &iCount, uint64_t &iSum, uint64_t &iMax) const
+    {
+        vBucket.resize(kBuckets);
+
+        for (size_t i = 0; i < kBuckets; i++)
+        {
+            vBucket[i] += _vBucket[i].load(std::memory_order_relaxed);
+        }
+
+        iCount += _iCount.load(std::memory_order_relaxed);
+        iSum   += _iSum.load(std::memory_order_relaxed);
+        iMax    = std::max(iMax, _iMax.load(std::memory_order_relaxed));
+    }
+
+    static size_t index(uint64_t iValue)
+    {
+        if (iValue < kSub)
+        {
+            return iValue;
+        }
+
+        int iExp = 63 - __builtin_clzll(iValue);
+
+        if (iExp >= kMaxExp)
+        {
+            return kBuckets - 1;
+        }
+
+        return kSub + (iExp - kSubBits) * kSub + ((iValue >> (iExp - kSubBits)) & (kSub - 1));
+    }
+
+    /**
+    * @brief 桶的代表值(区间中点)
+    */
+    static uint64_t value(size_t iIndex)
+    {
+        if (iIndex < kSub)
+        {
+            return iIndex;
+        }
+
+        size_t iExp = (iIndex - kSub) / kSub + kSubBits;
+        uint64_t iLow = (uint64_t)(kSub + (iIndex - kSub) % kSub) << (iExp - kSubBits);
+
+        return iLow + ((1ULL << (iExp - kSubBits)) >> 1);
+    }
+
+    /**
+    * @brief vBucket中分位q(0~1)的值
+    */
+    static uint64_t percentile(const vector<uint64_t> &vBucket, uint64_t iCount, double q)
+    {
+        if (iCount == 0)
+        {
+            return 0;
+        }
+
+        uint64_t iRank = (uint64_t)(q * iCount + 0.5);
+        iRank = std::max<uint64_t>(iRank, 1);
+
+        uint64_t iSeen = 0;
+
+        for (size_t i = 0; i < vBucket.size(); i++)
+        {
+            iSeen += vBucket[i];
+
+            if (iSeen >= iRank)
+            {
+                return value(i);
+            }
+        }
+
+        return value(vBucket.size() - 1);
+    }
+
+protected:
+    /**
+    * @brief 单写者的递增, 不需要原子读改写
+    */
+    static void add(std::atomic<uint64_t> &a, uint64_t n)
+    {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+protected:
+    std::atomic<uint64_t>   _vBucket[kBuckets];
+
+    std::atomic<uint64_t>   _iCount;
+
+    std::atomic<uint64_t>   _iSum;
+
+    std::atomic<uint64_t>   _iMax;
+};
+
+typedef shared_ptr<RedisHistogram> RedisHistogramPtr;
+
+/**
+* @brief 一条连接的收发统计
+*/
+struct RedisConnStat
+{
+    string   sObj;
+
+    /**
+    * 连接标识: proxy#<序号>为ServantProxy的网络连接, conn#<序号>为RedisConnection, *为obj级别的计数
+    */
+    string   sConn;
+
+    uint64_t iBytesSent;
+
+    uint64_t iBytesRecv;
+
+    /**
+    * 发出的命令数/收到的应答数
+    */
+    uint64_t iCommands;
+
+    uint64_t iReplies;
+
+    /**
+    * 当前在途(已发出未应答)的命令数, 及出现过的最大值(pipeline深度)
+    */
+    uint64_t iInFlight;
+
+    uint64_t iMaxInFlight;
+
+    /**
+    * 接收缓冲中未解码数据的最大长度
+    */
+    uint64_t iMaxBuffer;
+
+    /**
+    * 建立连接的次数, 大于1即发生过重连
+    */
+    uint64_t iConnects;
+
+    uint64_t iAuthFailed;
+
+    uint64_t iTimeouts;
+};
+
+/**
+* @brief 一条连接的计数器.
+*        除onTimeout外只能由连接所在的一个线程(网络线程, 或当前持有RedisConnection的线程)调用,
+*        计数都是单写者的relaxed原子变量, 与getStat可以并发
+*/
+class RedisConnCounter
+{
+public:
+    RedisConnCounter(const string &sObj, const string &sConn)
+        : _sObj(sObj)
+        , _sConn(sConn)
+        , _iBytesSent(0)
+        , _iBytesRecv(0)
+        , _iCommands(0)
+        , _iReplies(0)
+        , _iDropped(0)
+        , _iMaxInFlight(0)
+        , _iMaxBuffer(0)
+        , _iConnects(0)
+        , _iAuthFailed(0)
+        , _iTimeouts(0)
+    {
+    }
+
+    const string &getObj() const { return _sObj; }
+
+    const string &getConn() const { return _sConn; }
+
+    /**
+    * 发出后超过该时间(微秒)仍未应答, 且其后的命令已有应答的, 视为连接断开时丢失
+    */
+    static const int64_t kStaleTime = 60 * 1000000LL;
+
+    /**
+    * @brief 发出iCommands个命令, 共iBytes字节
+    */
+    void onSend(size_t iBytes, size_t iCommands)
+    {
+        add(_iBytesSent, iBytes);
+        add(_iCommands, iCommands);
+
+        int64_t iNow = TC_Common::now2us();
+
+        for (size_t i = 0; i < iCommands; i++)
+        {
+            _qSend.push_back(iNow);
+        }
+
+        uint64_t iInFlight = inFlight();
+
+        if (iInFlight > _iMaxInFlight.load(std::memory_order_relaxed))
+        {
+            _iMaxInFlight.store(iInFlight, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+    * @brief 收到iBytes字节, 接收缓冲中未解码的数据为iBuffer字节
+    */
+    void onRecv(size_t iBytes, size_t iBuffer)
+    {
+        add(_iBytesRecv, iBytes);
+
+        if (iBuffer > _iMaxBuffer.load(std::memory_order_relaxed))
+        {
+            _iMaxBuffer.store(iBuffer, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+    * @brief 收到一个应答. 应答按命令的发送顺序返回, 队首超过kStaleTime的命令(保留最后一个给本次应答)
+    *        是重连前发出的: 没有AUTH时重连不会调用onConnect, 在这里计为丢失
+    */
+    void onReply()
+    {
+        add(_iReplies, 1);
+
+        if (_qSend.empty())
+        {
+            return;
+        }
+
+        int64_t iStale = TC_Common::now2us() - kStaleTime;
+        uint64_t iDropped = 0;
+
+        while (_qSend.size() > 1 && _qSend.front() < iStale)
+        {
+            _qSend.pop_front();
+            ++iDropped;
+        }
+
+        if (iDropped > 0)
+        {
+            add(_iDropped, iDropped);
+        }
+
+        _qSend.pop_front();
+    }
+
+    /**
+    * @brief 连接(重新)建立, 旧连接上在途的命令不会再有应答
+    */
+    void onConnect()
+    {
+        add(_iDropped, inFlight());
+        add(_iConnects, 1);
+
+        _qSend.clear();
+    }
+
+    void onAuthFailed()
+    {
+        add(_iAuthFailed, 1);
+    }
+
+    /**
+    * @brief 超时, 可以多线程调用
+    */
+    void onTimeout()
+    {
+        _iTimeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t inFlight() const
+    {
+        uint64_t iDone = _iReplies.load(std::memory_order_relaxed) + _iDropped.load(std::memory_order_relaxed);
+        uint64_t iSent = _iCommands.load(std::memory_order_relaxed);
+
+        //订阅等场景应答多于命令
+        return iSent > iDone ? iSent - iDone : 0;
+    }
+
+    void getStat(RedisConnStat &stat) const
+    {
+        stat.sObj         = _sObj;
+        stat.sConn        = _sConn;
+        stat.iBytesSent   = _iBytesSent.load(std::memory_order_relaxed);
+        stat.iBytesRecv   = _iBytesRecv.load(std::memory_order_relaxed);
+        stat.iCommands    = _iCommands.load(std::memory_order_relaxed);
+        stat.iReplies     = _iReplies.load(std::memory_order_relaxed);
+        stat.iInFlight    = inFlight();
+        stat.iMaxInFlight = _iMaxInFlight.load(std::memory_order_relaxed);
+        stat.iMaxBuffer   = _iMaxBuffer.load(std::memory_order_relaxed);
+        stat.iConnects    = _iConnects.load(std::memory_order_relaxed);
+        stat.iAuthFailed  = _iAuthFailed.load(std::memory_order_relaxed);
+        stat.iTimeouts    = _iTimeouts.load(std::memory_order_relaxed);
+    }
+
+protected:
+    static void add(std::atomic<uint64_t> &a, uint64_t n)
+    {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+protected:
+    string                  _sObj;
+
+    string                  _sConn;
+
+    std::atomic<uint64_t>   _iBytesSent;
+
+    std::atomic<uint64_t>   _iBytesRecv;
+
+    std::atomic<uint64_t>   _iCommands;
+
+    std::atomic<uint64_t>   _iReplies;
+
+    /**
+    * 因重连丢失应答的命令数
+    */
+    std::atomic<uint64_t>   _iDropped;
+
+    std::atomic<uint64_t>   _iMaxInFlight;
+
+    std::atomic<uint64_t>   _iMaxBuffer;
+
+    std::atomic<uint64_t>   _iConnects;
+
+    std::atomic<uint64_t>   _iAuthFailed;
+
+    std::atomic<uint64_t>   _iTimeouts;
+
+    /**
+    * 在途命令的发送时间, 只由连接所在的线程访问
+    */
+    std::deque<int64_t>     _qSend;
+};
+
+typedef shared_ptr<RedisConnCounter> RedisConnCounterPtr;
+
+/**
+* @brief 连接统计的汇总及上报.
+*        ServantProxy的连接在网络线程上按TC_Transceiver记录, RedisConnection各自持有一个计数器
+*/
+class TC_Redis_Conn_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_Conn_Holder>
+{
+public:
+    TC_Redis_Conn_Holder()
+        : _bEnable(true)
+        , _iSeq(0)
+    {
+    }
+
+    /**
+    * @brief 开关连接统计, 默认开启
+    */
+    void setEnable(bool bEnable) { _bEnable = bEnable; }
+
+    bool isEnable() const { return _bEnable; }
+
+    /**
+    * @brief 发送时在网络线程上取连接的计数器, 同一个连接只会在一个网络线程上收发.
+    *        TC_Transceiver销毁时没有通知, 按地址记录有两个问题, 分别处理:
+    *        地址被其他obj的连接复用时注销旧的计数器; 空闲超过kIdleTime的连接注销, 再次使用时按新连接计
+    *
+    * @param pConn  连接(TC_Transceiver)
+    * @param sObj   obj名
+    * @param pNew   返回是否为新的计数器
+    */
+    RedisConnCounter *getProxyCounter(const void *pConn, const string &sObj, bool *pNew = NULL)
+    {
+        Local &local = getLocal();
+
+        if (++local.iCalls >= kSweepCalls)
+        {
+            sweep(local);
+        }
+
+        LocalConn &conn = local.mConn[pConn];
+
+        if (conn.counter && conn.counter->getObj() != sObj)
+        {
+            remove(conn.counter);
+            conn.counter.reset();
+        }
+
+        if (pNew != NULL)
+        {
+            *pNew = !conn.counter;
+        }
+
+        if (!conn.counter)
+        {
+            conn.counter = create(sObj, "proxy");
+        }
+
+        conn.iSweep = local.iSweep;
+
+        return conn.counter.get();
+    }
+
+    /**
+    * @brief 接收时取发送时登记的计数器(obj名由发送时确定), 没有返回NULL
+    */
+    RedisConnCounter *findProxyCounter(const void *pConn)
+    {
+        Local &local = getLocal();
+
+        unordered_map<const void*, LocalConn>::iterator it = local.mConn.find(pConn);
+
+        if (it == local.mConn.end())
+        {
+            return NULL;
+        }
+
+        it->second.iSweep = local.iSweep;
+
+        return it->second.counter.get();
+    }
+
+    /**
+    * @brief obj级别的计数器, 记录无法对应到某条连接的事件(如ServantProxy的调用超时)
+    */
+    RedisConnCounter *getObjCounter(const string &sObj)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        RedisConnCounterPtr &counter = _mObj[sObj];
+
+        if (!counter)
+        {
+            counter = std::make_shared<RedisConnCounter>(sObj, "*");
+            _vCounter.push_back(counter);
+        }
+
+        return counter.get();
+    }
+
+    /**
+    * @brief 创建并登记一个连接的计数器
+    *
+    * @param sType  proxy或conn, 与序号组成连接标识
+    */
+    RedisConnCounterPtr create(const string &sObj, const string &sType)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        RedisConnCounterPtr counter = std::make_shared<RedisConnCounter>(sObj, sType + "#" + TC_Common::tostr(++_iSeq));
+
+        _vCounter.push_back(counter);
+
+        return counter;
+    }
+
+    /**
+    * @brief 连接销毁时注销, 已累计的数据并入obj级别的计数器的上报基线, 上报值不会倒退
+    */
+    void remove(const RedisConnCounterPtr &counter)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (size_t i = 0; i < _vCounter.size(); i++)
+        {
+            if (_vCounter[i] == counter)
+            {
+                RedisConnStat stat;
+                counter->getStat(stat);
+
+                Report &report = _mReport[counter->getObj()];
+                report.vRemoved[0] += stat.iBytesSent;
+                report.vRemoved[1] += stat.iBytesRecv;
+                report.vRemoved[2] += stat.iConnects;
+                report.vRemoved[3] += stat.iAuthFailed;
+                report.vRemoved[4] += stat.iTimeouts;
+
+                _vCounter.erase(_vCounter.begin() + i);
+                break;
+            }
+        }
+    }
+
+    /**
+    * @brief 各连接当前的统计
+    */
+    vector<RedisConnStat> getStat()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        vector<RedisConnStat> vStat(_vCounter.size());
+
+        for (size_t i = 0; i < _vCounter.size(); i++)
+        {
+            _vCounter[i]->getStat(vStat[i]);
+        }
+
+        return vStat;
+    }
+
+    /**
+    * @brief 按obj汇总上报一个周期的连接统计, 由TC_Redis_Stat_Holder::report调用.
+    *        属性名: Redis.<obj>.conn.<bytes_sent|bytes_recv|connects|auth_failed|timeouts>为周期内的增量,
+    *        Redis.<obj>.conn.<in_flight|max_pipeline|max_buffer>为当前值/历史最大值
+    */
+    void report(StatReport *stat)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        map<string, Report> mCurrent;
+
+        for (size_t i = 0; i < _vCounter.size(); i++)
+        {
+            RedisConnStat conn;
+            _vCounter[i]->getStat(conn);
+
+            Report &cur = mCurrent[conn.sObj];
+            cur.vTotal[0] += conn.iBytesSent;
+            cur.vTotal[1] += conn.iBytesRecv;
+            cur.vTotal[2] += conn.iConnects;
+            cur.vTotal[3] += conn.iAuthFailed;
+            cur.vTotal[4] += conn.iTimeouts;
+            cur.iInFlight += conn.iInFlight;
+            cur.iMaxInFlight = std::max(cur.iMaxInFlight, conn.iMaxInFlight);
+            cur.iMaxBuffer   = std::max(cur.iMaxBuffer, conn.iMaxBuffer);
+        }
+
+        static const char *kName[kTotal] = { "bytes_sent", "bytes_recv", "connects", "auth_failed", "timeouts" };
+
+        for (map<string, Report>::iterator it = mCurrent.begin(); it != mCurrent.end(); ++it)
+        {
+            Report &report = _mReport[it->first];
+
+            if (report.vProperty.empty())
+            {
+                string sPrefix = "Redis." + it->first + ".conn.";
+
+                for (size_t i = 0; i < kTotal; i++)
+                {
+                    report.vProperty.push_back(stat->createPropertyReport(sPrefix + kName[i], PropertyReport::sum()));
+                }
+
+                report.vProperty.push_back(stat->createPropertyReport(sPrefix + "in_flight", PropertyReport::avg()));
+                report.vProperty.push_back(stat->createPropertyReport(sPrefix + "max_pipeline", PropertyReport::max()));
+                report.vProperty.push_back(stat->createPropertyReport(sPrefix + "max_buffer", PropertyReport::max()));
+            }
+
+            for (size_t i = 0; i < kTotal; i++)
+            {
+                uint64_t iTotal = it->second.vTotal[i] + report.vRemoved[i];
+
+                report.vProperty[i]->report(iTotal - report.vTotal[i]);
+                report.vTotal[i] = iTotal;
+            }
+
+            report.vProperty[kTotal]->report(it->second.iInFlight);
+            report.vProperty[kTotal + 1]->report(it->second.iMaxInFlight);
+            report.vProperty[kTotal + 2]->report(it->second.iMaxBuffer);
+        }
+    }
+
+protected:
+    enum { kTotal = 5 };
+
+    /**
+    * @brief 一个obj的汇总: 累计值(上次上报时), 已注销连接的累计值, 当前值
+    */
+    struct Report
+    {
+        Report() : iInFlight(0), iMaxInFlight(0), iMaxBuffer(0)
+        {
+            for (size_t i = 0; i < kTotal; i++)
+            {
+                vTotal[i]   = 0;
+                vRemoved[i] = 0;
+            }
+        }
+
+        uint64_t                    vTotal[kTotal];
+        uint64_t                    vRemoved[kTotal];
+        uint64_t                    iInFlight;
+        uint64_t                    iMaxInFlight;
+        uint64_t                    iMaxBuffer;
+
+        vector<PropertyReportPtr>   vProperty;
+    };
+
+    enum
+    {
+        /**
+        * 每取这么多次计数器检查一次空闲连接
+        */
+        kSweepCalls = 1024,
+    };
+
+    /**
+    * 连接空闲多久后注销(微秒)
+    */
+    static const int64_t kIdleTime = 30 * 60 * 1000000LL;
+
+    struct LocalConn
+    {
+        LocalConn() : iSweep(0) {}
+
+        RedisConnCounterPtr counter;
+
+        /**
+        * 最后一次使用时的清理轮次
+        */
+        uint32_t            iSweep;
+    };
+
+    /**
+    * @brief 网络线程私有的连接表
+    */
+    struct Local
+    {
+        Local() : iCalls(0), iSweep(0), iLastSweep(0) {}
+
+        unordered_map<const void*, LocalConn>   mConn;
+
+        uint32_t                                iCalls;
+
+        uint32_t                                iSweep;
+
+        int64_t                                 iLastSweep;
+    };
+
+    static Local &getLocal()
+    {
+        static thread_local Local local;
+
+        return local;
+    }
+
+    /**
+    * @brief 每kIdleTime进入新的一轮, 上一轮中没有使用过的连接注销
+    */
+    void sweep(Local &local)
+    {
+        local.iCalls = 0;
+
+        int64_t iNow = TC_Common::now2us();
+
+        if (local.iLastSweep == 0)
+        {
+            local.iLastSweep = iNow;
+            return;
+        }
+
+        if (iNow - local.iLastSweep < kIdleTime)
+        {
+            return;
+        }
+
+        for (unordered_map<const void*, LocalConn>::iterator it = local.mConn.begin(); it != local.mConn.end(); )
+        {
+            if (it->second.iSweep != local.iSweep)
+            {
+                remove(it->second.counter);
+                it = local.mConn.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        ++local.iSweep;
+        local.iLastSweep = iNow;
+    }
+
+protected:
+    bool                            _bEnable;
+
+    uint64_t                        _iSeq;
+
+    std::mutex                      _mutex;
+
+    /**
+    * 登记的计数器, 由汇总方持有
+    */
+    vector<RedisConnCounterPtr>     _vCounter;
+
+    map<string, RedisConnCounterPtr> _mObj;
+
+    map<string, Report>             _mReport;
+};
+
+/**
+* @brief 一个热点key
+*/
+struct RedisHotKey
+{
+    /**
+    * 第一次把该key计入候选的proxy的obj名
+    */
+    string   sObj;
+
+    string   sKey;
+
+    /**
+    * 周期内访问次数的估计值(count-min, 只会高估)
+    */
+    uint64_t iCount;
+};
+
+/**
+* @brief 热点key统计.
+*
+* 每个线程把请求的key(命令的第一个参数)计入本线程的count-min sketch, 并维护本线程估计值最大的一批候选key;
+* 周期结束后第一个记录或查询的线程把各线程的sketch相加, 用合并后的估计值从所有候选中选出top-K.
+* 记录时只锁本线程的数据, 只在合并时才与合并方竞争. 默认关闭.
+*/
+class TC_Redis_HotKey_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_HotKey_Holder>
+{
+public:
+    TC_Redis_HotKey_Holder()
+        : _bEnable(false)
+        , _bCacheUsed(false)
+        , _iInterval(10)
+        , _iTopK(16)
+        , _iHotCount(1000)
+        , _iWidth(4096)
+        , _iDepth(4)
+        , _iWindow(0)
+        , _iLastBegin(0)
+        , _iLastTotal(0)
+        , _iReportBegin(0)
+        , _iGen(0)
+    {
+        //第一个slot不属于任何线程, 存放已退出线程在当前周期的数据
+        _vSlot.push_back(std::make_shared<Slot>());
+
+        resetSlot(*_vSlot[0]);
+    }
+
+    /**
+    * @brief 配置并开启, 新的sketch大小从下一个周期生效
+    *
+    * @param iTopK      每个周期保留的key数, 0 关闭
+    * @param iInterval  周期(秒)
+    * @param iHotCount  top-K中周期内估计次数不小于该值的才算热点(用于上报的热点数及本地缓存)
+    * @param iWidth     sketch每行的计数器数(向上取整到2的幂), 估计值高出 周期内总次数*e/iWidth 的概率约为 e^-iDepth
+    * @param iDepth     sketch的行数
+    */
+    void setConf(size_t iTopK, int iInterval = 10, uint64_t iHotCount = 1000, size_t iWidth = 4096, size_t iDepth = 4)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _iTopK     = iTopK;
+        _iInterval = iInterval > 0 ? iInterval : 10;
+        _iHotCount = iHotCount;
+        _iWidth    = 1;
+        _iDepth    = std::max<size_t>(1, std::min<size_t>(iDepth, 16));
+
+        while (_iWidth < iWidth && _iWidth < (1 << 24))
+        {
+            _iWidth <<= 1;
+        }
+
+        _bEnable = iTopK > 0;
+    }
+
+    bool isEnable() const { return _bEnable.load(std::memory_order_relaxed); }
+
+    /**
+    * @brief 有proxy开启了热点key本地缓存, 都未开启时请求不必查询缓存
+    */
+    void setCacheUsed() { _bCacheUsed = true; }
+
+    bool isCacheUsed() const { return _bCacheUsed.load(std::memory_order_relaxed); }
+
+    /**
+    * @brief 记录一次key的访问
+    *
+    * @param getObj  取obj名, 仅在key进入本线程候选时调用
+    * @param iNow    当前时间(微秒)
+    */
+    template<typename GetObj>
+    void record(const GetObj &getObj, const char *pKey, size_t iLen, int64_t iNow)
+    {
+        if (!isEnable())
+        {
+            return;
+        }
+
+        int64_t iWindow = iNow / (_iInterval.load(std::memory_order_relaxed) * 1000000LL);
+
+        if (iWindow != _iWindow.load(std::memory_order_relaxed))
+        {
+            roll(iWindow, false);
+        }
+
+        Slot &slot = local();
+
+        uint64_t iHash = hash(pKey, iLen);
+        uint64_t iRow  = iHash;
+
+        std::lock_guard<std::mutex> lock(slot.mutex);
+
+        uint64_t iEstimate = UINT32_MAX;
+
+        for (size_t i = 0; i < slot.iDepth; i++)
+        {
+            uint32_t &iCount = slot.vCount[i * slot.iWidth + index(iRow, slot.iWidth)];
+
+            if (iCount < UINT32_MAX)
+            {
+                ++iCount;
+            }
+
+            iEstimate = std::min<uint64_t>(iEstimate, iCount);
+        }
+
+        ++slot.iTotal;
+
+        //候选已满时, 不超过候选中最小估计值的key直接跳过, 冷key不做任何拷贝
+        if (slot.mCandidate.size() >= slot.iCapacity && iEstimate <= slot.iMin)
+        {
+            return;
+        }
+
+        unordered_map<uint64_t, Candidate>::iterator it = slot.mCandidate.find(iHash);
+
+        if (it != slot.mCandidate.end())
+        {
+            it->second.iCount = iEstimate;
+            return;
+        }
+
+        if (slot.mCandidate.size() >= slot.iCapacity)
+        {
+            unordered_map<uint64_t, Candidate>::iterator itMin = slot.mCandidate.begin();
+
+            for (it = slot.mCandidate.begin(); it != slot.mCandidate.end(); ++it)
+            {
+                if (it->second.iCount < itMin->second.iCount)
+                {
+                    itMin = it;
+                }
+            }
+
+            slot.mCandidate.erase(itMin);
+        }
+
+        Candidate &candidate = slot.mCandidate[iHash];
+        candidate.sObj   = getObj();
+        candidate.sKey.assign(pKey, iLen);
+        candidate.iCount = iEstimate;
+
+        if (slot.mCandidate.size() >= slot.iCapacity)
+        {
+            slot.iMin = UINT64_MAX;
+
+            for (it = slot.mCandidate.begin(); it != slot.mCandidate.end(); ++it)
+            {
+                slot.iMin = std::min(slot.iMin, it->second.iCount);
+            }
+        }
+    }
+
+    /**
+    * @brief 上一个完整周期的top-K, 按估计次数从大到小
+    *
+    * @param iBegin  返回该周期的开始时间(毫秒)
+    * @param iTotal  返回该周期记录的总次数
+    */
+    void getHotKeys(vector<RedisHotKey> &vKey, int64_t &iBegin, uint64_t &iTotal)
+    {
+        roll(TC_Common::now2us() / (_iInterval.load(std::memory_order_relaxed) * 1000000LL), true);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        vKey   = _vLast;
+        iBegin = _iLastBegin;
+        iTotal = _iLastTotal;
+    }
+
+    /**
+    * @brief 上一个完整周期的top-K以文本输出, 每行一个key
+    */
+    string dump()
+    {
+        vector<RedisHotKey> vKey;
+        int64_t iBegin  = 0;
+        uint64_t iTotal = 0;
+
+        getHotKeys(vKey, iBegin, iTotal);
+
+        ostringstream os;
+
+        os << "interval:" << TC_Common::tm2str(iBegin / 1000) << "|total:" << iTotal << endl;
+
+        for (size_t i = 0; i < vKey.size(); i++)
+        {
+            os << vKey[i].sObj << "|" << vKey[i].sKey << "|" << vKey[i].iCount << endl;
+        }
+
+        return os.str();
+    }
+
+    /**
+    * @brief key在上一个完整周期是否为热点(top-K且估计次数不小于iHotCount).
+    *        热点集合按周期复制到本线程, 查询不加锁
+    */
+    bool isHot(const string &sKey)
+    {
+        HotSet &hot = localHot();
+
+        uint64_t iGen = _iGen.load(std::memory_order_acquire);
+
+        if (hot.iGen != iGen)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            hot.sKey = _sHot;
+            hot.iGen = _iGen.load(std::memory_order_relaxed);
+        }
+
+        return hot.sKey.count(sKey) > 0;
+    }
+
+    /**
+    * @brief 按obj上报上一个完整周期: Redis.<obj>.hotkey.max 最热key的估计次数, Redis.<obj>.hotkey.hot 热点key数.
+    *        由TC_Redis_Stat_Holder::report调用
+    */
+    void report(StatReport *stat)
+    {
+        if (!isEnable())
+        {
+            return;
+        }
+
+        roll(TC_Common::now2us() / (_iInterval.load(std::memory_order_relaxed) * 1000000LL), true);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_iLastBegin == _iReportBegin)
+        {
+            return;
+        }
+
+        _iReportBegin = _iLastBegin;
+
+        map<string, pair<uint64_t, uint64_t> > mObj;
+
+        for (size_t i = 0; i < _vLast.size(); i++)
+        {
+            pair<uint64_t, uint64_t> &obj = mObj[_vLast[i].sObj];
+
+            obj.first = std::max(obj.first, _vLast[i].iCount);
+
+            if (_vLast[i].iCount >= _iHotCount)
+            {
+                ++obj.second;
+            }
+        }
+
+        for (map<string, pair<uint64_t, uint64_t> >::iterator it = mObj.begin(); it != mObj.end(); ++it)
+        {
+            vector<PropertyReportPtr> &vProperty = _mProperty[it->first];
+
+            if (vProperty.empty())
+            {
+                string sPrefix = "Redis." + it->first + ".hotkey.";
+
+                vProperty.push_back(stat->createPropertyReport(sPrefix + "max", PropertyReport::max()));
+                vProperty.push_back(stat->createPropertyReport(sPrefix + "hot", PropertyReport::max()));
+            }
+
+            vProperty[0]->report(it->second.first);
+            vProperty[1]->report(it->second.second);
+        }
+    }
+
+protected:
+    struct Candidate
+    {
+        string   sObj;
+
+        string   sKey;
+
+        uint64_t iCount;
+    };
+
+    /**
+    * @brief 一个线程的sketch及候选, 由汇总方持有, 线程退出时并入_vSlot[0]后注销
+    */
+    struct Slot
+    {
+        Slot() : iWidth(0), iDepth(0), iTotal(0), iCapacity(0), iMin(0) {}
+
+        std::mutex                          mutex;
+
+        /**
+        * iDepth行, 每行iWidth个计数器
+        */
+        size_t                              iWidth;
+
+        size_t                              iDepth;
+
+        vector<uint32_t>                    vCount;
+
+        uint64_t                            iTotal;
+
+        /**
+        * 候选key, 以key的哈希为索引; 容量为top-K的4倍
+        */
+        unordered_map<uint64_t, Candidate>  mCandidate;
+
+        size_t                              iCapacity;
+
+        uint64_t                            iMin;
+    };
+
+    typedef shared_ptr<Slot> SlotPtr;
+
+    /**
+    * @brief 本线程复制的热点集合
+    */
+    struct HotSet
+    {
+        HotSet() : iGen(UINT64_MAX) {}
+
+        uint64_t                iGen;
+
+        unordered_set<string>   sKey;
+    };
+
+    static uint64_t hash(const char *p, size_t iLen)
+    {
+        uint64_t iHash = 14695981039346656037ULL;
+
+        for (size_t i = 0; i < iLen; i++)
+        {
+            iHash = (iHash ^ (unsigned char)p[i]) * 1099511628211ULL;
+        }
+
+        //FNV-1a的高位混合较弱, 再做一次finalizer
+        iHash ^= iHash >> 33;
+        iHash *= 0xff51afd7ed558ccdULL;
+        iHash ^= iHash >> 33;
+
+        return iHash;
+    }
+
+    /**
+    * @brief 下一行的计数器下标. 每行由哈希再做一步LCG得到, 行之间互不相关
+    *        (h1 + i * h2的双重哈希在宽度为2的幂时, 低位相同的两个key会在所有行上冲突)
+    */
+    static size_t index(uint64_t &iRow, size_t iWidth)
+    {
+        iRow = iRow * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        return (size_t)(iRow >> 32) & (iWidth - 1);
+    }
+
+    /**
+    * @brief 按当前配置清空一个线程的数据, 调用方持有slot.mutex及_mutex
+    */
+    void resetSlot(Slot &slot)
+    {
+        slot.iWidth    = _iWidth;
+        slot.iDepth    = _iDepth;
+        slot.iTotal    = 0;
+        slot.iCapacity = std::max<size_t>(_iTopK * 4, 1);
+        slot.iMin      = 0;
+
+        slot.vCount.assign(slot.iWidth * slot.iDepth, 0);
+        slot.mCandidate.clear();
+    }
+
+    /**
+    * @brief 线程私有的slot登记, 线程退出时注销
+    */
+    struct LocalSlot
+    {
+        LocalSlot() : holder(NULL), slot(NULL) {}
+
+        ~LocalSlot()
+        {
+            if (holder != NULL)
+            {
+                holder->retire(slot);
+            }
+        }
+
+        TC_Redis_HotKey_Holder  *holder;
+
+        Slot                    *slot;
+    };
+
+    Slot &local()
+    {
+        static thread_local LocalSlot local;
+
+        if (local.slot == NULL)
+        {
+            SlotPtr ptr = std::make_shared<Slot>();
+
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            resetSlot(*ptr);
+
+            _vSlot.push_back(ptr);
+
+            local.holder = this;
+            local.slot   = ptr.get();
+        }
+
+        return *local.slot;
+    }
+
+    /**
+    * @brief 线程退出: 当前周期的数据并入_vSlot[0], 并注销其slot.
+    *        候选已满时替换估计值最小的候选
+    */
+    void retire(Slot *pSlot)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (size_t i = 1; i < _vSlot.size(); i++)
+        {
+            if (_vSlot[i].get() != pSlot)
+            {
+                continue;
+            }
+
+            Slot &retired = *_vSlot[0];
+            Slot &slot    = *pSlot;
+
+            std::lock_guard<std::mutex> lockRetired(retired.mutex);
+            std::lock_guard<std::mutex> lockSlot(slot.mutex);
+
+            //配置变化前的数据无法合并, 丢弃
+            if (slot.iWidth == retired.iWidth && slot.iDepth == retired.iDepth)
+            {
+                for (size_t j = 0; j < slot.vCount.size(); j++)
+                {
+                    retired.vCount[j] = (uint32_t)std::min<uint64_t>((uint64_t)retired.vCount[j] + slot.vCount[j], UINT32_MAX);
+                }
+
+                retired.iTotal += slot.iTotal;
+
+                for (unordered_map<uint64_t, Candidate>::iterator it = slot.mCandidate.begin(); it != slot.mCandidate.end(); ++it)
+                {
+                    if (retired.mCandidate.size() >= retired.iCapacity && retired.mCandidate.find(it->first) == retired.mCandidate.end())
+                    {
+                        unordered_map<uint64_t, Candidate>::iterator itMin = retired.mCandidate.begin();
+
+                        for (unordered_map<uint64_t, Candidate>::iterator itRetired = retired.mCandidate.begin(); itRetired != retired.mCandidate.end(); ++itRetired)
+                        {
+                            if (itRetired->second.iCount < itMin->second.iCount)
+                            {
+                                itMin = itRetired;
+                            }
+                        }
+
+                        if (itMin == retired.mCandidate.end() || itMin->second.iCount >= it->second.iCount)
+                        {
+                            continue;
+                        }
+
+                        retired.mCandidate.erase(itMin);
+                    }
+
+                    Candidate &candidate = retired.mCandidate[it->first];
+
+                    if (candidate.sKey.empty())
+                    {
+                        candidate.sObj.swap(it->second.sObj);
+                        candidate.sKey.swap(it->second.sKey);
+                    }
+
+                    candidate.iCount = std::max(candidate.iCount, it->second.iCount);
+                }
+            }
+
+            _vSlot.erase(_vSlot.begin() + i);
+            break;
+        }
+    }
+
+    static HotSet &localHot()
+    {
+        static thread_local HotSet hot;
+
+        return hot;
+    }
+
+    /**
+    * @brief 进入新周期时合并各线程的数据, 结果作为上一个周期
+    *
+    * @param bWait  false 已有线程在合并时直接返回(记录时), true 等待(查询时)
+    */
+    void roll(int64_t iWindow, bool bWait)
+    {
+        std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+
+        if (bWait)
+        {
+            lock.lock();
+        }
+        else if (!lock.try_lock())
+        {
+            return;
+        }
+
+        if (_iWindow.load(std::memory_order_relaxed) == iWindow)
+        {
+            return;
+        }
+
+        vector<uint64_t> vSum(_iWidth * _iDepth, 0);
+        unordered_map<uint64_t, Candidate> mCandidate;
+        uint64_t iTotal = 0;
+
+        for (size_t i = 0; i < _vSlot.size(); i++)
+        {
+            Slot &slot = *_vSlot[i];
+
+            std::lock_guard<std::mutex> lockSlot(slot.mutex);
+
+            //配置变化前的数据无法合并, 丢弃
+            if (slot.iWidth == _iWidth && slot.iDepth == _iDepth)
+            {
+                for (size_t j = 0; j < slot.vCount.size(); j++)
+                {
+                    vSum[j] += slot.vCount[j];
+                }
+
+                iTotal += slot.iTotal;
+
+                for (unordered_map<uint64_t, Candidate>::iterator it = slot.mCandidate.begin(); it != slot.mCandidate.end(); ++it)
+                {
+                    Candidate &candidate = mCandidate[it->first];
+
+                    if (candidate.sKey.empty())
+                    {
+                        candidate.sObj.swap(it->second.sObj);
+                        candidate.sKey.swap(it->second.sKey);
+                    }
+                }
+            }
+
+            resetSlot(slot);
+        }
+
+        vector<RedisHotKey> vKey;
+        vKey.reserve(mCandidate.size());
+
+        for (unordered_map<uint64_t, Candidate>::iterator it = mCandidate.begin(); it != mCandidate.end(); ++it)
+        {
+            uint64_t iRow = it->first;
+
+            RedisHotKey key;
+            key.sObj.swap(it->second.sObj);
+            key.sKey.swap(it->second.sKey);
+            key.iCount = UINT64_MAX;
+
+            for (size_t i = 0; i < _iDepth; i++)
+            {
+                key.iCount = std::min(key.iCount, vSum[i * _iWidth + index(iRow, _iWidth)]);
+            }
+
+            vKey.push_back(key);
+        }
+
+        size_t iTopK = std::min(_iTopK, vKey.size());
+
+        std::partial_sort(vKey.begin(), vKey.begin() + iTopK, vKey.end(), hotter);
+        vKey.resize(iTopK);
+
+        _sHot.clear();
+
+        for (size_t i = 0; i < vKey.size(); i++)
+        {
+            if (vKey[i].iCount >= _iHotCount)
+            {
+                _sHot.insert(vKey[i].sKey);
+            }
+        }
+
+        _vLast.swap(vKey);
+        _iLastBegin = _iWindow.load(std::memory_order_relaxed) * _iInterval.load(std::memory_order_relaxed) * 1000LL;
+        _iLastTotal = iTotal;
+
+        _iWindow.store(iWindow, std::memory_order_relaxed);
+        _iGen.fetch_add(1, std::memory_order_release);
+    }
+
+    static bool hotter(const RedisHotKey &a, const RedisHotKey &b)
+    {
+        return a.iCount > b.iCount;
+    }
+
+protected:
+    std::atomic<bool>                   _bEnable;
+
+    std::atomic<bool>                   _bCacheUsed;
+
+    std::atomic<int>                    _iInterval;
+
+    /**
+    * 以下配置及结果由_mutex保护
+    */
+    std::mutex                          _mutex;
+
+    size_t                              _iTopK;
+
+    uint64_t                            _iHotCount;
+
+    size_t                              _iWidth;
+
+    size_t                              _iDepth;
+
+    vector<SlotPtr>                     _vSlot;
+
+    /**
+    * 当前周期的序号(时间/周期)
+    */
+    std::atomic<int64_t>                _iWindow;
+
+    vector<RedisHotKey>                 _vLast;
+
+    int64_t                             _iLastBegin;
+
+    uint64_t                            _iLastTotal;
+
+    int64_t                             _iReportBegin;
+
+    unordered_set<string>               _sHot;
+
+    std::atomic<uint64_t>               _iGen;
+
+    map<string, vector<PropertyReportPtr> > _mProperty;
+};
+
+/**
+* @brief 命令的指纹: 命令名, 参数个数及key(第二个参数)的指纹, 慢命令与大value记录共用
+*/
+struct RedisCommandFingerprint
+{
+    RedisCommandFingerprint() : iArgc(0), iKeyHash(0) {}
+
+    /**
+    * 命令名(大写)
+    */
+    string   sCmd;
+
+    /**
+    * 参数个数(含命令名)
+    */
+    size_t   iArgc;
+
+    /**
+    * key的64位FNV-1a哈希, 以及数字串替换为'#'后的形式(最长64字节), 如 user:123:info -> user:#:info
+    */
+    uint64_t iKeyHash;
+
+    string   sKeyPattern;
+
+    /**
+    * @brief 从编码后的命令解析
+    */
+    void parse(const string &sCommand)
+    {
+        iArgc    = 0;
+        iKeyHash = 0;
+
+        sCmd.clear();
+        sKeyPattern.clear();
+
+        if (sCommand.empty() || sCommand[0] != '*')
+        {
+            return;
+        }
+
+        iArgc = strtoul(sCommand.c_str() + 1, NULL, 10);
+
+        size_t iPos = sCommand.find('\n');
+
+        for (int i = 0; i < 2 && iPos != string::npos; i++)
+        {
+            size_t iLine = sCommand.find('\n', iPos + 1);
+
+            if (sCommand[iPos + 1] != '$' || iLine == string::npos)
+            {
+                return;
+            }
+
+            size_t iLen = strtoul(sCommand.c_str() + iPos + 2, NULL, 10);
+
+            if (iLine + 1 + iLen > sCommand.size())
+            {
+                return;
+            }
+
+            const char *p = sCommand.data() + iLine + 1;
+
+            if (i == 0)
+            {
+                sCmd.resize(iLen);
+                std::transform(p, p + iLen, sCmd.begin(), ::toupper);
+            }
+            else
+            {
+                iKeyHash = 14695981039346656037ULL;
+
+                for (size_t j = 0; j < iLen; j++)
+                {
+                    iKeyHash = (iKeyHash ^ (unsigned char)p[j]) * 1099511628211ULL;
+
+                    if (sKeyPattern.size() >= 64)
+                    {
+                        continue;
+                    }
+
+                    if (isdigit((unsigned char)p[j]))
+                    {
+                        if (sKeyPattern.empty() || sKeyPattern.back() != '#')
+                        {
+                            sKeyPattern += '#';
+                        }
+                    }
+                    else
+                    {
+                        sKeyPattern += p[j];
+                    }
+                }
+            }
+
+            iPos = iLine + iLen + 2;
+        }
+    }
+};
+
+/**
+* @brief 一条请求或应答超过阈值的命令
+*/
+struct RedisBigValue
+{
+    /**
+    * 时间(毫秒)
+    */
+    int64_t                 iTime;
+
+    string                  sObj;
+
+    /**
+    * 服务端地址 host:port
+    */
+    string                  sEndpoint;
+
+    /**
+    * 调用方: RedisProxy::setCaller设置的当前线程标识, 未设置时为线程id
+    */
+    string                  sCaller;
+
+    RedisCommandFingerprint fingerprint;
+
+    size_t                  iReqBytes;
+
+    /**
+    * 应答字节数, 被拒绝的请求为0
+    */
+    size_t                  iRspBytes;
+
+    /**
+    * 请求超过上限被拒绝(未发送)
+    */
+    bool                    bRejected;
+};
+
+/**
+* @brief 大value检测: 请求/应答超过告警阈值的命令计数, 记录最近的N条并输出日志;
+*        请求超过上限时拒绝或拆分; 可选按命令统计请求/应答大小的直方图
+*/
+class TC_Redis_BigValue_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_BigValue_Holder>
+{
+public:
+    TC_Redis_BigValue_Holder()
+        : _iWarnReq(1024 * 1024)
+        , _iWarnRsp(1024 * 1024)
+        , _iLimit(SIZE_MAX)
+        , _bSplit(false)
+        , _bSizeStat(false)
+        , _iCapacity(32)
+        , _iLogPerSecond(10)
+        , _iLogSecond(0)
+        , _iLogCount(0)
+    {
+    }
+
+    /**
+    * @brief 配置
+    *
+    * @param iWarnReq   请求不小于该字节数时记录, 0 不检测
+    * @param iWarnRsp   应答不小于该字节数时记录, 0 不检测
+    * @param iLimit     请求超过该字节数时不发送, 0 不限制
+    * @param bSplit     超过上限的MSET/HMSET/HSET/SADD/LPUSH/RPUSH拆成多条发送(不再是原子操作), 否则拒绝
+    * @param iCapacity  保留最近的记录条数
+    */
+    void setConf(size_t iWarnReq, size_t iWarnRsp, size_t iLimit = 0, bool bSplit = false, size_t iCapacity = 32)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _iWarnReq  = iWarnReq > 0 ? iWarnReq : SIZE_MAX;
+        _iWarnRsp  = iWarnRsp > 0 ? iWarnRsp : SIZE_MAX;
+        _iLimit    = iLimit > 0 ? iLimit : SIZE_MAX;
+        _bSplit    = bSplit;
+        _iCapacity = iCapacity > 0 ? iCapacity : 1;
+
+        while (_dqLast.size() > _iCapacity)
+        {
+            _dqLast.pop_front();
+        }
+    }
+
+    /**
+    * @brief 开关按命令统计请求/应答大小(字节), 默认关闭.
+    *        与延时一起统计和上报, 命令名为 size.req.<命令> 及 size.rsp.<命令>
+    */
+    void setSizeStat(bool bEnable) { _bSizeStat = bEnable; }
+
+    bool isSizeStat() const { return _bSizeStat.load(std::memory_order_relaxed); }
+
+    bool isBig(size_t iReqBytes, size_t iRspBytes) const
+    {
+        return iReqBytes >= _iWarnReq.load(std::memory_order_relaxed) || iRspBytes >= _iWarnRsp.load(std::memory_order_relaxed);
+    }
+
+    bool isLimited(size_t iReqBytes) const
+    {
+        return iReqBytes > _iLimit.load(std::memory_order_relaxed);
+    }
+
+    size_t getLimit() const { return _iLimit.load(std::memory_order_relaxed); }
+
+    bool isSplit() const { return _bSplit.load(std::memory_order_relaxed); }
+
+    /**
+    * @brief 设置当前线程的调用方标识, 空串清除
+    */
+    static void setCaller(const string &sCaller)
+    {
+        caller() = sCaller;
+    }
+
+    /**
+    * @brief 记录一条, 超过每秒的日志条数后只计数
+    *
+    * @param sCommand  编码后的命令, 从中取命令名及key指纹
+    */
+    void add(RedisBigValue &big, const string &sCommand)
+    {
+        big.fingerprint.parse(sCommand);
+        big.sCaller = caller();
+
+        if (big.sCaller.empty())
+        {
+            ostringstream os;
+            os << "tid:" << std::this_thread::get_id();
+            big.sCaller = os.str();
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        pair<uint64_t, uint64_t> &count = _mCount[big.sObj];
+
+        if (big.iReqBytes >= _iWarnReq.load(std::memory_order_relaxed))
+        {
+            ++count.first;
+        }
+
+        if (big.iRspBytes >= _iWarnRsp.load(std::memory_order_relaxed))
+        {
+            ++count.second;
+        }
+
+        _dqLast.push_back(big);
+
+        if (_dqLast.size() > _iCapacity)
+        {
+            _dqLast.pop_front();
+        }
+
+        int64_t iSecond = big.iTime / 1000;
+
+        if (iSecond != _iLogSecond)
+        {
+            _iLogSecond = iSecond;
+            _iLogCount  = 0;
+        }
+
+        if (_iLogCount++ < _iLogPerSecond)
+        {
+            ostringstream os;
+            print(os, big);
+
+            LOG_CONSOLE_DEBUG << "redis big value|" << os.str();
+        }
+    }
+
+    /**
+    * @brief 最近的记录, 从新到旧
+    */
+    vector<RedisBigValue> getBigValues()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return vector<RedisBigValue>(_dqLast.rbegin(), _dqLast.rend());
+    }
+
+    /**
+    * @brief 最近的记录以文本输出, 每行一条
+    */
+    string dump()
+    {
+        vector<RedisBigValue> vBig = getBigValues();
+
+        ostringstream os;
+
+        for (size_t i = 0; i < vBig.size(); i++)
+        {
+            print(os, vBig[i]);
+        }
+
+        return os.str();
+    }
+
+    /**
+    * @brief 按obj上报周期内的次数: Redis.<obj>.bigvalue.req 大请求(含被拒绝的), Redis.<obj>.bigvalue.rsp 大应答.
+    *        由TC_Redis_Stat_Holder::report调用
+    */
+    void report(StatReport *stat)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (map<string, pair<uint64_t, uint64_t> >::iterator it = _mCount.begin(); it != _mCount.end(); ++it)
+        {
+            Report &report = _mReport[it->first];
+
+            if (report.vProperty.empty())
+            {
+                string sPrefix = "Redis." + it->first + ".bigvalue.";
+
+                report.vProperty.push_back(stat->createPropertyReport(sPrefix + "req", PropertyReport::sum()));
+                report.vProperty.push_back(stat->createPropertyReport(sPrefix + "rsp", PropertyReport::sum()));
+            }
+
+            report.vProperty[0]->report(it->second.first - report.iLastReq);
+            report.vProperty[1]->report(it->second.second - report.iLastRsp);
+
+            report.iLastReq = it->second.first;
+            report.iLastRsp = it->second.second;
+        }
+    }
+
+protected:
+    struct Report
+    {
+        Report() : iLastReq(0), iLastRsp(0) {}
+
+        uint64_t                    iLastReq;
+
+        uint64_t                    iLastRsp;
+
+        vector<PropertyReportPtr>   vProperty;
+    };
+
+    static string &caller()
+    {
+        static thread_local string sCaller;
+
+        return sCaller;
+    }
+
+    static void print(ostream &os, const RedisBigValue &big)
+    {
+        os << TC_Common::tm2str(big.iTime / 1000) << "|" << big.sEndpoint << "|" << big.fingerprint.sCmd
+           << "|argc:" << big.fingerprint.iArgc << "|key:" << big.fingerprint.sKeyPattern
+           << "|hash:" << std::hex << big.fingerprint.iKeyHash << std::dec
+           << "|req:" << big.iReqBytes << "|rsp:" << big.iRspBytes << "|caller:" << big.sCaller
+           << (big.bRejected ? "|rejected" : "") << endl;
+    }
+
+protected:
+    std::atomic<size_t>                         _iWarnReq;
+
+    std::atomic<size_t>                         _iWarnRsp;
+
+    std::atomic<size_t>                         _iLimit;
+
+    std::atomic<bool>                           _bSplit;
+
+    std::atomic<bool>                           _bSizeStat;
+
+    std::mutex                                  _mutex;
+
+    size_t                                      _iCapacity;
+
+    deque<RedisBigValue>                        _dqLast;
+
+    /**
+    * obj -> (大请求数, 大应答数)
+    */
+    map<string, pair<uint64_t, uint64_t> >      _mCount;
+
+    map<string, Report>                         _mReport;
+
+    size_t                                      _iLogPerSecond;
+
+    int64_t                                     _iLogSecond;
+
+    size_t                                      _iLogCount;
+};
+
+/**
+* @brief 一个(obj, 命令)的延时统计, 单位微秒
+*/
+struct RedisLatencyStat
+{
+    string   sObj;
+
+    string   sCmd;
+
+    uint64_t iCount;
+
+    uint64_t iAvg;
+
+    uint64_t iP50;
+
+    uint64_t iP99;
+
+    uint64_t iP999;
+
+    uint64_t iMax;
+};
+
+/**
+* @brief 延时统计的汇总及上报
+*/
+class TC_Redis_Stat_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_Stat_Holder>
+{
+public:
+    TC_Redis_Stat_Holder()
+        : _bEnable(true)
+        , _stat(NULL)
+        , _iInterval(60)
+        , _bTerminate(false)
+    {
+    }
+
+    ~TC_Redis_Stat_Holder()
+    {
+        stopReport();
+    }
+
+    /**
+    * @brief 开关延时记录, 默认开启
+    */
+    void setEnable(bool bEnable) { _bEnable = bEnable; }
+
+    bool isEnable() const { return _bEnable; }
+
+    /**
+    * @brief 记录一次调用的耗时
+    *
+    * @param pProxy   调用的proxy, 用于线程内缓存
+    * @param sObj     proxy的obj名, 仅在本线程第一次记录该proxy时使用
+    * @param pCmd     命令名(大写)
+    * @param iCost    耗时(微秒)
+    */
+    template<typename GetObj>
+    void record(const void *pProxy, const GetObj &getObj, const char *pCmd, size_t iCmdLen, uint64_t iCost)
+    {
+        if (!_bEnable)
+        {
+            return;
+        }
+
+        LocalCache &cache = local();
+
+        if (cache.pProxy != pProxy || cache.sCmd.compare(0, string::npos, pCmd, iCmdLen) != 0)
+        {
+            unordered_map<string, RedisHistogram*> &mHist = cache.mProxy[pProxy];
+
+            cache.sCmd.assign(pCmd, iCmdLen);
+
+            RedisHistogram *&hist = mHist[cache.sCmd];
+
+            if (hist == NULL)
+            {
+                hist = create(getObj(), cache.sCmd);
+            }
+
+            cache.pProxy = pProxy;
+            cache.pHist  = hist;
+        }
+
+        cache.pHist->record(iCost);
+    }
+
+    /**
+    * @brief 累计的延时统计(各线程合并)
+    */
+    vector<RedisLatencyStat> getStat()
+    {
+        vector<RedisLatencyStat> vStat;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (map<pair<string, string>, Entry>::iterator it = _mEntry.begin(); it != _mEntry.end(); ++it)
+        {
+            vector<uint64_t> vBucket;
+            uint64_t iCount = 0, iSum = 0, iMax = 0;
+
+            merge(it->second, vBucket, iCount, iSum, iMax);
+
+            vStat.push_back(toStat(it->first, vBucket, iCount, iSum, iMax));
+        }
+
+        return vStat;
+    }
+
+    /**
+    * @brief 按周期把每个(obj, 命令)在该周期内的次数, 平均, p50/p99/p999, 最大延时上报到tars属性.
+    *        属性名: Redis.<obj>.<命令>.<count|avg|p50|p99|p999|max>
+    *
+    * @param stat       tars的StatReport(Communicator::getStatReport())
+    * @param iInterval  上报周期(秒), 与tars属性的统计周期一致时每个周期一个值
+    */
+    void startReport(StatReport *stat, int iInterval = 60)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _stat      = stat;
+        _iInterval = iInterval > 0 ? iInterval : 60;
+
+        if (!_reportThread.joinable() && _stat != NULL)
+        {
+            _bTerminate   = false;
+            _reportThread = std::thread(&TC_Redis_Stat_Holder::reportLoop, this);
+        }
+    }
+
+    void stopReport()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _bTerminate = true;
+            _cond.notify_all();
+        }
+
+        if (_reportThread.joinable())
+        {
+            _reportThread.join();
+        }
+    }
+
+    /**
+    * @brief 上报一个周期的统计, 由上报线程调用, 也可以由业务自己的定时器调用
+    */
+    void report(StatReport *stat)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (map<pair<string, string>, Entry>::iterator it = _mEntry.begin(); it != _mEntry.end(); ++it)
+        {
+            Entry &entry = it->second;
+
+            vector<uint64_t> vBucket;
+            uint64_t iCount = 0, iSum = 0, iMax = 0;
+
+            merge(entry, vBucket, iCount, iSum, iMax);
+
+            //与上次的差即本周期的分布
+            vector<uint64_t> vInterval(vBucket);
+
+            for (size_t i = 0; i < entry.vLastBucket.size() && i < vInterval.size(); i++)
+            {
+                vInterval[i] -= entry.vLastBucket[i];
+            }
+
+            uint64_t iIntervalCount = iCount - entry.iLastCount;
+            uint64_t iIntervalSum   = iSum - entry.iLastSum;
+
+            entry.vLastBucket.swap(vBucket);
+            entry.iLastCount = iCount;
+            entry.iLastSum   = iSum;
+
+            if (iIntervalCount == 0)
+            {
+                continue;
+            }
+
+            if (entry.vProperty.empty())
+            {
+                string sPrefix = "Redis." + it->first.first + "." + it->first.second + ".";
+
+                entry.vProperty.push_back(stat->createPropertyReport(sPrefix + "count", PropertyReport::sum()));
+                entry.vProperty.push_back(stat->createPropertyReport(sPrefix + "avg", PropertyReport::avg()));
+                entry.vProperty.push_back(stat->createPropertyReport(sPrefix + "p50", PropertyReport::avg()));
+                entry.vProperty.push_back(stat->createPropertyReport(sPrefix + "p99", PropertyReport::avg()));
+                entry.vProperty.push_back(stat->createPropertyReport(sPrefix + "p999", PropertyReport::avg()));
+                entry.vProperty.push_back(stat->createPropertyReport(sPrefix + "max", PropertyReport::max()));
+            }
+
+            entry.vProperty[0]->report(iIntervalCount);
+            entry.vProperty[1]->report(iIntervalSum / iIntervalCount);
+            entry.vProperty[2]->report(RedisHistogram::percentile(vInterval, iIntervalCount, 0.5));
+            entry.vProperty[3]->report(RedisHistogram::percentile(vInterval, iIntervalCount, 0.99));
+            entry.vProperty[4]->report(RedisHistogram::percentile(vInterval, iIntervalCount, 0.999));
+            entry.vProperty[5]->report(RedisHistogram::percentile(vInterval, iIntervalCount, 1.0));
+        }
+
+        TC_Redis_Conn_Holder::getInstance()->report(stat);
+
+        TC_Redis_HotKey_Holder::getInstance()->report(stat);
+
+        TC_Redis_BigValue_Holder::getInstance()->report(stat);
+    }
+
+protected:
+    struct Entry
+    {
+        Entry() : iLastCount(0), iLastSum(0) {}
+
+        /**
+        * 各线程的直方图
+        */
+        vector<RedisHistogramPtr>   vHist;
+
+        /**
+        * 上次上报时的累计值
+        */
+        vector<uint64_t>            vLastBucket;
+        uint64_t                    iLastCount;
+        uint64_t                    iLastSum;
+
+        vector<PropertyReportPtr>   vProperty;
+    };
+
+    /**
+    * @brief 线程内缓存: proxy -> 命令 -> 本线程的直方图, 及上次命中的项
+    */
+    struct LocalCache
+    {
+        LocalCache() : pProxy(NULL), pHist(NULL) {}
+
+        unordered_map<const void*, unordered_map<string, RedisHistogram*> > mProxy;
+
+        const void     *pProxy;
+
+        string          sCmd;
+
+        RedisHistogram *pHist;
+    };
+
+    static LocalCache &local()
+    {
+        static thread_local LocalCache cache;
+
+        return cache;
+    }
+
+    /**
+    * @brief 为当前线程创建直方图, 由汇总方持有, 线程退出后数据仍保留
+    */
+    RedisHistogram *create(const string &sObj, const string &sCmd)
+    {
+        RedisHistogramPtr hist = std::make_shared<RedisHistogram>();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _mEntry[make_pair(sObj, sCmd)].vHist.push_back(hist);
+
+        return hist.get();
+    }
+
+    static void merge(const Entry &entry, vector<uint64_t> &vBucket, uint64_t &iCount, uint64_t &iSum, uint64_t &iMax)
+    {
+        vBucket.assign(RedisHistogram::kBuckets, 0);
+
+        for (size_t i = 0; i < entry.vHist.size(); i++)
+        {
+            entry.vHist[i]->mergeTo(vBucket, iCount, iSum, iMax);
+        }
+    }
+
+    static RedisLatencyStat toStat(const pair<string, string> &key, const vector<uint64_t> &vBucket, uint64_t iCount, uint64_t iSum, uint64_t iMax)
+    {
+        RedisLatencyStat stat;
+
+        stat.sObj   = key.first;
+        stat.sCmd   = key.second;
+        stat.iCount = iCount;
+        stat.iAvg   = iCount > 0 ? iSum / iCount : 0;
+        stat.iP50   = RedisHistogram::percentile(vBucket, iCount, 0.5);
+        stat.iP99   = RedisHistogram::percentile(vBucket, iCount, 0.99);
+        stat.iP999  = RedisHistogram::percentile(vBucket, iCount, 0.999);
+        stat.iMax   = iMax;
+
+        return stat;
+    }
+
+    void reportLoop()
+    {
+        while (true)
+        {
+            StatReport *stat = NULL;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+
+                _cond.wait_for(lock, std::chrono::seconds(_iInterval), [this]{ return _bTerminate; });
+
+                if (_bTerminate)
+                {
+                    break;
+                }
+
+                stat = _stat;
+            }
+
+            report(stat);
+        }
+    }
+
+protected:
+    std::atomic<bool>                       _bEnable;
+
+    std::mutex                              _mutex;
+
+    std::condition_variable                 _cond;
+
+    map<pair<string, string>, Entry>        _mEntry;
+
+    StatReport                             *_stat;
+
+    int                                     _iInterval;
+
+    bool                                    _bTerminate;
+
+    std::thread                             _reportThread;
+};
+
+/**
+* @brief 一条慢命令
+*/
+struct RedisSlowCommand
+{
+    /**
+    * 完成时间(毫秒)
+    */
+    int64_t  iTime;
+
+    string   sObj;
+
+    string   sCmd;
+
+    /**
+    * 服务端地址 host:port
+    */
+    string   sEndpoint;
+
+    /**
+    * 参数个数(含命令名)
+    */
+    size_t   iArgc;
+
+    /**
+    * key的指纹: 64位FNV-1a哈希, 以及数字串替换为'#'后的形式(最长64字节), 如 user:123:info -> user:#:info
+    */
+    uint64_t iKeyHash;
+
+    string   sKeyPattern;
+
+    /**
+    * 请求/应答字节数
+    */
+    size_t   iReqBytes;
+
+    size_t   iRspBytes;
+
+    /**
+    * 总耗时, 其中等待连接的耗时(阻塞命令的连接池), 网络调用的耗时, 单位微秒
+    */
+    int64_t  iCostUs;
+
+    int64_t  iWaitUs;
+
+    int64_t  iCallUs;
+
+    /**
+    * 是否以异常(超时等)结束
+    */
+    bool     bException;
+};
+
+/**
+* @brief 慢命令记录: 每个周期保留最慢的N条
+*/
+class TC_Redis_SlowLog_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_SlowLog_Holder>
+{
+public:
+    TC_Redis_SlowLog_Holder()
+        : _iThreshold(20000)
+        , _iCapacity(32)
+        , _iSample(1)
+        , _iInterval(60)
+        , _iSlow(0)
+        , _iBegin(TC_Common::now2ms())
+    {
+    }
+
+    /**
+    * @brief 配置
+    *
+    * @param iThreshold  耗时不小于该值(微秒)的命令为慢命令, 0 关闭
+    * @param iCapacity   每个周期保留的最慢命令数
+    * @param iSample     每iSample条慢命令记录1条(1 全部记录)
+    * @param iInterval   周期(秒)
+    */
+    void setConf(int64_t iThreshold, size_t iCapacity = 32, size_t iSample = 1, int iInterval = 60)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _iCapacity = iCapacity > 0 ? iCapacity : 1;
+        _iSample   = iSample > 0 ? iSample : 1;
+        _iInterval = iInterval > 0 ? iInterval : 60;
+
+        _iThreshold = iThreshold > 0 ? iThreshold : INT64_MAX;
+    }
+
+    /**
+    * @brief 是否慢命令, 调用方据此决定是否构造RedisSlowCommand
+    */
+    bool isSlow(int64_t iCost) const
+    {
+        return iCost >= _iThreshold.load(std::memory_order_relaxed);
+    }
+
+    /**
+    * @brief 记录慢命令, 超过本周期容量时只保留最慢的
+    *
+    * @param sCommand  编码后的命令, 从中取命令名及key指纹
+    */
+    void add(RedisSlowCommand &slow, const string &sCommand)
+    {
+        if ((_iSlow++ % _iSample.load(std::memory_order_relaxed)) != 0)
+        {
+            return;
+        }
+
+        fingerprint(sCommand, slow);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        roll(slow.iTime);
+
+        if (_vCurrent.size() < _iCapacity)
+        {
+            _vCurrent.push_back(slow);
+            std::push_heap(_vCurrent.begin(), _vCurrent.end(), faster);
+        }
+        else if (slow.iCostUs > _vCurrent.front().iCostUs)
+        {
+            std::pop_heap(_vCurrent.begin(), _vCurrent.end(), faster);
+            _vCurrent.back() = slow;
+            std::push_heap(_vCurrent.begin(), _vCurrent.end(), faster);
+        }
+    }
+
+    /**
+    * @brief 上一个周期及当前周期的慢命令, 按耗时从大到小
+    */
+    void dump(vector<RedisSlowCommand> &vLast, vector<RedisSlowCommand> &vCurrent)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            roll(TC_Common::now2ms());
+
+            vLast    = _vLast;
+            vCurrent = _vCurrent;
+        }
+
+        std::sort(vLast.begin(), vLast.end(), faster);
+        std::sort(vCurrent.begin(), vCurrent.end(), faster);
+    }
+
+    /**
+    * @brief 慢命令以文本输出, 每行一条
+    */
+    string dump()
+    {
+        vector<RedisSlowCommand> vLast, vCurrent;
+
+        dump(vLast, vCurrent);
+
+        ostringstream os;
+
+        os << "current interval:" << endl;
+        print(os, vCurrent);
+        os << "last interval:" << endl;
+        print(os, vLast);
+
+        return os.str();
+    }
+
+    /**
+    * @brief 慢命令总数(含未采样的)
+    */
+    uint64_t getSlowCount() const { return _iSlow; }
+
+protected:
+    /**
+    * @brief 小顶堆比较: 耗时小的在堆顶; sort时为从大到小
+    */
+    static bool faster(const RedisSlowCommand &a, const RedisSlowCommand &b)
+    {
+        return a.iCostUs > b.iCostUs;
+    }
+
+    void roll(int64_t iNow)
+    {
+        if (iNow - _iBegin >= _iInterval * 1000LL)
+        {
+            _vLast.swap(_vCurrent);
+            _vCurrent.clear();
+
+            _iBegin = iNow;
+        }
+    }
+
+    /**
+    * @brief 从编码后的命令取命令名, 参数个数及key(第二个参数)的指纹
+    */
+    static void fingerprint(const string &sCommand, RedisSlowCommand &slow)
+    {
+        RedisCommandFingerprint fingerprint;
+
+        fingerprint.parse(sCommand);
+
+        slow.sCmd.swap(fingerprint.sCmd);
+        slow.sKeyPattern.swap(fingerprint.sKeyPattern);
+
+        slow.iArgc     = fingerprint.iArgc;
+        slow.iKeyHash  = fingerprint.iKeyHash;
+        slow.iReqBytes = sCommand.size();
+    }
+
+    static void print(ostream &os, const vector<RedisSlowCommand> &vSlow)
+    {
+        for (size_t i = 0; i < vSlow.size(); i++)
+        {
+            const RedisSlowCommand &s = vSlow[i];
+
+            os << TC_Common::tm2str(s.iTime / 1000) << "|" << s.sEndpoint << "|" << s.sCmd << "|argc:" << s.iArgc
+               << "|key:" << s.sKeyPattern << "|hash:" << std::hex << s.iKeyHash << std::dec
+               << "|req:" << s.iReqBytes << "|rsp:" << s.iRspBytes
+               << "|cost:" << s.iCostUs << "|wait:" << s.iWaitUs << "|call:" << s.iCallUs
+               << (s.bException ? "|exception" : "") << endl;
+        }
+    }
+
+protected:
+    std::mutex                  _mutex;
+
+    std::atomic<int64_t>        _iThreshold;
+
+    size_t                      _iCapacity;
+
+    std::atomic<size_t>         _iSample;
+
+    int                         _iInterval;
+
+    std::atomic<uint64_t>       _iSlow;
+
+    int64_t                     _iBegin;
+
+    vector<RedisSlowCommand>    _vCurrent;
+
+    vector<RedisSlowCommand>    _vLast;
+};
+
+/**
+* @brief 一个请求的追踪信息, 时间单位微秒.
+*
+* 阶段:
+*   queue    调用发起到网络线程开始编码(ServantProxy的队列及网络线程调度)
+*   encode   网络线程把命令写入发送缓冲
+*   wire     发送缓冲就绪到应答分帧完成, 扣除decode(网络传输及服务端处理)
+*   decode   网络线程上RedisRsp分帧的累计耗时
+*   dispatch 应答分帧完成到调用线程被唤醒
+* 调用方从应答缓冲取值的耗时不在其中.
+*/
+struct RedisSpan
+{
+    enum
+    {
+        PHASE_QUEUE = 0,
+        PHASE_ENCODE,
+        PHASE_WIRE,
+        PHASE_DECODE,
+        PHASE_DISPATCH,
+        PHASE_MAX,
+    };
+
+    string   sObj;
+
+    /**
+    * 命令名(大写)
+    */
+    string   sCmd;
+
+    string   sHost;
+
+    int      iPort;
+
+    int      iIndex;
+
+    /**
+    * 开始/结束时间(1970年以来的微秒)
+    */
+    int64_t  iStartUs;
+
+    int64_t  iEndUs;
+
+    /**
+    * 各阶段耗时, 没有经过的阶段为0
+    */
+    int64_t  vPhaseUs[PHASE_MAX];
+
+    size_t   iReqBytes;
+
+    size_t   iRspBytes;
+
+    /**
+    * 是否以异常结束(超时等), 及异常信息
+    */
+    bool     bError;
+
+    string   sError;
+
+    static const char *phaseName(int iPhase)
+    {
+        static const char *sName[PHASE_MAX] = { "queue", "encode", "wire", "decode", "dispatch" };
+
+        return iPhase >= 0 && iPhase < PHASE_MAX ? sName[iPhase] : "unknown";
+    }
+
+    /**
+    * @brief 按OpenTelemetry数据库客户端span的语义约定生成属性, 阶段耗时为 redis.phase.<阶段>_us
+    */
+    void getAttributes(vector<pair<string, string> > &vAttr) const
+    {
+        vAttr.push_back(make_pair("db.system", "redis"));
+        vAttr.push_back(make_pair("db.operation.name", sCmd));
+        vAttr.push_back(make_pair("db.namespace", TC_Common::tostr(iIndex)));
+        vAttr.push_back(make_pair("server.address", sHost));
+        vAttr.push_back(make_pair("server.port", TC_Common::tostr(iPort)));
+        vAttr.push_back(make_pair("tars.obj", sObj));
+        vAttr.push_back(make_pair("redis.request.size", TC_Common::tostr(iReqBytes)));
+        vAttr.push_back(make_pair("redis.response.size", TC_Common::tostr(iRspBytes)));
+
+        for (int i = 0; i < PHASE_MAX; i++)
+        {
+            vAttr.push_back(make_pair(string("redis.phase.") + phaseName(i) + "_us", TC_Common::tostr(vPhaseUs[i])));
+        }
+
+        if (bError)
+        {
+            vAttr.push_back(make_pair("error.type", sError.empty() ? string("exception") : sError));
+        }
+    }
+};
+
+/**
+* @brief 追踪钩子, 在调用线程上每个请求完成后回调, 实现应尽量轻
+*/
+class RedisTraceHook
+{
+public:
+    virtual ~RedisTraceHook() {}
+
+    virtual void onSpan(const RedisSpan &span) = 0;
+};
+
+typedef shared_ptr<RedisTraceHook> RedisTraceHookPtr;
+
+/**
+* @brief 追踪开关及钩子. 关闭时每个请求只多一次原子读
+*/
+class TC_Redis_Trace_Holder : public  tars::TC_HandleBase, public tars::TC_Singleton<TC_Redis_Trace_Holder>
+{
+public:
+    TC_Redis_Trace_Holder()
+        : _bPhase(false)
+        , _bEnable(false)
+    {
+    }
+
+    /**
+    * @brief 开关阶段耗时统计(计入延时统计, 命令名为 phase.<阶段>)
+    */
+    void setPhaseStat(bool bEnable)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _bPhase  = bEnable;
+        _bEnable = _bPhase || _hook;
+    }
+
+    /**
+    * @brief 设置追踪钩子, NULL 取消
+    */
+    void setHook(const RedisTraceHookPtr &hook)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _hook    = hook;
+        _bEnable = _bPhase || _hook;
+    }
+
+    bool isEnable() const { return _bEnable.load(std::memory_order_relaxed); }
+
+    bool isPhaseStat() const { return _bPhase; }
+
+    RedisTraceHookPtr getHook()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return _hook;
+    }
+
+protected:
+    std::mutex              _mutex;
+
+    std::atomic<bool>       _bPhase;
+
+    std::atomic<bool>       _bEnable;
+
+    RedisTraceHookPtr       _hook;
+};
+
+}
+#endif
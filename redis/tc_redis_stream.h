@@ -0,0 +1,498 @@
+#ifndef tc_redis_stream_h__
+#define tc_redis_stream_h__
+#include "tc_redis.h"
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace tars
+{
+
+/////////////////////////////////////////////////
+/**
+* @file  tc_redis_stream.h
+* @brief redis stream消费组的消费端.
+*
+* 拉取线程按COUNT批量XREADGROUP, 消息交给处理线程并行处理;
+* 处理成功的id攒批后一条XACK确认(条数或时间先到为准);
+* 定期XAUTOCLAIM接管已退出消费者遗留的pending消息;
+* 启动时先处理本消费者上次未确认的消息.
+*/
+/////////////////////////////////////////////////
+class RedisStreamConsumer
+{
+public:
+    /**
+    * 处理函数, 返回true时确认该消息, false或抛异常则留在pending中等待重新投递
+    */
+    typedef std::function<bool(const RedisStreamEntry &)> HandlerFunc;
+
+    RedisStreamConsumer()
+        : _iThreadNum(4)
+        , _iBatch(100)
+        , _iBlock(-1)
+        , _iIdleSleep(50)
+        , _iAckBatch(100)
+        , _iAckInterval(100)
+        , _iMinIdle(60000)
+        , _iClaimInterval(30000)
+        , _bTerminate(true)
+        , _bReaderExit(true)
+        , _iInflight(0)
+        , _iLastAck(0)
+        , _iProcessed(0)
+        , _iAcked(0)
+        , _iClaimed(0)
+        , _iFailed(0)
+    {
+    }
+
+    ~RedisStreamConsumer()
+    {
+        stop();
+    }
+
+    /**
+    * @brief 初始化, 需在start()之前调用
+    *
+    * @param prx         redis代理
+    * @param sKey        stream
+    * @param sGroup      消费组, 不存在时自动创建(从最新消息开始)
+    * @param sConsumer   消费者名, 同一组内唯一
+    * @param handler     处理函数
+    * @param iThreadNum  处理线程数
+    * @param iBatch      每次拉取的条数(COUNT)
+    */
+    void init(const RedisPrx &prx, const string &sKey, const string &sGroup, const string &sConsumer,
+              const HandlerFunc &handler, size_t iThreadNum = 4, size_t iBatch = 100)
+    {
+        _prx        = prx;
+        _sKey       = sKey;
+        _sGroup     = sGroup;
+        _sConsumer  = sConsumer;
+        _handler    = handler;
+        _iThreadNum = iThreadNum > 0 ? iThreadNum : 1;
+        _iBatch     = iBatch > 0 ? iBatch : 1;
+    }
+
+    /**
+    * @brief 没有新消息时的等待方式
+    *
+    * @param iBlock      >=0 XREADGROUP BLOCK的毫秒数(在RedisProxy的阻塞命令连接池上执行); <0 不阻塞
+    * @param iIdleSleep  不阻塞时, 没有消息后休眠的毫秒数
+    */
+    void setBlock(int iBlock, int iIdleSleep = 50)
+    {
+        _iBlock     = iBlock;
+        _iIdleSleep = iIdleSleep;
+    }
+
+    /**
+    * @brief 确认攒批: 满iAckBatch条或距上次确认超过iAckInterval毫秒时发送一次XACK
+    */
+    void setAck(size_t iAckBatch, int iAckInterval)
+    {
+        _iAckBatch    = iAckBatch > 0 ? iAckBatch : 1;
+        _iAckInterval = iAckInterval;
+    }
+
+    /**
+    * @brief 接管pending消息: 每iClaimInterval毫秒扫描一轮, 接管空闲超过iMinIdle毫秒的消息; iMinIdle<=0 关闭
+    */
+    void setClaim(int64_t iMinIdle, int iClaimInterval)
+    {
+        _iMinIdle       = iMinIdle;
+        _iClaimInterval = iClaimInterval;
+    }
+
+    void start()
+    {
+        if (!_bTerminate)
+        {
+            return;
+        }
+
+        _bTerminate  = false;
+        _bReaderExit = false;
+
+        try
+        {
+            if (_prx->xgroupCreate(_sKey, _sGroup) != 0)
+            {
+                LOG_CONSOLE_DEBUG << "xgroup create failed, key:" << _sKey << " group:" << _sGroup << endl;
+            }
+        }
+        catch (exception &ex)
+        {
+            LOG_CONSOLE_DEBUG << "xgroup create exception, key:" << _sKey << " error:" << ex.what() << endl;
+        }
+
+        for (size_t i = 0; i < _iThreadNum; i++)
+        {
+            _vWorker.push_back(std::thread(&RedisStreamConsumer::workerLoop, this));
+        }
+
+        _reader = std::thread(&RedisStreamConsumer::readLoop, this);
+    }
+
+    /**
+    * @brief 停止拉取, 已拉取的消息处理完并确认后返回
+    */
+    void stop()
+    {
+        if (_bTerminate)
+        {
+            return;
+        }
+
+        _bTerminate = true;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _notEmpty.notify_all();
+            _notFull.notify_all();
+        }
+
+        if (_reader.joinable())
+        {
+            _reader.join();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _bReaderExit = true;
+            _notEmpty.notify_all();
+        }
+
+        for (size_t i = 0; i < _vWorker.size(); i++)
+        {
+            if (_vWorker[i].joinable())
+            {
+                _vWorker[i].join();
+            }
+        }
+
+        _vWorker.clear();
+
+        flushAck(true);
+    }
+
+    /**
+    * @brief 处理过的消息数
+    */
+    size_t getProcessed() const { return _iProcessed; }
+
+    /**
+    * @brief 已确认的消息数
+    */
+    size_t getAcked() const { return _iAcked; }
+
+    /**
+    * @brief 从其他消费者接管的消息数
+    */
+    size_t getClaimed() const { return _iClaimed; }
+
+    /**
+    * @brief 处理失败的消息数
+    */
+    size_t getFailed() const { return _iFailed; }
+
+protected:
+    void readLoop()
+    {
+        //先处理本消费者上次未确认的消息
+        bool bPending        = true;
+        string sPendingId    = "0";
+        string sClaimStart   = "0-0";
+        int64_t iLastClaim   = TC_Common::now2ms();
+
+        while (!_bTerminate)
+        {
+            flushAck(false);
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+
+                //在途消息有上限, 处理不过来时不再拉取
+                while (_iInflight >= _iBatch * 2 && !_bTerminate)
+                {
+                    _notFull.wait_for(lock, std::chrono::milliseconds(_iAckInterval > 0 ? _iAckInterval : 100));
+
+                    lock.unlock();
+                    flushAck(false);
+                    lock.lock();
+                }
+            }
+
+            if (_bTerminate)
+            {
+                break;
+            }
+
+            vector<RedisStreamEntry> vEntry;
+            int iRet      = -1;
+            bool bReadNew = false;
+
+            try
+            {
+                if (bPending)
+                {
+                    iRet = _prx->xreadgroup(_sKey, _sGroup, _sConsumer, _iBatch, vEntry, -1, sPendingId);
+
+                    if (iRet == 0 && vEntry.empty())
+                    {
+                        bPending = false;
+                    }
+                    else if (!vEntry.empty())
+                    {
+                        sPendingId = vEntry.back().sId;
+                    }
+                }
+                else if (_iMinIdle > 0 && TC_Common::now2ms() - iLastClaim >= _iClaimInterval)
+                {
+                    string sNext;
+
+                    iRet = _prx->xautoclaim(_sKey, _sGroup, _sConsumer, _iMinIdle, sClaimStart, _iBatch, sNext, vEntry);
+
+                    if (iRet != 0 || sNext.empty() || sNext == "0-0")
+                    {
+                        sClaimStart = "0-0";
+                        iLastClaim  = TC_Common::now2ms();
+                    }
+                    else
+                    {
+                        sClaimStart = sNext;
+                    }
+
+                    _iClaimed += vEntry.size();
+                }
+                else
+                {
+                    bReadNew = true;
+                    iRet     = _prx->xreadgroup(_sKey, _sGroup, _sConsumer, _iBatch, vEntry, _iBlock);
+                }
+            }
+            catch (exception &ex)
+            {
+                LOG_CONSOLE_DEBUG << "read stream exception, key:" << _sKey << " error:" << ex.what() << endl;
+            }
+
+            if (vEntry.empty())
+            {
+                //空闲时把剩余的确认发出去
+                flushAck(true);
+
+                if ((iRet != 0 || (bReadNew && _iBlock < 0)) && _iIdleSleep > 0)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(_iIdleSleep));
+                }
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            for (size_t i = 0; i < vEntry.size(); i++)
+            {
+                if (vEntry[i].vField.empty())
+                {
+                    //消息已被删除, 直接确认
+                    _vAck.push_back(vEntry[i].sId);
+                    continue;
+                }
+
+                _queue.push_back(RedisStreamEntry());
+                _queue.back().sId.swap(vEntry[i].sId);
+                _queue.back().vField.swap(vEntry[i].vField);
+                ++_iInflight;
+            }
+
+            _notEmpty.notify_all();
+        }
+
+        //等待已拉取的消息处理完
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (_iInflight > 0)
+        {
+            _notEmpty.notify_all();
+            _notFull.wait_for(lock, std::chrono::milliseconds(100));
+        }
+    }
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            RedisStreamEntry entry;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+
+                while (_queue.empty() && !_bReaderExit)
+                {
+                    _notEmpty.wait(lock);
+                }
+
+                if (_queue.empty())
+                {
+                    return;
+                }
+
+                entry.sId.swap(_queue.front().sId);
+                entry.vField.swap(_queue.front().vField);
+                _queue.pop_front();
+            }
+
+            bool bAck = false;
+
+            try
+            {
+                bAck = _handler(entry);
+            }
+            catch (exception &ex)
+            {
+                LOG_CONSOLE_DEBUG << "handler exception, id:" << entry.sId << " error:" << ex.what() << endl;
+            }
+            catch (...)
+            {
+                LOG_CONSOLE_DEBUG << "handler unknown exception, id:" << entry.sId << endl;
+            }
+
+            ++_iProcessed;
+
+            if (!bAck)
+            {
+                ++_iFailed;
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (bAck)
+            {
+                _vAck.push_back(entry.sId);
+            }
+
+            --_iInflight;
+
+            _notFull.notify_one();
+        }
+    }
+
+    /**
+    * @brief 发送攒批的确认
+    *
+    * @param bForce 不满足条数/时间条件也发送
+    */
+    void flushAck(bool bForce)
+    {
+        vector<string> vAck;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_vAck.empty())
+            {
+                return;
+            }
+
+            if (!bForce && _vAck.size() < _iAckBatch && TC_Common::now2ms() - _iLastAck < _iAckInterval)
+            {
+                return;
+            }
+
+            vAck.swap(_vAck);
+            _iLastAck = TC_Common::now2ms();
+        }
+
+        try
+        {
+            int iRet = _prx->xack(_sKey, _sGroup, vAck);
+
+            if (iRet >= 0)
+            {
+                _iAcked += iRet;
+                return;
+            }
+        }
+        catch (exception &ex)
+        {
+            LOG_CONSOLE_DEBUG << "xack exception, key:" << _sKey << " error:" << ex.what() << endl;
+        }
+
+        //确认失败的消息留在pending中, 之后会被重新投递或接管
+        LOG_CONSOLE_DEBUG << "xack failed, key:" << _sKey << " count:" << vAck.size() << endl;
+    }
+
+protected:
+    RedisPrx                        _prx;
+
+    string                          _sKey;
+
+    string                          _sGroup;
+
+    string                          _sConsumer;
+
+    HandlerFunc                     _handler;
+
+    size_t                          _iThreadNum;
+
+    size_t                          _iBatch;
+
+    int                             _iBlock;
+
+    int                             _iIdleSleep;
+
+    size_t                          _iAckBatch;
+
+    int                             _iAckInterval;
+
+    int64_t                         _iMinIdle;
+
+    int                             _iClaimInterval;
+
+    std::atomic<bool>               _bTerminate;
+
+    /**
+    * 拉取线程已退出, 处理线程处理完队列后退出
+    */
+    bool                            _bReaderExit;
+
+    std::mutex                      _mutex;
+    std::condition_variable         _notEmpty;
+    std::condition_variable         _notFull;
+
+    /**
+    * 待处理的消息
+    */
+    std::deque<RedisStreamEntry>    _queue;
+
+    /**
+    * 已拉取未处理完的消息数
+    */
+    size_t                          _iInflight;
+
+    /**
+    * 待确认的id
+    */
+    vector<string>                  _vAck;
+
+    int64_t                         _iLastAck;
+
+    std::thread                     _reader;
+
+    vector<std::thread>             _vWorker;
+
+    std::atomic<size_t>             _iProcessed;
+
+    std::atomic<size_t>             _iAcked;
+
+    std::atomic<size_t>             _iClaimed;
+
+    std::atomic<size_t>             _iFailed;
+};
+
+}
+#endif
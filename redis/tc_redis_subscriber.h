@@ -0,0 +1,580 @@
+#ifndef tc_redis_subscriber_h__
+#define tc_redis_subscriber_h__
+#include "tc_redis.h"
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace tars
+{
+
+/////////////////////////////////////////////////
+/**
+* @file  tc_redis_subscriber.h
+* @brief redis发布/订阅的订阅端.
+*
+* ServantProxy的请求/应答模型无法表达服务端推送, 订阅端独占一条RedisConnection:
+* 一个接收线程负责收包, 用RedisReplyParser增量分帧, 同时支持RESP2的数组推送和RESP3的'>'推送;
+* 消息按channel哈希到固定的处理线程(保证同一channel内有序), 每个处理线程一个有界队列.
+* 断线后自动重连并重新订阅所有channel/pattern.
+*/
+/////////////////////////////////////////////////
+class RedisSubscriber
+{
+public:
+    /**
+    * @brief 推送的消息
+    */
+    struct Message
+    {
+        /**
+        * 消息所属的channel
+        */
+        string sChannel;
+
+        /**
+        * psubscribe匹配到的pattern, subscribe收到的消息为空
+        */
+        string sPattern;
+
+        /**
+        * 消息内容
+        */
+        string sPayload;
+    };
+
+    typedef std::function<void(const Message &)> HandlerFunc;
+
+    RedisSubscriber()
+        : _iThreadNum(4)
+        , _iQueueCap(10000)
+        , _bResp3(false)
+        , _bDropWhenFull(false)
+        , _iPingInterval(30000)
+        , _iReconnectInterval(1000)
+        , _bTerminate(true)
+        , _iReceived(0)
+        , _iDropped(0)
+        , _iReconnect(0)
+    {
+    }
+
+    ~RedisSubscriber()
+    {
+        stop();
+    }
+
+    /**
+    * @brief 初始化, 需在start()之前调用
+    *
+    * @param tcRDConf    redis配置
+    * @param iThreadNum  处理线程数
+    * @param iQueueCap   每个处理线程的队列上限
+    * @param bResp3      是否用HELLO 3切换到RESP3
+    */
+    void init(const TC_RDConf &tcRDConf, size_t iThreadNum = 4, size_t iQueueCap = 10000, bool bResp3 = false)
+    {
+        _conn.init(tcRDConf);
+
+        _iThreadNum = iThreadNum > 0 ? iThreadNum : 1;
+        _iQueueCap  = iQueueCap > 0 ? iQueueCap : 1;
+        _bResp3     = bResp3;
+    }
+
+    /**
+    * @brief 队列满时丢弃消息(默认阻塞接收线程, 由tcp反压到服务端)
+    */
+    void setDropWhenFull(bool bDrop) { _bDropWhenFull = bDrop; }
+
+    /**
+    * @brief 空闲多久发一次PING探测连接(毫秒), PING在同样时间内无应答则重连
+    */
+    void setPingInterval(int iPingInterval) { _iPingInterval = iPingInterval; }
+
+    /**
+    * @brief 连接失败后的重试间隔(毫秒)
+    */
+    void setReconnectInterval(int iReconnectInterval) { _iReconnectInterval = iReconnectInterval; }
+
+    /**
+    * @brief 订阅channel, 重复订阅会替换handler
+    */
+    void subscribe(const string &sChannel, const HandlerFunc &handler)
+    {
+        {
+            TC_ThreadWLock w(_rwl);
+            _mChannel[sChannel] = std::make_shared<HandlerFunc>(handler);
+        }
+
+        addCommand("SUBSCRIBE", sChannel);
+    }
+
+    /**
+    * @brief 按pattern订阅
+    */
+    void psubscribe(const string &sPattern, const HandlerFunc &handler)
+    {
+        {
+            TC_ThreadWLock w(_rwl);
+            _mPattern[sPattern] = std::make_shared<HandlerFunc>(handler);
+        }
+
+        addCommand("PSUBSCRIBE", sPattern);
+    }
+
+    void unsubscribe(const string &sChannel)
+    {
+        {
+            TC_ThreadWLock w(_rwl);
+            _mChannel.erase(sChannel);
+        }
+
+        addCommand("UNSUBSCRIBE", sChannel);
+    }
+
+    void punsubscribe(const string &sPattern)
+    {
+        {
+            TC_ThreadWLock w(_rwl);
+            _mPattern.erase(sPattern);
+        }
+
+        addCommand("PUNSUBSCRIBE", sPattern);
+    }
+
+    /**
+    * @brief 启动接收线程和处理线程
+    */
+    void start()
+    {
+        if (!_bTerminate)
+        {
+            return;
+        }
+
+        _bTerminate = false;
+
+        for (size_t i = 0; i < _iThreadNum; i++)
+        {
+            _vWorker.push_back(std::make_shared<Worker>());
+        }
+
+        for (size_t i = 0; i < _vWorker.size(); i++)
+        {
+            _vWorker[i]->thread = std::thread(&RedisSubscriber::workerLoop, this, _vWorker[i]);
+        }
+
+        _reader = std::thread(&RedisSubscriber::readerLoop, this);
+    }
+
+    /**
+    * @brief 停止, 已入队的消息会处理完再退出
+    */
+    void stop()
+    {
+        if (_bTerminate)
+        {
+            return;
+        }
+
+        _bTerminate = true;
+
+        for (size_t i = 0; i < _vWorker.size(); i++)
+        {
+            std::lock_guard<std::mutex> lock(_vWorker[i]->mutex);
+            _vWorker[i]->notFull.notify_all();
+            _vWorker[i]->notEmpty.notify_all();
+        }
+
+        if (_reader.joinable())
+        {
+            _reader.join();
+        }
+
+        for (size_t i = 0; i < _vWorker.size(); i++)
+        {
+            if (_vWorker[i]->thread.joinable())
+            {
+                _vWorker[i]->thread.join();
+            }
+        }
+
+        _vWorker.clear();
+
+        _conn.close();
+    }
+
+    /**
+    * @brief 收到的消息数
+    */
+    size_t getReceived() const { return _iReceived; }
+
+    /**
+    * @brief 队列满丢弃的消息数
+    */
+    size_t getDropped() const { return _iDropped; }
+
+    /**
+    * @brief 重连次数
+    */
+    size_t getReconnect() const { return _iReconnect; }
+
+protected:
+    typedef shared_ptr<HandlerFunc> HandlerPtr;
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        std::deque<pair<HandlerPtr, Message> > queue;
+        std::thread thread;
+    };
+
+    typedef shared_ptr<Worker> WorkerPtr;
+
+    void addCommand(const string &sCmd, const string &sArg)
+    {
+        vector<string> vPart;
+        vPart.push_back(sCmd);
+        vPart.push_back(sArg);
+
+        string sCommand;
+        RedisProxy::buildCommand(vPart, sCommand);
+
+        std::lock_guard<std::mutex> lock(_cmdMutex);
+        _sPending += sCommand;
+    }
+
+    /**
+    * @brief 连接并重新订阅全部channel/pattern
+    */
+    int reconnect()
+    {
+        if (_conn.connect() != 0)
+        {
+            return -1;
+        }
+
+        RedisReply reply;
+
+        if (_bResp3)
+        {
+            vector<string> vPart;
+            vPart.push_back("HELLO");
+            vPart.push_back("3");
+
+            string sCommand;
+            RedisProxy::buildCommand(vPart, sCommand);
+
+            if (_conn.call(sCommand, reply) != 0 || reply.isError())
+            {
+                LOG_CONSOLE_DEBUG << "HELLO 3 error:" << reply.str << endl;
+                _conn.close();
+                return -1;
+            }
+        }
+
+        vector<string> vChannel;
+        vector<string> vPattern;
+
+        vChannel.push_back("SUBSCRIBE");
+        vPattern.push_back("PSUBSCRIBE");
+
+        {
+            //重订阅包含了所有已登记的channel, 之前积压的命令不再需要
+            std::lock_guard<std::mutex> lock(_cmdMutex);
+            _sPending.clear();
+
+            TC_ThreadRLock r(_rwl);
+
+            for (map<string, HandlerPtr>::const_iterator it = _mChannel.begin(); it != _mChannel.end(); ++it)
+            {
+                vChannel.push_back(it->first);
+            }
+
+            for (map<string, HandlerPtr>::const_iterator it = _mPattern.begin(); it != _mPattern.end(); ++it)
+            {
+                vPattern.push_back(it->first);
+            }
+        }
+
+        string sCommand;
+
+        if (vChannel.size() > 1)
+        {
+            RedisProxy::buildCommand(vChannel, sCommand);
+
+            if (_conn.send(sCommand) != 0)
+            {
+                return -1;
+            }
+        }
+
+        if (vPattern.size() > 1)
+        {
+            RedisProxy::buildCommand(vPattern, sCommand);
+
+            if (_conn.send(sCommand) != 0)
+            {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    void readerLoop()
+    {
+        bool bFirst       = true;
+        int64_t iLastRecv = 0;
+        int64_t iPingTime = 0;
+
+        while (!_bTerminate)
+        {
+            if (!_conn.isConnected())
+            {
+                if (!bFirst)
+                {
+                    ++_iReconnect;
+                }
+
+                bFirst = false;
+
+                if (reconnect() != 0)
+                {
+                    LOG_CONSOLE_DEBUG << "subscriber connect failed, retry after " << _iReconnectInterval << "ms" << endl;
+
+                    for (int i = 0; i < _iReconnectInterval && !_bTerminate; i += 100)
+                    {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    }
+                    continue;
+                }
+
+                iLastRecv = TC_Common::now2ms();
+                iPingTime = 0;
+            }
+
+            string sPending;
+
+            {
+                std::lock_guard<std::mutex> lock(_cmdMutex);
+                sPending.swap(_sPending);
+            }
+
+            if (!sPending.empty() && _conn.send(sPending) != 0)
+            {
+                continue;
+            }
+
+            int iRet = _conn.recv(100);
+
+            if (iRet < 0)
+            {
+                continue;
+            }
+
+            int64_t iNow = TC_Common::now2ms();
+
+            if (iRet == 0)
+            {
+                if (_iPingInterval > 0 && iNow - iLastRecv > _iPingInterval)
+                {
+                    if (iPingTime == 0)
+                    {
+                        iPingTime = iNow;
+                        _conn.send("*1\r\n$4\r\nPING\r\n");
+                    }
+                    else if (iNow - iPingTime > _iPingInterval)
+                    {
+                        LOG_CONSOLE_DEBUG << "subscriber ping timeout, reconnect" << endl;
+                        _conn.close();
+                    }
+                }
+                continue;
+            }
+
+            iLastRecv = iNow;
+            iPingTime = 0;
+
+            RedisReply reply;
+
+            while (_conn.nextReply(reply) > 0)
+            {
+                onReply(reply);
+
+                reply.element.clear();
+            }
+        }
+    }
+
+    /**
+    * @brief 处理一个推送
+    * RESP2: *3 message channel payload / *4 pmessage pattern channel payload
+    * RESP3: 同样的内容, 类型为'>'
+    */
+    void onReply(RedisReply &reply)
+    {
+        if (reply.type != RedisReply::REPLY_ARRAY && reply.type != RedisReply::REPLY_PUSH)
+        {
+            return;
+        }
+
+        vector<RedisReply> &v = reply.element;
+
+        if (v.size() == 3 && (v[0].str == "message" || v[0].str == "smessage"))
+        {
+            HandlerPtr handler = findHandler(_mChannel, v[1].str);
+
+            if (handler)
+            {
+                Message msg;
+                msg.sChannel.swap(v[1].str);
+                msg.sPayload.swap(v[2].str);
+
+                dispatch(handler, msg);
+            }
+        }
+        else if (v.size() == 4 && v[0].str == "pmessage")
+        {
+            HandlerPtr handler = findHandler(_mPattern, v[1].str);
+
+            if (handler)
+            {
+                Message msg;
+                msg.sPattern.swap(v[1].str);
+                msg.sChannel.swap(v[2].str);
+                msg.sPayload.swap(v[3].str);
+
+                dispatch(handler, msg);
+            }
+        }
+    }
+
+    HandlerPtr findHandler(const map<string, HandlerPtr> &mHandler, const string &sKey)
+    {
+        TC_ThreadRLock r(_rwl);
+
+        map<string, HandlerPtr>::const_iterator it = mHandler.find(sKey);
+
+        return it == mHandler.end() ? HandlerPtr() : it->second;
+    }
+
+    void dispatch(const HandlerPtr &handler, Message &msg)
+    {
+        ++_iReceived;
+
+        const WorkerPtr &worker = _vWorker[std::hash<string>()(msg.sChannel) % _vWorker.size()];
+
+        std::unique_lock<std::mutex> lock(worker->mutex);
+
+        while (worker->queue.size() >= _iQueueCap)
+        {
+            if (_bDropWhenFull || _bTerminate)
+            {
+                ++_iDropped;
+                return;
+            }
+
+            worker->notFull.wait(lock);
+        }
+
+        worker->queue.push_back(make_pair(handler, std::move(msg)));
+
+        if (worker->queue.size() == 1)
+        {
+            worker->notEmpty.notify_one();
+        }
+    }
+
+    void workerLoop(WorkerPtr worker)
+    {
+        std::deque<pair<HandlerPtr, Message> > batch;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(worker->mutex);
+
+                while (worker->queue.empty() && !_bTerminate)
+                {
+                    worker->notEmpty.wait(lock);
+                }
+
+                if (worker->queue.empty())
+                {
+                    return;
+                }
+
+                //整批取走, 减少锁竞争
+                batch.swap(worker->queue);
+
+                worker->notFull.notify_all();
+            }
+
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                try
+                {
+                    (*batch[i].first)(batch[i].second);
+                }
+                catch (exception &ex)
+                {
+                    LOG_CONSOLE_DEBUG << "handler exception, channel:" << batch[i].second.sChannel << " error:" << ex.what() << endl;
+                }
+                catch (...)
+                {
+                    LOG_CONSOLE_DEBUG << "handler unknown exception, channel:" << batch[i].second.sChannel << endl;
+                }
+            }
+
+            batch.clear();
+        }
+    }
+
+protected:
+    RedisConnection             _conn;
+
+    size_t                      _iThreadNum;
+
+    size_t                      _iQueueCap;
+
+    bool                        _bResp3;
+
+    bool                        _bDropWhenFull;
+
+    int                         _iPingInterval;
+
+    int                         _iReconnectInterval;
+
+    std::atomic<bool>           _bTerminate;
+
+    TC_ThreadRWLocker           _rwl;
+
+    map<string, HandlerPtr>     _mChannel;
+
+    map<string, HandlerPtr>     _mPattern;
+
+    /**
+    * 待发送的(un)subscribe命令, 由接收线程发送
+    */
+    std::mutex                  _cmdMutex;
+    string                      _sPending;
+
+    std::thread                 _reader;
+
+    vector<WorkerPtr>           _vWorker;
+
+    std::atomic<size_t>         _iReceived;
+
+    std::atomic<size_t>         _iDropped;
+
+    std::atomic<size_t>         _iReconnect;
+};
+
+}
+#endif